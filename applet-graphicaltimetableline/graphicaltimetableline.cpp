@@ -24,6 +24,7 @@
 #include <stopwidget.h>
 #include <checkcombobox.h>
 #include <vehicletypemodel.h>
+#include <vehicleiconatlas.h>
 
 // KDE includes
 #include <KLocale>
@@ -868,61 +869,32 @@ void GraphicalTimetableLine::paintVehicle( QPainter* painter, VehicleType vehicl
     bool drawTransportLine = m_drawTransportLine && !transportLine.isEmpty()
             && PublicTransport::Global::generalVehicleType(vehicle) == LocalPublicTransport;
 
-    QString vehicleKey;
-    switch ( vehicle ) {
-        case Tram: vehicleKey = "tram"; break;
-        case Bus: vehicleKey = "bus"; break;
-        case TrolleyBus: vehicleKey = "trolleybus"; break;
-        case Subway: vehicleKey = "subway"; break;
-        case Metro: vehicleKey = "metro"; break;
-        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-        case RegionalTrain: vehicleKey = "regionaltrain"; break;
-        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-        case IntercityTrain: vehicleKey = "intercitytrain"; break;
-        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-        case Feet: vehicleKey = "feet"; break;
-        case Ship: vehicleKey = "ship"; break;
-        case Plane: vehicleKey = "plane"; break;
-        default:
-            kDebug() << "Unknown vehicle type" << vehicle;
-            return; // TODO: draw a simple circle or something.. or an unknown vehicle type icon
-    }
-    if ( drawTransportLine ) {
-        vehicleKey.append( "_empty" );
-    }
-    if ( !m_svg.hasElement(vehicleKey) ) {
-        kDebug() << "SVG element" << vehicleKey << "not found";
-        return;
+    const VehicleIconAtlas::IconFlags iconFlags = drawTransportLine
+            ? VehicleIconAtlas::EmptyIcon : VehicleIconAtlas::ColoredIcon;
+    const QString vehicleKey = VehicleIconAtlas::iconKey( vehicle, iconFlags );
+    if ( vehicleKey.isEmpty() ) {
+        kDebug() << "Unknown vehicle type" << vehicle;
+        return; // TODO: draw a simple circle or something.. or an unknown vehicle type icon
     }
 
+    // Get the pre-rendered vehicle icon, with the transport line string drawn into it
+    // (only for local public transport)
     int shadowWidth = 4;
-    m_svg.resize( rect.width() - 2 * shadowWidth, rect.height() - 2 * shadowWidth );
+    const QSize iconSize( int(rect.width()) - 2 * shadowWidth, int(rect.height()) - 2 * shadowWidth );
+    VehicleIconAtlas *atlas = VehicleIconAtlas::instance();
+    const QImage icon = drawTransportLine
+            ? atlas->iconWithTransportLine( m_svg.imagePath(), vehicle, iconFlags, iconSize,
+                                            transportLine, font() )
+            : atlas->icon( m_svg.imagePath(), vehicleKey, iconSize );
+    if ( icon.isNull() ) {
+        return;
+    }
 
     QPixmap pixmap( (int)rect.width(), (int)rect.height() );
     pixmap.fill( Qt::transparent );
     QPainter p( &pixmap );
-    m_svg.paint( &p, shadowWidth, shadowWidth, vehicleKey );
-
-    // Draw transport line string (only for local public transport)
-    if ( drawTransportLine ) {
-        QString text = transportLine;
-        text.remove( ' ' );
-
-        QFont f = font();
-        f.setBold( true );
-        if ( text.length() > 2 ) {
-            f.setPixelSize( qMax(8, qCeil(1.2 * rect.width() / text.length())) );
-        } else {
-            f.setPixelSize( rect.width() * 0.55 );
-        }
-        p.setFont( f );
-        p.setPen( Qt::white );
-
-        QRect textRect( shadowWidth, shadowWidth,
-                        rect.width() - 2 * shadowWidth, rect.height() - 2 * shadowWidth );
-        p.drawText( textRect, text, QTextOption(Qt::AlignCenter) );
-    }
+    p.drawImage( shadowWidth, shadowWidth, icon );
+    p.end();
 
     QImage shadow = pixmap.toImage();
     Plasma::PaintUtils::shadowBlur( shadow, shadowWidth - 1, Qt::black );
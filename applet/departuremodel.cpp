@@ -28,9 +28,13 @@
 #include <Plasma/Animation>
 
 #include <QTimer>
+#include <QSet>
 #include <QPropertyAnimation>
 #include <qmath.h>
 
+// Alarms get fired up to this number of seconds before the alarm time
+static const int ALARM_TOLERANCE_SECONDS = 10;
+
 // Used to sort departures in the model
 class DepartureModelLessThan
 {
@@ -961,10 +965,6 @@ void DepartureItem::updateTimeValues()
             timeFlags.testFlag(Settings::ShowDepartureTime), m_info->linesPerRow );
         setText( ColumnDeparture, depText );
     }
-
-    if ( m_model ) {
-        m_model->itemChanged( this, 2, 2 );
-    }
 }
 
 bool DepartureItem::hasDataForChildType( ItemType itemType )
@@ -1249,7 +1249,7 @@ void JourneyItem::setAlarmStates(AlarmStates alarmStates)
 
 PublicTransportModel::PublicTransportModel( QObject* parent )
         : QAbstractItemModel( parent ), m_nextItem( 0 ),
-        m_updateTimer( new QTimer(this) )
+        m_updateTimer( new QTimer(this) ), m_collectItemChanges( false )
 {
     m_updateTimer->setInterval( 60000 );
     connect( m_updateTimer, SIGNAL(timeout()), this, SLOT(update()) );
@@ -1288,9 +1288,11 @@ void PublicTransportModel::setSizeFactor( float sizeFactor )
 void PublicTransportModel::setDepartureColumnSettings( Settings::DepartureTimeFlags flags )
 {
     m_info.departureTimeFlags = flags;
+    beginItemChanges();
     foreach( ItemBase *item, m_items ) {
         item->updateTimeValues();
     }
+    endItemChanges();
 }
 
 void PublicTransportModel::setProviderFeatures( const QStringList &providerFeatures )
@@ -1375,6 +1377,19 @@ QModelIndex PublicTransportModel::indexFromItem( ItemBase* item, int column ) co
 
 void PublicTransportModel::itemChanged( ItemBase* item, int columnLeft, int columnRight )
 {
+    if ( m_collectItemChanges && item && !item->parent() ) {
+        // Emit dataChanged() later for ranges of changed rows
+        const int row = item->row();
+        QMap< int, QPair<int, int> >::Iterator it = m_changedRows.find( row );
+        if ( it == m_changedRows.end() ) {
+            m_changedRows.insert( row, qMakePair(columnLeft, columnRight) );
+        } else {
+            it->first = qMin( it->first, columnLeft );
+            it->second = qMax( it->second, columnRight );
+        }
+        return;
+    }
+
     if ( columnLeft == columnRight ) {
         QModelIndex index = indexFromItem( item, columnLeft );
         if ( !index.isValid() ) {
@@ -1406,6 +1421,35 @@ void PublicTransportModel::childrenChanged( ItemBase* parentItem )
     }
 }
 
+void PublicTransportModel::beginItemChanges()
+{
+    m_collectItemChanges = true;
+}
+
+void PublicTransportModel::endItemChanges()
+{
+    m_collectItemChanges = false;
+
+    // Emit dataChanged() for each range of consecutive changed rows
+    QMap< int, QPair<int, int> >::ConstIterator it = m_changedRows.constBegin();
+    while ( it != m_changedRows.constEnd() ) {
+        const int firstRow = it.key();
+        int lastRow = firstRow;
+        int columnLeft = it->first;
+        int columnRight = it->second;
+        for ( ++it; it != m_changedRows.constEnd() && it.key() == lastRow + 1; ++it ) {
+            lastRow = it.key();
+            columnLeft = qMin( columnLeft, it->first );
+            columnRight = qMax( columnRight, it->second );
+        }
+
+        if ( lastRow < m_items.count() ) {
+            emit dataChanged( index(firstRow, columnLeft), index(lastRow, columnRight) );
+        }
+    }
+    m_changedRows.clear();
+}
+
 QVariant PublicTransportModel::data( const QModelIndex& index, int role ) const
 {
     if ( !index.isValid() ) {
@@ -1715,33 +1759,45 @@ JourneyItem* JourneyModel::findNextItem( bool sortedByDepartureAscending ) const
 
 DepartureModel::DepartureModel( QObject* parent ) : PublicTransportModel( parent )
 {
+    // Started for the next deadline in scheduleUpdate()
+    m_updateTimer->setSingleShot( true );
+}
+
+void DepartureModel::startUpdateTimer()
+{
+    // Called at the first full minute, update() schedules the next update
+    update();
 }
 
 void DepartureModel::update()
 {
+    const QDateTime now = QDateTime::currentDateTime();
+    beginItemChanges();
+
     // Check for alarms that should now be fired
-    if ( !m_alarms.isEmpty() ) {
-        QDateTime nextAlarm = m_alarms.keys().first();
-        int secs = QDateTime::currentDateTime().secsTo( nextAlarm );
-        if ( secs < 10 ) {
-            while ( m_alarms.contains( nextAlarm ) ) {
-                DepartureItem *item = m_alarms.take( nextAlarm );
-                fireAlarm( nextAlarm, item );
-            }
-        }
+    while ( !m_alarms.isEmpty() &&
+            now.secsTo(m_alarms.constBegin().key()) < ALARM_TOLERANCE_SECONDS )
+    {
+        const QDateTime nextAlarm = m_alarms.constBegin().key();
+        DepartureItem *item = m_alarms.take( nextAlarm );
+        fireAlarm( nextAlarm, item );
     }
 
     // Sort out departures in the past
     int row = 0;
+    bool hasLeavingDepartures = false;
     m_nextItem = m_items.isEmpty() ? 0 : static_cast<DepartureItem*>( m_items[row] );
     QDateTime nextDeparture = m_nextItem
             ? static_cast<DepartureItem*>(m_nextItem)->departureInfo()->predictedDeparture()
             : QDateTime();
     nextDeparture.setTime( QTime(nextDeparture.time().hour(), nextDeparture.time().minute()) ); // Set second to 0
-    while ( m_nextItem && nextDeparture < QDateTime::currentDateTime() ) {
+    while ( m_nextItem && nextDeparture <= now ) {
         // The next departure is in the past
         DepartureItem *leavingItem = static_cast<DepartureItem*>( m_nextItem );
-        leavingItem->setLeavingSoon( true );
+        if ( !leavingItem->isLeavingSoon() ) {
+            leavingItem->setLeavingSoon( true );
+        }
+        hasLeavingDepartures = true;
 
         // Go to the next item, if any
         ++row;
@@ -1753,17 +1809,76 @@ void DepartureModel::update()
         nextDeparture.setTime( QTime(nextDeparture.time().hour(), nextDeparture.time().minute()) ); // Set second to 0
     }
 
-    // Wait 10 seconds before removing the departure.
-    // By having called setLeavingSoon(true) the items to be removed will animate to indicate that
-    // they are leaving soon.
-    QTimer::singleShot( 10000, this, SLOT(removeLeavingDepartures()) );
+    if ( hasLeavingDepartures ) {
+        // Wait 10 seconds before removing the departure.
+        // By having called setLeavingSoon(true) the items to be removed will animate to indicate
+        // that they are leaving soon.
+        QTimer::singleShot( 10000, this, SLOT(removeLeavingDepartures()) );
+    }
+
+    // Update departure column if necessary (remaining minutes or dates at midnight),
+    // only items with changed texts notify the model
+    foreach( ItemBase *item, m_items ) {
+        item->updateTimeValues();
+    }
+
+    endItemChanges();
+    scheduleUpdate();
+}
+
+QDateTime DepartureModel::nextUpdateTime() const
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    QDateTime next;
+
+    // The next departure starts leaving in it's departure minute
+    const DepartureItem *nextItem = static_cast<DepartureItem*>( m_nextItem );
+    if ( nextItem && !nextItem->isLeavingSoon() ) {
+        next = nextItem->departureInfo()->predictedDeparture();
+        next.setTime( QTime(next.time().hour(), next.time().minute()) ); // Set second to 0
+    }
+
+    // The earliest pending alarm
+    if ( !m_alarms.isEmpty() ) {
+        const QDateTime alarm = m_alarms.constBegin().key().addSecs( -ALARM_TOLERANCE_SECONDS );
+        if ( !next.isValid() || alarm < next ) {
+            next = alarm;
+        }
+    }
 
-    // Update departure column if necessary (remaining minutes)
-    if ( m_info.departureTimeFlags.testFlag(Settings::ShowRemainingTime) ) {
-        foreach( ItemBase *item, m_items ) {
-            item->updateTimeValues();
+    // Departure texts change each minute if remaining minutes are shown,
+    // otherwise dates get added/removed at midnight
+    if ( !m_items.isEmpty() ) {
+        const QDateTime textChange = m_info.departureTimeFlags.testFlag(Settings::ShowRemainingTime)
+                ? QDateTime(now.date(), QTime(now.time().hour(), now.time().minute())).addSecs(60)
+                : QDateTime(now.date().addDays(1), QTime(0, 0));
+        if ( !next.isValid() || textChange < next ) {
+            next = textChange;
         }
     }
+
+    return next;
+}
+
+void DepartureModel::scheduleUpdate()
+{
+    const QDateTime next = nextUpdateTime();
+    if ( !next.isValid() ) {
+        // Nothing to update
+        m_updateTimer->stop();
+        return;
+    }
+
+    const qint64 msecs = QDateTime::currentDateTime().msecsTo( next );
+    m_updateTimer->start( int(qBound(qint64(0), msecs, qint64(24 * 60 * 60 * 1000))) );
+}
+
+void DepartureModel::setDepartureColumnSettings( Settings::DepartureTimeFlags flags )
+{
+    PublicTransportModel::setDepartureColumnSettings( flags );
+
+    // Remaining minutes may have been enabled or disabled
+    scheduleUpdate();
 }
 
 void DepartureModel::removeLeavingDepartures()
@@ -1806,12 +1921,18 @@ void DepartureModel::setAlarmSettings( const AlarmSettingsList& alarm )
         it = m_alarms.erase( it );
     }
 
-    // Set new alarms (go through all alarm settings for all departures)
+    // Set new alarms (go through all alarm settings for all departures),
+    // compile the alarm filters once for all departures
+    QVector< CompiledFilter > alarmFilters;
+    alarmFilters.reserve( m_info.alarm.count() );
+    foreach ( const AlarmSettings &alarm, m_info.alarm ) {
+        alarmFilters << CompiledFilter( alarm.filter );
+    }
     for ( int row = 0; row < m_items.count(); ++row ) {
         for ( int a = 0; a < m_info.alarm.count(); ++a ) {
-            AlarmSettings alarm = m_info.alarm.at( a );
+            const AlarmSettings &alarm = m_info.alarm.at( a );
             if ( alarm.enabled
-                    && alarm.filter.match(
+                    && alarmFilters[a].match(
                         *static_cast<DepartureItem*>(m_items[row])->departureInfo() ) )
             {
                 // Current alarm is enabled and matches the current departure
@@ -1872,9 +1993,9 @@ QVariant DepartureModel::headerData( int section, Qt::Orientation orientation,
     return QVariant();
 }
 
-QList< uint > DepartureModel::itemHashes() const
+QList< quint64 > DepartureModel::itemHashes() const
 {
-    QList< uint > hashes;
+    QList< quint64 > hashes;
     foreach( ItemBase *item, m_items ) {
         hashes << static_cast<DepartureItem*>( item )->departureInfo()->hash();
     }
@@ -2002,22 +2123,153 @@ DepartureItem *DepartureModel::addItem( const DepartureInfo& departureInfo,
 
     // Create and insert the new DepartureItem
     beginInsertRows( QModelIndex(), insertBefore, insertBefore );
+    DepartureItem *newItem = createItem( departureInfo );
+    m_items.insert( insertBefore, newItem );
+    endInsertRows();
+
+    itemAdded( newItem, sortColumn == ColumnDeparture && sortOrder == Qt::AscendingOrder );
+    scheduleUpdate();
+    return newItem;
+}
+
+void DepartureModel::mergeItems( const QList<DepartureInfo> &departures, int maximalItemCount )
+{
+    DepartureModelLessThan lt( ColumnDeparture );
+
+    // Update existing items and collect items to remove and new departures
+    QSet< ItemBase* > removeItems;
+    QList< const DepartureInfo* > newDepartures;
+    QSet< quint64 > newHashes;
+    bool newDeparturesSorted = true;
+    foreach ( const DepartureInfo &departureInfo, departures ) {
+        ItemBase *existingItem = m_infoToItem.value( departureInfo.hash(), 0 );
+        if ( existingItem ) {
+            if ( departureInfo.isFilteredOut() ) {
+                // Departure has been marked as "filtered out" in the DepartureProcessor
+                removeItems.insert( existingItem );
+            } else {
+                updateItem( static_cast<DepartureItem*>(existingItem), departureInfo );
+            }
+        } else if ( !departureInfo.isFilteredOut() && !newHashes.contains(departureInfo.hash()) ) {
+            if ( !newDepartures.isEmpty() && lt(&departureInfo, newDepartures.last()) ) {
+                newDeparturesSorted = false;
+            }
+            newDepartures << &departureInfo;
+            newHashes.insert( departureInfo.hash() );
+        }
+    }
+
+    // Remove items in as few contiguous row ranges as possible, beginning at the end
+    int row = m_items.count() - 1;
+    while ( row >= 0 && !removeItems.isEmpty() ) {
+        if ( !removeItems.contains(m_items[row]) ) {
+            --row;
+            continue;
+        }
+
+        int first = row;
+        while ( first > 0 && removeItems.contains(m_items[first - 1]) ) {
+            --first;
+        }
+        for ( int i = first; i <= row; ++i ) {
+            removeItems.remove( m_items[i] );
+        }
+        removeRows( first, row - first + 1 );
+        row = first - 1;
+    }
+
+    // Updated departures may have changed their order, eg. because of a new delay,
+    // only sort the model in this case
+    for ( int i = 1; i < m_items.count(); ++i ) {
+        if ( lt(static_cast<DepartureItem*>(m_items[i])->departureInfo(),
+                static_cast<DepartureItem*>(m_items[i - 1])->departureInfo()) )
+        {
+            sort( ColumnDeparture );
+            break;
+        }
+    }
+
+    if ( !newDeparturesSorted ) {
+        kDebug() << "New departures are not sorted";
+        qStableSort( newDepartures.begin(), newDepartures.end(), lt );
+    }
+
+    // Merge the sorted new departures into the sorted items, insert runs of new departures
+    // that get inserted before the same existing item at once
+    row = 0;
+    int i = 0;
+    while ( i < newDepartures.count() &&
+            (maximalItemCount < 0 || row < maximalItemCount) )
+    {
+        // Skip items departing before or at the same time as the new departure
+        while ( row < m_items.count() && !lt(newDepartures[i],
+                static_cast<DepartureItem*>(m_items[row])->departureInfo()) )
+        {
+            ++row;
+        }
+        if ( maximalItemCount >= 0 && row >= maximalItemCount ) {
+            // All remaining new departures would be inserted after the maximal item count
+            break;
+        }
+
+        // Find all new departures that get inserted before the item at row
+        int end = i + 1;
+        if ( row == m_items.count() ) {
+            end = newDepartures.count();
+        } else {
+            const DepartureInfo *nextInfo =
+                    static_cast<DepartureItem*>( m_items[row] )->departureInfo();
+            while ( end < newDepartures.count() && lt(newDepartures[end], nextInfo) ) {
+                ++end;
+            }
+        }
+        if ( maximalItemCount >= 0 ) {
+            end = qMin( end, i + maximalItemCount - row );
+        }
+
+        beginInsertRows( QModelIndex(), row, row + end - i - 1 );
+        for ( int n = i; n < end; ++n ) {
+            m_items.insert( row + n - i, createItem(*newDepartures[n]) );
+        }
+        endInsertRows();
+
+        for ( int n = row; n < row + end - i; ++n ) {
+            itemAdded( static_cast<DepartureItem*>(m_items[n]), true );
+        }
+        row += end - i;
+        i = end;
+    }
+
+    // Limit the item count, existing items may have been moved after the maximal item count
+    if ( maximalItemCount >= 0 && m_items.count() > maximalItemCount ) {
+        removeRows( maximalItemCount, m_items.count() - maximalItemCount );
+    }
+
+    // The next departure or alarm may have changed
+    scheduleUpdate();
+}
+
+DepartureItem *DepartureModel::createItem( const DepartureInfo &departureInfo )
+{
     DepartureItem *newItem = new DepartureItem( departureInfo, &m_info );
     m_infoToItem.insert( departureInfo.hash(), newItem );
-    m_items.insert( insertBefore, newItem );
     newItem->setModel( this );
-    endInsertRows();
+    return newItem;
+}
+
+void DepartureModel::itemAdded( DepartureItem *newItem, bool sortedByDepartureAscending )
+{
+    const DepartureInfo &departureInfo = *newItem->departureInfo();
 
     // Ensure m_nextItem points to the next departure in the list
     if ( m_nextItem ) {
-        if ( newItem->departureInfo()->predictedDeparture() <
+        if ( departureInfo.predictedDeparture() <
              static_cast<DepartureItem*>(m_nextItem)->departureInfo()->predictedDeparture() )
         {
             m_nextItem = newItem;
         }
     } else {
-        m_nextItem = findNextItem( sortColumn == ColumnDeparture
-                                && sortOrder == Qt::AscendingOrder );
+        m_nextItem = findNextItem( sortedByDepartureAscending );
     }
 
     // Handle alarms
@@ -2053,8 +2305,6 @@ DepartureItem *DepartureModel::addItem( const DepartureInfo& departureInfo,
             }
         }
     }
-
-    return newItem;
 }
 
 void PublicTransportModel::appendChild( ItemBase *parent, ChildItem *child )
@@ -2096,6 +2346,7 @@ void DepartureModel::clear()
 {
     PublicTransportModel::clear();
     m_alarms.clear();
+    scheduleUpdate();
 }
 
 void DepartureModel::alarmItemDestroyed( QObject* item )
@@ -2116,6 +2367,9 @@ void DepartureModel::addAlarm( DepartureItem* item )
         connect( item, SIGNAL(destroyed(QObject*)), this, SLOT(alarmItemDestroyed(QObject*)) );
         m_alarms.insert( alarmTime, item );
         item->setAlarmStates( (item->alarmStates() & ~AlarmFired) | AlarmPending );
+
+        // The alarm may be the next one
+        scheduleUpdate();
     }
 }
 
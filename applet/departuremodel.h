@@ -630,7 +630,8 @@ public:
 
     void setSizeFactor( float sizeFactor );
 
-    void setDepartureColumnSettings( Settings::DepartureTimeFlags flags = Settings::DefaultDepartureTimeFlags );
+    virtual void setDepartureColumnSettings(
+            Settings::DepartureTimeFlags flags = Settings::DefaultDepartureTimeFlags );
 
     void setHomeStop( const QString &homeStop ) {
         m_info.homeStop = homeStop;
@@ -673,6 +674,17 @@ public:
      **/
     void childrenChanged( ItemBase *parentItem );
 
+    /**
+     * @brief Collect changes of toplevel items until endItemChanges() gets called.
+     *
+     * Instead of emitting dataChanged() for each changed item (and column), dataChanged()
+     * gets emitted once for each range of changed rows in endItemChanges().
+     **/
+    void beginItemChanges();
+
+    /** @brief Emit dataChanged() for all items changed since beginItemChanges(). */
+    void endItemChanges();
+
 signals:
     /**
      * @brief The @p items will get removed after this signal was emitted.
@@ -693,7 +705,7 @@ public slots:
     void setHighlightedStop( const QString &stopName = QString() );
 
 protected slots:
-    void startUpdateTimer();
+    virtual void startUpdateTimer();
 
     /** @brief Called each full minute. */
     virtual void update() = 0;
@@ -704,11 +716,14 @@ protected:
     void appendChild( ItemBase *parent, ChildItem *child );
 
     QList< ItemBase* > m_items;
-    QHash< uint, ItemBase* > m_infoToItem;
+    QHash< quint64, ItemBase* > m_infoToItem;
     ItemBase *m_nextItem;
 
     Info m_info;
     QTimer *m_updateTimer;
+
+    bool m_collectItemChanges;
+    QMap< int, QPair<int, int> > m_changedRows; // First/last changed column by changed row
 };
 
 class QTimer;
@@ -760,7 +775,7 @@ public:
      *
      * Hashes can be retrieved using qHash or @ref DepartureInfo::hash.
      **/
-    QList< uint > itemHashes() const;
+    QList< quint64 > itemHashes() const;
 
     QList< DepartureInfo > departureInfos() const;
 
@@ -778,6 +793,22 @@ public:
     virtual DepartureItem *addItem( const DepartureInfo &departureInfo,
                 Columns sortColumn = ColumnDeparture,
                 Qt::SortOrder sortOrder = Qt::AscendingOrder );
+
+    /**
+     * @brief Merges a batch of @p departures into the model in a single pass.
+     *
+     * The model needs to be sorted by departure in ascending order, @p departures should also
+     * be sorted that way (otherwise they get sorted first). New departures get inserted using
+     * one beginInsertRows() call for each run of departures that get inserted at the same
+     * position. Departures that are already in the model get updated, or removed in contiguous
+     * row ranges if they are marked as filtered out. The model only gets sorted again, ie.
+     * layoutChanged() only gets emitted, if updated departures changed their order.
+     *
+     * @param departures The departures to merge into the model, sorted by departure.
+     * @param maximalItemCount The maximal number of items in the model, departures after this
+     *   count do not get inserted and existing items after it get removed. -1 for no limit.
+     **/
+    void mergeItems( const QList<DepartureInfo> &departures, int maximalItemCount = -1 );
     /**
      * @brief Updates the given @p departureItem with the given @p newDepartureInfo.
      *
@@ -823,6 +854,17 @@ public:
     void setColorGroups( const ColorGroupSettingsList &colorGroups );
     ColorGroupSettingsList colorGroups() const { return m_colorGroups; };
 
+    /** @brief Also updates when update() gets called next. */
+    virtual void setDepartureColumnSettings(
+            Settings::DepartureTimeFlags flags = Settings::DefaultDepartureTimeFlags );
+
+    /**
+     * @brief The date and time at which update() gets called next.
+     *
+     * Invalid, if no update is scheduled, ie. if the model is empty and there are no alarms.
+     **/
+    QDateTime nextUpdateTime() const;
+
 signals:
     /** @brief The alarm for @p item has been fired. */
     void alarmFired( DepartureItem *item, const AlarmSettings &alarm );
@@ -840,9 +882,17 @@ protected slots:
     /**
      * @brief Updates time values, checks for alarms and sorts out old departures.
      *
-     * Called each full minute. */
+     * Not called each full minute, but at the earliest deadline of all items, ie. when the
+     * next departure leaves, when the next alarm should be fired or when departure texts
+     * change (each full minute only if remaining minutes are shown, otherwise at midnight).
+     * Only changed rows get updated, dataChanged() gets emitted once for each range of
+     * changed rows.
+     * @see nextUpdateTime
+     **/
     virtual void update();
 
+    virtual void startUpdateTimer();
+
     void removeLeavingDepartures();
 
     void alarmItemDestroyed( QObject *item );
@@ -851,6 +901,15 @@ private:
     virtual DepartureItem *findNextItem( bool sortedByDepartureAscending = false ) const;
     void fireAlarm( const QDateTime& dateTime, DepartureItem* item );
 
+    // Start the update timer for the earliest deadline, see nextUpdateTime()
+    void scheduleUpdate();
+
+    // Create a new item for @p departureInfo, call between beginInsertRows() and endInsertRows()
+    DepartureItem *createItem( const DepartureInfo &departureInfo );
+
+    // Update the next item and handle alarms of a new item, call after endInsertRows()
+    void itemAdded( DepartureItem *newItem, bool sortedByDepartureAscending );
+
     QMultiMap< QDateTime, DepartureItem* > m_alarms;
     ColorGroupSettingsList m_colorGroups; // A list of color groups for the current stop
 };
@@ -884,7 +943,7 @@ public:
      * @brief A list of hashes of all departure items.
      *
      * Hashes can be retrieved using qHash or @ref JourneyInfo::hash. */
-    QList< uint > itemHashes() const;
+    QList< quint64 > itemHashes() const;
 
     virtual JourneyItem *addItem( const JourneyInfo &journeyInfo,
             Columns sortColumn = ColumnDeparture, Qt::SortOrder sortOrder = Qt::AscendingOrder );
@@ -27,6 +27,7 @@
 // libpublictransporthelper includes
 #include <departureinfo.h>
 #include <global.h>
+#include <vehicleiconatlas.h>
 
 // KDE+Plasma includes
 #include <Plasma/Theme>
@@ -51,36 +52,23 @@ DeparturePainter::~DeparturePainter()
 
 QString DeparturePainter::iconKey( VehicleType vehicle, DeparturePainter::VehicleIconFlags flags )
 {
-    QString vehicleKey;
-    switch ( vehicle ) {
-        case Tram: vehicleKey = "tram"; break;
-        case Bus: vehicleKey = "bus"; break;
-        case TrolleyBus: vehicleKey = "trolleybus"; break;
-        case Subway: vehicleKey = "subway"; break;
-        case Metro: vehicleKey = "metro"; break;
-        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-        case RegionalTrain: vehicleKey = "regionaltrain"; break;
-        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-        case IntercityTrain: vehicleKey = "intercitytrain"; break;
-        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-        case Feet: vehicleKey = "feet"; break;
-        case Ship: vehicleKey = "ship"; break;
-        case Plane: vehicleKey = "plane"; break;
-        default:
-            kDebug() << "Unknown vehicle type" << vehicle;
-            return QString();
+    const QString vehicleKey = VehicleIconAtlas::iconKey( vehicle, atlasIconFlags(flags) );
+    if ( vehicleKey.isEmpty() ) {
+        kDebug() << "Unknown vehicle type" << vehicle;
     }
+    return vehicleKey;
+}
 
-    // Use monochrome (mostly white) icons
+VehicleIconAtlas::IconFlags DeparturePainter::atlasIconFlags( VehicleIconFlags flags )
+{
+    VehicleIconAtlas::IconFlags atlasFlags = VehicleIconAtlas::ColoredIcon;
     if ( flags.testFlag(MonochromeIcon) ) {
-        vehicleKey.append( "_white" );
+        atlasFlags |= VehicleIconAtlas::MonochromeIcon;
     }
     if ( flags.testFlag(EmptyIcon) ) {
-        vehicleKey.append( "_empty" );
+        atlasFlags |= VehicleIconAtlas::EmptyIcon;
     }
-
-    return vehicleKey;
+    return atlasFlags;
 }
 
 DeparturePainter::VehicleIconFlags DeparturePainter::iconFlagsFromIconDrawFlags(
@@ -119,67 +107,22 @@ void DeparturePainter::paintVehicle( QPainter* painter, VehicleType vehicle,
         vehiclePixmap = QPixmap( int(rect.width()), int(rect.height()) );
         vehiclePixmap.fill( Qt::transparent );
         QPainter p( &vehiclePixmap );
-        p.setRenderHint( QPainter::Antialiasing );
 
-        // Resize vehicle type icon SVG and draw it
-        m_svg->resize( rect.width() - shadowWidth, rect.height() - shadowWidth );
-        m_svg->paint( &p, shadowWidth / 2, shadowWidth / 2, vehicleKey );
-
-        // Draw transport line string (only for local public transport)
+        // Get the pre-rendered vehicle type icon, with the transport line string drawn into it
+        // (only for local public transport)
+        const QSize iconSize( int(rect.width()) - shadowWidth, int(rect.height()) - shadowWidth );
+        VehicleIconAtlas *atlas = VehicleIconAtlas::instance();
+        QImage icon;
         if ( drawTransportLine ) {
-            QString text;
-            if ( transportLine.length() > 8 ) {
-                // The transport line string is too long to be drawn inside a vehicle icon
-                const QStringList words = transportLine.split( QRegExp("[ \\-_\\+&/\\\\]"),
-                                                               QString::SkipEmptyParts );
-                if ( words.count() == 1 ) {
-                    // No spaces in the transport line string, remove all lower case letters
-                    text = words[0];
-                    text.remove( QRegExp("[a-z]+") );
-                    if ( text.length() > 8 ) {
-                        // Still more than eight characters, cut the string
-                        text = text.left( 8 );
-                    }
-                } else {
-                    // Multiple words in the transport line string,
-                    // create an abbreviation by only using the first letter of each word
-                    foreach ( const QString &word, words ) {
-                        text += word[0]; // Empty parts are skipped, therefore word is not empty
-                    }
-                }
-            } else {
-                text = transportLine;
-                text.replace(' ', QString());
-            }
-
-            QFont font = Plasma::Theme::defaultTheme()->font( Plasma::Theme::DefaultFont );
-            font.setBold( true );
-            if ( text.length() > 2 ) {
-                font.setPixelSize( qMax(8, qCeil(1.18 * rect.width() / text.length())) );
-            } else {
-                font.setPixelSize( rect.width() * 0.5 );
-            }
-            p.setFont( font );
-            QFontMetrics fm( font );
-            if ( iconDrawFlags.testFlag(DrawMonochromeIcon) ) {
-                // For monochrome icons, draw white text with a dark gray outline
-                QPen textOutlinePen( QColor(0, 0, 0, 100) );
-                textOutlinePen.setWidthF( qMin(qreal(10.0), qreal(font.pixelSize() / 5.0)) );
-                textOutlinePen.setCapStyle( Qt::RoundCap );
-                textOutlinePen.setJoinStyle( Qt::RoundJoin );
-                QPainterPath textPath;
-                textPath.addText( rect.left() + (rect.width() - fm.width(text)) / 2.0,
-                                rect.bottom() - (rect.height() - fm.ascent() + fm.descent()) / 2.0,
-                                font, text );
-                p.setPen( textOutlinePen );
-                p.drawPath( textPath ); // Takes much time
-                p.fillPath( textPath, Qt::white );
-            } else {
-                // For colored icons simply draw white text
-                p.setPen( Qt::white );
-                p.drawText( rect, text, QTextOption(Qt::AlignCenter) );
-            }
+            icon = atlas->iconWithTransportLine( m_svg->imagePath(), vehicle,
+                    atlasIconFlags(iconFlags), iconSize, transportLine,
+                    Plasma::Theme::defaultTheme()->font(Plasma::Theme::DefaultFont),
+                    iconDrawFlags.testFlag(DrawMonochromeIcon)
+                    ? VehicleIconAtlas::OutlinedText : VehicleIconAtlas::PlainText );
+        } else {
+            icon = atlas->icon( m_svg->imagePath(), vehicleKey, iconSize );
         }
+        p.drawImage( shadowWidth / 2, shadowWidth / 2, icon );
         p.end();
 
         // Insert rendered vehicle icon into the pixmap cache
@@ -25,6 +25,7 @@
  * @author Friedrich Pülz <fpuelz@gmx.de> */
 
 #include <enums.h>
+#include <vehicleiconatlas.h>
 
 class DepartureModel;
 class DepartureItem;
@@ -126,6 +127,8 @@ public:
     QPixmap createPopupIcon( PopupIcon *popupIcon, DepartureModel *model, const QSize &size );
 
 private:
+    static VehicleIconAtlas::IconFlags atlasIconFlags( VehicleIconFlags flags );
+
     KPixmapCache *m_pixmapCache;
     Plasma::Svg *m_svg;
 };
@@ -25,15 +25,31 @@
 
 // Qt includes
 #include <QMutex> // Member variable
+#include <QThread>
+#include <QElapsedTimer>
 #include <QUrl>
 
-const int DepartureProcessor::DEPARTURE_BATCH_SIZE = 10;
+const int DepartureProcessor::MAXIMUM_THREAD_COUNT = 3;
+const int DepartureProcessor::DEPARTURE_BATCH_INTERVAL = 50;
 const int DepartureProcessor::JOURNEY_BATCH_SIZE = 10;
 
+/** @brief A thread that processes jobs of a DepartureProcessor. */
+class DepartureProcessorThread : public QThread {
+public:
+    explicit DepartureProcessorThread( DepartureProcessor *processor )
+            : QThread(), m_processor(processor) {};
+
+protected:
+    virtual void run() { m_processor->processJobs(); };
+
+private:
+    DepartureProcessor *const m_processor;
+};
+
 DepartureProcessor::DepartureProcessor( QObject *parent )
-        : QThread(parent), m_currentJob(NoJob), m_timeOffsetOfFirstDeparture(0),
-          m_isArrival(false), m_quit(false), m_abortCurrentJob(false), m_requeueCurrentJob(false),
-          m_mutex(new QMutex())
+        : QObject(parent), m_idleThreadCount(0), m_processedDeparturesGeneration(0),
+          m_reusedDepartureCount(0), m_createdDepartureCount(0), m_timeOffsetOfFirstDeparture(0),
+          m_isArrival(false), m_quit(false), m_mutex(new QMutex())
 {
     qRegisterMetaType< QList<DepartureInfo> >( "QList<DepartureInfo>" );
     qRegisterMetaType< QList<JourneyInfo> >( "QList<JourneyInfo>" );
@@ -41,58 +57,123 @@ DepartureProcessor::DepartureProcessor( QObject *parent )
 
 DepartureProcessor::~DepartureProcessor()
 {
-    // Wake up, abort running jobs and quit
+    // Wake up all threads, abort running jobs and quit
     m_mutex->lock();
     m_quit = true;
-    m_abortCurrentJob = true;
-    m_cond.wakeOne();
+    foreach ( JobInfo *job, m_runningJobs ) {
+        job->abort = true;
+    }
+    m_cond.wakeAll();
     m_mutex->unlock();
 
-    // Wait for the abort to finish
-    wait();
+    // Wait for the aborts to finish
+    foreach ( DepartureProcessorThread *thread, m_threads ) {
+        thread->wait();
+    }
 
     // Cleanup
+    qDeleteAll( m_threads );
+    qDeleteAll( m_jobQueue );
     delete m_mutex;
 }
 
 void DepartureProcessor::abortJobs( DepartureProcessor::JobTypes jobTypes )
 {
     QMutexLocker locker( m_mutex );
-    if ( jobTypes.testFlag( m_currentJob ) ) {
-        m_abortCurrentJob = true;
+    foreach ( JobInfo *job, m_runningJobs ) {
+        if ( jobTypes.testFlag(job->type) ) {
+            job->abort = true;
+        }
     }
 
-    if ( jobTypes == AllJobs ) {
-        // Clear all jobs in the queue
-        m_jobQueue.clear();
-    } else {
-        // Remove jobs of the given types
-        for ( int i = m_jobQueue.count() - 1; i >= 0; --i ) {
-            if ( jobTypes.testFlag( m_jobQueue[i]->type ) ) {
-                m_jobQueue.removeAt( i );
+    // Remove jobs of the given types from the queue
+    for ( int i = m_jobQueue.count() - 1; i >= 0; --i ) {
+        if ( jobTypes.testFlag(m_jobQueue[i]->type) ) {
+            delete m_jobQueue.takeAt( i );
+        }
+    }
+}
+
+DepartureProcessor::JobTypes DepartureProcessor::runningJobs() const
+{
+    QMutexLocker locker( m_mutex );
+    JobTypes jobTypes = NoJob;
+    foreach ( const JobInfo *job, m_runningJobs ) {
+        jobTypes |= job->type;
+    }
+    return jobTypes;
+}
+
+int DepartureProcessor::reusedDepartureCount() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_reusedDepartureCount;
+}
+
+int DepartureProcessor::createdDepartureCount() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_createdDepartureCount;
+}
+
+void DepartureProcessor::removeSource( const QString &sourceName )
+{
+    QMutexLocker locker( m_mutex );
+    for ( int i = m_jobQueue.count() - 1; i >= 0; --i ) {
+        if ( m_jobQueue[i]->sourceName == sourceName ) {
+            delete m_jobQueue.takeAt( i );
+        }
+    }
+    foreach ( JobInfo *job, m_runningJobs ) {
+        if ( job->sourceName == sourceName ) {
+            job->abort = true;
+            job->sourceRemoved = true;
+        }
+    }
+    m_processedDepartures.remove( sourceName );
+}
+
+void DepartureProcessor::requeueRunningDepartureJobs()
+{
+    // private function, m_mutex is expected to be already locked.
+    // Running departure jobs get requeued, if other jobs for the same source are waiting,
+    // eg. to filter already processed departures with changed settings. The remaining
+    // departures get processed later with the new settings
+    foreach ( JobInfo *job, m_runningJobs ) {
+        if ( job->type != ProcessDepartures ) {
+            continue;
+        }
+        foreach ( const JobInfo *queuedJob, m_jobQueue ) {
+            if ( queuedJob->sourceName == job->sourceName ) {
+                job->requeue = true;
+                break;
             }
         }
     }
 }
 
+void DepartureProcessor::clearProcessedDepartures()
+{
+    // private function, m_mutex is expected to be already locked.
+    // Results of running jobs, which use the old settings, do not get stored
+    m_processedDepartures.clear();
+    ++m_processedDeparturesGeneration;
+}
+
 void DepartureProcessor::setFilters( const FilterSettingsList &filters )
 {
     QMutexLocker locker( m_mutex );
     m_filters = filters;
-
-    if ( m_currentJob == ProcessDepartures && !m_jobQueue.isEmpty() ) {
-        m_requeueCurrentJob = true;
-    }
+    clearProcessedDepartures();
+    requeueRunningDepartureJobs();
 }
 
 void DepartureProcessor::setColorGroups( const ColorGroupSettingsList& colorGroups )
 {
     QMutexLocker locker( m_mutex );
     m_colorGroups = colorGroups;
-
-    if ( m_currentJob == ProcessDepartures && !m_jobQueue.isEmpty() ) {
-        m_requeueCurrentJob = true;
-    }
+    clearProcessedDepartures();
+    requeueRunningDepartureJobs();
 }
 
 void DepartureProcessor::setFirstDepartureSettings(
@@ -108,17 +189,19 @@ void DepartureProcessor::setFirstDepartureSettings(
 void DepartureProcessor::setDepartureArrivalListType( DepartureArrivalListType type )
 {
     QMutexLocker locker( m_mutex );
-    m_isArrival = type == ArrivalList;
+    const bool isArrival = type == ArrivalList;
+    if ( isArrival != m_isArrival ) {
+        m_isArrival = isArrival;
+        clearProcessedDepartures();
+    }
 }
 
 void DepartureProcessor::setAlarms( const AlarmSettingsList &alarms )
 {
     QMutexLocker locker( m_mutex );
     m_alarms = alarms;
-
-    if ( m_currentJob == ProcessDepartures && !m_jobQueue.isEmpty() ) {
-        m_requeueCurrentJob = true;
-    }
+    clearProcessedDepartures();
+    requeueRunningDepartureJobs();
 }
 
 bool DepartureProcessor::isTimeShown( const QDateTime& dateTime,
@@ -139,15 +222,37 @@ bool DepartureProcessor::isTimeShown( const QDateTime& dateTime,
     return secsToDepartureTime > -60;
 }
 
+void DepartureProcessor::cancelJobs( DepartureProcessor::JobType type, const QString &sourceName )
+{
+    // private function, m_mutex is expected to be already locked
+    for ( int i = m_jobQueue.count() - 1; i >= 0; --i ) {
+        const JobInfo *job = m_jobQueue[i];
+        if ( job->type == type && job->sourceName == sourceName ) {
+            delete m_jobQueue.takeAt( i );
+        }
+    }
+    foreach ( JobInfo *job, m_runningJobs ) {
+        if ( job->type == type && job->sourceName == sourceName ) {
+            job->abort = true;
+        }
+    }
+}
+
 void DepartureProcessor::startOrEnqueueJob( DepartureProcessor::JobInfo *job )
 {
     // private function, m_mutex is expected to be already locked
+    cancelJobs( job->type, job->sourceName );
     m_jobQueue.enqueue( job );
 
-    if ( !isRunning() ) {
-        start();
+    const int maximumThreadCount = qBound( 1, QThread::idealThreadCount(), MAXIMUM_THREAD_COUNT );
+    if ( m_idleThreadCount == 0 && m_threads.count() < maximumThreadCount ) {
+        DepartureProcessorThread *thread = new DepartureProcessorThread( this );
+        m_threads << thread;
+        thread->start();
     } else {
-        m_cond.wakeOne();
+        // Waiting threads may not be able to take the new job if its source is busy,
+        // wake all threads to let the first one that can take it do so
+        m_cond.wakeAll();
     }
 }
 
@@ -170,7 +275,7 @@ void DepartureProcessor::processJourneys( const QString& sourceName, const QVari
 }
 
 void DepartureProcessor::filterDepartures( const QString &sourceName,
-        const QList< DepartureInfo > &departures, const QList< uint > &shownDepartures )
+        const QList< DepartureInfo > &departures, const QList< quint64 > &shownDepartures )
 {
     QMutexLocker locker( m_mutex );
     FilterJobInfo *job = new FilterJobInfo();
@@ -180,53 +285,139 @@ void DepartureProcessor::filterDepartures( const QString &sourceName,
     startOrEnqueueJob( job );
 }
 
-void DepartureProcessor::run()
+DepartureProcessor::JobInfo *DepartureProcessor::takeNextJob()
+{
+    // private function, m_mutex is expected to be already locked.
+    // Take the first job for a source that is not processed by another thread,
+    // jobs for the same source get processed one after another in the queued order
+    for ( int i = 0; i < m_jobQueue.count(); ++i ) {
+        const QString &sourceName = m_jobQueue[i]->sourceName;
+        bool sourceBusy = false;
+        foreach ( const JobInfo *runningJob, m_runningJobs ) {
+            if ( runningJob->sourceName == sourceName ) {
+                sourceBusy = true;
+                break;
+            }
+        }
+        if ( !sourceBusy ) {
+            return m_jobQueue.takeAt( i );
+        }
+    }
+    return 0;
+}
+
+bool DepartureProcessor::isJobAborted( const DepartureProcessor::JobInfo *job ) const
+{
+    QMutexLocker locker( m_mutex );
+    return job->abort;
+}
+
+void DepartureProcessor::processJobs()
 {
     QMutexLocker locker( m_mutex );
     forever {
+        // Wait for a job, the wait condition is met on exit, when a new job was queued
+        // or when another thread has finished a job
+        JobInfo *job = 0;
+        while ( !m_quit && !(job = takeNextJob()) ) {
+            ++m_idleThreadCount;
+            m_cond.wait( m_mutex );
+            --m_idleThreadCount;
+        }
         if ( m_quit ) {
+            // Exit the thread
             break;
         }
-        if ( m_jobQueue.isEmpty() ) {
-            // Wait for new jobs, the wait condition is met on exit or when a new job was queued
-            m_currentJob = NoJob;
-            m_cond.wait( m_mutex );
-            if ( m_quit ) {
-                // Exit the thread
-                break;
-            }
-            Q_ASSERT( !m_jobQueue.isEmpty() );
-        }
-
-        // Get the next job
-        JobInfo *job = m_jobQueue.dequeue();
-        m_currentJob = job->type;
+        m_runningJobs << job;
 
         // Run the job with unlocked mutex
-        m_mutex->unlock();
+        locker.unlock();
+        bool requeue = false;
         if ( job->type == ProcessDepartures ) {
-            doDepartureJob( static_cast<DepartureJobInfo*>( job ) );
+            requeue = doDepartureJob( static_cast<DepartureJobInfo*>( job ) );
         } else if ( job->type == FilterDepartures ) {
             doFilterJob( static_cast<FilterJobInfo*>( job ) );
         } else if ( job->type == ProcessJourneys ) {
-            doJourneyJob( static_cast<JourneyJobInfo*>( job ) );
+            requeue = doJourneyJob( static_cast<JourneyJobInfo*>( job ) );
         }
-        m_mutex->lock();
+        locker.relock();
 
-        if ( !m_requeueCurrentJob ) {
-            delete job;
-        } else {
+        m_runningJobs.removeOne( job );
+        if ( requeue && !job->abort ) {
             kDebug() << "  .. requeue job ..";
+            job->requeue = false;
+            m_jobQueue.enqueue( job );
+        } else {
+            delete job;
         }
-        m_abortCurrentJob = false;
-        m_requeueCurrentJob = false;
+
+        // Other threads may now take jobs for the source of the finished job
+        m_cond.wakeAll();
     }
 
-    qDeleteAll( m_jobQueue );
     kDebug() << "Thread terminated";
 }
 
-void DepartureProcessor::doDepartureJob( DepartureProcessor::DepartureJobInfo* departureJob )
+static CompiledFilterList compileColorGroupFilters( const ColorGroupSettingsList &colorGroups )
+{
+    // Departures/arrivals matching a filter of a color group that is filtered out get
+    // filtered out, ie. all these filters get OR combined into one list
+    FilterList filters;
+    foreach ( const ColorGroupSettings &colorGroup, colorGroups ) {
+        if ( colorGroup.filterOut ) {
+            filters << colorGroup.filters;
+        }
+    }
+    return CompiledFilterList( filters );
+}
+
+static uint hashVariant( const QVariant &value )
+{
+    switch ( value.type() ) {
+    case QVariant::Invalid:
+        return 0;
+    case QVariant::Bool:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        return qHash( value.toLongLong() );
+    case QVariant::DateTime: {
+        const QDateTime dateTime = value.toDateTime();
+        return qHash( dateTime.date().toJulianDay() ) ^ qHash( QTime(0, 0).msecsTo(dateTime.time()) );
+    }
+    case QVariant::StringList: {
+        uint hash = 0;
+        foreach ( const QString &string, value.toStringList() ) {
+            hash = hash * 31 + qHash( string );
+        }
+        return hash;
+    }
+    case QVariant::List: {
+        uint hash = 0;
+        foreach ( const QVariant &item, value.toList() ) {
+            hash = hash * 31 + hashVariant( item );
+        }
+        return hash;
+    }
+    default:
+        return qHash( value.toString() );
+    }
+}
+
+uint DepartureProcessor::hashDepartureData( const QVariantHash &departureData )
+{
+    // Combine hashes of all key/value pairs independent of their order
+    uint hash = 0;
+    for ( QVariantHash::ConstIterator it = departureData.constBegin();
+          it != departureData.constEnd(); ++it )
+    {
+        hash += qHash( it.key() ) * 31 ^ hashVariant( *it );
+    }
+    return hash;
+}
+
+bool DepartureProcessor::doDepartureJob( DepartureProcessor::DepartureJobInfo* departureJob )
 {
     const QString sourceName = departureJob->sourceName;
     QVariantHash data = departureJob->data;
@@ -241,11 +432,36 @@ void DepartureProcessor::doDepartureJob( DepartureProcessor::DepartureJobInfo* d
     int timeOffsetOfFirstDeparture = m_timeOffsetOfFirstDeparture;
     const DepartureInfo::DepartureFlags globalFlags = m_isArrival
             ? DepartureInfo::IsArrival : DepartureInfo::NoDepartureFlags;
+
+    // Jobs for the same source do not run concurrently, departures processed by the last job
+    // for this source do not get changed while this job is running
+    const ProcessedDepartures lastProcessedDepartures = m_processedDepartures.value( sourceName );
+    const int processedDeparturesGeneration = m_processedDeparturesGeneration;
     m_mutex->unlock();
 
-    emit beginDepartureProcessing( sourceName );
+    // Compile filters once for all departures, each job uses it's own compiled filters
+    const CompiledFilterSettingsList compiledFilters( filters );
+    const CompiledFilterList compiledColorGroupFilters = compileColorGroupFilters( colorGroups );
+    QVector< QPair<int, CompiledFilter> > compiledAlarmFilters; // Enabled alarms by index
+    for ( int a = 0; a < alarms.count(); ++a ) {
+        if ( alarms[a].enabled ) {
+            compiledAlarmFilters << qMakePair( a, CompiledFilter(alarms[a].filter) );
+        }
+    }
+    ProcessedDepartures processedDepartures;
+    bool processedAllDepartures = departureJob->alreadyProcessed == 0;
+    int reusedCount = 0;
+    int createdCount = 0;
+
+    // Requeued jobs continue to process their departures, the already processed departures
+    // were already emitted and should not get cleared by receivers of beginDepartureProcessing()
+    if ( departureJob->alreadyProcessed == 0 ) {
+        emit beginDepartureProcessing( sourceName );
+    }
 
     QList< DepartureInfo > departureInfos;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
     const QUrl url = data["requestUrl"].toUrl();
     const QDateTime updated = data["updated"].toDateTime();
     const QDateTime nextAutomaticUpdate = data["nextAutomaticUpdate"].toDateTime();
@@ -254,95 +470,146 @@ void DepartureProcessor::doDepartureJob( DepartureProcessor::DepartureJobInfo* d
                                                               : data["arrivals"].toList();
 
 //     Q_ASSERT( departureJob->alreadyProcessed <= count );
+    bool requeue = false;
     for ( int i = departureJob->alreadyProcessed; i < departuresData.count(); ++i ) {
-        QVariantHash departureData = departuresData[ i ].toHash();
-        QList< QDateTime > routeTimes;
-        if ( departureData.contains("RouteTimes") ) {
-            QVariantList times = departureData[ "RouteTimes" ].toList();
-            foreach( const QVariant &time, times ) {
-                routeTimes << time.toDateTime();
+        const QVariantHash departureData = departuresData[ i ].toHash();
+        const uint departureDataHash = hashDepartureData( departureData );
+        const quint64 identity = PublicTransport::Global::departureIdentity(
+                departureData["DepartureDateTime"].toDateTime(),
+                static_cast<VehicleType>( departureData["TypeOfVehicle"].toInt() ),
+                departureData["TransportLine"].toString(), departureData["Target"].toString(),
+                globalFlags.testFlag(DepartureInfo::IsArrival) );
+
+        // Reuse the departure and the results of filters/alarms from the last update,
+        // if the same departure was found and it's data is unchanged
+        ProcessedDeparture processedDeparture;
+        const ProcessedDepartures::ConstIterator lastIt =
+                lastProcessedDepartures.constFind( identity );
+        if ( lastIt != lastProcessedDepartures.constEnd() &&
+             lastIt->dataHash == departureDataHash )
+        {
+            processedDeparture = *lastIt;
+            processedDeparture.departure.setIndex( i );
+            ++reusedCount;
+        } else {
+            ++createdCount;
+            QList< QDateTime > routeTimes;
+            if ( departureData.contains("RouteTimes") ) {
+                QVariantList times = departureData[ "RouteTimes" ].toList();
+                foreach( const QVariant &time, times ) {
+                    routeTimes << time.toDateTime();
+                }
             }
-        }
 
-        // Read departure flags
-        DepartureInfo::DepartureFlags flags = globalFlags;
-        const QString additionalDataState = departureData["additionalDataState"].toString();
-        if ( additionalDataState == QLatin1String("included") ) {
-            // This departure includes additional timetable data,
-            // most other data is most probably unchanged
-            flags |= PublicTransport::DepartureInfo::IncludesAdditionalData;
-        } else if ( additionalDataState == QLatin1String("busy") ) {
-            // Additional data was requested for this departure,
-            // but the request did not finish yet
-            flags |= PublicTransport::DepartureInfo::WaitingForAdditionalData;
-        }
+            // Read departure flags
+            DepartureInfo::DepartureFlags flags = globalFlags;
+            const QString additionalDataState = departureData["additionalDataState"].toString();
+            if ( additionalDataState == QLatin1String("included") ) {
+                // This departure includes additional timetable data,
+                // most other data is most probably unchanged
+                flags |= PublicTransport::DepartureInfo::IncludesAdditionalData;
+            } else if ( additionalDataState == QLatin1String("busy") ) {
+                // Additional data was requested for this departure,
+                // but the request did not finish yet
+                flags |= PublicTransport::DepartureInfo::WaitingForAdditionalData;
+            }
 
-        DepartureInfo departureInfo( sourceName, i, flags, departureData["Operator"].toString(),
-                departureData["TransportLine"].toString(),
-                departureData["Target"].toString(), departureData["TargetShortened"].toString(),
-                departureData["DepartureDateTime"].toDateTime(),
-                static_cast<VehicleType>( departureData["TypeOfVehicle"].toInt() ),
-                departureData["Nightline"].toBool(), departureData["Expressline"].toBool(),
-                departureData["Platform"].toString(), departureData["Delay"].toInt(),
-                departureData["DelayReason"].toString(),
-                departureData["JourneyNews"].toString(),
-                departureData["JourneyNewsUrl"].toString(),
-                departureData["RouteStops"].toStringList(),
-                departureData["RouteStopsShortened"].toStringList(),
-                routeTimes, departureData["RouteExactStops"].toInt(),
-                departureData["additionalDataError"].toString() );
-
-        // Update the list of alarms that match the current departure
-        departureInfo.matchedAlarms().clear();
-        for ( int a = 0; a < alarms.count(); ++a ) {
-            AlarmSettings alarm = alarms.at( a );
-            if ( alarm.enabled && alarm.filter.match( departureInfo ) ) {
-                departureInfo.matchedAlarms() << a;
+            processedDeparture.dataHash = departureDataHash;
+            DepartureInfo &departureInfo = processedDeparture.departure;
+            departureInfo = DepartureInfo( sourceName, i, flags, departureData["Operator"].toString(),
+                    departureData["TransportLine"].toString(),
+                    departureData["Target"].toString(), departureData["TargetShortened"].toString(),
+                    departureData["DepartureDateTime"].toDateTime(),
+                    static_cast<VehicleType>( departureData["TypeOfVehicle"].toInt() ),
+                    departureData["Nightline"].toBool(), departureData["Expressline"].toBool(),
+                    departureData["Platform"].toString(), departureData["Delay"].toInt(),
+                    departureData["DelayReason"].toString(),
+                    departureData["JourneyNews"].toString(),
+                    departureData["JourneyNewsUrl"].toString(),
+                    departureData["RouteStops"].toStringList(),
+                    departureData["RouteStopsShortened"].toStringList(),
+                    routeTimes, departureData["RouteExactStops"].toInt(),
+                    departureData["additionalDataError"].toString() );
+
+            // Update the list of alarms that match the current departure
+            departureInfo.matchedAlarms().clear();
+            for ( int a = 0; a < compiledAlarmFilters.count(); ++a ) {
+                if ( compiledAlarmFilters[a].second.match(departureInfo) ) {
+                    departureInfo.matchedAlarms() << compiledAlarmFilters[a].first;
+                }
             }
+
+            processedDeparture.filteredOut = compiledFilters.filterOut( departureInfo )
+                    || compiledColorGroupFilters.match( departureInfo );
         }
+        processedDepartures.insert( identity, processedDeparture );
 
         // Mark departures/arrivals as filtered out that are either filtered out
         // or shouldn't be shown because of the first departure settings
-        if ( !isTimeShown(departureInfo.predictedDeparture(), firstDepartureConfigMode,
-                          timeOfFirstDepartureCustom, timeOffsetOfFirstDeparture)
-             || filters.filterOut(departureInfo)
-             || colorGroups.filterOut(departureInfo) )
+        DepartureInfo departureInfo = processedDeparture.departure;
+        if ( processedDeparture.filteredOut ||
+             !isTimeShown(departureInfo.predictedDeparture(), firstDepartureConfigMode,
+                          timeOfFirstDepartureCustom, timeOffsetOfFirstDeparture) )
         {
             departureInfo.setFlag( PublicTransport::DepartureInfo::IsFilteredOut );
         }
         departureInfos << departureInfo;
 
-        if ( departureInfos.count() == DEPARTURE_BATCH_SIZE ) {
+        // Emit all departures processed in the last batch interval
+        if ( batchTimer.elapsed() >= DEPARTURE_BATCH_INTERVAL && i < departuresData.count() - 1 ) {
             emit departuresProcessed( sourceName, departureInfos, url, updated,
                                       nextAutomaticUpdate, minManualUpdateTime,
                                       departuresData.count() - i - 1 );
             departureInfos.clear();
+            batchTimer.restart();
 
             QMutexLocker locker( m_mutex );
-            if ( m_abortCurrentJob ) {
+            if ( departureJob->abort ) {
+                processedAllDepartures = false;
                 break;
-            } else if ( m_requeueCurrentJob ) {
+            } else if ( departureJob->requeue ) {
+                // Gets enqueued again in processJobs()
                 departureJob->alreadyProcessed = i + 1;
-                m_jobQueue << departureJob;
+                processedAllDepartures = false;
+                requeue = true;
                 break;
             }
         }
     } // for ( int i = 0; i < count; ++i )
 
+    // Store processed departures to be reused by the next job for this source,
+    // if the settings did not change and the source was not removed in the meantime
+    m_mutex->lock();
+    m_reusedDepartureCount += reusedCount;
+    m_createdDepartureCount += createdCount;
+    if ( processedDeparturesGeneration == m_processedDeparturesGeneration &&
+         !departureJob->sourceRemoved )
+    {
+        if ( processedAllDepartures ) {
+            // Departures that are no longer available get removed
+            m_processedDepartures.insert( sourceName, processedDepartures );
+        } else {
+            ProcessedDepartures &storedDepartures = m_processedDepartures[ sourceName ];
+            for ( ProcessedDepartures::ConstIterator it = processedDepartures.constBegin();
+                  it != processedDepartures.constEnd(); ++it )
+            {
+                storedDepartures.insert( it.key(), *it );
+            }
+        }
+    }
+    m_mutex->unlock();
+
     // Emit remaining departures
     if ( !departureInfos.isEmpty() ) {
-        m_mutex->lock();
-        const bool abortCurrentJob = m_abortCurrentJob;
-        m_mutex->unlock();
-
-        if ( !abortCurrentJob ) {
+        if ( !isJobAborted(departureJob) ) {
             emit departuresProcessed( sourceName, departureInfos, url, updated,
                                       nextAutomaticUpdate, minManualUpdateTime, 0 );
         }
     }
+    return requeue;
 }
 
-void DepartureProcessor::doJourneyJob( DepartureProcessor::JourneyJobInfo* journeyJob )
+bool DepartureProcessor::doJourneyJob( DepartureProcessor::JourneyJobInfo* journeyJob )
 {
     const QString sourceName = journeyJob->sourceName;
     QVariantHash data = journeyJob->data;
@@ -351,7 +618,9 @@ void DepartureProcessor::doJourneyJob( DepartureProcessor::JourneyJobInfo* journ
     AlarmSettingsList alarms = m_alarms;
     m_mutex->unlock();
 
-    emit beginJourneyProcessing( sourceName );
+    if ( journeyJob->alreadyProcessed == 0 ) {
+        emit beginJourneyProcessing( sourceName );
+    }
 
     QList< JourneyInfo > journeyInfos;
     QUrl url = data["requestUrl"].toUrl();
@@ -478,26 +747,23 @@ void DepartureProcessor::doJourneyJob( DepartureProcessor::JourneyJobInfo* journ
             journeyInfos.clear();
 
             QMutexLocker locker( m_mutex );
-            if ( m_abortCurrentJob ) {
+            if ( journeyJob->abort ) {
                 break;
-            } else if ( m_requeueCurrentJob ) {
+            } else if ( journeyJob->requeue ) {
+                // Gets enqueued again in processJobs()
                 journeyJob->alreadyProcessed = i + 1;
-                m_jobQueue << journeyJob;
-                break;
+                return true;
             }
         }
     }
 
     // Emit remaining journeys
     if ( !journeyInfos.isEmpty() ) {
-        m_mutex->lock();
-        const bool abortCurrentJob = m_abortCurrentJob;
-        m_mutex->unlock();
-
-        if ( !abortCurrentJob ) {
+        if ( !isJobAborted(journeyJob) ) {
             emit journeysProcessed( sourceName, journeyInfos, url, updated );
         }
     }
+    return false;
 }
 
 void DepartureProcessor::doFilterJob( DepartureProcessor::FilterJobInfo* filterJob )
@@ -510,15 +776,18 @@ void DepartureProcessor::doFilterJob( DepartureProcessor::FilterJobInfo* filterJ
     ColorGroupSettingsList colorGroups = m_colorGroups;
 
     FirstDepartureConfigMode firstDepartureConfigMode = m_firstDepartureConfigMode;
-    const QTime &timeOfFirstDepartureCustom = m_timeOfFirstDepartureCustom;
+    const QTime timeOfFirstDepartureCustom = m_timeOfFirstDepartureCustom;
     int timeOffsetOfFirstDeparture = m_timeOffsetOfFirstDeparture;
     m_mutex->unlock();
 
+    const CompiledFilterSettingsList compiledFilters( filters );
+    const CompiledFilterList compiledColorGroupFilters = compileColorGroupFilters( colorGroups );
+
     emit beginFiltering( filterJob->sourceName );
     for ( int i = 0; i < departures.count(); ++i ) {
         DepartureInfo &departureInfo = departures[ i ];
-        const bool filterOut = filters.filterOut( departureInfo )
-                || colorGroups.filterOut( departureInfo );
+        const bool filterOut = compiledFilters.filterOut( departureInfo )
+                || compiledColorGroupFilters.match( departureInfo );
 
         // Newly filtered departures are now filtered out and were shown.
         // They may be newly filtered if they weren't filtered out, but
@@ -545,11 +814,7 @@ void DepartureProcessor::doFilterJob( DepartureProcessor::FilterJobInfo* filterJ
         departureInfo.setFlag( PublicTransport::DepartureInfo::IsFilteredOut, filterOut );
     }
 
-    m_mutex->lock();
-    const bool abortCurrentJob = m_abortCurrentJob;
-    m_mutex->unlock();
-
-    if ( !abortCurrentJob ) {
+    if ( !isJobAborted(filterJob) ) {
         emit departuresFiltered( filterJob->sourceName, departures, newlyFiltered, newlyNotFiltered );
     }
 }
@@ -18,7 +18,7 @@
  */
 
 /** @file
- * @brief This file contains the QThread-derived class DepartureProcessor to process data from the public transport data engine.
+ * @brief This file contains the class DepartureProcessor to process data from the public transport data engine in threads.
  * @author Friedrich Pülz <fpuelz@gmx.de> */
 
 #ifndef DEPARTUREPROCESSOR_HEADER
@@ -32,34 +32,47 @@
 #include <filter.h> // Member variable
 
 // Qt includes
-#include <QThread> // Base class
+#include <QObject> // Base class
 #include <QWaitCondition> // Member variable
 #include <QQueue> // Member variable
+#include <QHash> // Member variable
+
+class DepartureProcessorThread;
 
 /**
- * @brief Worker thread for PublicTransport
+ * @brief Worker threads for PublicTransport
  *
- * A worker thread that puts data from the publicTransport data engine into DepartureInfo/
+ * Worker threads that put data from the publicTransport data engine into DepartureInfo/
  * JourneyInfo instances. It also applies filters and checks if alarm filters match.
  * Filters are given as FilterSettings by @ref setFilterSettings. They contain a list of filters
  * which get OR combined. Each filter has a list of constraints which get AND combined. This could
  * take some time with complex filter settings and a long list of departures/arrivals. That's
  * actually the main reason to do this in a thread.
  * To ensure that only departures get marked to be shown which departure time is greater than or
- * equal to the first departure time, use @ref setFirstDepartureSettings. The thread uses a job
+ * equal to the first departure time, use @ref setFirstDepartureSettings. The threads use a job
  * queue, jobs can be cancelled by their type using @ref abortJobs. To add a new job to the queue
  * use @ref processDepartures, @ref processJourneys or @ref filterDepartures.
  *
+ * Jobs get processed by up to @ref MAXIMUM_THREAD_COUNT threads, which get started when needed.
+ * Jobs for different data sources (eg. for multiple combined stops) run concurrently, while jobs
+ * for the same data source are processed in the order in which they were added. A new job
+ * replaces waiting jobs of the same type for the same data source and aborts such a running job,
+ * ie. an update for one source does not need to wait for old data of that source to be processed.
+ *
+ * Departures/arrivals that did not change since the last update of their data source do not get
+ * processed again. Instead the DepartureInfo object and the filter/alarm results of the last
+ * update get reused. Changing filters, color groups, alarms or the departure/arrival list type
+ * discards these results, removeSource() discards them for one data source.
+ *
  * @ingroup models
  **/
-class DepartureProcessor : public QThread {
+class DepartureProcessor : public QObject {
     Q_OBJECT
 
 public:
     /** @brief Types of jobs. */
     enum JobType {
-        NoJob = 0x00, /**< No job. This is returned by @ref currentJob if the
-            * thread is idle. */
+        NoJob = 0x00, /**< No job. */
         ProcessDepartures = 0x01, /**< Processing departures, ie. putting data
             * from the publicTransport data engine into DepartureInfo
             * instances and apply filters/alarms. */
@@ -78,12 +91,16 @@ public:
     /** @brief Destructor. */
     ~DepartureProcessor();
 
+    /** @brief The maximal number of threads used to process jobs. */
+    static const int MAXIMUM_THREAD_COUNT;
+
     /**
-     * @brief The number of departures/arrivals in one batch, which gets send to the applet.
+     * @brief The interval in milliseconds in which processed departures/arrivals get send to the applet.
      *
-     * If there are more items to be processed, they will be send in a later call to the applet.
+     * All departures/arrivals that were processed in this interval get send to the applet in one
+     * batch. If there are more items to be processed, they will be send in a later call.
      **/
-    static const int DEPARTURE_BATCH_SIZE;
+    static const int DEPARTURE_BATCH_INTERVAL;
 
     /**
      * @brief The number of journeys in one batch, which gets send to the applet.
@@ -129,6 +146,8 @@ public:
     /**
      * @brief Enqueues a job of type @ref ProcessDepartures to the job queue.
      *
+     * Waiting or running jobs of the same type for @p sourceName get cancelled.
+     *
      * @param sourceName The data engine source name for the departure data.
      *
      * @param data The departure/arrival data from the publicTransport data engine to be processed,
@@ -139,6 +158,8 @@ public:
     /**
      * @brief Enqueues a job of type @ref FilterDepartures to the job queue.
      *
+     * Waiting or running jobs of the same type for @p sourceName get cancelled.
+     *
      * @param sourceName The data engine source name for the departure data.
      *
      * @param departures The list of departures that should be filtered.
@@ -148,11 +169,13 @@ public:
      *   @ref DepartureInfo::hash.
      **/
     void filterDepartures( const QString &sourceName, const QList< DepartureInfo > &departures,
-                           const QList< uint > &shownDepartures = QList< uint >() );
+                           const QList< quint64 > &shownDepartures = QList< quint64 >() );
 
     /**
      * @brief Enqueues a job of type @ref ProcessJourneys to the job queue.
      *
+     * Waiting or running jobs of the same type for @p sourceName get cancelled.
+     *
      * @param sourceName The data engine source name for the journey data.
      *
      * @param data The journey data from the publicTransport data engine to
@@ -167,8 +190,27 @@ public:
      **/
     void abortJobs( DepartureProcessor::JobTypes jobTypes = AllJobs );
 
-    /** @returns the job that's currently being processed by this thread. */
-    JobType currentJob() const { return m_currentJob; };
+    /** @returns the types of all jobs that are currently being processed. */
+    JobTypes runningJobs() const;
+
+    /**
+     * @brief The number of departures/arrivals reused from the last update of their data source.
+     * @see createdDepartureCount()
+     **/
+    int reusedDepartureCount() const;
+
+    /**
+     * @brief The number of departures/arrivals that were processed and not reused.
+     * @see reusedDepartureCount()
+     **/
+    int createdDepartureCount() const;
+
+    /**
+     * @brief Cancel all jobs for @p sourceName and discard it's processed departures/arrivals.
+     *
+     * Should be called when the data source @p sourceName gets disconnected.
+     **/
+    void removeSource( const QString &sourceName );
 
     /**
      * @brief Checks if a departure/arrival/journey should be shown with the given settings.
@@ -196,6 +238,9 @@ signals:
     /**
      * @brief A departure/arrival processing job now gets started.
      *
+     * Not emitted again when an interrupted job continues to process it's remaining
+     * departures/arrivals, ie. departures emitted before with departuresProcessed() are still
+     * valid.
      * @param sourceName The data engine source name for the departure data.
      **/
     void beginDepartureProcessing( const QString &sourceName );
@@ -212,6 +257,8 @@ signals:
      *   data source. Earlier update requests will be rejected.
      * @param departuresToGo The number of departures to still be processed. If this isn't 0
      *   this signal gets emitted again after the next batch of departures has been processed.
+     *
+     * @note This signal gets emitted in a worker thread.
      **/
     void departuresProcessed( const QString &sourceName, const QList< DepartureInfo > &departures,
             const QUrl &requestUrl, const QDateTime &lastUpdate,
@@ -221,6 +268,7 @@ signals:
     /**
      * @brief A journey processing job now gets started.
      *
+     * Not emitted again when an interrupted job continues, see beginDepartureProcessing().
      * @param sourceName The data engine source name for the journey data.
      **/
     void beginJourneyProcessing( const QString &sourceName );
@@ -259,13 +307,18 @@ signals:
                              const QList< DepartureInfo > &newlyFiltered,
                              const QList< DepartureInfo > &newlyNotFiltered );
 
-protected:
-    virtual void run();
-
 private:
+    friend class DepartureProcessorThread;
+
     struct JobInfo {
+        JobInfo() : abort(false), requeue(false), sourceRemoved(false) {};
+        virtual ~JobInfo() {};
+
         JobType type;
         QString sourceName;
+        bool abort; // Set to abort the job while it is running
+        bool requeue; // Set to interrupt the job and process the remaining items later
+        bool sourceRemoved; // Set to not store processed departures, see removeSource()
     };
     struct DepartureJobInfo : public JobInfo {
         DepartureJobInfo() {
@@ -280,7 +333,7 @@ private:
         FilterJobInfo() { type = FilterDepartures; };
 
         QList< DepartureInfo > departures;
-        QList< uint > shownDepartures;
+        QList< quint64 > shownDepartures;
     };
     struct JourneyJobInfo : public DepartureJobInfo {
         JourneyJobInfo() {
@@ -289,13 +342,40 @@ private:
         };
     };
 
-    void doDepartureJob( DepartureJobInfo *departureJob );
-    void doJourneyJob( JourneyJobInfo *journeyJob );
+    // A processed departure/arrival with the result of filters/color groups, stored to be reused
+    struct ProcessedDeparture {
+        DepartureInfo departure;
+        uint dataHash; // Hash of the data of the departure, see hashDepartureData()
+        bool filteredOut;
+    };
+    // Processed departures/arrivals of one data source by Global::departureIdentity()
+    typedef QHash< quint64, ProcessedDeparture > ProcessedDepartures;
+
+    static uint hashDepartureData( const QVariantHash &departureData );
+    void clearProcessedDepartures();
+
+    // Return true, if the job should be enqueued again to process the remaining items later
+    bool doDepartureJob( DepartureJobInfo *departureJob );
+    bool doJourneyJob( JourneyJobInfo *journeyJob );
     void doFilterJob( FilterJobInfo *filterJob );
     void startOrEnqueueJob( JobInfo *jobInfo );
+    void cancelJobs( JobType type, const QString &sourceName );
+    void requeueRunningDepartureJobs();
+    JobInfo *takeNextJob();
+    bool isJobAborted( const JobInfo *job ) const;
+
+    // Called by each thread, processes jobs until m_quit is set
+    void processJobs();
 
     QQueue< JobInfo* > m_jobQueue;
-    JobType m_currentJob;
+    QList< JobInfo* > m_runningJobs;
+    QList< DepartureProcessorThread* > m_threads;
+    int m_idleThreadCount;
+
+    QHash< QString, ProcessedDepartures > m_processedDepartures; // By source name
+    int m_processedDeparturesGeneration; // Increased when m_processedDepartures gets cleared
+    int m_reusedDepartureCount;
+    int m_createdDepartureCount;
 
     FilterSettingsList m_filters;
     ColorGroupSettingsList m_colorGroups;
@@ -305,7 +385,7 @@ private:
     int m_timeOffsetOfFirstDeparture;
     bool m_isArrival;
 
-    bool m_quit, m_abortCurrentJob, m_requeueCurrentJob;
+    bool m_quit;
     QMutex *const m_mutex;
     QWaitCondition m_cond;
 };
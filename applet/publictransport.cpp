@@ -402,19 +402,12 @@ void PublicTransportApplet::departuresFiltered( const QString& sourceName,
         }
     }
 
-    // Append previously filtered out departures
+    // Merge previously filtered out departures into the model,
+    // limit the item count to the maximal number of departure setting
     if ( !newlyNotFiltered.isEmpty() ) {
         kDebug() << "Add" << newlyNotFiltered.count() << "previously filtered departures";
     }
-    foreach( const DepartureInfo &departureInfo, newlyNotFiltered ) {
-        d->model->addItem( departureInfo );
-    }
-
-    // Limit item count to the maximal number of departure setting
-    int delta = d->model->rowCount() - d->settings.maximalNumberOfDepartures();
-    if ( delta > 0 ) {
-        d->model->removeRows( d->settings.maximalNumberOfDepartures(), delta );
-    }
+    d->model->mergeItems( newlyNotFiltered, d->settings.maximalNumberOfDepartures() );
 
     d->popupIcon->createDepartureGroups();
     updatePopupIcon();
@@ -514,32 +507,7 @@ void PublicTransportApplet::departuresProcessed( const QString& sourceName,
 
     // Request additional data for new items
     if ( d->settings.additionalDataRequestType() == Settings::RequestAdditionalDataDirectly ) {
-        int itemBegin = 999999999;
-        int itemEnd = 0;
-        foreach ( const DepartureInfo departure, departures ) {
-            if ( !departure.includesAdditionalData() &&
-                 !departure.isWaitingForAdditionalData() &&
-                  departure.additionalDataError().isEmpty() )
-            {
-                const int index = departure.index();
-                itemBegin = qMin( itemBegin, index );
-                itemEnd = qMax( itemEnd, index );
-            }
-        }
-
-        if ( itemBegin < 999999999 ) {
-            Plasma::Service *service = dataEngine("publictransport")->serviceForSource( sourceName );
-            if ( !service ) {
-                kWarning() << "No Timetable Service!";
-                return;
-            }
-
-            KConfigGroup op = service->operationDescription("requestAdditionalDataRange");
-            op.writeEntry( "itemnumberbegin", itemBegin );
-            op.writeEntry( "itemnumberend", itemEnd );
-            Plasma::ServiceJob *additionDataJob = service->startOperationCall( op );
-            connect( additionDataJob, SIGNAL(finished(KJob*)), service, SLOT(deleteLater()) );
-        }
+        d->requestAdditionalData( sourceName, departures );
     }
 }
 
@@ -644,16 +612,55 @@ void PublicTransportApplet::dataUpdated( const QString &sourceName,
             kDebug() << "Received journey data, but journey list is hidden.";
         }
     } else if ( data.contains("departures") || data.contains("arrivals") ) {
-        // Disable the update action, it will get enabled when update requests will be accepted
-        // again by the engine (see departuresProcessed())
-        disableUpdateAction();
+        if ( d->kioskTimer && d->model->rowCount() > 0 ) {
+            // Apply new departures together with the time values at the next full minute,
+            // departures are shown immediately if the board is empty
+            d->pendingDepartureData.insert( sourceName, data );
+            return;
+        }
+
+        processDepartureData( sourceName, data );
+    }
+}
+
+void PublicTransportApplet::processDepartureData( const QString &sourceName,
+                                                  const Plasma::DataEngine::Data &data )
+{
+    Q_D( PublicTransportApplet );
+
+    // Disable the update action, it will get enabled when update requests will be accepted
+    // again by the engine (see departuresProcessed())
+    disableUpdateAction();
+
+    // List of departures / arrivals received
+    emit validDepartureDataReceived();
+    d->departureProcessor->processDepartures( sourceName, data );
+}
 
-        // List of departures / arrivals received
-        emit validDepartureDataReceived();
-        d->departureProcessor->processDepartures( sourceName, data );
+void PublicTransportApplet::applyPendingDepartureData()
+{
+    Q_D( PublicTransportApplet );
+    const QHash< QString, Plasma::DataEngine::Data > pendingData = d->pendingDepartureData;
+    d->pendingDepartureData.clear();
+    for ( QHash<QString, Plasma::DataEngine::Data>::ConstIterator it = pendingData.constBegin();
+          it != pendingData.constEnd(); ++it )
+    {
+        if ( d->currentSources.contains(it.key()) ) {
+            processDepartureData( it.key(), it.value() );
+        } else {
+            kDebug() << "Pending data discarded" << it.key();
+        }
     }
 }
 
+void PublicTransportApplet::kioskTimerTimeout()
+{
+    Q_D( PublicTransportApplet );
+    applyPendingDepartureData();
+    d->logKioskStatistics();
+    d->updateKioskTimer();
+}
+
 void PublicTransportApplet::appletResized()
 {
     Q_D( PublicTransportApplet );
@@ -1014,8 +1021,7 @@ void PublicTransportApplet::showJourneyList()
                                   d->isStateActive("journeyDataValid") );
 
     // Create timetable widget for journeys
-    PublicTransportWidget::Options options = d->settings.drawShadows()
-            ? PublicTransportWidget::DrawShadowsOrHalos : PublicTransportWidget::NoOption;
+    const PublicTransportWidget::Options options = d->timetableOptions();
     JourneyTimetableWidget::Flags flags =
             d->currentServiceProviderFeatures.contains("ProvidesMoreJourneys")
             ? JourneyTimetableWidget::ShowEarlierAndLaterJourneysItems
@@ -1457,8 +1463,8 @@ QAction* PublicTransportApplet::updatedAction( const QString& actionName )
 
     if ( actionName == QLatin1String("toggleExpanded") ) {
         if ( (d->journeyTimetable && d->isStateActive("journeyView"))
-            ? d->journeyTimetable->item(d->clickedItemIndex.row())->isExpanded()
-            : d->timetable->item(d->clickedItemIndex.row())->isExpanded() )
+            ? d->journeyTimetable->isItemExpanded(d->clickedItemIndex.row())
+            : d->timetable->isItemExpanded(d->clickedItemIndex.row()) )
         {
             a->setText( i18nc("@action", "Hide Additional &Information") );
             a->setIcon( KIcon("arrow-up") );
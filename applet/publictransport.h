@@ -214,6 +214,13 @@ protected slots:
      **/
     void dataUpdated( const QString &sourceName, const Plasma::DataEngine::Data &data );
 
+    /**
+     * @brief Called each full minute in kiosk mode.
+     *
+     * Applies departure data received since the last full minute and logs paint statistics.
+     **/
+    void kioskTimerTimeout();
+
     void acceptActionButtons();
 
     void setAssociatedApplicationUrlForDepartures();
@@ -593,6 +600,12 @@ protected:
 
     void disableUpdateAction();
 
+    /** @brief Processes received departure/arrival @p data of the source @p sourceName. */
+    void processDepartureData( const QString &sourceName, const Plasma::DataEngine::Data &data );
+
+    /** @brief Processes departure data that was received in kiosk mode and not yet applied. */
+    void applyPendingDepartureData();
+
     /**
      * @brief Get an action with string and icon updated to the current settings.
      *
@@ -44,6 +44,9 @@
 #include <QGraphicsScene>
 #include <QApplication>
 #include <QList>
+#include <QVector>
+#include <QSet>
+#include <QTimer>
 #include <qmath.h>
 
 ToPropertyTransition::ToPropertyTransition( QObject *sender, const char *signal, QState *source,
@@ -66,7 +69,7 @@ PublicTransportAppletPrivate::PublicTransportAppletPrivate( PublicTransportApple
         oldItem(0), titleWidget(0), labelInfo(0), timetable(0), journeyTimetable(0),
         labelJourneysNotSupported(0), listStopSuggestions(0), overlay(0), model(0),
         popupIcon(0), titleToggleAnimation(0), runningUpdateRequests(0), updateTimer(0),
-        modelJourneys(0), originalStopIndex(-1), filtersGroup(0), colorFiltersGroup(0),
+        kioskTimer(0), kioskCpuClock(0), modelJourneys(0), originalStopIndex(-1), filtersGroup(0), colorFiltersGroup(0),
         departureProcessor(0), departurePainter(0), stateMachine(0), journeySearchTransition1(0),
         journeySearchTransition2(0), journeySearchTransition3(0), marble(0), q_ptr( q )
 {
@@ -166,34 +169,9 @@ void PublicTransportAppletPrivate::onSettingsChanged( const Settings &_settings,
     {
         // Request additional data for all timetable items
         if ( settings.additionalDataRequestType() == Settings::RequestAdditionalDataDirectly ) {
+            const QList< DepartureInfo > departures = model->departureInfos();
             foreach ( const QString &currentSource, currentSources ) {
-                Plasma::Service *service =
-                        q->dataEngine("publictransport")->serviceForSource( currentSource );
-                if ( !service ) {
-                    kWarning() << "No Timetable Service!";
-                    return;
-                }
-
-                int itemBegin = 999999999;
-                int itemEnd = 0;
-                foreach ( const DepartureInfo departure, model->departureInfos() ) {
-                    if ( !departure.includesAdditionalData() &&
-                         !departure.isWaitingForAdditionalData() &&
-                          departure.additionalDataError().isEmpty() )
-                    {
-                        const int index = departure.index();
-                        itemBegin = qMin( itemBegin, index );
-                        itemEnd = qMax( itemEnd, index );
-                    }
-                }
-
-                if ( itemBegin < 999999999 ) {
-                    KConfigGroup op = service->operationDescription("requestAdditionalDataRange");
-                    op.writeEntry( "itemnumberbegin", itemBegin );
-                    op.writeEntry( "itemnumberend", itemEnd );
-                    Plasma::ServiceJob *additionDataJob = service->startOperationCall( op );
-                    q->connect( additionDataJob, SIGNAL(finished(KJob*)), service, SLOT(deleteLater()) );
-                }
+                requestAdditionalData( currentSource, departures );
             }
         }
     }
@@ -271,6 +249,16 @@ void PublicTransportAppletPrivate::onSettingsChanged( const Settings &_settings,
         }
     }
 
+    // Apply kiosk mode settings, items get recreated without animations and hover effects
+    if ( changed.testFlag(SettingsIO::ChangedKioskMode) ) {
+        timetable->setOption( PublicTransportWidget::LowPowerMode, settings.kioskMode() );
+        if ( journeyTimetable && isStateActive("journeyView") ) {
+            journeyTimetable->setOption( PublicTransportWidget::LowPowerMode,
+                                         settings.kioskMode() );
+        }
+        updateKioskTimer();
+    }
+
     // Update title widget to settings
     if ( changed.testFlag(SettingsIO::ChangedCurrentStopSettings) ||
          changed.testFlag(SettingsIO::ChangedFont) ||
@@ -287,6 +275,11 @@ void PublicTransportAppletPrivate::onSettingsChanged( const Settings &_settings,
         timetable->updateItemLayouts();
     }
 
+    // Only create items for visible departures if many departures may be shown,
+    // otherwise keep the remove animations. Does nothing if the option is unchanged
+    timetable->setOption( PublicTransportWidget::Virtualized,
+                          settings.maximalNumberOfDepartures() > 30 );
+
     // Limit model item count to the maximal number of departures setting
     if ( model->rowCount() > settings.maximalNumberOfDepartures() ) {
         model->removeRows( settings.maximalNumberOfDepartures(),
@@ -712,31 +705,75 @@ QString PublicTransportAppletPrivate::stripDateAndTimeValues( const QString &sou
     return ret;
 }
 
-void PublicTransportAppletPrivate::fillModel( const QList<DepartureInfo> &departures )
+void PublicTransportAppletPrivate::requestAdditionalData( const QString &sourceName,
+                                                          const QList<DepartureInfo> &departures )
 {
-    bool modelFilled = model->rowCount() >= settings.maximalNumberOfDepartures();
-    foreach( const DepartureInfo &departureInfo, departures ) {
-        QModelIndex index = model->indexFromInfo( departureInfo );
-        if ( !index.isValid() ) {
-            // Departure wasn't in the model
-            if ( !modelFilled && !departureInfo.isFilteredOut() ) {
-                // Departure doesn't get filtered out and the model isn't full => Add departure
-                model->addItem( departureInfo );
-                modelFilled = model->rowCount() >= settings.maximalNumberOfDepartures();
+    Q_Q( PublicTransportApplet );
+
+    // Get hashes of the departures in visible rows
+    QSet< quint64 > visibleDepartures;
+    int firstRow, lastRow;
+    if ( timetable && timetable->visibleRowRange(&firstRow, &lastRow) ) {
+        for ( int row = firstRow; row <= lastRow && row < model->rowCount(); ++row ) {
+            const DepartureItem *item = static_cast< DepartureItem* >( model->item(row) );
+            visibleDepartures << item->departureInfo()->hash();
+        }
+    }
+
+    // Get ranges of item numbers without additional data, for visible rows and for other rows
+    int visibleBegin = 999999999, visibleEnd = -1;
+    int otherBegin = 999999999, otherEnd = -1;
+    foreach ( const DepartureInfo &departure, departures ) {
+        if ( !departure.includesAdditionalData() &&
+             !departure.isWaitingForAdditionalData() &&
+              departure.additionalDataError().isEmpty() )
+        {
+            const int index = departure.index();
+            if ( visibleDepartures.contains(departure.hash()) ) {
+                visibleBegin = qMin( visibleBegin, index );
+                visibleEnd = qMax( visibleEnd, index );
+            } else {
+                otherBegin = qMin( otherBegin, index );
+                otherEnd = qMax( otherEnd, index );
             }
-        } else if ( departureInfo.isFilteredOut() ) {
-            // Departure has been marked as "filtered out" in the DepartureProcessor => Remove departure
-            model->removeItem( model->itemFromInfo( departureInfo ) );
-        } else {
-            // Departure isn't filtered out => Update associated item in the model
-            DepartureItem *item = dynamic_cast< DepartureItem* >( model->itemFromIndex(index) );
-            model->updateItem( item, departureInfo );
         }
     }
+    if ( visibleEnd == -1 && otherEnd == -1 ) {
+        return; // Nothing to request
+    }
 
-    // Sort departures in the model.
-    // They are most probably already sorted, but sometimes they are not
-    model->sort( ColumnDeparture );
+    // Start requests for visible rows first, the engine runs requests of a provider in
+    // the order in which they were started. Items of the visible range that are also in
+    // the other range are already busy then and get skipped by the engine
+    QList< QPair<int, int> > ranges;
+    if ( visibleEnd != -1 ) {
+        ranges << qMakePair( visibleBegin, visibleEnd );
+    }
+    if ( otherEnd != -1 ) {
+        ranges << qMakePair( otherBegin, otherEnd );
+    }
+    for ( int i = 0; i < ranges.count(); ++i ) {
+        // Use one service per job, the service gets deleted when its job has finished
+        Plasma::Service *service =
+                q->dataEngine("publictransport")->serviceForSource( sourceName );
+        if ( !service ) {
+            kWarning() << "No Timetable Service!";
+            return;
+        }
+
+        KConfigGroup op = service->operationDescription("requestAdditionalDataRange");
+        op.writeEntry( "itemnumberbegin", ranges[i].first );
+        op.writeEntry( "itemnumberend", ranges[i].second );
+        Plasma::ServiceJob *additionDataJob = service->startOperationCall( op );
+        q->connect( additionDataJob, SIGNAL(finished(KJob*)), service, SLOT(deleteLater()) );
+    }
+}
+
+void PublicTransportAppletPrivate::fillModel( const QList<DepartureInfo> &departures )
+{
+    // Merge the departures into the model, which stays sorted by departure.
+    // Departures marked as "filtered out" in the DepartureProcessor get removed
+    model->mergeItems( departures, settings.maximalNumberOfDepartures() );
 }
 
 void PublicTransportAppletPrivate::fillModelJourney( const QList<JourneyInfo> &journeys )
@@ -899,22 +936,52 @@ void PublicTransportAppletPrivate::updateJourneyMenu()
 QList<DepartureInfo> PublicTransportAppletPrivate::mergedDepartureList( bool includeFiltered,
                                                                   int max ) const
 {
-    QList< DepartureInfo > ret;
-
+    // Get the departure lists of all sources, sorted by departure
+    QList< QList<DepartureInfo> > sourceDepartures;
     for( int n = stopIndexToSourceName.count() - 1; n >= 0; --n ) {
         QString sourceName = stripDateAndTimeValues( stopIndexToSourceName[n] );
         if ( departureInfos.contains( sourceName ) ) {
-            foreach( const DepartureInfo & departureInfo, departureInfos[sourceName] ) {
-                // Only add not filtered items
-                if ( !departureInfo.isFilteredOut() || includeFiltered ) {
-                    ret << departureInfo;
+            QList< DepartureInfo > departures = departureInfos[ sourceName ];
+            for ( int i = 1; i < departures.count(); ++i ) {
+                if ( departures[i] < departures[i - 1] ) {
+                    qStableSort( departures.begin(), departures.end() );
+                    break;
                 }
             }
+            sourceDepartures << departures;
         }
     }
 
-    qSort( ret.begin(), ret.end() );
-    return max == -1 ? ret.mid( 0, settings.maximalNumberOfDepartures() ) : ret.mid( 0, max );
+    // Merge the sorted lists until enough departures are found
+    const int maxCount = max == -1 ? settings.maximalNumberOfDepartures() : max;
+    QVector< int > positions( sourceDepartures.count(), 0 );
+    QList< DepartureInfo > ret;
+    while ( ret.count() < maxCount ) {
+        // Find the list with the earliest next departure
+        int next = -1;
+        for ( int i = 0; i < sourceDepartures.count(); ++i ) {
+            const QList< DepartureInfo > &departures = sourceDepartures[i];
+            int &pos = positions[i];
+
+            // Only add not filtered items
+            while ( pos < departures.count() && !includeFiltered &&
+                    departures[pos].isFilteredOut() )
+            {
+                ++pos;
+            }
+            if ( pos < departures.count() && (next == -1 ||
+                 departures[pos] < sourceDepartures[next][positions[next]]) )
+            {
+                next = i;
+            }
+        }
+        if ( next == -1 ) {
+            // All lists are merged
+            break;
+        }
+        ret << sourceDepartures[next][positions[next]++];
+    }
+    return ret;
 }
 
 void PublicTransportAppletPrivate::reconnectSource()
@@ -1003,7 +1070,53 @@ void PublicTransportAppletPrivate::reconnectSource()
     foreach( const QString &previousSource, previousSources ) {
         kDebug() << "Disconnect data source" << previousSource;
         q->dataEngine( "publictransport" )->disconnectSource( previousSource, q );
+        departureProcessor->removeSource( previousSource );
+    }
+}
+
+void PublicTransportAppletPrivate::updateKioskTimer()
+{
+    Q_Q( PublicTransportApplet );
+    if ( !settings.kioskMode() ) {
+        delete kioskTimer;
+        kioskTimer = 0;
+
+        // Do not wait for the next full minute to apply received departures
+        q->applyPendingDepartureData();
+        return;
+    }
+
+    if ( !kioskTimer ) {
+        kioskTimer = new QTimer( q );
+        kioskTimer->setSingleShot( true );
+        q->connect( kioskTimer, SIGNAL(timeout()), q, SLOT(kioskTimerTimeout()) );
+
+        // Start measuring for the statistics
+        kioskCpuClock = std::clock();
+        timetable->resetPaintStatistics();
+    }
+
+    // Restart the timer each minute, a repeating timer would drift away from full minutes.
+    // If the timer fired a bit too early, do not fire again in the same minute
+    const QTime time = QTime::currentTime();
+    int msecs = 60000 - time.second() * 1000 - time.msec();
+    if ( msecs < 500 ) {
+        msecs += 60000;
     }
+    kioskTimer->start( msecs );
+}
+
+void PublicTransportAppletPrivate::logKioskStatistics()
+{
+    // The CPU time is measured for the whole process, ie. including other applets
+    const std::clock_t cpuClock = std::clock();
+    const qreal cpuMsecs = 1000.0 * (cpuClock - kioskCpuClock) / CLOCKS_PER_SEC;
+    kDebug() << "Kiosk mode statistics for the last minute:"
+             << timetable->frameCount() << "frames," << timetable->paintedRowCount()
+             << "painted rows," << cpuMsecs << "ms CPU time";
+
+    kioskCpuClock = cpuClock;
+    timetable->resetPaintStatistics();
 }
 
 void PublicTransportAppletPrivate::disconnectSources()
@@ -1013,6 +1126,7 @@ void PublicTransportAppletPrivate::disconnectSources()
         foreach( const QString &currentSource, currentSources ) {
             kDebug() << "Disconnect data source" << currentSource;
             q->dataEngine( "publictransport" )->disconnectSource( currentSource, q );
+            departureProcessor->removeSource( currentSource );
         }
         currentSources.clear();
     }
@@ -53,6 +53,9 @@
 #include <QGraphicsLinearLayout>
 #include <QLabel>
 
+// STL includes
+#include <ctime>
+
 class MarbleProcess;
 class OverlayWidget;
 class JourneySearchSuggestionWidget;
@@ -161,6 +164,16 @@ public: // Other functions
      **/
     void fillModelJourney( const QList<JourneyInfo> &journeys );
 
+    /** @brief Requests additional data for @p departures of @p sourceName, if not already done.
+     *
+     * Departures shown in currently visible rows get requested first. The engine does not
+     * track them separately, it publishes received additional data of the data source when all
+     * it's requests are done or otherwise after a short delay (ADDITIONAL_DATA_PUBLISH_INTERVAL
+     * of the engine). Visible rows therefore usually get their additional data after that delay.
+     **/
+    void requestAdditionalData( const QString &sourceName,
+                                const QList<DepartureInfo> &departures );
+
     /** @brief Gets a list of current departures/arrivals for the selected stop(s).
      *
      * @param includeFiltered Whether or not to include filtered departures in the returned list.
@@ -177,6 +190,16 @@ public: // Other functions
      **/
     void reconnectSource();
 
+    /**
+     * @brief Starts the kiosk timer for the next full minute if kiosk mode is enabled.
+     *
+     * Otherwise the timer gets deleted and pending departure data gets applied.
+     **/
+    void updateKioskTimer();
+
+    /** @brief Logs painted frames and rows and the used CPU time since the last call. */
+    void logKioskStatistics();
+
     /** @brief Disconnects a currently connected departure/arrival data source. */
     void disconnectSources();
 
@@ -270,6 +293,9 @@ public: // Inline functions, mostly used only once (therefore inline) or very sh
 
         // Create tooltip
         createTooltip();
+
+        // Align updates to full minutes in kiosk mode
+        updateKioskTimer();
     };
 
     /** @brief Create, initialize and connect the departure/journey models. */
@@ -551,9 +577,8 @@ public: // Inline functions, mostly used only once (therefore inline) or very sh
         _labelInfo->installEventFilter( q );
 
         // Create timetable item for departures/arrivals
-        timetable = new TimetableWidget( settings.drawShadows()
-                ? PublicTransportWidget::DrawShadowsOrHalos : PublicTransportWidget::NoOption,
-                PublicTransportWidget::ExpandSingle, mainGraphicsWidget );
+        timetable = new TimetableWidget( timetableOptions(), PublicTransportWidget::ExpandSingle,
+                                         mainGraphicsWidget );
         timetable->setModel( model );
         timetable->setSvg( &vehiclesSvg );
         q->connect( timetable, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
@@ -582,6 +607,18 @@ public: // Inline functions, mostly used only once (therefore inline) or very sh
         applyTheme();
     };
 
+    /** @brief Get the options for timetable widgets, depending on the current settings. */
+    inline PublicTransportWidget::Options timetableOptions() const {
+        PublicTransportWidget::Options options = PublicTransportWidget::NoOption;
+        if ( settings.drawShadows() ) {
+            options |= PublicTransportWidget::DrawShadowsOrHalos;
+        }
+        if ( settings.kioskMode() ) {
+            options |= PublicTransportWidget::LowPowerMode;
+        }
+        return options;
+    };
+
     /** @brief Clears the departure list received from the data engine and displayed by the applet. */
     inline void clearDepartures() {
         departureInfos.clear(); // Clear data from data engine
@@ -616,6 +653,10 @@ protected:
     QStringList currentSources; // Current source names at the publictransport data engine.
     int runningUpdateRequests; // The number of currently running update requests.
     QTimer *updateTimer; // A timer used to enable the update action again
+    QTimer *kioskTimer; // A timer firing each full minute in kiosk mode
+    QHash< QString, Plasma::DataEngine::Data > pendingDepartureData; // Departure data by source
+            // name, received in kiosk mode and applied at the next full minute
+    std::clock_t kioskCpuClock; // Used CPU time at the last kiosk timer tick
 
     JourneyModel *modelJourneys; // The model for journeys from or to the "home stop".
     QList<JourneyInfo> journeyInfos; // List of current journeys.
@@ -201,6 +201,9 @@ public:
         DrawShadows             = 0x0004,
         HideTargetColumn        = 0x0008,
         UseThemeFont            = 0x0010,
+        KioskMode               = 0x0020, /**< Low power mode for always visible boards,
+                * eg. on wall mounted displays. Disables animations and hover effects,
+                * caches painted rows and aligns data updates to full minutes. */
 
         DefaultSettingsFlags    = ColorizeDepartureGroups | DrawShadows | UseThemeFont
     };
@@ -424,6 +427,9 @@ public:
     /** @brief Whether or not the target/origin column should be shown in the departure view. */
     inline bool hideTargetColumn() const { return m_settingsFlags.testFlag(HideTargetColumn); };
 
+    /** @brief Whether or not the low power kiosk mode is enabled, see KioskMode. */
+    inline bool kioskMode() const { return m_settingsFlags.testFlag(KioskMode); };
+
     /** @brief Whether or not the default plasma theme's font is used. */
     inline bool useThemeFont() const { return m_settingsFlags.testFlag(UseThemeFont); };
 
@@ -485,6 +491,12 @@ public:
             m_settingsFlags ^= DrawShadows;
     };
 
+    /** @brief Whether or not the low power kiosk mode is enabled, see KioskMode. */
+    void setKioskMode( bool kioskMode ) {
+        if ( m_settingsFlags.testFlag(KioskMode) != kioskMode )
+            m_settingsFlags ^= KioskMode;
+    };
+
     /** @brief Whether or not the target/origin column should be shown in the departure view. */
     void setHideTargetColumn( bool hideTargetColumn ) {
         if ( m_settingsFlags.testFlag(HideTargetColumn) != hideTargetColumn )
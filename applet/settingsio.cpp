@@ -134,6 +134,7 @@ Settings SettingsIO::readSettings( KConfigGroup cg, KConfigGroup cgGlobal,
 
     settings.setDrawShadows( cg.readEntry("drawShadows", true) );
     settings.setHideTargetColumn( cg.readEntry("hideColumnTarget", false) );
+    settings.setKioskMode( cg.readEntry("kioskMode", false) );
     settings.setColorize( cg.readEntry("colorize", true) );
 
     QString fontFamily = cg.readEntry( "fontFamily", QString() );
@@ -324,6 +325,10 @@ SettingsIO::ChangedFlags SettingsIO::writeSettings( const Settings &settings,
             cg.writeEntry( "colorize", settings.colorize() );
             changed |= IsChanged | ChangedColorization;
         }
+        if ( settings.kioskMode() != oldSettings.kioskMode() ) {
+            cg.writeEntry( "kioskMode", settings.kioskMode() );
+            changed |= IsChanged | ChangedKioskMode;
+        }
     }
 
     if ( settings.departureArrivalListType() != oldSettings.departureArrivalListType() ) {
@@ -90,6 +90,7 @@ public:
         ChangedAdditionalDataRequestSettings
                                 = 0x02000, /**< Changed when additional timetable data should
                 * be requested. */
+        ChangedKioskMode        = 0x040000, /**< The low power kiosk mode has been toggled. */
 
         ChangedCurrentFilterSettings = ChangedCurrentStop || ChangedCurrentStopSettings ||
                 ChangedFilterSettings
@@ -188,6 +188,7 @@ SettingsUiManager::SettingsUiManager( const Settings &settings,
     connect( m_uiAdvanced.showArrivals, SIGNAL(toggled(bool)), this, SLOT(changed()) );
     connect( m_uiAdvanced.showDepartures, SIGNAL(toggled(bool)), this, SLOT(changed()) );
     connect( m_uiAdvanced.additionalData, SIGNAL(currentIndexChanged(int)), this, SLOT(changed()) );
+    connect( m_uiAdvanced.kioskMode, SIGNAL(stateChanged(int)), this, SLOT(changed()) );
     connect( m_uiAlarms.affectedStops, SIGNAL(checkedItemsChanged()), this, SLOT(changed()) );
     connect( m_uiAlarms.alarmFilter, SIGNAL(changed()), this, SLOT(changed()) );
     connect( m_uiAlarms.alarmType, SIGNAL(currentIndexChanged(int)), this, SLOT(changed()) );
@@ -635,6 +636,7 @@ void SettingsUiManager::setValuesOfAdvancedConfig( const Settings &settings )
     m_uiAdvanced.showDepartures->setChecked( settings.departureArrivalListType() == DepartureList );
     m_uiAdvanced.showArrivals->setChecked( settings.departureArrivalListType() == ArrivalList );
     m_uiAdvanced.maximalNumberOfDepartures->setValue( settings.maximalNumberOfDepartures() );
+    m_uiAdvanced.kioskMode->setChecked( settings.kioskMode() );
     switch ( settings.additionalDataRequestType() ) {
     case Settings::NeverRequestAdditionalData:
         m_uiAppearance.cmbDepartureColumnInfos->setCurrentIndex( 2 );
@@ -847,6 +849,9 @@ Settings SettingsUiManager::settings()
     if ( m_uiAppearance.colorize->isChecked() ) {
         flags |= Settings::ColorizeDepartureGroups;
     }
+    if ( m_uiAdvanced.kioskMode->isChecked() ) {
+        flags |= Settings::KioskMode;
+    }
     ret.setSettingsFlags( flags );
 
     switch ( m_uiAdvanced.additionalData->currentIndex() ) {
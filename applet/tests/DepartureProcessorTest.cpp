@@ -0,0 +1,502 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "DepartureProcessorTest.h"
+
+#include <QtTest/QTest>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QUrl>
+
+// Create departure data like it gets published by the data engine, all departures are in the
+// future to not get filtered out by the first departure settings
+static QVariantHash departureData( int count, const QString &targetPrefix )
+{
+    const QDateTime firstDeparture = QDateTime::currentDateTime().addSecs( 3600 );
+    QVariantList departures;
+    for ( int i = 0; i < count; ++i ) {
+        QVariantHash departure;
+        departure[ "DepartureDateTime" ] = firstDeparture.addSecs( i * 60 );
+        departure[ "TypeOfVehicle" ] = static_cast< int >( Tram );
+        departure[ "TransportLine" ] = QString::number( i % 10 + 1 );
+        departure[ "Target" ] = targetPrefix + ' ' + QString::number( i );
+        departure[ "Platform" ] = QString::number( i % 3 );
+        departure[ "Delay" ] = -1;
+        departure[ "Nightline" ] = false;
+        departure[ "Expressline" ] = false;
+        departure[ "additionalDataState" ] = "notrequested";
+        departures << departure;
+    }
+
+    QVariantHash data;
+    data[ "departures" ] = departures;
+    data[ "requestUrl" ] = QUrl( "http://www.example.com/departures" );
+    data[ "updated" ] = QDateTime::currentDateTime();
+    data[ "nextAutomaticUpdate" ] = QDateTime::currentDateTime().addSecs( 300 );
+    data[ "minManualUpdateTime" ] = QDateTime::currentDateTime().addSecs( 60 );
+    return data;
+}
+
+static QVariantHash journeyData( int count )
+{
+    const QDateTime firstDeparture = QDateTime::currentDateTime().addSecs( 3600 );
+    QVariantList journeys;
+    for ( int i = 0; i < count; ++i ) {
+        QVariantHash journey;
+        journey[ "DepartureDateTime" ] = firstDeparture.addSecs( i * 600 );
+        journey[ "ArrivalDateTime" ] = firstDeparture.addSecs( i * 600 + 1800 );
+        journey[ "StartStopName" ] = "Start";
+        journey[ "TargetStopName" ] = "Target";
+        journey[ "Duration" ] = 30;
+        journey[ "Changes" ] = i % 2;
+        journeys << journey;
+    }
+
+    QVariantHash data;
+    data[ "journeys" ] = journeys;
+    data[ "requestUrl" ] = QUrl( "http://www.example.com/journeys" );
+    data[ "updated" ] = QDateTime::currentDateTime();
+    return data;
+}
+
+// Wait until no more jobs are running, the queue is expected to be empty
+static bool waitForIdle( DepartureProcessor *processor, int timeout = 10000 )
+{
+    QElapsedTimer timer;
+    timer.start();
+    while ( processor->runningJobs() != DepartureProcessor::NoJob ) {
+        if ( timer.elapsed() > timeout ) {
+            return false;
+        }
+        QTest::qWait( 10 );
+    }
+    return true;
+}
+
+// Process departures of @p sourceName and wait until they were delivered
+static bool processDeparturesAndWait( DepartureProcessor *processor,
+        DepartureProcessorRecorder *recorder, const QString &sourceName,
+        const QVariantHash &data )
+{
+    const int processedCount = recorder->events( sourceName ).count( "processed" );
+    processor->processDepartures( sourceName, data );
+
+    QElapsedTimer timer;
+    timer.start();
+    while ( recorder->events(sourceName).count("processed") == processedCount ) {
+        if ( timer.elapsed() > 10000 ) {
+            return false;
+        }
+        QTest::qWait( 10 );
+    }
+    return waitForIdle( processor );
+}
+
+DepartureProcessorRecorder::DepartureProcessorRecorder( DepartureProcessor *processor )
+        : QObject()
+{
+    // Slots get called in the threads of the processor
+    connect( processor, SIGNAL(beginDepartureProcessing(QString)),
+             this, SLOT(beginDepartureProcessing(QString)), Qt::DirectConnection );
+    connect( processor, SIGNAL(departuresProcessed(QString,QList<DepartureInfo>,QUrl,QDateTime,QDateTime,QDateTime,int)),
+             this, SLOT(departuresProcessed(QString,QList<DepartureInfo>,QUrl,QDateTime,QDateTime,QDateTime,int)),
+             Qt::DirectConnection );
+    connect( processor, SIGNAL(beginJourneyProcessing(QString)),
+             this, SLOT(beginJourneyProcessing(QString)), Qt::DirectConnection );
+    connect( processor, SIGNAL(journeysProcessed(QString,QList<JourneyInfo>,QUrl,QDateTime)),
+             this, SLOT(journeysProcessed(QString,QList<JourneyInfo>,QUrl,QDateTime)),
+             Qt::DirectConnection );
+    connect( processor, SIGNAL(beginFiltering(QString)),
+             this, SLOT(beginFiltering(QString)), Qt::DirectConnection );
+    connect( processor, SIGNAL(departuresFiltered(QString,QList<DepartureInfo>,QList<DepartureInfo>,QList<DepartureInfo>)),
+             this, SLOT(departuresFiltered(QString,QList<DepartureInfo>,QList<DepartureInfo>,QList<DepartureInfo>)),
+             Qt::DirectConnection );
+}
+
+void DepartureProcessorRecorder::blockDepartureJob( const QString &sourceName )
+{
+    QMutexLocker locker( &m_mutex );
+    m_blockedSourceName = sourceName;
+}
+
+bool DepartureProcessorRecorder::waitForBlockedJob( int timeout )
+{
+    return m_blocked.tryAcquire( 1, timeout );
+}
+
+void DepartureProcessorRecorder::continueDepartureJob()
+{
+    m_continue.release();
+}
+
+bool DepartureProcessorRecorder::waitForEvents( int count, int timeout )
+{
+    QMutexLocker locker( &m_mutex );
+    QElapsedTimer timer;
+    timer.start();
+    while ( m_events.count() < count ) {
+        const qint64 remainingTime = timeout - timer.elapsed();
+        if ( remainingTime <= 0 ) {
+            return false;
+        }
+        m_eventAdded.wait( &m_mutex, remainingTime );
+    }
+    return true;
+}
+
+QStringList DepartureProcessorRecorder::events() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_events;
+}
+
+QStringList DepartureProcessorRecorder::events( const QString &sourceName ) const
+{
+    QMutexLocker locker( &m_mutex );
+    QStringList sourceEvents;
+    const QString suffix = ' ' + sourceName;
+    foreach ( const QString &event, m_events ) {
+        if ( event.endsWith(suffix) ) {
+            sourceEvents << event.left( event.length() - suffix.length() );
+        }
+    }
+    return sourceEvents;
+}
+
+QList< DepartureInfo > DepartureProcessorRecorder::departures( const QString &sourceName ) const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_departures.value( sourceName );
+}
+
+void DepartureProcessorRecorder::addEvent( const QString &event, const QString &sourceName )
+{
+    // m_mutex is expected to be already locked
+    m_events << event + ' ' + sourceName;
+    m_eventAdded.wakeAll();
+}
+
+void DepartureProcessorRecorder::beginDepartureProcessing( const QString &sourceName )
+{
+    m_mutex.lock();
+    m_departures[ sourceName ].clear();
+    addEvent( "begin", sourceName );
+    const bool block = sourceName == m_blockedSourceName;
+    if ( block ) {
+        m_blockedSourceName.clear();
+    }
+    m_mutex.unlock();
+
+    if ( block ) {
+        m_blocked.release();
+        m_continue.acquire();
+    }
+}
+
+void DepartureProcessorRecorder::departuresProcessed( const QString &sourceName,
+        const QList< DepartureInfo > &departures, const QUrl &requestUrl,
+        const QDateTime &lastUpdate, const QDateTime &nextAutomaticUpdate,
+        const QDateTime &minManualUpdateTime, int departuresToGo )
+{
+    Q_UNUSED( requestUrl );
+    Q_UNUSED( lastUpdate );
+    Q_UNUSED( nextAutomaticUpdate );
+    Q_UNUSED( minManualUpdateTime );
+    QMutexLocker locker( &m_mutex );
+    m_departures[ sourceName ] << departures;
+    addEvent( departuresToGo == 0 ? "processed" : "batch", sourceName );
+}
+
+void DepartureProcessorRecorder::beginJourneyProcessing( const QString &sourceName )
+{
+    QMutexLocker locker( &m_mutex );
+    addEvent( "beginJourneys", sourceName );
+}
+
+void DepartureProcessorRecorder::journeysProcessed( const QString &sourceName,
+        const QList< JourneyInfo > &journeys, const QUrl &requestUrl,
+        const QDateTime &lastUpdate )
+{
+    Q_UNUSED( journeys );
+    Q_UNUSED( requestUrl );
+    Q_UNUSED( lastUpdate );
+    QMutexLocker locker( &m_mutex );
+    addEvent( "journeys", sourceName );
+}
+
+void DepartureProcessorRecorder::beginFiltering( const QString &sourceName )
+{
+    QMutexLocker locker( &m_mutex );
+    addEvent( "beginFiltering", sourceName );
+}
+
+void DepartureProcessorRecorder::departuresFiltered( const QString &sourceName,
+        const QList< DepartureInfo > &departures, const QList< DepartureInfo > &newlyFiltered,
+        const QList< DepartureInfo > &newlyNotFiltered )
+{
+    Q_UNUSED( departures );
+    Q_UNUSED( newlyFiltered );
+    Q_UNUSED( newlyNotFiltered );
+    QMutexLocker locker( &m_mutex );
+    addEvent( "filtered", sourceName );
+}
+
+void DepartureProcessorTest::init()
+{
+    m_processor = new DepartureProcessor();
+    m_processor->setFirstDepartureSettings( RelativeToCurrentTime, QTime(), 0 );
+    m_recorder = new DepartureProcessorRecorder( m_processor );
+}
+
+void DepartureProcessorTest::cleanup()
+{
+    // Do not leave a thread blocked in the recorder, the processor waits for it's threads
+    m_recorder->continueDepartureJob();
+    delete m_processor;
+    delete m_recorder;
+}
+
+void DepartureProcessorTest::deliveryOrderTest()
+{
+    // Keep the first job for source A running while other jobs get queued
+    m_recorder->blockDepartureJob( "A" );
+    m_processor->processDepartures( "A", departureData(5, "A") );
+    QVERIFY( m_recorder->waitForBlockedJob() );
+    m_processor->filterDepartures( "A", QList< DepartureInfo >() );
+    m_processor->processJourneys( "A", journeyData(3) );
+    m_processor->processDepartures( "B", departureData(5, "B") );
+
+    if ( qBound(1, QThread::idealThreadCount(), DepartureProcessor::MAXIMUM_THREAD_COUNT) > 1 ) {
+        // Another thread processes the departures of source B while source A is busy
+        QVERIFY( m_recorder->waitForEvents(3) );
+        QCOMPARE( m_recorder->events("B"), QStringList() << "begin" << "processed" );
+    }
+    m_recorder->continueDepartureJob();
+
+    QVERIFY( m_recorder->waitForEvents(8) );
+    QVERIFY( waitForIdle(m_processor) );
+    QCOMPARE( m_recorder->events("A"), QStringList() << "begin" << "processed"
+              << "beginFiltering" << "filtered" << "beginJourneys" << "journeys" );
+    QCOMPARE( m_recorder->events("B"), QStringList() << "begin" << "processed" );
+    QCOMPARE( m_recorder->departures("A").count(), 5 );
+    QCOMPARE( m_recorder->departures("B").count(), 5 );
+}
+
+void DepartureProcessorTest::cancelJobsTest()
+{
+    // Abort the running job for source A and the waiting filter job
+    m_recorder->blockDepartureJob( "A" );
+    m_processor->processDepartures( "A", departureData(5, "A") );
+    QVERIFY( m_recorder->waitForBlockedJob() );
+    m_processor->filterDepartures( "A", QList< DepartureInfo >() );
+    QVERIFY( m_processor->runningJobs() == DepartureProcessor::ProcessDepartures );
+    m_processor->abortJobs();
+    m_recorder->continueDepartureJob();
+    QVERIFY( waitForIdle(m_processor) );
+    QTest::qWait( 100 );
+    QCOMPARE( m_recorder->events(), QStringList() << "begin A" );
+
+    // Removing the source cancels it's running and waiting jobs, but not jobs of other sources
+    m_recorder->blockDepartureJob( "A" );
+    m_processor->processDepartures( "A", departureData(5, "A") );
+    QVERIFY( m_recorder->waitForBlockedJob() );
+    m_processor->processJourneys( "A", journeyData(3) );
+    m_processor->removeSource( "A" );
+    m_processor->processDepartures( "B", departureData(5, "B") );
+    m_recorder->continueDepartureJob();
+    QVERIFY( m_recorder->waitForEvents(4) );
+    QVERIFY( waitForIdle(m_processor) );
+    QTest::qWait( 100 );
+    QCOMPARE( m_recorder->events("A"), QStringList() << "begin" << "begin" );
+    QCOMPARE( m_recorder->events("B"), QStringList() << "begin" << "processed" );
+}
+
+void DepartureProcessorTest::supersededJobsTest()
+{
+    // Queue newer departure jobs for source A while the first one is running
+    m_recorder->blockDepartureJob( "A" );
+    m_processor->processDepartures( "A", departureData(5, "First") );
+    QVERIFY( m_recorder->waitForBlockedJob() );
+    m_processor->processDepartures( "A", departureData(5, "Second") );
+    m_processor->processDepartures( "A", departureData(5, "Third") );
+    m_processor->processDepartures( "A", departureData(4, "Last") );
+    m_recorder->continueDepartureJob();
+
+    // The running job was aborted and the waiting jobs were dropped,
+    // only departures of the last job get delivered
+    QVERIFY( m_recorder->waitForEvents(3) );
+    QVERIFY( waitForIdle(m_processor) );
+    QTest::qWait( 100 );
+    QCOMPARE( m_recorder->events("A"), QStringList() << "begin" << "begin" << "processed" );
+    const QList< DepartureInfo > departures = m_recorder->departures( "A" );
+    QCOMPARE( departures.count(), 4 );
+    foreach ( const DepartureInfo &departure, departures ) {
+        QVERIFY( departure.target().startsWith(QLatin1String("Last")) );
+    }
+}
+
+void DepartureProcessorTest::requeueTest()
+{
+    // Use enough departures to take longer than DEPARTURE_BATCH_INTERVAL to process,
+    // only then running jobs check if they should get requeued
+    const int count = 20000;
+    m_recorder->blockDepartureJob( "A" );
+    m_processor->processDepartures( "A", departureData(count, "A") );
+    QVERIFY( m_recorder->waitForBlockedJob() );
+
+    // Changed settings requeue the running departure job, because a filter job is waiting
+    m_processor->filterDepartures( "A", QList< DepartureInfo >() );
+    m_processor->setFilters( FilterSettingsList() );
+    m_recorder->continueDepartureJob();
+
+    QElapsedTimer timer;
+    timer.start();
+    while ( !m_recorder->events("A").contains("processed") ||
+            !m_recorder->events("A").contains("filtered") )
+    {
+        QVERIFY( timer.elapsed() < 30000 );
+        QTest::qWait( 10 );
+    }
+    QVERIFY( waitForIdle(m_processor) );
+
+    // The requeued job did not emit beginDepartureProcessing() again, which would have cleared
+    // the departures of the batches emitted before it was requeued
+    const QStringList events = m_recorder->events( "A" );
+    QCOMPARE( events.count("begin"), 1 );
+    const QList< DepartureInfo > departures = m_recorder->departures( "A" );
+    QCOMPARE( departures.count(), count );
+    for ( int i = 0; i < departures.count(); ++i ) {
+        QCOMPARE( departures[i].index(), i );
+    }
+
+    // The filter job runs before the remaining departures of the requeued job get processed
+    if ( events.indexOf("filtered") > events.indexOf("processed") ) {
+        QSKIP( "Departures were processed before the job could get requeued", SkipSingle );
+    }
+}
+
+void DepartureProcessorTest::reuseProcessedDeparturesTest()
+{
+    const QVariantHash data = departureData( 10, "A" );
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", data) );
+    QCOMPARE( m_processor->createdDepartureCount(), 10 );
+    QCOMPARE( m_processor->reusedDepartureCount(), 0 );
+
+    // An update with the same data reuses all departures
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", data) );
+    QCOMPARE( m_processor->createdDepartureCount(), 10 );
+    QCOMPARE( m_processor->reusedDepartureCount(), 10 );
+    QCOMPARE( m_recorder->departures("A").count(), 10 );
+
+    // Only a departure with changed data gets processed again
+    QVariantHash changedData = data;
+    QVariantList departures = changedData[ "departures" ].toList();
+    QVariantHash departure = departures[ 3 ].toHash();
+    departure[ "Delay" ] = 5;
+    departures[ 3 ] = departure;
+    changedData[ "departures" ] = departures;
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", changedData) );
+    QCOMPARE( m_processor->createdDepartureCount(), 11 );
+    QCOMPARE( m_processor->reusedDepartureCount(), 19 );
+    QCOMPARE( m_recorder->departures("A")[3].delay(), 5 );
+
+    // Reused departures get the index of their position in the new data
+    departures.prepend( departureData(1, "New").value("departures").toList().first() );
+    changedData[ "departures" ] = departures;
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", changedData) );
+    QCOMPARE( m_processor->createdDepartureCount(), 12 );
+    QCOMPARE( m_processor->reusedDepartureCount(), 29 );
+    const QList< DepartureInfo > processedDepartures = m_recorder->departures( "A" );
+    for ( int i = 0; i < processedDepartures.count(); ++i ) {
+        QCOMPARE( processedDepartures[i].index(), i );
+    }
+
+    // Departures of another source do not get reused
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "B", data) );
+    QCOMPARE( m_processor->createdDepartureCount(), 22 );
+    QCOMPARE( m_processor->reusedDepartureCount(), 29 );
+}
+
+void DepartureProcessorTest::discardProcessedDeparturesTest_data()
+{
+    QTest::addColumn< QString >( "change" );
+
+    QTest::newRow( "Filters" ) << "filters";
+    QTest::newRow( "Color groups" ) << "colorGroups";
+    QTest::newRow( "Alarms" ) << "alarms";
+    QTest::newRow( "Arrivals" ) << "arrivals";
+    QTest::newRow( "Removed source" ) << "removeSource";
+}
+
+void DepartureProcessorTest::discardProcessedDeparturesTest()
+{
+    QFETCH( QString, change );
+
+    const QVariantHash data = departureData( 10, "A" );
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", data) );
+    QCOMPARE( m_processor->createdDepartureCount(), 10 );
+
+    // Matches the first departure
+    Filter filter;
+    filter << Constraint( FilterByTarget, FilterEquals, "A 0" );
+    if ( change == QLatin1String("filters") ) {
+        FilterSettings filterSettings;
+        filterSettings.filterAction = HideMatching;
+        filterSettings.filters << filter;
+        m_processor->setFilters( FilterSettingsList() << filterSettings );
+    } else if ( change == QLatin1String("colorGroups") ) {
+        ColorGroupSettings colorGroup( Qt::red );
+        colorGroup.filters << filter;
+        colorGroup.filterOut = true;
+        ColorGroupSettingsList colorGroups;
+        colorGroups << colorGroup;
+        m_processor->setColorGroups( colorGroups );
+    } else if ( change == QLatin1String("alarms") ) {
+        AlarmSettings alarm( "Alarm" );
+        alarm.filter = filter;
+        AlarmSettingsList alarms;
+        alarms << alarm;
+        m_processor->setAlarms( alarms );
+    } else if ( change == QLatin1String("arrivals") ) {
+        m_processor->setDepartureArrivalListType( ArrivalList );
+    } else {
+        m_processor->removeSource( "A" );
+    }
+
+    // No departure gets reused, all get processed again using the changed settings
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", data) );
+    QCOMPARE( m_processor->reusedDepartureCount(), 0 );
+    QCOMPARE( m_processor->createdDepartureCount(), 20 );
+
+    const DepartureInfo first = m_recorder->departures( "A" ).first();
+    QCOMPARE( first.target(), QString("A 0") );
+    QCOMPARE( first.isFilteredOut(),
+              change == QLatin1String("filters") || change == QLatin1String("colorGroups") );
+    QCOMPARE( first.matchedAlarms(),
+              change == QLatin1String("alarms") ? QList<int>() << 0 : QList<int>() );
+    QCOMPARE( first.isArrival(), change == QLatin1String("arrivals") );
+
+    // The departures processed with the changed settings get reused again
+    QVERIFY( processDeparturesAndWait(m_processor, m_recorder, "A", data) );
+    QCOMPARE( m_processor->reusedDepartureCount(), 10 );
+    QCOMPARE( m_processor->createdDepartureCount(), 20 );
+}
+
+QTEST_MAIN(DepartureProcessorTest)
+#include "DepartureProcessorTest.moc"
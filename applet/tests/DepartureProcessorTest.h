@@ -0,0 +1,125 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef DEPARTUREPROCESSORTEST_H
+#define DEPARTUREPROCESSORTEST_H
+
+#include "../departureprocessor.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QSemaphore>
+
+/**
+ * @brief Records signals of a DepartureProcessor, which get emitted in it's threads.
+ *
+ * Departures get stored like the applet does, ie. departures of a source get cleared in
+ * beginDepartureProcessing(). Can block a departure job of a source when it gets started,
+ * to queue other jobs while it is running.
+ **/
+class DepartureProcessorRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DepartureProcessorRecorder( DepartureProcessor *processor );
+
+    /** @brief Block the next departure job for @p sourceName when it gets started. */
+    void blockDepartureJob( const QString &sourceName );
+
+    /** @brief Wait until the job given to blockDepartureJob() is blocked. */
+    bool waitForBlockedJob( int timeout = 5000 );
+
+    /** @brief Continue the blocked departure job. */
+    void continueDepartureJob();
+
+    /** @brief Wait until @p count events were recorded. */
+    bool waitForEvents( int count, int timeout = 10000 );
+
+    /** @brief Events like "processed A" in the order in which they were recorded. */
+    QStringList events() const;
+
+    /** @brief Events for @p sourceName, without the source name. */
+    QStringList events( const QString &sourceName ) const;
+
+    /** @brief Departures received for @p sourceName since the last beginDepartureProcessing(). */
+    QList< DepartureInfo > departures( const QString &sourceName ) const;
+
+public slots:
+    // Directly connected, called in the threads of the processor
+    void beginDepartureProcessing( const QString &sourceName );
+    void departuresProcessed( const QString &sourceName, const QList< DepartureInfo > &departures,
+            const QUrl &requestUrl, const QDateTime &lastUpdate,
+            const QDateTime &nextAutomaticUpdate, const QDateTime &minManualUpdateTime,
+            int departuresToGo );
+    void beginJourneyProcessing( const QString &sourceName );
+    void journeysProcessed( const QString &sourceName, const QList< JourneyInfo > &journeys,
+                            const QUrl &requestUrl, const QDateTime &lastUpdate );
+    void beginFiltering( const QString &sourceName );
+    void departuresFiltered( const QString &sourceName, const QList< DepartureInfo > &departures,
+                             const QList< DepartureInfo > &newlyFiltered,
+                             const QList< DepartureInfo > &newlyNotFiltered );
+
+private:
+    void addEvent( const QString &event, const QString &sourceName );
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_eventAdded;
+    QStringList m_events;
+    QHash< QString, QList<DepartureInfo> > m_departures;
+    QString m_blockedSourceName;
+    QSemaphore m_blocked;
+    QSemaphore m_continue;
+};
+
+class DepartureProcessorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    // Jobs for one source get delivered in the queued order, other sources do not wait
+    void deliveryOrderTest();
+
+    // Cancelled jobs do not deliver results, using abortJobs() or removeSource()
+    void cancelJobsTest();
+
+    // Waiting jobs get dropped and running jobs get aborted by newer jobs of the same type
+    void supersededJobsTest();
+
+    // A job interrupted by changed settings continues without clearing it's first departures
+    void requeueTest();
+
+    // Unchanged departures of the last update of a source get reused
+    void reuseProcessedDeparturesTest();
+
+    // Changed settings or removing the source discard departures to be reused
+    void discardProcessedDeparturesTest_data();
+    void discardProcessedDeparturesTest();
+
+private:
+    DepartureProcessor *m_processor;
+    DepartureProcessorRecorder *m_recorder;
+};
+
+#endif // DEPARTUREPROCESSORTEST_H
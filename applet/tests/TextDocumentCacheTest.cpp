@@ -0,0 +1,157 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "TextDocumentCacheTest.h"
+#include "../textdocumentcache.h"
+
+#include <QtTest/QTest>
+#include <QTextOption>
+#include <QPainter>
+#include <QImage>
+
+// Number of rows used for the benchmark
+static const int ROW_COUNT = 200;
+
+static QString infoHtml( int row )
+{
+    return QString( "<b>%1</b> to Target %2" ).arg( row % 20 ).arg( row % 7 );
+}
+
+static QString timeHtml( int row, int minute )
+{
+    return QString( "12:%1 (in %2 minutes)" ).arg( row % 60, 2, 10, QLatin1Char('0') )
+            .arg( row / 4 + 1 - minute );
+}
+
+void TextDocumentCacheTest::cacheTest()
+{
+    TextDocumentCache cache;
+    const QTextOption textOption( Qt::AlignVCenter | Qt::AlignLeft );
+    const QFont font;
+    const QSizeF size( 200, 40 );
+
+    TextDocumentCache::DocumentPtr document =
+            cache.textDocument( "<b>4</b> to Target", size, textOption, font );
+    QVERIFY( document );
+    QCOMPARE( document->pageSize(), size );
+    QCOMPARE( cache.missCount(), 1 );
+
+    // Same arguments return the same document
+    QCOMPARE( cache.textDocument("<b>4</b> to Target", size, textOption, font), document );
+    QCOMPARE( cache.hitCount(), 1 );
+
+    // Any changed argument returns another document
+    QVERIFY( cache.textDocument("<b>5</b> to Target", size, textOption, font) != document );
+    QVERIFY( cache.textDocument("<b>4</b> to Target", QSizeF(150, 40), textOption, font)
+             != document );
+    QVERIFY( cache.textDocument("<b>4</b> to Target", size,
+                                QTextOption(Qt::AlignVCenter | Qt::AlignRight), font) != document );
+    QFont italicFont = font;
+    italicFont.setItalic( true );
+    TextDocumentCache::DocumentPtr italicDocument =
+            cache.textDocument( "<b>4</b> to Target", size, textOption, italicFont );
+    QVERIFY( italicDocument != document );
+    QCOMPARE( italicDocument->defaultFont(), italicFont );
+    QCOMPARE( cache.missCount(), 5 );
+    QCOMPARE( cache.count(), 5 );
+
+    // Cleared documents stay valid while they are used
+    cache.clear();
+    QCOMPARE( cache.count(), 0 );
+    QVERIFY( !document->isEmpty() );
+    QVERIFY( cache.textDocument("<b>4</b> to Target", size, textOption, font) != document );
+}
+
+void TextDocumentCacheTest::evictionTest()
+{
+    TextDocumentCache cache;
+    const QTextOption textOption;
+    const QFont font;
+    const QSizeF size( 200, 40 );
+
+    const TextDocumentCache::DocumentPtr first = cache.textDocument( "0", size, textOption, font );
+    for ( int i = 1; i <= TextDocumentCache::MAXIMUM_CACHED_DOCUMENTS; ++i ) {
+        cache.textDocument( QString::number(i), size, textOption, font );
+    }
+    QCOMPARE( cache.count(), TextDocumentCache::MAXIMUM_CACHED_DOCUMENTS );
+
+    // The least recently used document was removed, but is still valid
+    QCOMPARE( first->toPlainText(), QString("0") );
+    QVERIFY( cache.textDocument("0", size, textOption, font) != first );
+}
+
+void TextDocumentCacheTest::paintBenchmark_data()
+{
+    QTest::addColumn<bool>( "cached" );
+
+    QTest::newRow( "uncached" ) << false;
+    QTest::newRow( "cached" ) << true;
+}
+
+void TextDocumentCacheTest::paintBenchmark()
+{
+    QFETCH( bool, cached );
+
+    TextDocumentCache cache;
+    QTextOption textOption( Qt::AlignVCenter | Qt::AlignLeft );
+    textOption.setWrapMode( QTextOption::WordWrap );
+    const QFont font;
+    const QSizeF infoSize( 250, 40 );
+    const QSizeF timeSize( 150, 40 );
+    QImage image( 400, 40, QImage::Format_ARGB32_Premultiplied );
+
+    // Documents currently used by the rows, initially laid out for minute 0
+    QList< TextDocumentCache::DocumentPtr > infoDocuments;
+    QList< TextDocumentCache::DocumentPtr > timeDocuments;
+    for ( int row = 0; row < ROW_COUNT; ++row ) {
+        infoDocuments << cache.textDocument( infoHtml(row), infoSize, textOption, font );
+        timeDocuments << cache.textDocument( timeHtml(row, 0), timeSize, textOption, font );
+    }
+
+    int minute = 0;
+    QBENCHMARK {
+        // The remaining minutes changed, update and paint all rows
+        ++minute;
+        for ( int row = 0; row < ROW_COUNT; ++row ) {
+            if ( cached ) {
+                // Only the time column changed, the info document gets reused
+                infoDocuments[row] = cache.textDocument( infoHtml(row), infoSize, textOption, font );
+                timeDocuments[row] = cache.textDocument( timeHtml(row, minute), timeSize,
+                                                         textOption, font );
+            } else {
+                // Create new documents for all columns, as done before the cache was added
+                infoDocuments[row] = TextDocumentCache::DocumentPtr(
+                        TextDocumentCache::createTextDocument(infoHtml(row), infoSize,
+                                                              textOption, font) );
+                timeDocuments[row] = TextDocumentCache::DocumentPtr(
+                        TextDocumentCache::createTextDocument(timeHtml(row, minute), timeSize,
+                                                              textOption, font) );
+            }
+
+            image.fill( Qt::transparent );
+            QPainter painter( &image );
+            infoDocuments[row]->drawContents( &painter );
+            painter.translate( infoSize.width(), 0 );
+            timeDocuments[row]->drawContents( &painter );
+        }
+    }
+}
+
+QTEST_MAIN(TextDocumentCacheTest)
+#include "TextDocumentCacheTest.moc"
@@ -0,0 +1,71 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "textdocumentcache.h"
+
+// Qt includes
+#include <QAbstractTextDocumentLayout>
+#include <QTextOption>
+
+const int TextDocumentCache::MAXIMUM_CACHED_DOCUMENTS = 300;
+
+TextDocumentCache::TextDocumentCache() : m_hitCount(0), m_missCount(0)
+{
+    m_documents.setMaxCost( MAXIMUM_CACHED_DOCUMENTS );
+}
+
+QTextDocument *TextDocumentCache::createTextDocument( const QString &html, const QSizeF &size,
+                                                      const QTextOption &textOption,
+                                                      const QFont &font )
+{
+    QTextDocument *textDocument = new QTextDocument;
+    textDocument->setDefaultFont( font );
+    textDocument->setDocumentMargin( 0 );
+    textDocument->setDefaultTextOption( textOption );
+    textDocument->setPageSize( size );
+    textDocument->setHtml( html );
+    textDocument->documentLayout();
+    return textDocument;
+}
+
+TextDocumentCache::DocumentPtr TextDocumentCache::textDocument( const QString &html,
+        const QSizeF &size, const QTextOption &textOption, const QFont &font )
+{
+    // The font key contains family, size, weight, style, etc.
+    const QString key = QString( "%1|%2|%3|%4|%5|" )
+            .arg( font.key() ).arg( size.width() ).arg( size.height() )
+            .arg( static_cast<int>(textOption.alignment()) )
+            .arg( static_cast<int>(textOption.wrapMode()) ) + html;
+    DocumentPtr *document = m_documents.object( key );
+    if ( document ) {
+        ++m_hitCount;
+        return *document;
+    }
+
+    ++m_missCount;
+    const DocumentPtr newDocument( createTextDocument(html, size, textOption, font) );
+    m_documents.insert( key, new DocumentPtr(newDocument) );
+    return newDocument;
+}
+
+void TextDocumentCache::clear()
+{
+    m_documents.clear();
+}
@@ -0,0 +1,89 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains a cache for laid out text documents, shared by timetable items.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef TEXTDOCUMENTCACHE_HEADER
+#define TEXTDOCUMENTCACHE_HEADER
+
+// Qt includes
+#include <QCache>
+#include <QSharedPointer>
+#include <QTextDocument>
+
+class QTextOption;
+
+/**
+ * @brief A cache for laid out QTextDocuments, keyed by HTML, font, size and text option.
+ *
+ * Many departure rows show the same texts (eg. the same line and target or the same remaining
+ * time), rows that get updated mostly show the same texts as before. Instead of creating and
+ * laying out a new QTextDocument for each row and update, use textDocument() to get a shared
+ * document. The zoom factor is part of the key through the font and the size.
+ *
+ * Returned documents are shared and must not be modified, eg. use another font for another
+ * document instead of calling QTextDocument::setDefaultFont(). Documents get removed from the
+ * cache in least recently used order, but stay alive while they are still used.
+ **/
+class TextDocumentCache {
+public:
+    typedef QSharedPointer< QTextDocument > DocumentPtr;
+
+    /** @brief The maximal number of cached documents. */
+    static const int MAXIMUM_CACHED_DOCUMENTS;
+
+    /** @brief Create a new empty cache. */
+    TextDocumentCache();
+
+    /**
+     * @brief Get a laid out document for @p html.
+     *
+     * If a document with the same @p html, @p size, @p textOption and @p font is cached, it
+     * gets returned, otherwise a new document gets created and cached.
+     **/
+    DocumentPtr textDocument( const QString &html, const QSizeF &size,
+                              const QTextOption &textOption, const QFont &font );
+
+    /** @brief Remove all documents from the cache. */
+    void clear();
+
+    /** @brief The number of currently cached documents. */
+    int count() const { return m_documents.count(); };
+
+    /** @brief The number of documents that were found in the cache. */
+    int hitCount() const { return m_hitCount; };
+
+    /** @brief The number of documents that needed to be created. */
+    int missCount() const { return m_missCount; };
+
+    /** @brief Create and lay out a new document, which does not get cached. */
+    static QTextDocument *createTextDocument( const QString &html, const QSizeF &size,
+                                              const QTextOption &textOption, const QFont &font );
+
+private:
+    Q_DISABLE_COPY( TextDocumentCache )
+
+    QCache< QString, DocumentPtr > m_documents;
+    int m_hitCount;
+    int m_missCount;
+};
+
+#endif // Multiple inclusion guard
@@ -22,6 +22,9 @@
 #include "routegraphicsitem.h"
 #include "departuremodel.h"
 
+// libpublictransporthelper includes
+#include <vehicleiconatlas.h>
+
 // Plasma includes
 #include <Plasma/PaintUtils>
 #include <Plasma/Svg>
@@ -56,6 +59,12 @@
 #include <qmath.h>
 #include <QTimer>
 
+const int PublicTransportWidget::OVERSCAN_ROWS = 3;
+
+// Maximal number of hidden items kept for reuse in virtualized mode,
+// more released items get deleted
+static const int MAXIMUM_RECYCLED_ITEMS = 40;
+
 PublicTransportGraphicsItem::PublicTransportGraphicsItem(
         PublicTransportWidget *publicTransportWidget, QGraphicsItem *parent,
         StopAction *copyStopToClipboardAction, StopAction *showInMapAction/*, QAction *toggleAlarmAction*/ )
@@ -66,6 +75,10 @@ PublicTransportGraphicsItem::PublicTransportGraphicsItem(
 {
     setFlag( ItemClipsToShape );
     setFlag( ItemClipsChildrenToShape );
+    if ( publicTransportWidget->isOptionEnabled(PublicTransportWidget::LowPowerMode) ) {
+        // Draw unchanged items from the cache, eg. when other items get repainted
+        setCacheMode( DeviceCoordinateCache );
+    }
     m_expanded = false;
     m_expandStep = 0.0;
     m_fadeOut = 1.0;
@@ -120,6 +133,21 @@ void PublicTransportGraphicsItem::setExpandedNotAffectingOtherItems( bool expand
         }
     }
 
+    if ( m_parent->isOptionEnabled(PublicTransportWidget::LowPowerMode) ) {
+        // Expand/collapse without animation
+        if ( m_resizeAnimation ) {
+            m_resizeAnimation->stop();
+        }
+        setExpandStep( expand ? 1.0 : 0.0 );
+        resizeAnimationFinished();
+        if ( expand ) {
+            // Ensure visibility after the layout got updated
+            QTimer::singleShot( 0, this, SLOT(ensureVisibleSnapped()) );
+        }
+        emit expandedStateChanged( this, expand );
+        return;
+    }
+
     if ( m_resizeAnimation ) {
         m_resizeAnimation->stop();
     } else {
@@ -192,6 +220,31 @@ void PublicTransportGraphicsItem::updateGeometry()
     QGraphicsWidget::updateGeometry();
 }
 
+void PublicTransportGraphicsItem::resetState()
+{
+    if ( m_resizeAnimation ) {
+        m_resizeAnimation->stop();
+        delete m_resizeAnimation;
+        m_resizeAnimation = 0;
+    }
+    delete m_ensureVisibleTimer;
+    m_ensureVisibleTimer = 0;
+    delete m_pixmap;
+    m_pixmap = 0;
+
+    m_expanded = false;
+    m_expandStep = 0.0;
+    m_fadeOut = 1.0;
+    setOpacity( 1.0 );
+
+    QGraphicsWidget *route = routeItem();
+    if ( route ) {
+        route->setVisible( false );
+    }
+    m_item = 0;
+    updateGeometry();
+}
+
 void TimetableListItem::paint( QPainter *painter, const QStyleOptionGraphicsItem *option,
                                QWidget *widget )
 {
@@ -251,6 +304,7 @@ void PublicTransportGraphicsItem::paint( QPainter* painter,
         const QStyleOptionGraphicsItem* option, QWidget* widget )
 {
     Q_UNUSED( widget );
+    m_parent->rowPainted();
     painter->setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform );
     if ( !m_item || !isValid() ) {
         if ( m_pixmap ) {
@@ -347,14 +401,7 @@ int PublicTransportGraphicsItem::extraIconSize() const
 QTextDocument* TextDocumentHelper::createTextDocument( const QString& html, const QSizeF& size,
     const QTextOption &textOption, const QFont &font )
 {
-    QTextDocument *textDocument = new QTextDocument;
-    textDocument->setDefaultFont( font );
-    textDocument->setDocumentMargin( 0 );
-    textDocument->setDefaultTextOption( textOption );
-    textDocument->setPageSize( size );
-    textDocument->setHtml( html );
-    textDocument->documentLayout();
-    return textDocument;
+    return TextDocumentCache::createTextDocument( html, size, textOption, font );
 }
 
 void TextDocumentHelper::drawTextDocument( QPainter *painter,
@@ -653,8 +700,8 @@ DepartureGraphicsItem::DepartureGraphicsItem( PublicTransportWidget* publicTrans
         StopAction *newFilterViaStopAction, KPixmapCache *pixmapCache )
         : PublicTransportGraphicsItem( publicTransportWidget, parent, copyStopToClipboardAction,
                                        showInMapAction ),
-        m_infoTextDocument(0), m_timeTextDocument(0), m_othersTextDocument(0), m_routeItem(0),
-        m_routeInfoWidget(0), m_highlighted(false), m_leavingAnimation(0),
+        m_routeItem(0), m_routeInfoWidget(0), m_highlighted(false), m_paintStateKey(0),
+        m_leavingAnimation(0),
         m_showDeparturesAction(showDeparturesAction), m_highlightStopAction(highlightStopAction),
         m_newFilterViaStopAction(newFilterViaStopAction), m_updateAdditionalDataAction(0),
         m_pixmapCache(pixmapCache)
@@ -664,7 +711,10 @@ DepartureGraphicsItem::DepartureGraphicsItem( PublicTransportWidget* publicTrans
                                                 i18nc("@info", "Refresh"), this );
     connect( m_updateAdditionalDataAction, SIGNAL(triggered(bool)),
              this, SIGNAL(updateAdditionalDataRequest()) );
-    setAcceptHoverEvents( true ); // Hover anchors in the document
+
+    // Hover anchors in the document
+    setAcceptHoverEvents(
+            !publicTransportWidget->isOptionEnabled(PublicTransportWidget::LowPowerMode) );
 }
 
 DepartureGraphicsItem::~DepartureGraphicsItem()
@@ -672,10 +722,6 @@ DepartureGraphicsItem::~DepartureGraphicsItem()
     if ( m_leavingAnimation ) {
         m_leavingAnimation->stop();
     }
-
-    delete m_infoTextDocument;
-    delete m_timeTextDocument;
-    delete m_othersTextDocument;
 }
 
 JourneyGraphicsItem::JourneyGraphicsItem( PublicTransportWidget* publicTransportWidget,
@@ -696,6 +742,24 @@ JourneyGraphicsItem::~JourneyGraphicsItem()
     delete m_infoTextDocument;
 }
 
+void DepartureGraphicsItem::resetState()
+{
+    if ( m_leavingAnimation ) {
+        // Gets deleted when stopped
+        m_leavingAnimation->stop();
+        m_leavingAnimation = 0;
+    }
+    m_leavingStep = 0.0;
+
+    // Route data is most probably not available for the next departure shown by this item
+    delete m_routeItem;
+    m_routeItem = 0;
+    delete m_routeInfoWidget;
+    m_routeInfoWidget = 0;
+
+    PublicTransportGraphicsItem::resetState();
+}
+
 void DepartureGraphicsItem::setLeavingStep( qreal leavingStep )
 {
     m_leavingStep = leavingStep;
@@ -703,6 +767,24 @@ void DepartureGraphicsItem::setLeavingStep( qreal leavingStep )
     update();
 }
 
+void DepartureGraphicsItem::updateTextDocument( TextDocumentCache::DocumentPtr *document,
+        QString *documentHtml, const QString &html, const QSizeF &size,
+        const QTextOption &textOption )
+{
+    // Only look for another document if something changed,
+    // eg. the time column changes every minute while the other columns stay unchanged
+    if ( *document && (*document)->pageSize() == size && *documentHtml == html &&
+         (*document)->defaultFont() == font() &&
+         (*document)->defaultTextOption().alignment() == textOption.alignment() &&
+         (*document)->defaultTextOption().wrapMode() == textOption.wrapMode() )
+    {
+        return;
+    }
+
+    *document = m_parent->textDocumentCache()->textDocument( html, size, textOption, font() );
+    *documentHtml = html;
+}
+
 void DepartureGraphicsItem::updateTextLayouts()
 {
     if ( !m_item ) {
@@ -717,48 +799,34 @@ void DepartureGraphicsItem::updateTextLayouts()
             ? QTextOption::NoWrap : QTextOption::WordWrap );
 
     // Update text layouts
-    if ( !m_timeTextDocument || (m_timeTextDocument->pageSize() != _timeRect.size()) ) {
-        delete m_timeTextDocument;
-        textOption.setAlignment( Qt::AlignVCenter | Qt::AlignRight );
-        m_timeTextDocument = TextDocumentHelper::createTextDocument(
-                index().model()->index(index().row(), 2).data(FormattedTextRole).toString(),
-                _timeRect.size(), textOption, font() );
-    }
+    textOption.setAlignment( Qt::AlignVCenter | Qt::AlignRight );
+    updateTextDocument( &m_timeTextDocument, &m_timeHtml,
+            index().model()->index(index().row(), 2).data(FormattedTextRole).toString(),
+            _timeRect.size(), textOption );
 
     const qreal timeWidth = timeColumnWidth();
     const QRectF _infoRect = infoRect( rect, timeWidth );
 
     // Create layout for the main column showing information about the departure
-    if ( !m_infoTextDocument || (m_infoTextDocument->pageSize() != _infoRect.size()) ) {
-        delete m_infoTextDocument;
-        textOption.setAlignment( Qt::AlignVCenter | Qt::AlignLeft );
-        QString html;
-        const DepartureInfo *info = departureItem()->departureInfo();
-        TimetableWidget *timetableWidget = qobject_cast<TimetableWidget*>( m_parent );
-        if ( timetableWidget->isTargetHidden() ) {
-            html = i18nc("@info", "<emphasis strong='1'>%1</emphasis>", info->lineString());
-        } else if ( departureItem()->model()->info().departureArrivalListType == ArrivalList ) {
-            html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> from %2",
-                         info->lineString(), info->targetShortened());
-        } else { // if ( departureItem()->model()->info().departureArrivalListType == DepartureList ) {
-            html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> to %2",
-                         info->lineString(), info->targetShortened());
-        }
-        m_infoTextDocument = TextDocumentHelper::createTextDocument( html, _infoRect.size(),
-                                                                     textOption, font() );
-    }
+    textOption.setAlignment( Qt::AlignVCenter | Qt::AlignLeft );
+    QString html;
+    const DepartureInfo *info = departureItem()->departureInfo();
+    TimetableWidget *timetableWidget = qobject_cast<TimetableWidget*>( m_parent );
+    if ( timetableWidget->isTargetHidden() ) {
+        html = i18nc("@info", "<emphasis strong='1'>%1</emphasis>", info->lineString());
+    } else if ( departureItem()->model()->info().departureArrivalListType == ArrivalList ) {
+        html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> from %2",
+                     info->lineString(), info->targetShortened());
+    } else { // if ( departureItem()->model()->info().departureArrivalListType == DepartureList ) {
+        html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> to %2",
+                     info->lineString(), info->targetShortened());
+    }
+    updateTextDocument( &m_infoTextDocument, &m_infoHtml, html, _infoRect.size(), textOption );
 
     QSizeF othersSize( rect.width() - expandAreaIndentation() - padding(), 999 );
-    const QString html = othersText();
-    if ( !m_othersTextDocument || m_othersTextDocument->textWidth() != othersSize.width() ||
-         html != m_othersTextDocument->toHtml() )
-    {
-        delete m_othersTextDocument;
-        textOption.setAlignment( Qt::AlignBottom | Qt::AlignLeft );
-
-        m_othersTextDocument = TextDocumentHelper::createTextDocument( html, othersSize,
-                                                                       textOption, font() );
-    }
+    textOption.setAlignment( Qt::AlignBottom | Qt::AlignLeft );
+    updateTextDocument( &m_othersTextDocument, &m_othersHtml, othersText(), othersSize,
+                        textOption );
 }
 
 QString DepartureGraphicsItem::othersText() const
@@ -843,7 +911,7 @@ void JourneyGraphicsItem::updateTextLayouts()
 void JourneyGraphicsItem::updateData( JourneyItem* item, bool updateLayouts )
 {
     m_item = item;
-    setAcceptHoverEvents( true );
+    setAcceptHoverEvents( !m_parent->isOptionEnabled(PublicTransportWidget::LowPowerMode) );
     updateGeometry();
 
     if ( updateLayouts ) {
@@ -928,16 +996,27 @@ bool DepartureGraphicsItem::isRouteDataRequestable() const
 
 void DepartureGraphicsItem::updateData( DepartureItem* item, bool updateLayouts )
 {
+    const DepartureItem *oldItem = departureItem();
     m_item = item;
     updateGeometry();
 
-    if ( updateLayouts ) {
-        delete m_infoTextDocument;
-        delete m_timeTextDocument;
-        m_infoTextDocument = 0;
-        m_timeTextDocument = 0;
-    }
+    // Documents only get replaced for changed texts, eg. only the time column
+    // when the remaining minutes change
+    Q_UNUSED( updateLayouts );
+    const QTextDocument *oldTimeTextDocument = m_timeTextDocument.data();
+    const QTextDocument *oldInfoTextDocument = m_infoTextDocument.data();
+    const QTextDocument *oldOthersTextDocument = m_othersTextDocument.data();
     updateTextLayouts();
+    const bool textChanged = oldItem != item ||
+            m_timeTextDocument.data() != oldTimeTextDocument ||
+            m_infoTextDocument.data() != oldInfoTextDocument ||
+            m_othersTextDocument.data() != oldOthersTextDocument;
+
+    // Alarm icons/backgrounds, color groups, the vehicle type and the highlighted stop
+    // are not part of the text documents
+    const uint paintStateKey = this->paintStateKey();
+    const bool paintStateChanged = paintStateKey != m_paintStateKey;
+    m_paintStateKey = paintStateKey;
 
     // Test if route data is already available or if it should be available as additional data
     if ( isRouteDataAvailable() ) {
@@ -1008,6 +1087,15 @@ void DepartureGraphicsItem::updateData( DepartureItem* item, bool updateLayouts
         hideRouteInfoWidget();
     }
 
+    if ( m_parent->isOptionEnabled(PublicTransportWidget::LowPowerMode) ) {
+        // Only repaint if the displayed text or other painted state changed,
+        // otherwise the item gets drawn from the cache
+        if ( textChanged || paintStateChanged ) {
+            update();
+        }
+        return;
+    }
+
     if ( item->isLeavingSoon() && !m_leavingAnimation ) {
         m_leavingAnimation = new QPropertyAnimation( this, "leavingStep", this );
         m_leavingAnimation->setStartValue( 0.0 );
@@ -1022,9 +1110,35 @@ void DepartureGraphicsItem::updateData( DepartureItem* item, bool updateLayouts
     update();
 }
 
+uint DepartureGraphicsItem::paintStateKey() const
+{
+    if ( !m_item ) {
+        // Item was already deleted
+        return 0;
+    }
+
+    const QAbstractItemModel *model = index().model();
+    const int row = index().row();
+    uint key = static_cast<uint>( departureItem()->departureInfo()->vehicleType() );
+    key = key * 31 + (row % 2);
+    key = key * 31 + index().data( Qt::BackgroundColorRole ).value<QColor>().rgba();
+    key = key * 31 + (index().data( DrawAlarmBackgroundRole ).toBool() ? 1 : 0);
+    key = key * 31 + qHash( model->index(row, ColumnTarget).data(Qt::DecorationRole)
+                            .value<QIcon>().cacheKey() );
+    key = key * 31 + qHash( model->index(row, ColumnDeparture).data(Qt::DecorationRole)
+                            .value<QIcon>().cacheKey() );
+
+    // Only departures can have a manually highlighted stop (not journeys)
+    const DepartureModel *departureModel = qobject_cast<const DepartureModel*>( model );
+    const bool manuallyHighlighted = departureModel &&
+            departureItem()->departureInfo()->routeStops().contains(
+                departureModel->highlightedStop(), Qt::CaseInsensitive );
+    return key * 31 + (manuallyHighlighted ? 1 : 0);
+}
+
 qreal DepartureGraphicsItem::timeColumnWidth() const
 {
-    qreal width = TextDocumentHelper::textDocumentWidth( m_timeTextDocument );
+    qreal width = TextDocumentHelper::textDocumentWidth( m_timeTextDocument.data() );
 
     QRectF rect = contentsRect();
     if ( qobject_cast<TimetableWidget*>(m_parent)->isTargetHidden() ) {
@@ -1391,47 +1505,34 @@ void DepartureGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGrap
 
     int shadowWidth = 4;
     QSizeF iconSize( _vehicleRect.width() - 2 * shadowWidth, _vehicleRect.height() - 2 * shadowWidth );
-    QString vehicleKey;
-    switch ( departureItem()->departureInfo()->vehicleType() ) {
-        case Tram: vehicleKey = "tram"; break;
-        case Bus: vehicleKey = "bus"; break;
-        case TrolleyBus: vehicleKey = "trolleybus"; break;
-        case Subway: vehicleKey = "subway"; break;
-        case Metro: vehicleKey = "metro"; break;
-        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-        case RegionalTrain: vehicleKey = "regionaltrain"; break;
-        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-        case IntercityTrain: vehicleKey = "intercitytrain"; break;
-        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-        case Feet: vehicleKey = "feet"; break;
-        case Ship: vehicleKey = "ship"; break;
-        case Plane: vehicleKey = "plane"; break;
-        default:
-            kDebug() << "Unknown vehicle type" << departureItem()->departureInfo()->vehicleType();
-            painter->setPen( _textColor );
-            painter->setBrush( _backgroundColor );
-            painter->drawEllipse( QRectF(shadowWidth, shadowWidth, iconSize.width(), iconSize.height())
-                                .adjusted(2, 2, -2, -2) );
-            painter->drawText( QRectF(shadowWidth, shadowWidth, iconSize.width(), iconSize.height()),
-                            "?", QTextOption(Qt::AlignCenter) );
+    const VehicleType vehicleType = departureItem()->departureInfo()->vehicleType();
+    const QString vehicleKey = VehicleIconAtlas::iconKey( vehicleType );
+    if ( vehicleKey.isEmpty() ) {
+        kDebug() << "Unknown vehicle type" << vehicleType;
+        painter->setPen( _textColor );
+        painter->setBrush( _backgroundColor );
+        painter->drawEllipse( QRectF(shadowWidth, shadowWidth, iconSize.width(), iconSize.height())
+                            .adjusted(2, 2, -2, -2) );
+        painter->drawText( QRectF(shadowWidth, shadowWidth, iconSize.width(), iconSize.height()),
+                        "?", QTextOption(Qt::AlignCenter) );
     }
 
     const QString vehicleCacheKey
             = vehicleKey + QString("%1%2").arg( iconSize.width() ).arg( iconSize.height() );
     QPixmap vehiclePixmap;
-    if ( !m_pixmapCache || !m_pixmapCache->find(vehicleCacheKey, vehiclePixmap) ) {
-        if ( !m_parent->svg()->hasElement(vehicleKey) ) {
-            if ( !vehicleKey.isEmpty() ) {
-                kDebug() << "SVG element" << vehicleKey << "not found";
-            }
-        } else {
-            // Draw SVG vehicle element into pixmap
+    if ( !vehicleKey.isEmpty() &&
+         (!m_pixmapCache || !m_pixmapCache->find(vehicleCacheKey, vehiclePixmap)) )
+    {
+        // Get the pre-rendered vehicle icon, does not render the SVG here if it is ready
+        const QImage icon = VehicleIconAtlas::instance()->icon(
+                m_parent->svg()->imagePath(), vehicleKey, iconSize.toSize() );
+        if ( !icon.isNull() ) {
+            // Draw vehicle icon into pixmap
             QPixmap pixmap( (int)_vehicleRect.width(), (int)_vehicleRect.height() );
             pixmap.fill( Qt::transparent );
             QPainter p( &pixmap );
-            m_parent->svg()->resize( iconSize );
-            m_parent->svg()->paint( &p, shadowWidth, shadowWidth, vehicleKey );
+            p.drawImage( shadowWidth, shadowWidth, icon );
+            p.end();
 
             vehiclePixmap = QPixmap( pixmap.size() );
             vehiclePixmap.fill( Qt::transparent );
@@ -1475,21 +1576,20 @@ void DepartureGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGrap
     }
 
     if ( m_highlighted != manuallyHighlighted ) {
+        // The documents are shared, get other documents for the changed font
         QFont _font = font();
         _font.setItalic( manuallyHighlighted );
-        m_infoTextDocument->setDefaultFont( _font );
-        m_timeTextDocument->setDefaultFont( _font );
-        m_othersTextDocument->setDefaultFont( _font );
         setFont( _font );
         m_highlighted = manuallyHighlighted;
+        updateTextLayouts();
     }
 
     TextDocumentHelper::Option options = drawShadowsOrHalos
             ? (drawHalos ? TextDocumentHelper::DrawHalos : TextDocumentHelper::DrawShadows)
             : TextDocumentHelper::DoNotDrawShadowOrHalos;
-    TextDocumentHelper::drawTextDocument( painter, option, m_infoTextDocument,
+    TextDocumentHelper::drawTextDocument( painter, option, m_infoTextDocument.data(),
             _infoRect, options );
-    TextDocumentHelper::drawTextDocument( painter, option, m_timeTextDocument,
+    TextDocumentHelper::drawTextDocument( painter, option, m_timeTextDocument.data(),
             _timeRect, options );
 
     // Draw extra icon(s), eg. an alarm icon or an indicator for additional news for a journey
@@ -1599,7 +1699,7 @@ void DepartureGraphicsItem::paintExpanded( QPainter* painter, const QStyleOption
         QFontMetrics fm( font() );
         QRectF htmlRect( rect.left(), y, rect.width(), rect.bottom() - y );
         painter->setPen( _textColor );
-        TextDocumentHelper::drawTextDocument( painter, option, m_othersTextDocument,
+        TextDocumentHelper::drawTextDocument( painter, option, m_othersTextDocument.data(),
                 htmlRect, drawShadowsOrHalos
                 ? (drawHalos ? TextDocumentHelper::DrawHalos : TextDocumentHelper::DrawShadows)
                 : TextDocumentHelper::DoNotDrawShadowOrHalos);
@@ -1740,7 +1840,8 @@ QSizeF PublicTransportWidget::sizeHint(Qt::SizeHint which, const QSizeF& constra
 PublicTransportWidget::PublicTransportWidget( Options options, ExpandingOption expandingOption,
                                               QGraphicsItem* parent )
     : Plasma::ScrollWidget( parent ), m_options(options), m_expandingOption(expandingOption),
-      m_model(0), m_prefixItem(0), m_postfixItem(0), m_svg(0),
+      m_model(0), m_prefixItem(0), m_postfixItem(0), m_topSpacer(0), m_bottomSpacer(0), m_svg(0),
+      m_frameCount(0), m_paintedRowCount(0), m_paintingFrame(false),
       m_copyStopToClipboardAction(0), m_showInMapAction(0)
 {
     setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
@@ -1753,10 +1854,17 @@ PublicTransportWidget::PublicTransportWidget( Options options, ExpandingOption e
     container->setLayout( l );
     setWidget( container );
 
+    // The container widget gets moved when scrolling
+    connect( container, SIGNAL(yChanged()), this, SLOT(updateVisibleRows()) );
+
     m_maxLineCount = 2;
     m_iconSize = 32;
     m_zoomFactor = 1.0;
     updateSnapSize();
+
+    if ( m_options.testFlag(Virtualized) ) {
+        rebuildItems();
+    }
 }
 
 QPainterPath PublicTransportGraphicsItem::shape() const
@@ -1814,21 +1922,214 @@ void PublicTransportWidget::setupActions()
 
 void PublicTransportWidget::setOption( PublicTransportWidget::Option option, bool enable )
 {
-    m_options = enable ? m_options | option : m_options & ~option;
-    update();
+    setOptions( enable ? m_options | option : m_options & ~option );
 }
 
 void PublicTransportWidget::setOptions( PublicTransportWidget::Options options )
 {
+    const bool virtualizedChanged =
+            options.testFlag(Virtualized) != m_options.testFlag(Virtualized);
+    const bool lowPowerModeChanged =
+            options.testFlag(LowPowerMode) != m_options.testFlag(LowPowerMode);
     m_options = options;
+    if ( virtualizedChanged || lowPowerModeChanged ) {
+        // Items get their cache mode and hover setting when they get created
+        rebuildItems();
+    }
     update();
 }
 
+void PublicTransportWidget::rowPainted()
+{
+    ++m_paintedRowCount;
+    if ( !m_paintingFrame ) {
+        // The first row painted in this frame, all rows of a frame get painted
+        // before control returns to the event loop
+        m_paintingFrame = true;
+        ++m_frameCount;
+        QTimer::singleShot( 0, this, SLOT(framePainted()) );
+    }
+}
+
 void PublicTransportWidget::updateSnapSize()
 {
     setSnapSize( QSizeF(0, PublicTransportGraphicsItem::unexpandedHeight(m_iconSize,
             PublicTransportGraphicsItem::padding(m_zoomFactor), QFontMetrics(font()).lineSpacing(),
             m_maxLineCount)) );
+    updateVisibleRows();
+}
+
+void PublicTransportWidget::resizeEvent( QGraphicsSceneResizeEvent *event )
+{
+    Plasma::ScrollWidget::resizeEvent( event );
+    updateVisibleRows();
+}
+
+void PublicTransportWidget::rebuildItems()
+{
+    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
+    foreach ( PublicTransportGraphicsItem *item, m_items ) {
+        if ( item ) {
+            l->removeItem( item );
+            delete item;
+        }
+    }
+    m_items.clear();
+    qDeleteAll( m_recycledItems );
+    m_recycledItems.clear();
+
+    if ( m_topSpacer ) {
+        l->removeItem( m_topSpacer );
+        l->removeItem( m_bottomSpacer );
+        delete m_topSpacer;
+        delete m_bottomSpacer;
+        m_topSpacer = m_bottomSpacer = 0;
+    }
+
+    if ( m_options.testFlag(Virtualized) ) {
+        // The spacers take the space of the rows without item above/below the visible rows
+        const int prefixOffset = m_prefixItem ? 1 : 0;
+        m_topSpacer = new QGraphicsWidget( widget() );
+        m_bottomSpacer = new QGraphicsWidget( widget() );
+        m_topSpacer->setMaximumHeight( 0.0 );
+        m_bottomSpacer->setMaximumHeight( 0.0 );
+        l->insertItem( prefixOffset, m_topSpacer );
+        l->insertItem( prefixOffset + 1, m_bottomSpacer );
+    }
+
+    if ( m_model && m_model->rowCount() > 0 ) {
+        insertItems( 0, m_model->rowCount() - 1 );
+    }
+}
+
+void PublicTransportWidget::insertItems( int first, int last )
+{
+    if ( m_options.testFlag(Virtualized) ) {
+        // Items get created in updateVisibleRows() for visible rows only
+        for ( int row = first; row <= last; ++row ) {
+            m_items.insert( row, 0 );
+        }
+        updateVisibleRows();
+        return;
+    }
+
+    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
+    const int prefixOffset = m_prefixItem ? 1 : 0;
+    for ( int row = first; row <= last; ++row ) {
+        PublicTransportGraphicsItem *item = createItem();
+        updateItemData( item, row );
+        m_items.insert( row, item );
+        l->insertItem( row + prefixOffset, item );
+        if ( m_options.testFlag(LowPowerMode) ) {
+            continue;
+        }
+
+        // Fade new items in
+        Plasma::Animation *fadeAnimation = Plasma::Animator::create(
+                Plasma::Animator::FadeAnimation, item );
+        fadeAnimation->setTargetWidget( item );
+        fadeAnimation->setProperty( "startOpacity", 0.0 );
+        fadeAnimation->setProperty( "targetOpacity", 1.0 );
+        fadeAnimation->start( QAbstractAnimation::DeleteWhenStopped );
+    }
+}
+
+void PublicTransportWidget::updateVisibleRows()
+{
+    if ( !m_options.testFlag(Virtualized) || !m_topSpacer ) {
+        return;
+    }
+
+    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
+    const int prefixOffset = m_prefixItem ? 1 : 0;
+    const int rowCount = m_items.count();
+    const qreal rowHeight = qMax( qreal(1.0), snapSize().height() );
+
+    // Get the range of rows to create items for, expanded items are ignored here,
+    // the overscan rows should be enough to fill the additional space
+    const qreal prefixHeight = m_prefixItem ? m_prefixItem->size().height() : 0.0;
+    const qreal top = qMax( qreal(0.0), scrollPosition().y() - prefixHeight );
+    const int first = qMax( 0, qFloor(top / rowHeight) - OVERSCAN_ROWS );
+    const int last = qMin( rowCount - 1,
+            qCeil((top + viewportGeometry().height()) / rowHeight) + OVERSCAN_ROWS );
+
+    // Release items of rows that are no longer visible
+    for ( int row = 0; row < rowCount; ++row ) {
+        if ( m_items[row] && (row < first || row > last) ) {
+            releaseItem( m_items[row] );
+            m_items[row] = 0;
+        }
+    }
+
+    // Acquire items for visible rows and keep them in row order in the layout
+    for ( int row = first; row <= last; ++row ) {
+        const int layoutIndex = prefixOffset + 1 + row - first;
+        PublicTransportGraphicsItem *item = m_items[ row ];
+        if ( !item ) {
+            item = acquireItem( row );
+            m_items[ row ] = item;
+        } else if ( l->itemAt(layoutIndex) == item ) {
+            continue;
+        } else {
+            l->removeItem( item );
+        }
+        l->insertItem( layoutIndex, item );
+    }
+
+    // Let the spacers take the space of the rows without item
+    const qreal topHeight = first * rowHeight;
+    const qreal bottomHeight = qMax( 0, rowCount - 1 - last ) * rowHeight;
+    m_topSpacer->setMinimumHeight( topHeight );
+    m_topSpacer->setMaximumHeight( topHeight );
+    m_topSpacer->setPreferredHeight( topHeight );
+    m_bottomSpacer->setMinimumHeight( bottomHeight );
+    m_bottomSpacer->setMaximumHeight( bottomHeight );
+    m_bottomSpacer->setPreferredHeight( bottomHeight );
+}
+
+bool PublicTransportWidget::visibleRowRange( int *firstRow, int *lastRow ) const
+{
+    const int rowCount = m_items.count();
+    if ( rowCount == 0 ) {
+        return false;
+    }
+
+    const qreal rowHeight = qMax( qreal(1.0), snapSize().height() );
+    const qreal prefixHeight = m_prefixItem ? m_prefixItem->size().height() : 0.0;
+    const qreal top = qMax( qreal(0.0), scrollPosition().y() - prefixHeight );
+    *firstRow = qMin( rowCount - 1, qFloor(top / rowHeight) );
+    *lastRow = qBound( *firstRow, qCeil((top + viewportGeometry().height()) / rowHeight),
+                       rowCount - 1 );
+    return true;
+}
+
+PublicTransportGraphicsItem *PublicTransportWidget::acquireItem( int row )
+{
+    PublicTransportGraphicsItem *item;
+    if ( m_recycledItems.isEmpty() ) {
+        item = createItem();
+    } else {
+        item = m_recycledItems.takeLast();
+        item->show();
+        item->updateSettings();
+    }
+
+    // Text gets only laid out here, ie. for items of visible rows
+    updateItemData( item, row, true );
+    return item;
+}
+
+void PublicTransportWidget::releaseItem( PublicTransportGraphicsItem *item )
+{
+    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
+    l->removeItem( item );
+    item->hide();
+    if ( m_recycledItems.count() >= MAXIMUM_RECYCLED_ITEMS ) {
+        item->deleteLater();
+    } else {
+        item->resetState();
+        m_recycledItems << item;
+    }
 }
 
 void PublicTransportWidget::setPrefixItem( TimetableListItem *prefixItem )
@@ -1970,7 +2271,7 @@ void PublicTransportWidget::setModel( PublicTransportModel* model )
 PublicTransportGraphicsItem* PublicTransportWidget::item( const QModelIndex& index )
 {
     foreach ( PublicTransportGraphicsItem *item, m_items ) {
-        if ( item->index() == index ) {
+        if ( item && item->index() == index ) {
             return item;
         }
     }
@@ -1995,13 +2296,15 @@ void PublicTransportWidget::setExpandOption( ExpandingOption expandingOption )
 {
     if ( expandingOption == NoExpanding ) {
         foreach ( PublicTransportGraphicsItem *item, m_items ) {
-            item->setExpanded( false );
+            if ( item ) {
+                item->setExpanded( false );
+            }
         }
     } else if ( expandingOption == ExpandSingle ) {
         PublicTransportGraphicsItem *visibleExpandedItem = 0;
         QList< PublicTransportGraphicsItem* > expandedItems;
         foreach ( PublicTransportGraphicsItem *item, m_items ) {
-            if ( item->isExpanded() ) {
+            if ( item && item->isExpanded() ) {
                 if ( !visibleExpandedItem && item->geometry().intersects(boundingRect()) ) {
                     kDebug() << item->geometry();
                     visibleExpandedItem = item;
@@ -2026,7 +2329,8 @@ void PublicTransportWidget::setExpandOption( ExpandingOption expandingOption )
 
 bool PublicTransportWidget::isItemExpanded( int row ) const
 {
-    return m_items[ row ]->isExpanded();
+    // Items of rows that are not visible in virtualized mode are collapsed
+    return m_items[ row ] && m_items[ row ]->isExpanded();
 }
 
 void PublicTransportWidget::setItemExpanded( int row, bool expanded )
@@ -2038,11 +2342,15 @@ void PublicTransportWidget::setItemExpanded( int row, bool expanded )
     if ( m_expandingOption == ExpandSingle && expanded ) {
         // Toggle expanded items TODO fix docu...
         foreach ( PublicTransportGraphicsItem *item, m_items ) {
-            item->setExpandedNotAffectingOtherItems( false );
+            if ( item ) {
+                item->setExpandedNotAffectingOtherItems( false );
+            }
         }
     }
     PublicTransportGraphicsItem *expandItem = m_items[ row ];
-    expandItem->setExpandedNotAffectingOtherItems( expanded );
+    if ( expandItem ) {
+        expandItem->setExpandedNotAffectingOtherItems( expanded );
+    }
 }
 
 void PublicTransportWidget::setZoomFactor( qreal zoomFactor )
@@ -2051,12 +2359,21 @@ void PublicTransportWidget::setZoomFactor( qreal zoomFactor )
 
     for ( int i = 0; i < m_items.count(); ++i ) {
         // Notify children about changed settings
-        m_items[i]->updateSettings();
+        if ( m_items[i] ) {
+            m_items[i]->updateSettings();
+        }
     }
     updateGeometry();
     updateItemGeometries();
     updateSnapSize();
     update();
+
+    if ( m_svg ) {
+        // Start rendering vehicle icons for the new zoom factor in the background, the bucket
+        // of the icon size without shadow is also rendered as neighbouring bucket
+        const int size = qRound( iconSize() );
+        VehicleIconAtlas::instance()->prerender( m_svg->imagePath(), QSize(size, size) );
+    }
 }
 
 void PublicTransportWidget::contextMenuEvent( QGraphicsSceneContextMenuEvent* event )
@@ -2098,14 +2415,18 @@ void PublicTransportWidget::paint( QPainter* painter, const QStyleOptionGraphics
 void PublicTransportWidget::updateItemLayouts()
 {
     foreach ( PublicTransportGraphicsItem *item, m_items ) {
-        item->updateTextLayouts();
+        if ( item ) {
+            item->updateTextLayouts();
+        }
     }
 }
 
 void PublicTransportWidget::updateItemGeometries()
 {
     foreach ( PublicTransportGraphicsItem *item, m_items ) {
-        item->updateGeometry();
+        if ( item ) {
+            item->updateGeometry();
+        }
     }
 }
 
@@ -2113,6 +2434,7 @@ void PublicTransportWidget::modelReset()
 {
     qDeleteAll( m_items );
     m_items.clear();
+    updateVisibleRows();
 }
 
 void TimetableWidget::dataChanged( const QModelIndex& topLeft, const QModelIndex& bottomRight )
@@ -2121,7 +2443,10 @@ void TimetableWidget::dataChanged( const QModelIndex& topLeft, const QModelIndex
         return;
     }
     for ( int row = topLeft.row(); row <= bottomRight.row() && row < m_model->rowCount(); ++row ) {
-        departureItem( row )->updateData( static_cast<DepartureItem*>(m_model->item(row)), true );
+        DepartureGraphicsItem *item = departureItem( row );
+        if ( item ) {
+            item->updateData( static_cast<DepartureItem*>(m_model->item(row)), true );
+        }
     }
 }
 
@@ -2131,13 +2456,25 @@ void JourneyTimetableWidget::dataChanged( const QModelIndex& topLeft, const QMod
         return;
     }
     for ( int row = topLeft.row(); row <= bottomRight.row() && row < m_model->rowCount(); ++row ) {
-        journeyItem( row )->updateData( static_cast<JourneyItem*>(m_model->item(row)), true );
+        JourneyGraphicsItem *item = journeyItem( row );
+        if ( item ) {
+            item->updateData( static_cast<JourneyItem*>(m_model->item(row)), true );
+        }
     }
 }
 
 void PublicTransportWidget::layoutChanged()
 {
-
+    if ( m_options.testFlag(Virtualized) ) {
+        // Rows were moved, data of items may not match their rows any longer
+        for ( int row = 0; row < m_items.count(); ++row ) {
+            if ( m_items[row] ) {
+                releaseItem( m_items[row] );
+                m_items[row] = 0;
+            }
+        }
+        updateVisibleRows();
+    }
 }
 
 void JourneyTimetableWidget::rowsInserted( const QModelIndex& parent, int first, int last )
@@ -2147,37 +2484,33 @@ void JourneyTimetableWidget::rowsInserted( const QModelIndex& parent, int first,
         return;
     }
 
-    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
-    const int prefixOffset = m_prefixItem ? 1 : 0;
-
     if ( m_items.isEmpty() ) {
         setPrefixItem( m_prefixItem );
         setPostfixItem( m_postfixItem );
     }
 
-    for ( int row = first; row <= last; ++row ) {
-        JourneyGraphicsItem *item = new JourneyGraphicsItem( this, widget(),
-                m_copyStopToClipboardAction, m_showInMapAction,
-                m_requestJourneyToStopAction, m_requestJourneyFromStopAction );
-        item->updateData( static_cast<JourneyItem*>(m_model->item(row)) );
-        connect( item, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
-                 this, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
-        connect( item, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
-                 this, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
-        connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
-                 this, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)) );
-        m_items.insert( row, item );
+    insertItems( first, last );
+}
 
-        // Fade new items in
-        Plasma::Animation *fadeAnimation = Plasma::Animator::create(
-                Plasma::Animator::FadeAnimation, item );
-        fadeAnimation->setTargetWidget( item );
-        fadeAnimation->setProperty( "startOpacity", 0.0 );
-        fadeAnimation->setProperty( "targetOpacity", 1.0 );
-        fadeAnimation->start( QAbstractAnimation::DeleteWhenStopped );
+PublicTransportGraphicsItem *JourneyTimetableWidget::createItem()
+{
+    JourneyGraphicsItem *item = new JourneyGraphicsItem( this, widget(),
+            m_copyStopToClipboardAction, m_showInMapAction,
+            m_requestJourneyToStopAction, m_requestJourneyFromStopAction );
+    connect( item, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
+             this, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
+    connect( item, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
+             this, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
+    connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
+             this, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)) );
+    return item;
+}
 
-        l->insertItem( row + prefixOffset, item );
-    }
+void JourneyTimetableWidget::updateItemData( PublicTransportGraphicsItem *item, int row,
+                                             bool updateLayouts )
+{
+    static_cast<JourneyGraphicsItem*>( item )->updateData(
+            static_cast<JourneyItem*>(m_model->item(row)), updateLayouts );
 }
 
 void TimetableWidget::rowsInserted( const QModelIndex& parent, int first, int last )
@@ -2194,27 +2527,24 @@ void TimetableWidget::rowsInserted( const QModelIndex& parent, int first, int la
         return;
     }
 
-    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
-    const int prefixOffset = m_prefixItem ? 1 : 0;
-    for ( int row = first; row <= last; ++row ) {
-        DepartureGraphicsItem *item = new DepartureGraphicsItem( this, widget(),
-                m_copyStopToClipboardAction, m_showInMapAction, m_showDeparturesAction,
-                m_highlightStopAction, m_newFilterViaStopAction, m_pixmapCache );
-        item->updateData( static_cast<DepartureItem*>(m_model->item(row)) );
-        connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
-                 this, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)) );
-        m_items.insert( row, item );
+    insertItems( first, last );
+}
 
-        // Fade new items in
-        Plasma::Animation *fadeAnimation = Plasma::Animator::create(
-                Plasma::Animator::FadeAnimation, item );
-        fadeAnimation->setTargetWidget( item );
-        fadeAnimation->setProperty( "startOpacity", 0.0 );
-        fadeAnimation->setProperty( "targetOpacity", 1.0 );
-        fadeAnimation->start( QAbstractAnimation::DeleteWhenStopped );
+PublicTransportGraphicsItem *TimetableWidget::createItem()
+{
+    DepartureGraphicsItem *item = new DepartureGraphicsItem( this, widget(),
+            m_copyStopToClipboardAction, m_showInMapAction, m_showDeparturesAction,
+            m_highlightStopAction, m_newFilterViaStopAction, m_pixmapCache );
+    connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
+             this, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)) );
+    return item;
+}
 
-        l->insertItem( row + prefixOffset, item );
-    }
+void TimetableWidget::updateItemData( PublicTransportGraphicsItem *item, int row,
+                                      bool updateLayouts )
+{
+    static_cast<DepartureGraphicsItem*>( item )->updateData(
+            static_cast<DepartureItem*>(m_model->item(row)), updateLayouts );
 }
 
 void PublicTransportWidget::itemsAboutToBeRemoved( const QList< ItemBase* >& items )
@@ -2228,7 +2558,11 @@ void PublicTransportWidget::itemsAboutToBeRemoved( const QList< ItemBase* >& ite
         }
 
         PublicTransportGraphicsItem *timetableItem = m_items[ item->row() ];
-        timetableItem->capturePixmap();
+        if ( timetableItem && !m_options.testFlag(Virtualized) &&
+             !m_options.testFlag(LowPowerMode) )
+        {
+            timetableItem->capturePixmap();
+        }
     }
 }
 
@@ -2244,7 +2578,24 @@ void PublicTransportWidget::rowsRemoved( const QModelIndex& parent, int first, i
         last = m_items.count() - 1;
     }
 
-    if ( first == 0 && last == m_items.count() - 1 ) {
+    if ( m_options.testFlag(Virtualized) ) {
+        // Release items without animation, following rows move up
+        for ( int row = last; row >= first; --row ) {
+            PublicTransportGraphicsItem *item = m_items.takeAt( row );
+            if ( item ) {
+                releaseItem( item );
+            }
+        }
+        updateVisibleRows();
+    } else if ( m_options.testFlag(LowPowerMode) ) {
+        // Delete items without animation
+        QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
+        for ( int row = last; row >= first; --row ) {
+            PublicTransportGraphicsItem *item = m_items.takeAt( row );
+            l->removeItem( item );
+            delete item;
+        }
+    } else if ( first == 0 && last == m_items.count() - 1 ) {
         // All items get removed, the shrink animations wouldn't be smooth
         for ( int row = last; row >= first; --row ) {
             PublicTransportGraphicsItem *item = m_items.takeAt( row );
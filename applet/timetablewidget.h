@@ -23,6 +23,7 @@
 // Own includes
 #include "stopaction.h" // for StopAction::Type
 #include "departuremodel.h"
+#include "textdocumentcache.h" // Member variable
 
 // Plasma includes
 #include <Plasma/ScrollWidget> // Base class
@@ -363,6 +364,14 @@ protected:
 
     void setExpandedNotAffectingOtherItems( bool expand = true );
 
+    /**
+     * @brief Resets the state of this item before it gets reused for another row.
+     *
+     * Used by PublicTransportWidget in virtualized mode. The item gets collapsed without
+     * animation and running animations get stopped.
+     **/
+    virtual void resetState();
+
     QPointer<TopLevelItem> m_item;
     PublicTransportWidget *m_parent;
     bool m_expanded;
@@ -417,7 +426,7 @@ public:
      * @brief Updates this graphics item to visualize the given @p item.
      *
      * @param item The item with the new data.
-     * @param update Whether or not to update the layouts of the QTextDocuments. Default is false.
+     * @param update Unused, text documents get replaced only for changed texts or sizes.
      **/
     void updateData( DepartureItem* item, bool update = false );
 
@@ -540,13 +549,28 @@ protected:
     /** @brief The maximum size of the expand area. */
     virtual qreal expandAreaHeightMaximum() const;
 
+    virtual void resetState();
+
 private:
-    QTextDocument *m_infoTextDocument;
-    QTextDocument *m_timeTextDocument;
-    QTextDocument *m_othersTextDocument;
+    // Get a document for @p html from the shared cache, if it differs from @p document
+    void updateTextDocument( TextDocumentCache::DocumentPtr *document, QString *documentHtml,
+                             const QString &html, const QSizeF &size,
+                             const QTextOption &textOption );
+
+    // Get a key for the non-text state drawn in paintItem(), ie. colors, icons and highlighting
+    uint paintStateKey() const;
+
+    // Documents are shared with other items, do not modify them
+    TextDocumentCache::DocumentPtr m_infoTextDocument;
+    TextDocumentCache::DocumentPtr m_timeTextDocument;
+    TextDocumentCache::DocumentPtr m_othersTextDocument;
+    QString m_infoHtml; // The HTML shown in the documents
+    QString m_timeHtml;
+    QString m_othersHtml;
     RouteGraphicsItem *m_routeItem; // Pointer to the route item or 0 if no route data is available
     QGraphicsWidget *m_routeInfoWidget;
     bool m_highlighted;
+    uint m_paintStateKey; // The paintStateKey() of the last updateData() call
 
     QPropertyAnimation *m_leavingAnimation;
     qreal m_leavingStep;
@@ -692,6 +716,14 @@ public:
     enum Option {
         NoOption                = 0x0000, /**< No special option. */
         DrawShadowsOrHalos      = 0x0001, /**< Draw shadows/halos behind text, dependend on color. */
+        Virtualized             = 0x0002, /**< Only create items for visible rows (and
+                * OVERSCAN_ROWS rows above/below) and reuse them for other rows when scrolling.
+                * Text gets only laid out for these items. Items of removed rows are not
+                * animated and items get collapsed when they get scrolled out of view.
+                * Use this for long lists. */
+        LowPowerMode            = 0x0004, /**< Do not animate items and do not accept hover
+                * events. Items get painted into a cache and only get repainted if their
+                * displayed text changes. Use this for displays that are always on. */
 
         DefaultOptions = DrawShadowsOrHalos /**< Options used by default */
     };
@@ -708,6 +740,9 @@ public:
                            ExpandingOption expandingOption = ExpandSingle,
                            QGraphicsItem* parent = 0 );
 
+    /** @brief The number of rows above and below the visible rows with items in virtualized mode. */
+    static const int OVERSCAN_ROWS;
+
     /** @brief Gets the model containing the data for this widget. */
     PublicTransportModel *model() const { return m_model; };
 
@@ -717,7 +752,11 @@ public:
     /** @brief Sets the model containing the data for this widget to @p model. */
     void setModel( PublicTransportModel *model );
 
-    /** @brief Gets the item at the given @p row. */
+    /**
+     * @brief Gets the item at the given @p row.
+     *
+     * If the Virtualized option is enabled, this returns 0 for rows that are not visible.
+     **/
     PublicTransportGraphicsItem *item( int row ) { return m_items[row]; };
 
     /** @brief Gets the item with the given @p index. */
@@ -766,6 +805,23 @@ public:
     void setMaxLineCount( int maxLineCount ) { m_maxLineCount = maxLineCount; updateItemGeometries(); };
     int maxLineCount() const { return m_maxLineCount; };
 
+    /** @brief Gets the cache for text documents shared by all items of this widget. */
+    TextDocumentCache *textDocumentCache() { return &m_textDocumentCache; };
+
+    /**
+     * @brief The number of frames, in which at least one row was painted.
+     *
+     * Counted since the last call to resetPaintStatistics(). If the LowPowerMode option is
+     * enabled, rows that are not repainted get drawn from the item cache and are not counted.
+     **/
+    int frameCount() const { return m_frameCount; };
+
+    /** @brief The number of painted rows since the last call to resetPaintStatistics(). */
+    int paintedRowCount() const { return m_paintedRowCount; };
+
+    /** @brief Resets frameCount() and paintedRowCount() to 0. */
+    void resetPaintStatistics() { m_frameCount = m_paintedRowCount = 0; };
+
     /** @brief Call this eg. when the DepartureArrivalListType changes in the model
      * (only header data gets changed...). */
     void updateItemLayouts();
@@ -802,7 +858,49 @@ protected slots:
     virtual void layoutChanged();
     virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight ) = 0;
 
+    /**
+     * @brief Creates/reuses items for visible rows and releases items of other rows.
+     *
+     * Only used if the Virtualized option is enabled, called when the widget gets scrolled
+     * or resized and when rows get inserted/removed.
+     **/
+    void updateVisibleRows();
+
+    /**
+     * @brief Gets the range of rows that are currently visible in the viewport.
+     *
+     * Expanded items are not taken into account, ie. the range may contain some more rows
+     * than actually visible, which is good enough to prioritize visible rows.
+     * @param firstRow Gets set to the first visible row.
+     * @param lastRow Gets set to the last visible row.
+     * @return False if there are no rows, true otherwise.
+     **/
+    bool visibleRowRange( int *firstRow, int *lastRow ) const;
+
+    /** @brief The current frame was painted, the next painted row belongs to a new frame. */
+    void framePainted() { m_paintingFrame = false; };
+
 protected:
+    /** @brief Creates a new item, used for rows of the model. */
+    virtual PublicTransportGraphicsItem *createItem() = 0;
+
+    /** @brief Updates @p item with the data of @p row in the model. */
+    virtual void updateItemData( PublicTransportGraphicsItem *item, int row,
+                                 bool updateLayouts = false ) = 0;
+
+    /** @brief Inserts items for the model rows @p first to @p last. */
+    void insertItems( int first, int last );
+
+    /** @brief Deletes all items and inserts new ones, eg. after the Virtualized option changed. */
+    void rebuildItems();
+
+    /** @brief Gets a recycled or new item for @p row. */
+    PublicTransportGraphicsItem *acquireItem( int row );
+
+    /** @brief Removes @p item from the layout and keeps it for reuse. */
+    void releaseItem( PublicTransportGraphicsItem *item );
+
+    virtual void resizeEvent( QGraphicsSceneResizeEvent *event );
     virtual QSizeF sizeHint( Qt::SizeHint which, const QSizeF& constraint ) const;
     virtual void contextMenuEvent( QGraphicsSceneContextMenuEvent *event );
     virtual void paint( QPainter *painter, const QStyleOptionGraphicsItem *option,
@@ -813,17 +911,27 @@ protected:
     void setPostfixItem( TimetableListItem *postfixItem );
     void updateSnapSize();
 
+    /** @brief Called by items when they get painted, to count frames and painted rows. */
+    void rowPainted();
+
     Options m_options;
     ExpandingOption m_expandingOption;
     PublicTransportModel *m_model;
     TimetableListItem *m_prefixItem;
     TimetableListItem *m_postfixItem;
-    QList<PublicTransportGraphicsItem*> m_items;
+    QList<PublicTransportGraphicsItem*> m_items; // Items by row, 0 for rows without item
+    QList<PublicTransportGraphicsItem*> m_recycledItems; // Hidden items to reuse
+    QGraphicsWidget *m_topSpacer; // Takes the space of rows without item, if virtualized
+    QGraphicsWidget *m_bottomSpacer;
+    TextDocumentCache m_textDocumentCache;
     Plasma::Svg *m_svg;
     qreal m_iconSize;
     qreal m_zoomFactor;
     int m_maxLineCount;
     QString m_noItemsText;
+    int m_frameCount;
+    int m_paintedRowCount;
+    bool m_paintingFrame; // Whether or not a row was painted in the current frame
     bool m_enableOpenStreetMap; // Enable actions using the openstreetmap data engine
     StopAction *m_copyStopToClipboardAction;
     StopAction *m_showInMapAction;
@@ -869,6 +977,9 @@ protected slots:
     virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight );
 
 protected:
+    virtual PublicTransportGraphicsItem *createItem();
+    virtual void updateItemData( PublicTransportGraphicsItem *item, int row,
+                                 bool updateLayouts = false );
     virtual void contextMenuEvent( QGraphicsSceneContextMenuEvent *event );
     virtual void setupActions();
 
@@ -929,6 +1040,9 @@ protected slots:
     virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight );
 
 protected:
+    virtual PublicTransportGraphicsItem *createItem();
+    virtual void updateItemData( PublicTransportGraphicsItem *item, int row,
+                                 bool updateLayouts = false );
     virtual void setupActions();
 
 private:
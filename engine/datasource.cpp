@@ -28,6 +28,7 @@
 
 // Qt includes
 #include <QTimer>
+#include <QSet>
 
 DataSource::DataSource( const QString &dataSource ) : m_name(dataSource)
 {
@@ -49,14 +50,13 @@ SimpleDataSource::SimpleDataSource( const QString &dataSource, const QVariantHas
 }
 
 TimetableDataSource::TimetableDataSource( const QString &dataSource, const QVariantHash &data )
-        : SimpleDataSource(dataSource, data), m_updateTimer(0), m_cleanupTimer(0),
-          m_updateAdditionalDataDelayTimer(0)
+        : SimpleDataSource(dataSource, data), m_cleanupTimer(0),
+          m_updateAdditionalDataDelayTimer(0), m_runningAdditionalDataRequests(0)
 {
 }
 
 TimetableDataSource::~TimetableDataSource()
 {
-    delete m_updateTimer;
     delete m_cleanupTimer;
     delete m_updateAdditionalDataDelayTimer;
 }
@@ -148,6 +148,15 @@ void TimetableDataSource::setTimetableItems( const QVariantList &items )
     m_data[ timetableItemKey() ] = items;
 }
 
+void TimetableDataSource::appendTimetableItems( const QVariantList &items )
+{
+    // Take the list out of the hash to not hold a second reference to it while appending
+    const QString itemKey = timetableItemKey();
+    QVariantList allItems = m_data.take( itemKey ).toList();
+    allItems << items;
+    m_data.insert( itemKey, allItems );
+}
+
 UpdateFlags TimetableDataSource::updateFlags() const
 {
     UpdateFlags flags = NoUpdateFlags;
@@ -157,20 +166,6 @@ UpdateFlags TimetableDataSource::updateFlags() const
     return flags;
 }
 
-void TimetableDataSource::setUpdateTimer( QTimer *timer )
-{
-    // Delete old timer (if any) and replace with the new timer
-    delete m_updateTimer;
-    m_updateTimer = timer;
-}
-
-void TimetableDataSource::stopUpdateTimer()
-{
-    if ( m_updateTimer ) {
-        m_updateTimer->stop();
-    }
-}
-
 void TimetableDataSource::setUpdateAdditionalDataDelayTimer( QTimer *timer )
 {
     // Delete old timer (if any) and replace with the new timer
@@ -188,7 +183,7 @@ void TimetableDataSource::setCleanupTimer( QTimer *timer )
 void TimetableDataSource::cleanup()
 {
     // Get a list of hash values for all currently available timetable items
-    QList< uint > itemHashes;
+    QSet< quint64 > itemHashes;
     const QVariantList items = timetableItems();
     const bool isDeparture = timetableItemKey() != QLatin1String("arrivals");
     foreach ( const QVariant &item, items ) {
@@ -196,7 +191,7 @@ void TimetableDataSource::cleanup()
     }
 
     // Remove cached additional data for no longer present timetable items
-    QHash< uint, TimetableData >::Iterator it = m_additionalData.begin();
+    QHash< quint64, TimetableData >::Iterator it = m_additionalData.begin();
     while ( it != m_additionalData.end() ) {
         if ( itemHashes.contains(it.key()) ) {
             // The associated timetable item is still available
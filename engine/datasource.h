@@ -22,6 +22,7 @@
 
 // Own includes
 #include "enums.h"
+#include "global.h"
 #include "request.h"
 
 // Qt includes
@@ -276,37 +277,40 @@ public:
      **/
     void setTimetableItems( const QVariantList &items );
 
+    /**
+     * @brief Append @p items to the list of timetable items stored in this data source.
+     *
+     * The stored list gets appended in place, it only gets copied if it is still shared,
+     * eg. with the data published by the engine.
+     * @see timetableItems(), setTimetableItems()
+     **/
+    void appendTimetableItems( const QVariantList &items );
+
     /**
      * @brief Get all additional data of this data source.
      * Additional data gets stored by a hash value for the associated timetable item.
      **/
-    QHash< uint, TimetableData > additionalData() const { return m_additionalData; };
+    QHash< quint64, TimetableData > additionalData() const { return m_additionalData; };
 
     /**
      * @brief Set all additional data to @p additionalData.
      * This replaces all previously set additional timetable data.
      **/
-    void setAdditionalData( const QHash< uint, TimetableData > &additionalData ) {
+    void setAdditionalData( const QHash< quint64, TimetableData > &additionalData ) {
         // Cache all additional data for some time TODO
         m_additionalData.unite( additionalData );
     };
 
     /** @brief Get additional data for the item with @p departureHash. */
-    TimetableData additionalData( uint departureHash ) const {
+    TimetableData additionalData( quint64 departureHash ) const {
         return m_additionalData[ departureHash ];
     };
 
     /** @brief Set additional data for the item with @p departureHash to @p additionalData. */
-    void setAdditionalData( uint departureHash, const TimetableData &additionalData ) {
+    void setAdditionalData( quint64 departureHash, const TimetableData &additionalData ) {
         m_additionalData[ departureHash ] = additionalData;
     };
 
-    /** @brief Timer to update the data source periodically. */
-    QTimer *updateTimer() const { return m_updateTimer; };
-
-    void setUpdateTimer( QTimer *timer );
-    void stopUpdateTimer();
-
     /** @brief Timer to delay updates to additional timetable data of timetable items. */
     QTimer *updateAdditionalDataDelayTimer() const { return m_updateAdditionalDataDelayTimer; };
 
@@ -316,6 +320,17 @@ public:
     void setUpdateAdditionalDataDelayTimer( QTimer *timer );
     void setCleanupTimer( QTimer *timer );
 
+    /** @brief The number of running additional data requests for timetable items. */
+    int runningAdditionalDataRequests() const { return m_runningAdditionalDataRequests; };
+
+    /** @brief Should be called when an additional data request was started. */
+    void additionalDataRequestStarted() { ++m_runningAdditionalDataRequests; };
+
+    /** @brief Should be called when an additional data request is done (successful or not). */
+    void additionalDataRequestFinished() {
+        m_runningAdditionalDataRequests = qMax( 0, m_runningAdditionalDataRequests - 1 );
+    };
+
     /**
      * @brief The time at which new downloads will have sufficient changes.
      * Sufficient means enough timetable items are in the past or there may be changed delays.
@@ -329,29 +344,26 @@ public:
 
     QSharedPointer< AbstractRequest > request( const QString &sourceName ) const;
 
-    inline static uint hashForDeparture( const QVariantHash &departure, bool isDeparture = true ) {
+    inline static quint64 hashForDeparture( const QVariantHash &departure, bool isDeparture = true ) {
         return hashForDeparture( departure[Enums::toString(Enums::DepartureDateTime)].toDateTime(),
                 static_cast<Enums::VehicleType>(departure[Enums::toString(Enums::TypeOfVehicle)].toInt()),
                 departure[Enums::toString(Enums::TransportLine)].toString(),
                 departure[Enums::toString(Enums::Target)].toString(), isDeparture );
     };
 
-    inline static uint hashForDeparture( const TimetableData &departure, bool isDeparture = true ) {
+    inline static quint64 hashForDeparture( const TimetableData &departure, bool isDeparture = true ) {
         return hashForDeparture( departure[Enums::DepartureDateTime].toDateTime(),
                 static_cast<Enums::VehicleType>(departure[Enums::TypeOfVehicle].toInt()),
                 departure[Enums::TransportLine].toString(),
                 departure[Enums::Target].toString(), isDeparture );
     };
 
-    static uint hashForDeparture( const QDateTime &departure, Enums::VehicleType vehicleType,
-                                  const QString &lineString, const QString &target,
-                                  bool isDeparture = true )
+    static quint64 hashForDeparture( const QDateTime &departure, Enums::VehicleType vehicleType,
+                                     const QString &lineString, const QString &target,
+                                     bool isDeparture = true )
     {
-        return qHash( QString("%1%2%3%4%5").arg(departure.toString("dMMyyhhmmss"))
-                      .arg(static_cast<int>(vehicleType))
-                      .arg(lineString)
-                      .arg(target.trimmed().toLower())
-                      .arg(isDeparture ? "D" : "A") );
+        return Global::departureIdentity( departure, vehicleType, lineString, target,
+                                          !isDeparture );
     };
 
 private:
@@ -365,10 +377,10 @@ private:
         int count;
     };
 
-    QHash< uint, TimetableData > m_additionalData;
-    QTimer *m_updateTimer;
+    QHash< quint64, TimetableData > m_additionalData;
     QTimer *m_cleanupTimer;
     QTimer *m_updateAdditionalDataDelayTimer;
+    int m_runningAdditionalDataRequests;
     QDateTime m_nextDownloadTimeProposal;
     QHash< QString, SourceData > m_dataSources; // Connected data sources ("ambiguous" ones)
 };
@@ -26,7 +26,76 @@
 // KDE includes
 #include <KDebug>
 
-PublicTransportInfo::PublicTransportInfo(QObject* parent): QObject(parent)
+/**
+ * @brief Shared data of PublicTransportInfo objects.
+ *
+ * Frequently used values with their expected types get stored in fixed fields, all other
+ * values in the otherData side table. A value is never stored in both.
+ **/
+class PublicTransportInfoData : public QSharedData {
+public:
+    /** @brief Flags for values stored in fixed fields. */
+    enum Field {
+        NoField = 0x00,
+        DepartureDateTimeField = 0x01,
+        TypeOfVehicleField = 0x02,
+        TransportLineField = 0x04,
+        TargetField = 0x08,
+        DelayField = 0x10
+    };
+
+    PublicTransportInfoData() : fields(NoField), vehicleType(0), delay(-1), isValid(false) {};
+
+    /** @brief Get the fixed field used for @p info, if any. */
+    static Field fieldFromInfo( Enums::TimetableInformation info ) {
+        switch ( info ) {
+        case Enums::DepartureDateTime:
+            return DepartureDateTimeField;
+        case Enums::TypeOfVehicle:
+            return TypeOfVehicleField;
+        case Enums::TransportLine:
+            return TransportLineField;
+        case Enums::Target:
+            return TargetField;
+        case Enums::Delay:
+            return DelayField;
+        default:
+            return NoField;
+        }
+    };
+
+    /** @brief Whether or not @p type is the type expected for values stored in @p field. */
+    static bool isExpectedType( Field field, QVariant::Type type ) {
+        switch ( field ) {
+        case DepartureDateTimeField:
+            return type == QVariant::DateTime;
+        case TypeOfVehicleField:
+        case DelayField:
+            return type == QVariant::Int;
+        case TransportLineField:
+        case TargetField:
+            return type == QVariant::String;
+        default:
+            return false;
+        }
+    };
+
+    int fields; // Flags of fixed fields that contain a value
+    QDateTime departureDateTime;
+    QString transportLine;
+    QString target;
+    int vehicleType;
+    int delay;
+    LineServices lineServices;
+    bool isValid;
+    TimetableData otherData; // Side table for rarely used values and values of other types
+};
+
+PublicTransportInfo::PublicTransportInfo() : d(new PublicTransportInfoData)
+{
+}
+
+PublicTransportInfo::PublicTransportInfo( const PublicTransportInfo &other ) : d(other.d)
 {
 }
 
@@ -34,11 +103,181 @@ PublicTransportInfo::~PublicTransportInfo()
 {
 }
 
-PublicTransportInfo::PublicTransportInfo( const QHash< Enums::TimetableInformation, QVariant >& data,
-                                          Corrections corrections, QObject *parent )
-    : QObject(parent), m_data(data)
+PublicTransportInfo &PublicTransportInfo::operator =( const PublicTransportInfo &other )
+{
+    d = other.d;
+    return *this;
+}
+
+bool PublicTransportInfo::contains( Enums::TimetableInformation info ) const
+{
+    const PublicTransportInfoData::Field field = PublicTransportInfoData::fieldFromInfo( info );
+    return (d->fields & field) != 0 || d->otherData.contains( info );
+}
+
+QVariant PublicTransportInfo::value( Enums::TimetableInformation info ) const
+{
+    const PublicTransportInfoData::Field field = PublicTransportInfoData::fieldFromInfo( info );
+    if ( (d->fields & field) == 0 ) {
+        return d->otherData.value( info );
+    }
+
+    switch ( field ) {
+    case PublicTransportInfoData::DepartureDateTimeField:
+        return d->departureDateTime;
+    case PublicTransportInfoData::TypeOfVehicleField:
+        return d->vehicleType;
+    case PublicTransportInfoData::TransportLineField:
+        return d->transportLine;
+    case PublicTransportInfoData::TargetField:
+        return d->target;
+    case PublicTransportInfoData::DelayField:
+        return d->delay;
+    default:
+        return QVariant();
+    }
+}
+
+void PublicTransportInfo::insert( Enums::TimetableInformation info, const QVariant &data )
+{
+    const PublicTransportInfoData::Field field = PublicTransportInfoData::fieldFromInfo( info );
+    if ( !PublicTransportInfoData::isExpectedType(field, data.type()) ) {
+        // Store in the side table, remove a value from a fixed field
+        d->fields &= ~field;
+        d->otherData.insert( info, data );
+        return;
+    }
+
+    switch ( field ) {
+    case PublicTransportInfoData::DepartureDateTimeField:
+        d->departureDateTime = data.toDateTime();
+        break;
+    case PublicTransportInfoData::TypeOfVehicleField:
+        d->vehicleType = data.toInt();
+        break;
+    case PublicTransportInfoData::TransportLineField:
+        d->transportLine = data.toString();
+        break;
+    case PublicTransportInfoData::TargetField:
+        d->target = data.toString();
+        break;
+    case PublicTransportInfoData::DelayField:
+        d->delay = data.toInt();
+        break;
+    default:
+        break;
+    }
+    d->fields |= field;
+    if ( !d->otherData.isEmpty() ) {
+        d->otherData.remove( info );
+    }
+}
+
+void PublicTransportInfo::remove( Enums::TimetableInformation info )
+{
+    const PublicTransportInfoData::Field field = PublicTransportInfoData::fieldFromInfo( info );
+    d->fields &= ~field;
+    if ( !d->otherData.isEmpty() ) {
+        d->otherData.remove( info );
+    }
+}
+
+QDateTime PublicTransportInfo::departureDateTime() const
+{
+    return (d->fields & PublicTransportInfoData::DepartureDateTimeField) != 0
+            ? d->departureDateTime : d->otherData.value(Enums::DepartureDateTime).toDateTime();
+}
+
+Enums::VehicleType PublicTransportInfo::vehicleType() const
+{
+    return static_cast< Enums::VehicleType >(
+            (d->fields & PublicTransportInfoData::TypeOfVehicleField) != 0
+            ? d->vehicleType : d->otherData.value(Enums::TypeOfVehicle).toInt() );
+}
+
+QString PublicTransportInfo::transportLine() const
 {
-    m_isValid = false;
+    return (d->fields & PublicTransportInfoData::TransportLineField) != 0
+            ? d->transportLine : d->otherData.value(Enums::TransportLine).toString();
+}
+
+QString PublicTransportInfo::target() const
+{
+    return (d->fields & PublicTransportInfoData::TargetField) != 0
+            ? d->target : d->otherData.value(Enums::Target).toString();
+}
+
+int PublicTransportInfo::delay() const
+{
+    if ( (d->fields & PublicTransportInfoData::DelayField) != 0 ) {
+        return d->delay;
+    }
+    return d->otherData.contains(Enums::Delay) ? d->otherData[Enums::Delay].toInt() : -1;
+}
+
+TimetableData PublicTransportInfo::data() const
+{
+    TimetableData data = d->otherData;
+    if ( d->fields & PublicTransportInfoData::DepartureDateTimeField ) {
+        data.insert( Enums::DepartureDateTime, d->departureDateTime );
+    }
+    if ( d->fields & PublicTransportInfoData::TypeOfVehicleField ) {
+        data.insert( Enums::TypeOfVehicle, d->vehicleType );
+    }
+    if ( d->fields & PublicTransportInfoData::TransportLineField ) {
+        data.insert( Enums::TransportLine, d->transportLine );
+    }
+    if ( d->fields & PublicTransportInfoData::TargetField ) {
+        data.insert( Enums::Target, d->target );
+    }
+    if ( d->fields & PublicTransportInfoData::DelayField ) {
+        data.insert( Enums::Delay, d->delay );
+    }
+    return data;
+}
+
+QVariantHash PublicTransportInfo::toVariantHash() const
+{
+    QVariantHash data;
+    for ( TimetableData::ConstIterator it = d->otherData.constBegin();
+          it != d->otherData.constEnd(); ++it )
+    {
+        if ( it.value().isValid() ) {
+            data.insert( Global::timetableInformationToString(it.key()), it.value() );
+        }
+    }
+    if ( d->fields & PublicTransportInfoData::DepartureDateTimeField ) {
+        data.insert( Global::timetableInformationToString(Enums::DepartureDateTime),
+                     d->departureDateTime );
+    }
+    if ( d->fields & PublicTransportInfoData::TypeOfVehicleField ) {
+        data.insert( Global::timetableInformationToString(Enums::TypeOfVehicle),
+                     d->vehicleType );
+    }
+    if ( d->fields & PublicTransportInfoData::TransportLineField ) {
+        data.insert( Global::timetableInformationToString(Enums::TransportLine),
+                     d->transportLine );
+    }
+    if ( d->fields & PublicTransportInfoData::TargetField ) {
+        data.insert( Global::timetableInformationToString(Enums::Target), d->target );
+    }
+    if ( d->fields & PublicTransportInfoData::DelayField ) {
+        data.insert( Global::timetableInformationToString(Enums::Delay), d->delay );
+    }
+    return data;
+}
+
+bool PublicTransportInfo::isValid() const
+{
+    return d->isValid;
+}
+
+PublicTransportInfo::PublicTransportInfo( const TimetableData &data, Corrections corrections )
+    : d(new PublicTransportInfoData)
+{
+    for ( TimetableData::ConstIterator it = data.constBegin(); it != data.constEnd(); ++it ) {
+        insert( it.key(), it.value() );
+    }
 
     // Insert -1 as Delay if none is given (-1 means "no delay information available")
     if ( !contains(Enums::Delay) ) {
@@ -108,8 +347,8 @@ PublicTransportInfo::PublicTransportInfo( const QHash< Enums::TimetableInformati
     }
 }
 
-JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections, QObject *parent )
-        : PublicTransportInfo( data, corrections, parent )
+JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections )
+        : PublicTransportInfo( data, corrections )
 {
     if ( corrections.testFlag(DeduceMissingValues) ) {
         // Guess arrival date value if none is given,
@@ -261,25 +500,26 @@ JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections, QO
         }
     }
 
-    m_isValid = contains(Enums::DepartureDateTime) && contains(Enums::ArrivalDateTime) &&
+    d->isValid = contains(Enums::DepartureDateTime) && contains(Enums::ArrivalDateTime) &&
                 contains(Enums::StartStopName) && contains(Enums::TargetStopName);
 }
 
-StopInfo::StopInfo( QObject *parent ) : PublicTransportInfo(parent)
+StopInfo::StopInfo() : PublicTransportInfo()
 {
-    m_isValid = false;
 }
 
-StopInfo::StopInfo( const QHash< Enums::TimetableInformation, QVariant >& data, QObject *parent )
-    : PublicTransportInfo(parent)
+StopInfo::StopInfo( const QHash< Enums::TimetableInformation, QVariant >& data )
+    : PublicTransportInfo()
 {
-    m_data.unite( data );
-    m_isValid = contains( Enums::StopName );
+    for ( TimetableData::ConstIterator it = data.constBegin(); it != data.constEnd(); ++it ) {
+        insert( it.key(), it.value() );
+    }
+    d->isValid = contains( Enums::StopName );
 }
 
 StopInfo::StopInfo( const QString &name, const QString& id, int weight,
                     qreal longitude, qreal latitude, const QString &city,
-                    const QString &countryCode, QObject *parent ) : PublicTransportInfo(parent)
+                    const QString &countryCode ) : PublicTransportInfo()
 {
     insert( Enums::StopName, name );
     if ( !id.isNull() ) {
@@ -301,16 +541,15 @@ StopInfo::StopInfo( const QString &name, const QString& id, int weight,
         insert( Enums::StopWeight, weight );
     }
 
-    m_isValid = !name.isEmpty();
+    d->isValid = !name.isEmpty();
 }
 
-DepartureInfo::DepartureInfo( QObject *parent ) : PublicTransportInfo(parent)
+DepartureInfo::DepartureInfo() : PublicTransportInfo()
 {
-    m_isValid = false;
 }
 
-DepartureInfo::DepartureInfo( const TimetableData &data, Corrections corrections, QObject *parent )
-        : PublicTransportInfo( data, corrections, parent )
+DepartureInfo::DepartureInfo( const TimetableData &data, Corrections corrections )
+        : PublicTransportInfo( data, corrections )
 {
     if ( (contains(Enums::RouteStops) || contains(Enums::RouteTimes)) &&
          value(Enums::RouteTimes).toList().count() != value(Enums::RouteStops).toStringList().count() )
@@ -338,8 +577,18 @@ DepartureInfo::DepartureInfo( const TimetableData &data, Corrections corrections
         }
     }
 
-    m_isValid = contains( Enums::TransportLine ) && contains( Enums::Target ) &&
-                contains( Enums::DepartureDateTime );
+    d->isValid = contains( Enums::TransportLine ) && contains( Enums::Target ) &&
+                 contains( Enums::DepartureDateTime );
+}
+
+bool DepartureInfo::isNightLine() const
+{
+    return d->lineServices.testFlag( Enums::NightLine );
+}
+
+bool DepartureInfo::isExpressLine() const
+{
+    return d->lineServices.testFlag( Enums::ExpressLine );
 }
 
 QStringList JourneyInfo::vehicleIconNames() const
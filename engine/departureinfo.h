@@ -29,9 +29,9 @@
 
 // Qt includes
 #include <QVariant>
-#include <QTime>
+#include <QDateTime>
 #include <QStringList>
-#include <QPointer>
+#include <QSharedDataPointer>
 
 /**
  * @brief LineService-Flags.
@@ -39,13 +39,26 @@
  **/
 Q_DECLARE_FLAGS( LineServices, Enums::LineService )
 
+class PublicTransportInfoData;
+
 /**
- * @brief This is the abstract base class of all other timetable information classes.
+ * @brief This is the base class of all other timetable information classes.
+ *
+ * Timetable items are implicitly shared values, copying them is cheap. Frequently used values
+ * (the departure date and time, the vehicle type, the transport line, the target and the delay)
+ * are stored in fixed fields, if they have their expected types (QDateTime, int or QString).
+ * All other values get stored in a side table. This means that a timetable item needs only
+ * a single allocation for the shared data, if no rarely used values are available.
+ *
+ * PublicTransportInfo objects can be converted to the derived types (eg. using the
+ * DepartureInfo(const PublicTransportInfo&) constructor), which share the data of the
+ * PublicTransportInfo object. The derived classes add no data.
  *
  * @see JourneyInfo
  * @see DepartureInfo
+ * @see StopInfo
  **/
-class PublicTransportInfo : public QObject {
+class PublicTransportInfo {
 public:
     /** @brief Options for stop names, eg. use a shortened form or not. */
     enum StopNameOptions {
@@ -53,8 +66,8 @@ public:
         UseShortenedStopNames /**< Use a shortened form of the stop names. */
     };
 
-    /** @brief Constructs a new PublicTransportInfo object. */
-    PublicTransportInfo( QObject *parent = 0 );
+    /** @brief Constructs a new invalid PublicTransportInfo object. */
+    PublicTransportInfo();
 
     enum Correction {
         NoCorrection                    = 0x0000,
@@ -75,20 +88,47 @@ public:
      * @param data A hash that contains values for TimetableInformations.
      **/
     explicit PublicTransportInfo( const TimetableData &data,
-                                  Corrections corrections = CorrectEverything,
-                                  QObject *parent = 0 );
+                                  Corrections corrections = CorrectEverything );
 
-    virtual ~PublicTransportInfo();
+    /** @brief Copy constructor, shares the data of @p other. */
+    PublicTransportInfo( const PublicTransportInfo &other );
 
-    bool contains( Enums::TimetableInformation info ) const { return m_data.contains(info); };
-    QVariant value( Enums::TimetableInformation info ) const { return m_data[info]; };
-    void insert( Enums::TimetableInformation info, const QVariant &data ) {
-        m_data.insert( info, data );
-    };
-    void remove( Enums::TimetableInformation info ) { m_data.remove(info); };
+    ~PublicTransportInfo();
+
+    /** @brief Assignment operator, shares the data of @p other. */
+    PublicTransportInfo &operator =( const PublicTransportInfo &other );
+
+    bool contains( Enums::TimetableInformation info ) const;
+    QVariant value( Enums::TimetableInformation info ) const;
+    void insert( Enums::TimetableInformation info, const QVariant &data );
+    void remove( Enums::TimetableInformation info );
+
+    /** @brief The departure date and time, without converting a QVariant if possible. */
+    QDateTime departureDateTime() const;
+
+    /** @brief The vehicle type, without converting a QVariant if possible. */
+    Enums::VehicleType vehicleType() const;
+
+    /** @brief The transport line, without converting a QVariant if possible. */
+    QString transportLine() const;
+
+    /** @brief The target, without converting a QVariant if possible. */
+    QString target() const;
+
+    /** @brief The delay in minutes, -1 if no delay information is available. */
+    int delay() const;
 
     /** @brief Returns the TimetableData object for this item. */
-    TimetableData data() const { return m_data; };
+    TimetableData data() const;
+
+    /**
+     * @brief Get all valid values of this item in a QVariantHash.
+     *
+     * The keys are the names of the TimetableInformations, see
+     * Global::timetableInformationToString(). This gets used to publish timetable items
+     * in data sources without creating a TimetableData object first.
+     **/
+    QVariantHash toVariantHash() const;
 
     /**
      * @brief Wheather or not this PublicTransportInfo object is valid.
@@ -96,11 +136,14 @@ public:
      * @return true if the PublicTransportInfo object is valid.
      * @return false if the PublicTransportInfo object is invalid.
      **/
-    virtual bool isValid() const { return m_isValid; };
+    bool isValid() const;
+
+    /** @brief Whether or not this item shares its data with @p other, ie. was not modified. */
+    bool isSharedWith( const PublicTransportInfo &other ) const {
+        return d.constData() == other.d.constData(); };
 
 protected:
-    bool m_isValid;
-    TimetableData m_data;
+    QSharedDataPointer< PublicTransportInfoData > d;
 };
 
 /**
@@ -119,8 +162,10 @@ public:
      *   TargetStopName. Instead of DepartureDateTime, DepartureDate and DepartureTime can be used.
      *   If only DepartureTime gets used, the date is guessed. The same is true for ArrivalDateTime.
      **/
-    explicit JourneyInfo( const TimetableData &data, Corrections corrections = CorrectEverything,
-                          QObject *parent = 0 );
+    explicit JourneyInfo( const TimetableData &data, Corrections corrections = CorrectEverything );
+
+    /** @brief Constructs a JourneyInfo object sharing the data of @p info. */
+    explicit JourneyInfo( const PublicTransportInfo &info ) : PublicTransportInfo(info) {};
 
     QStringList vehicleIconNames() const;
     QStringList vehicleNames( bool plural = false ) const;
@@ -135,7 +180,7 @@ public:
 class DepartureInfo : public PublicTransportInfo {
 public:
     /** @brief Constructs an invalid DepartureInfo object. */
-    DepartureInfo( QObject *parent = 0 );
+    DepartureInfo();
 
     /**
      * @brief Contructs a new DepartureInfo object based on the information given with @p data.
@@ -145,17 +190,16 @@ public:
      *   DepartureDateTime, DepartureDate and DepartureTime can be used. If only DepartureTime
      *   gets used, the date is guessed.
      **/
-    explicit DepartureInfo( const TimetableData &data, Corrections corrections = CorrectEverything,
-                            QObject *parent = 0 );
+    explicit DepartureInfo( const TimetableData &data, Corrections corrections = CorrectEverything );
+
+    /** @brief Constructs a DepartureInfo object sharing the data of @p info. */
+    explicit DepartureInfo( const PublicTransportInfo &info ) : PublicTransportInfo(info) {};
 
     /** @brief Wheather or not the departing / arriving vehicle is a night line. */
-    bool isNightLine() const { return m_lineServices.testFlag( Enums::NightLine ); };
+    bool isNightLine() const;
 
     /** @brief Wheather or not the departing / arriving vehicle is an express line. */
-    bool isExpressLine() const { return m_lineServices.testFlag( Enums::ExpressLine ); };
-
-private:
-    LineServices m_lineServices;
+    bool isExpressLine() const;
 };
 
 /**
@@ -167,14 +211,17 @@ private:
 class StopInfo : public PublicTransportInfo {
 public:
     /** @brief Constructs an invalid StopInfo object. */
-    StopInfo( QObject *parent = 0 );
+    StopInfo();
 
     /**
      * @brief Contructs a new StopInfo object based on the information given with @p data.
      *
      * @param data A hash that contains values for at least the required TimetableInformations
      *   (StopName). */
-    StopInfo( const QHash<Enums::TimetableInformation, QVariant> &data, QObject *parent = 0 );
+    explicit StopInfo( const QHash<Enums::TimetableInformation, QVariant> &data );
+
+    /** @brief Constructs a StopInfo object sharing the data of @p info. */
+    explicit StopInfo( const PublicTransportInfo &info ) : PublicTransportInfo(info) {};
 
     /**
      * @brief Constructs a new StopInfo object.
@@ -188,19 +235,21 @@ public:
      */
     StopInfo( const QString &name, const QString &id = QString(), int weight = -1,
               qreal longitude = 0.0, qreal latitude = 0.0, const QString &city = QString(),
-              const QString &countryCode = QString(), QObject *parent = 0 );
+              const QString &countryCode = QString() );
 };
 
+// Timetable items only contain a QSharedDataPointer and can be moved in memory,
+// this allows QList to store them directly instead of allocating a node for each item
+Q_DECLARE_TYPEINFO( PublicTransportInfo, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( JourneyInfo, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( DepartureInfo, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( StopInfo, Q_MOVABLE_TYPE );
+
 typedef DepartureInfo ArrivalInfo;
-typedef QSharedPointer< PublicTransportInfo > PublicTransportInfoPtr;
-typedef QSharedPointer< DepartureInfo > DepartureInfoPtr;
-typedef QSharedPointer< ArrivalInfo > ArrivalInfoPtr;
-typedef QSharedPointer< JourneyInfo > JourneyInfoPtr;
-typedef QSharedPointer< StopInfo > StopInfoPtr;
-typedef QList< PublicTransportInfoPtr > PublicTransportInfoList;
-typedef QList< DepartureInfoPtr > DepartureInfoList;
-typedef QList< ArrivalInfoPtr > ArrivalInfoList;
-typedef QList< JourneyInfoPtr > JourneyInfoList;
-typedef QList< StopInfoPtr > StopInfoList;
+typedef QList< PublicTransportInfo > PublicTransportInfoList;
+typedef QList< DepartureInfo > DepartureInfoList;
+typedef QList< ArrivalInfo > ArrivalInfoList;
+typedef QList< JourneyInfo > JourneyInfoList;
+typedef QList< StopInfo > StopInfoList;
 
 #endif // DEPARTUREINFO_HEADER
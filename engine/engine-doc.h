@@ -86,6 +86,7 @@ You might need to run kbuildsycoca4 in order to get the .desktop file recognized
             <li>@ref usage_gtfs_service_delete </li>
             <li>@ref usage_gtfs_service_info </li>
         </ul>
+    <li>@ref usage_updatescheduler_sec </li>
 </ul>
 <br />
 
@@ -104,7 +105,8 @@ data source names need to be completely lower case. This is to prevent ambiguiti
 would get it's own data source object in the data engine, duplicating the data. To update a data
 source all connected source name variants would need to be updated. Only accepting source names
 case sensitive makes it much easier for the engine. The only thing left that can make two identic
-data sources ambiguous is their parameter order, which gets handled using disambiguateSourceName().
+data sources ambiguous is their parameter order, which gets handled using
+PublicTransportEngine::SourceKey.
 <br />
 The following enumeration can be used in your applet if you don't want to use
 libpublictransporthelper which exports this enumaration as @ref PublicTransport::VehicleType.
@@ -282,6 +284,48 @@ QString namePlural = vehicleData["namePlural"].toString();
 KIcon icon = KIcon( vehicleData["iconName"].toString() );
 @endcode
 
+<br />
+@section usage_updatescheduler_sec Diagnostics of Automatic Updates
+Automatic updates of timetable data sources are scheduled centrally for all providers. Requests
+to a provider are limited by a request budget (token bucket) per provider and due updates get
+dispatched in batches. The budget of a provider allows five requests in the minimal fetch wait
+time of the provider. Manual update requests also take from the budget and get rejected if it
+is exhausted. Diagnostic data about the scheduler is available in the data source
+@em "UpdateScheduler". It contains a field <i>queueDepth</i> (int) with the number of all
+currently scheduled updates and a field <i>providers</i> with a QVariantHash for each provider
+by provider ID with the following key/value pairs:
+<br />
+<table>
+<tr><td><i>queueDepth</i></td> <td>int</td> <td>The number of scheduled updates for the provider.
+</td></tr>
+<tr><td><i>tokens</i></td> <td>int</td> <td>The number of currently available tokens, ie. the
+number of updates that can be dispatched immediately.</td></tr>
+<tr><td><i>capacity</i></td> <td>int</td> <td>The maximal number of tokens.</td></tr>
+<tr><td><i>refillInterval</i></td> <td>int</td> <td>Milliseconds after which a token gets
+refilled.</td></tr>
+<tr><td><i>dispatchedCount</i></td> <td>int</td> <td>The number of dispatched updates.</td></tr>
+<tr><td><i>lastBatchSize</i></td> <td>int</td> <td>The number of updates dispatched together in
+the last batch.</td></tr>
+<tr><td><i>averageWaitTime</i></td> <td>int</td> <td>The average time in milliseconds between
+the time an update was due and the time it was dispatched.</td></tr>
+<tr><td><i>maxWaitTime</i></td> <td>int</td> <td>The maximal wait time in milliseconds.</td></tr>
+<tr><td><i>nextUpdate</i></td> <td>QDateTime</td> <td>The time of the next scheduled update,
+if any.</td></tr>
+</table>
+
+Jobs of scripted providers get executed by a dedicated executor with a limited number of threads
+and a limit of concurrently running jobs per provider. Queued jobs get executed by priority:
+stop suggestions first, then new timetable requests, automatic updates and finally requests for
+additional data. A stop suggestion job that was not started yet gets cancelled when a new stop
+suggestion request of the same kind (by name or by geo position) from the same requester arrives
+for the same provider. The requester gets identified by the <i>requester</i> parameter of the
+source name, see @ref usage_stopList_sec. The data source of the cancelled job gets the error
+code 4. The field <i>scriptExecutor</i> contains a QVariantHash with the fields
+<i>queueLength</i> (int), <i>maximumThreads</i> (int) and <i>waitTimes</i>. The latter contains
+a QVariantHash for each used priority ("stopSuggestions", "timetable", "backgroundUpdate" and
+"additionalData") with the fields <i>count</i> (int), <i>averageWaitTime</i> and
+<i>maxWaitTime</i> (milliseconds jobs waited in the queue).
+
 <br />
 @section usage_departures_sec Receiving Departures or Arrivals
 To get a list of departures/arrivals you need to construct the name of the data source. For
@@ -394,6 +438,12 @@ automatic update of the data source.</td></tr>
 an update using the "requestUpdate" operation of the timetable service.</td></tr>
 <tr><td><i>departures</i> or <i>arrivals</i></td> <td>QVariantList</td>
 <td>A list of all found departures/arrivals.</td></tr>
+<tr><td><i>complete</i></td> <td>bool</td> <td>False while a provider still publishes
+departures/arrivals in chunks, true when all chunks were received.</td></tr>
+<tr><td><i>appendedDepartures</i> or <i>appendedArrivals</i></td> <td>QVariantList</td>
+<td>(only if @em complete is @c false), the departures/arrivals of the last received chunk.
+They are not yet contained in @em departures/@em arrivals, which gets updated with all
+departures/arrivals when @em complete becomes @c true.</td></tr>
 </table>
 <br />
 
@@ -516,10 +566,16 @@ an error message string.</td></tr>
     Error code 1 means, that there was a problem downloading a source file.
     Error code 2 means, that parsing a source file failed.
     Error code 3 means that a GTFS feed needs to be imorted into the database before using it.
-    Use the @ref PublicTransportService to start and monitor the import.</td></tr>
+    Use the @ref PublicTransportService to start and monitor the import.
+    Error code 4 means, that the request was cancelled because it was superseded by a newer
+    request of the same requester.</td></tr>
 <tr><td><i>updated</i></td> <td>QDateTime</td> <td>The date and time when the data source was
 last updated.</td></tr>
 <tr><td><i>journeys</i></td> <td>QVariantList</td> <td>A list of all found journeys.</td></tr>
+<tr><td><i>complete</i></td> <td>bool</td> <td>False while a provider still publishes
+journeys in chunks, true when all chunks were received.</td></tr>
+<tr><td><i>appendedJourneys</i></td> <td>QVariantList</td> <td>(only if @em complete is
+@c false), the journeys of the last received chunk, see @em appendedDepartures.</td></tr>
 </table>
 <br />
 Each journey in the data received from the data engine (journeyData in the code
@@ -596,6 +652,11 @@ To get a list of stop suggestions use the data source
 If the provider supports the @em ProvidesStopsByGeoPosition feature, the following parameters can
 be used to get stops at a specific geo position:
 @verbatim "Stops <service-provider-id>|latitude=<decimal-latitude>|longitude=<decimal-longitude>" @endverbatim
+An ID of the requesting object can be added with the parameter <i>requester</i>, eg.
+@verbatim "Stops <service-provider-id>|stop=<stop-name-part>|requester=<requester-id>" @endverbatim
+Pending stop suggestion requests of a requester get cancelled, when the same requester requests
+newer stop suggestions, eg. while the user types a stop name. The requester parameter does not
+identify the requested data, sources that only differ in the requester share their data.
 
 In your dataUpdated-slot you should first check, if a stop list was received by checking if a
 key "stops" exists in the data object from the data engine. Then you get the stop data, which is
@@ -639,7 +700,9 @@ an error message string.</td></tr>
     Error code 1 means, that there was a problem downloading a source file.
     Error code 2 means, that parsing a source file failed.
     Error code 3 means that a GTFS feed needs to be imorted into the database before using it.
-    Use the @ref PublicTransportService to start and monitor the import.</td></tr>
+    Use the @ref PublicTransportService to start and monitor the import.
+    Error code 4 means, that the request was cancelled because it was superseded by a newer
+    request of the same requester.</td></tr>
 <tr><td><i>updated</i></td> <td>QDateTime</td> <td>The date and time when the data source was
 last updated.</td></tr>
 <tr><td><i>stops</i></td> <td>QVariantList</td> <td>A list of all found stops.</td></tr>
@@ -949,6 +1012,12 @@ to replace city names with values used by the service provider.</td></tr>
 <td>The charset of documents to be downloaded. Depending on the used service provider this might
 be needed or not. Scripts can use this value.</td></tr>
 
+<tr><td><b>\<useHttpCache\> </b></td><td>\<serviceProvider\> </td> <td>(Optional)</td>
+<td>Whether or not GET requests of the script may be answered from the HTTP cache shared by all
+providers, "true" (default) or "false". Cached documents get used and revalidated according to
+their "Cache-Control", "ETag" and "Last-Modified" headers. Use "false" if the service provider
+sends wrong caching headers.</td></tr>
+
 <tr><td><b>\<credit\> </b></td><td>\<serviceProvider\> </td> <td>(Optional)</td>
 <td>A courtesy string that is required to be shown to the user when showing the timetable data
 of the GTFS feed. If this tag is not given, a short default string is used,
@@ -57,9 +57,11 @@ enum ErrorCode {
 
     ErrorDownloadFailed = 1, /**< Download error occurred. */
     ErrorParsingFailed = 2, /**< Parsing downloaded data failed. */
-    ErrorNeedsImport = 3 /**< An import step needs to be performed, before using the accessor.
+    ErrorNeedsImport = 3, /**< An import step needs to be performed, before using the accessor.
             * This is currently only used for GTFS accessors, which need to import the GTFS feed
             * before being usable. */
+    ErrorRequestCancelled = 4 /**< The request was cancelled before it was started, because
+            * it was superseded by a newer request of the same requester. */
 };
 
 /** @brief Error codes of the GTFS service. */
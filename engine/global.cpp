@@ -20,6 +20,9 @@
 // Header
 #include "global.h"
 
+// Header only FNV-1a hash shared with libpublictransporthelper, which does not get linked
+#include <libpublictransporthelper/identityhash.h>
+
 // KDE includes
 #include <KDebug>
 #include <KLocalizedString>
@@ -27,10 +30,136 @@
 // Qt includes
 #include <QRegExp>
 #include <QTextCodec>
+#include <QDateTime>
+
+// Maps a lower case name to an enumerable value
+struct NameEntry {
+    const char *name;
+    int value;
+};
+
+// Names of all Enums::TimetableInformation values, including deprecated names.
+// Must be sorted by name for findName(), keep in sync with Enums::TimetableInformation
+static const NameEntry TIMETABLE_INFORMATION_NAMES[] = {
+    { "arrivaldate", Enums::ArrivalDate },
+    { "arrivaldatetime", Enums::ArrivalDateTime },
+    { "arrivaltime", Enums::ArrivalTime },
+    { "changes", Enums::Changes },
+    { "delay", Enums::Delay },
+    { "delayreason", Enums::DelayReason },
+    { "departuredate", Enums::DepartureDate },
+    { "departuredatetime", Enums::DepartureDateTime },
+    { "departuretime", Enums::DepartureTime },
+    { "duration", Enums::Duration },
+    { "flightnumber", Enums::FlightNumber },
+    { "isnightline", Enums::IsNightLine },
+    { "journeynews", Enums::JourneyNews },
+    { "journeynewslink", Enums::JourneyNewsUrl },
+    { "journeynewsother", Enums::JourneyNewsOther },
+    { "journeynewsurl", Enums::JourneyNewsUrl },
+    { "nothing", Enums::Nothing },
+    { "operator", Enums::Operator },
+    { "platform", Enums::Platform },
+    { "pricing", Enums::Pricing },
+    { "requestdata", Enums::RequestData },
+    { "routedataurl", Enums::RouteDataUrl },
+    { "routeexactstops", Enums::RouteExactStops },
+    { "routenews", Enums::RouteNews },
+    { "routeplatformsarrival", Enums::RoutePlatformsArrival },
+    { "routeplatformsdeparture", Enums::RoutePlatformsDeparture },
+    { "routestops", Enums::RouteStops },
+    { "routestopsshortened", Enums::RouteStopsShortened },
+    { "routesubjourneys", Enums::RouteSubJourneys },
+    { "routetimes", Enums::RouteTimes },
+    { "routetimesarrival", Enums::RouteTimesArrival },
+    { "routetimesarrivaldelay", Enums::RouteTimesArrivalDelay },
+    { "routetimesdeparture", Enums::RouteTimesDeparture },
+    { "routetimesdeparturedelay", Enums::RouteTimesDepartureDelay },
+    { "routetransportlines", Enums::RouteTransportLines },
+    { "routetypesofvehicles", Enums::RouteTypesOfVehicles },
+    { "startstopid", Enums::StartStopID },
+    { "startstopname", Enums::StartStopName },
+    { "status", Enums::Status },
+    { "stopcity", Enums::StopCity },
+    { "stopcountrycode", Enums::StopCountryCode },
+    { "stopid", Enums::StopID },
+    { "stoplatitude", Enums::StopLatitude },
+    { "stoplongitude", Enums::StopLongitude },
+    { "stopname", Enums::StopName },
+    { "stopweight", Enums::StopWeight },
+    { "target", Enums::Target },
+    { "targetshortened", Enums::TargetShortened },
+    { "targetstopid", Enums::TargetStopID },
+    { "targetstopname", Enums::TargetStopName },
+    { "transportline", Enums::TransportLine },
+    { "typeofvehicle", Enums::TypeOfVehicle },
+    { "typesofvehicleinjourney", Enums::TypesOfVehicleInJourney },
+};
+static const int TIMETABLE_INFORMATION_NAME_COUNT =
+        sizeof(TIMETABLE_INFORMATION_NAMES) / sizeof(NameEntry);
+
+// Names of all valid Enums::VehicleType values, sorted by name for findName()
+static const NameEntry VEHICLE_TYPE_NAMES[] = {
+    { "bus", Enums::Bus },
+    { "feet", Enums::Feet },
+    { "ferry", Enums::Ferry },
+    { "footway", Enums::Footway },
+    { "highspeedtrain", Enums::HighSpeedTrain },
+    { "intercitytrain", Enums::IntercityTrain },
+    { "interregionaltrain", Enums::InterregionalTrain },
+    { "interurbantrain", Enums::InterurbanTrain },
+    { "metro", Enums::Metro },
+    { "plane", Enums::Plane },
+    { "regionalexpresstrain", Enums::RegionalExpressTrain },
+    { "regionaltrain", Enums::RegionalTrain },
+    { "ship", Enums::Ship },
+    { "spacecraft", Enums::Spacecraft },
+    { "subway", Enums::Subway },
+    { "tram", Enums::Tram },
+    { "trolleybus", Enums::TrolleyBus },
+    { "unknownvehicletype", Enums::UnknownVehicleType },
+};
+static const int VEHICLE_TYPE_NAME_COUNT = sizeof(VEHICLE_TYPE_NAMES) / sizeof(NameEntry);
+
+// Compares @p string case insensitively with the lower case latin1 string @p lowerCaseName,
+// without creating a lower case copy of @p string
+static inline int compareLowerCase( const QString &string, const char *lowerCaseName )
+{
+    const QChar *c = string.constData();
+    const QChar *end = c + string.length();
+    for ( ; c < end && *lowerCaseName; ++c, ++lowerCaseName ) {
+        const ushort lower = c->toLower().unicode();
+        const uchar expected = static_cast< uchar >( *lowerCaseName );
+        if ( lower != expected ) {
+            return lower < expected ? -1 : 1;
+        }
+    }
+    return c < end ? 1 : (*lowerCaseName ? -1 : 0);
+}
+
+// Binary search for @p name in the sorted @p entries, returns 0 if @p name was not found
+static const NameEntry *findName( const NameEntry *entries, int count, const QString &name )
+{
+    int first = 0;
+    int last = count - 1;
+    while ( first <= last ) {
+        const int middle = (first + last) / 2;
+        const int comparison = compareLowerCase( name, entries[middle].name );
+        if ( comparison == 0 ) {
+            return &entries[middle];
+        } else if ( comparison < 0 ) {
+            last = middle - 1;
+        } else {
+            first = middle + 1;
+        }
+    }
+    return 0;
+}
 
 Enums::VehicleType Global::vehicleTypeFromString( QString sVehicleType )
 {
-    return Enums::stringToVehicleType( sVehicleType.toAscii().data() );
+    const NameEntry *entry = findName( VEHICLE_TYPE_NAMES, VEHICLE_TYPE_NAME_COUNT, sVehicleType );
+    return entry ? static_cast< Enums::VehicleType >( entry->value ) : Enums::InvalidVehicleType;
 }
 
 QString Global::vehicleTypeToString( const Enums::VehicleType& vehicleType, bool plural )
@@ -132,120 +261,18 @@ QString Global::vehicleTypeToIcon( const Enums::VehicleType& vehicleType )
 Enums::TimetableInformation Global::timetableInformationFromString(
         const QString& sTimetableInformation )
 {
-    const QString sInfo = sTimetableInformation.toLower();
-    if ( sInfo == QLatin1String("nothing") ) {
-        return Enums::Nothing;
-    } else if ( sInfo == QLatin1String("departuredatetime") ) {
-        return Enums::DepartureDateTime;
-    } else if ( sInfo == QLatin1String("departuredate") ) {
-        return Enums::DepartureDate;
-    } else if ( sInfo == QLatin1String("departuretime") ) {
-        return Enums::DepartureTime;
-    } else if ( sInfo == QLatin1String("typeofvehicle") ) {
-        return Enums::TypeOfVehicle;
-    } else if ( sInfo == QLatin1String("transportline") ) {
-        return Enums::TransportLine;
-    } else if ( sInfo == QLatin1String("flightnumber") ) {
-        return Enums::FlightNumber;
-    } else if ( sInfo == QLatin1String("target") ) {
-        return Enums::Target;
-    } else if ( sInfo == QLatin1String("targetshortened") ) {
-        return Enums::TargetShortened;
-    } else if ( sInfo == QLatin1String("platform") ) {
-        return Enums::Platform;
-    } else if ( sInfo == QLatin1String("delay") ) {
-        return Enums::Delay;
-    } else if ( sInfo == QLatin1String("delayreason") ) {
-        return Enums::DelayReason;
-    } else if ( sInfo == QLatin1String("journeynews") ) {
-        return Enums::JourneyNews;
-    } else if ( sInfo == QLatin1String("journeynewsother") ) { // DEPRECATED
-        kWarning() << "JourneyNewsOther is deprecated, use JourneyNews instead";
-        return Enums::JourneyNewsOther;
-    } else if ( sInfo == QLatin1String("journeynewslink") ) { // DEPRECATED
-        kWarning() << "JourneyNewsLink is deprecated, use JourneyNewsUrl instead";
-        return Enums::JourneyNewsUrl;
-    } else if ( sInfo == QLatin1String("journeynewsurl") ) {
-        return Enums::JourneyNewsUrl;
-    } else if ( sInfo == QLatin1String("status") ) {
-        return Enums::Status;
-    } else if ( sInfo == QLatin1String("routestops") ) {
-        return Enums::RouteStops;
-    } else if ( sInfo == QLatin1String("routestopsshortened") ) {
-        return Enums::RouteStopsShortened;
-    } else if ( sInfo == QLatin1String("routetimes") ) {
-        return Enums::RouteTimes;
-    } else if ( sInfo == QLatin1String("routetimesdeparture") ) {
-        return Enums::RouteTimesDeparture;
-    } else if ( sInfo == QLatin1String("routetimesarrival") ) {
-        return Enums::RouteTimesArrival;
-    } else if ( sInfo == QLatin1String("routeexactstops") ) {
-        return Enums::RouteExactStops;
-    } else if ( sInfo == QLatin1String("routetypesofvehicles") ) {
-        return Enums::RouteTypesOfVehicles;
-    } else if ( sInfo == QLatin1String("routetransportlines") ) {
-        return Enums::RouteTransportLines;
-    } else if ( sInfo == QLatin1String("routeplatformsdeparture") ) {
-        return Enums::RoutePlatformsDeparture;
-    } else if ( sInfo == QLatin1String("routeplatformsarrival") ) {
-        return Enums::RoutePlatformsArrival;
-    } else if ( sInfo == QLatin1String("routetimesdeparturedelay") ) {
-        return Enums::RouteTimesDepartureDelay;
-    } else if ( sInfo == QLatin1String("routetimesarrivaldelay") ) {
-        return Enums::RouteTimesArrivalDelay;
-    } else if ( sInfo == QLatin1String("routenews") ) {
-        return Enums::RouteNews;
-    } else if ( sInfo == QLatin1String("routesubjourneys") ) {
-        return Enums::RouteSubJourneys;
-    } else if ( sInfo == QLatin1String("routedataurl") ) {
-        return Enums::RouteDataUrl;
-    } else if ( sInfo == QLatin1String("operator") ) {
-        return Enums::Operator;
-    } else if ( sInfo == QLatin1String("duration") ) {
-        return Enums::Duration;
-    } else if ( sInfo == QLatin1String("startstopname") ) {
-        return Enums::StartStopName;
-    } else if ( sInfo == QLatin1String("startstopid") ) {
-        return Enums::StartStopID;
-    } else if ( sInfo == QLatin1String("targetstopname") ) {
-        return Enums::TargetStopName;
-    } else if ( sInfo == QLatin1String("targetstopid") ) {
-        return Enums::TargetStopID;
-    } else if ( sInfo == QLatin1String("arrivaldatetime") ) {
-        return Enums::ArrivalDateTime;
-    } else if ( sInfo == QLatin1String("arrivaldate") ) {
-        return Enums::ArrivalDate;
-    } else if ( sInfo == QLatin1String("arrivaltime") ) {
-        return Enums::ArrivalTime;
-    } else if ( sInfo == QLatin1String("changes") ) {
-        return Enums::Changes;
-    } else if ( sInfo == QLatin1String("typesofvehicleinjourney") ) {
-        return Enums::TypesOfVehicleInJourney;
-    } else if ( sInfo == QLatin1String("pricing") ) {
-        return Enums::Pricing;
-    } else if ( sInfo == QLatin1String("isnightline") ) {
-        return Enums::IsNightLine;
-    } else if ( sInfo == QLatin1String("stopname") ) {
-        return Enums::StopName;
-    } else if ( sInfo == QLatin1String("stopid") ) {
-        return Enums::StopID;
-    } else if ( sInfo == QLatin1String("stopweight") ) {
-        return Enums::StopWeight;
-    } else if ( sInfo == QLatin1String("stopcity") ) {
-        return Enums::StopCity;
-    } else if ( sInfo == QLatin1String("stopcountrycode") ) {
-        return Enums::StopCountryCode;
-    } else if ( sInfo == QLatin1String("stoplongitude") ) {
-        return Enums::StopLongitude;
-    } else if ( sInfo == QLatin1String("stoplatitude") ) {
-        return Enums::StopLatitude;
-    } else if ( sInfo == QLatin1String("requestdata") ) {
-        return Enums::RequestData;
-    } else {
+    const NameEntry *entry = findName( TIMETABLE_INFORMATION_NAMES,
+            TIMETABLE_INFORMATION_NAME_COUNT, sTimetableInformation );
+    if ( !entry ) {
         kDebug() << sTimetableInformation
                  << "is an unknown timetable information value! Assuming value Nothing.";
         return Enums::Nothing;
+    } else if ( entry->value == Enums::JourneyNewsOther ) { // DEPRECATED
+        kWarning() << "JourneyNewsOther is deprecated, use JourneyNews instead";
+    } else if ( qstrcmp(entry->name, "journeynewslink") == 0 ) { // DEPRECATED
+        kWarning() << "JourneyNewsLink is deprecated, use JourneyNewsUrl instead";
     }
+    return static_cast< Enums::TimetableInformation >( entry->value );
 }
 
 QString Global::timetableInformationToString( Enums::TimetableInformation timetableInformation )
@@ -339,13 +366,19 @@ QString Global::decodeHtmlEntities( const QString& html )
         return html;
     }
 
+    // Replace entities with a charcode, eg. "&#100;", in a single pass without a QRegExp
     QString ret = html;
-    QRegExp rx( "(?:&#)([0-9]+)(?:;)" );
-    rx.setMinimal( true );
     int pos = 0;
-    while ( (pos = rx.indexIn(ret, pos)) != -1 ) {
-        const int charCode = rx.cap( 1 ).toInt();
-        ret.replace( QString("&#%1;").arg(charCode), QChar(charCode) );
+    while ( (pos = ret.indexOf(QLatin1String("&#"), pos)) != -1 ) {
+        int end = pos + 2;
+        while ( end < ret.length() && ret[end] >= QLatin1Char('0') && ret[end] <= QLatin1Char('9') ) {
+            ++end;
+        }
+        if ( end > pos + 2 && end < ret.length() && ret[end] == QLatin1Char(';') ) {
+            const int charCode = ret.mid( pos + 2, end - pos - 2 ).toInt();
+            ret.replace( pos, end - pos + 1, QChar(charCode) );
+        }
+        ++pos;
     }
 
     return ret.replace( QLatin1String("&nbsp;"), QLatin1String(" ") )
@@ -437,3 +470,11 @@ QString Global::decode( const QByteArray &document, const QByteArray &charset )
         return QString::fromUtf8( document );
     }
 }
+
+quint64 Global::departureIdentity( const QDateTime &dateTime, Enums::VehicleType vehicleType,
+                                   const QString &transportLine, const QString &target,
+                                   bool isArrival )
+{
+    return PublicTransport::IdentityHash::departureIdentity( dateTime,
+            static_cast<int>(vehicleType), transportLine, target, isArrival );
+}
@@ -26,6 +26,8 @@
 // Qt includes
 #include <QString>
 
+class QDateTime;
+
 class Global {
 public:
     enum HtmlEntityEncodeFlag {
@@ -45,7 +47,11 @@ public:
 
     Global() {};
 
-    /** @brief Gets the VehicleType enumerable for the given string (case sensitive). */
+    /**
+     * @brief Gets the VehicleType enumerable for the given string (case insensitive).
+     * Uses a binary search in a sorted table of names. If no VehicleType matches
+     * @p sVehicleType InvalidVehicleType is returned.
+     **/
     static Enums::VehicleType vehicleTypeFromString( QString sVehicleType );
 
     /** Gets the name of the given type of vehicle. */
@@ -55,7 +61,8 @@ public:
     static QString vehicleTypeToIcon( const Enums::VehicleType &vehicleType );
 
     /**
-     * @brief Gets the TimetableInformation enumerable for the given string.
+     * @brief Gets the TimetableInformation enumerable for the given string (case insensitive).
+     * Uses a binary search in a sorted table of names, without creating temporary strings.
      * If no TimetableInformation matches @p sTimetableInformation Nothing is returned.
      **/
     static Enums::TimetableInformation timetableInformationFromString(
@@ -84,6 +91,21 @@ public:
 
     /** @brief Decode @p document using @p charset. */
     static QString decode( const QByteArray& document, const QByteArray& charset = QByteArray() );
+
+    /**
+     * @brief Gets a stable 64 bit identity for a departure/arrival.
+     *
+     * The seconds since epoch of @p dateTime, @p vehicleType, the arrival flag and
+     * @p transportLine and @p target (without surrounding whitespace and lower cased) get
+     * streamed into a 64 bit FNV-1a hash, without building any intermediate strings.
+     * Departures that only differ in eg. their delay get the same identity.
+     *
+     * @note PublicTransport::Global::departureIdentity() of the publictransporthelper library
+     *   uses the same header only implementation, ie. applets get the same identities.
+     **/
+    static quint64 departureIdentity( const QDateTime &dateTime, Enums::VehicleType vehicleType,
+                                      const QString &transportLine, const QString &target,
+                                      bool isArrival = false );
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS( Global::HtmlEntityEncodeFlags )
 
@@ -741,11 +741,9 @@ void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *r
         // Create new departure information object and add it to the departure list.
         // Do not use any corrections in the DepartureInfo constructor, because all values
         // from the database are already in the correct format
-        departures << DepartureInfoPtr( new DepartureInfo(data, PublicTransportInfo::NoCorrection) );
+        departures << DepartureInfo( data, PublicTransportInfo::NoCorrection );
     }
 
-    // TODO Do not use a list of pointers here, maybe use data sharing for PublicTransportInfo/StopInfo?
-    // The objects in departures are deleted in a connected slot in the data engine...
     const ArrivalRequest *arrivalRequest = dynamic_cast< const ArrivalRequest* >( request );
     if ( arrivalRequest ) {
         emit arrivalsReceived( this, QUrl(), departures, GlobalTimetableInfo(), *arrivalRequest );
@@ -837,8 +835,7 @@ StopInfoList ServiceProviderGtfs::stopsFromQuery( QSqlQuery *query,
             }
         }
 
-        stops << StopInfoPtr( new StopInfo(stopName, id, weight,
-                                           longitude, latitude, request->city()) );
+        stops << StopInfo( stopName, id, weight, longitude, latitude, request->city() );
     }
 
     if ( stops.isEmpty() ) {
@@ -29,9 +29,11 @@
 #include "request.h"
 #include "timetableservice.h"
 #include "datasource.h"
+#include "updatescheduler.h"
 
 #ifdef BUILD_PROVIDER_TYPE_SCRIPT
     #include "script/serviceproviderscript.h"
+    #include "script/scriptexecutor.h"
 #endif
 #ifdef BUILD_PROVIDER_TYPE_GTFS
     #include "gtfs/serviceprovidergtfs.h"
@@ -50,6 +52,8 @@
 
 const int PublicTransportEngine::DEFAULT_TIME_OFFSET = 0;
 const int PublicTransportEngine::PROVIDER_CLEANUP_TIMEOUT = 10000; // 10 seconds
+const int PublicTransportEngine::SOURCE_KEY_CACHE_SIZE = 250;
+const int PublicTransportEngine::ADDITIONAL_DATA_PUBLISH_INTERVAL = 500;
 
 Plasma::Service* PublicTransportEngine::serviceForSource( const QString &name )
 {
@@ -67,8 +71,7 @@ Plasma::Service* PublicTransportEngine::serviceForSource( const QString &name )
     // If the name of a data requesting source is given, return the timetable service
     const SourceType type = sourceTypeFromName( name );
     if ( isDataRequestingSourceType(type) ) {
-        const QString nonAmbiguousName = disambiguateSourceName( name );
-        if ( m_dataSources.contains(nonAmbiguousName) ) {
+        if ( m_dataSources.contains(sourceKey(name)) ) {
             // Data source exists
             TimetableService *service = new TimetableService( this, name, this );
             service->setDestination( name );
@@ -122,8 +125,8 @@ void PublicTransportEngine::publishData( DataSource *dataSource,
 
 ProvidersDataSource *PublicTransportEngine::providersDataSource() const
 {
-    const QString name = sourceTypeKeyword( ServiceProvidersSource );
-    ProvidersDataSource *dataSource = dynamic_cast< ProvidersDataSource* >( m_dataSources[name] );
+    ProvidersDataSource *dataSource = dynamic_cast< ProvidersDataSource* >(
+            m_dataSources.value(SourceKey(ServiceProvidersSource)) );
     Q_ASSERT_X( dataSource, "PublicTransportEngine::providersDataSource()",
                 "ProvidersDataSource is not available in m_dataSources!" );
     return dataSource;
@@ -245,7 +248,8 @@ void PublicTransportEngine::gtfsImportJobPercent( KJob *job, ulong percent )
 
 PublicTransportEngine::PublicTransportEngine( QObject* parent, const QVariantList& args )
         : Plasma::DataEngine( parent, args ),
-        m_fileSystemWatcher(0), m_providerUpdateDelayTimer(0), m_cleanupTimer(0)
+        m_fileSystemWatcher(0), m_providerUpdateDelayTimer(0), m_cleanupTimer(0),
+        m_updateScheduler(new UpdateScheduler(this)), m_sourceKeyCache(SOURCE_KEY_CACHE_SIZE)
 {
     // We ignore any arguments - data engines do not have much use for them
     Q_UNUSED( args )
@@ -262,15 +266,24 @@ PublicTransportEngine::PublicTransportEngine( QObject* parent, const QVariantLis
     // Get notified when data sources are no longer used
     connect( this, SIGNAL(sourceRemoved(QString)), this, SLOT(slotSourceRemoved(QString)) );
 
+    // Get notified when automatic updates of timetable data sources are due
+    connect( m_updateScheduler, SIGNAL(updatesDue(QString,QStringList)),
+             this, SLOT(scheduledUpdatesDue(QString,QStringList)) );
+    connect( m_updateScheduler, SIGNAL(diagnosticsChanged()),
+             this, SLOT(updateSchedulerDiagnosticsChanged()) );
+
     // Get notified when the network state changes to update data sources,
     // which update timers were missed because of missing network connection
     QDBusConnection::sessionBus().connect( "org.kde.kded", "/modules/networkstatus",
                                            "org.kde.Solid.Networking.Client", "statusChanged",
                                            this, SLOT(networkStateChanged(uint)) );
 
+    // Read the provider index to not need to read all provider plugin files
+    m_providerIndex.load();
+
     // Create "ServiceProviders" and "ServiceProvider [providerId]" data source object
     const QString name = sourceTypeKeyword( ServiceProvidersSource );
-    m_dataSources.insert( name, new ProvidersDataSource(name) );
+    m_dataSources.insert( SourceKey(ServiceProvidersSource), new ProvidersDataSource(name) );
     updateServiceProviderSource();
 
     // Ensure the local provider installation directory exists in the users HOME and will not
@@ -319,7 +332,8 @@ QStringList PublicTransportEngine::sources() const
     sources << sourceTypeKeyword(LocationsSource)
             << sourceTypeKeyword(ServiceProvidersSource)
             << sourceTypeKeyword(ErroneousServiceProvidersSource)
-            << sourceTypeKeyword(VehicleTypesSource);
+            << sourceTypeKeyword(VehicleTypesSource)
+            << sourceTypeKeyword(UpdateSchedulerSource);
     sources.removeDuplicates();
     return sources;
 }
@@ -332,7 +346,7 @@ void PublicTransportEngine::networkStateChanged( uint state )
     }
 
     // Network is connected again, check for missed update timers in connected data sources
-    for ( QHash<QString, DataSource*>::ConstIterator it = m_dataSources.constBegin();
+    for ( QHash<SourceKey, DataSource*>::ConstIterator it = m_dataSources.constBegin();
           it != m_dataSources.constEnd(); ++it )
     {
         // Check if the current data source is a timetable data source, without running update
@@ -349,11 +363,11 @@ void PublicTransportEngine::networkStateChanged( uint state )
             // This happens if there was no network connection while an automatic update
             // was triggered. If the system is suspended the QTimer's for automatic updates
             // are not triggered at all.
-            // Do now manually request updates for all connected sources, ie. do what should
-            // have been done in updateTimeout().
-            foreach ( const QString &sourceName, dataSource->usingDataSources() ) {
-                updateTimetableDataSource( SourceRequestData(sourceName) );
-            }
+            // Replace the pending automatic update with one that is due now, the scheduler
+            // then updates all connected sources in scheduledUpdatesDue() in the request
+            // budget of the provider and without fetching twice.
+            m_updateScheduler->schedule( it.key().toString(), dataSource->providerId(),
+                                         QDateTime::currentDateTime() );
         }
     }
 }
@@ -361,14 +375,14 @@ void PublicTransportEngine::networkStateChanged( uint state )
 bool PublicTransportEngine::isProviderUsed( const QString &providerId )
 {
     // Check if a request is currently running for the provider
-    foreach ( const QString &runningSource, m_runningSources ) {
-        if ( runningSource.contains(providerId) ) {
+    foreach ( const SourceKey &runningSource, m_runningSources ) {
+        if ( runningSource.providerId() == providerId ) {
             return true;
         }
     }
 
     // Check if a data source is connected that uses the provider
-    for ( QHash< QString, DataSource* >::ConstIterator it = m_dataSources.constBegin();
+    for ( QHash< SourceKey, DataSource* >::ConstIterator it = m_dataSources.constBegin();
           it != m_dataSources.constEnd(); ++it )
     {
         Q_ASSERT( *it );
@@ -384,12 +398,12 @@ bool PublicTransportEngine::isProviderUsed( const QString &providerId )
 
 void PublicTransportEngine::slotSourceRemoved( const QString &sourceName )
 {
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    if ( m_dataSources.contains(nonAmbiguousName) ) {
+    const SourceKey key = sourceKey( sourceName );
+    if ( m_dataSources.contains(key) ) {
         // If this is a timetable data source, which might be associated with multiple
         // ambiguous source names, check if this data source is still connected under other names
         TimetableDataSource *timetableDataSource =
-                dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+                dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
         if ( timetableDataSource ) {
             timetableDataSource->removeUsingDataSource( sourceName );
             if ( timetableDataSource->usageCount() > 0 ) {
@@ -398,14 +412,17 @@ void PublicTransportEngine::slotSourceRemoved( const QString &sourceName )
             }
         }
 
-        if ( sourceName == sourceTypeKeyword(ServiceProvidersSource) ) {
+        if ( key.type() == ServiceProvidersSource ) {
             // Do not remove ServiceProviders data source
             return;
         }
 
+        // Automatic updates are no longer needed
+        m_updateScheduler->unschedule( key.toString() );
+
         // If a provider was used by the source,
         // remove the provider if it is not used by another source
-        const DataSource *dataSource = m_dataSources.take( nonAmbiguousName );
+        const DataSource *dataSource = m_dataSources.take( key );
         Q_ASSERT( dataSource );
         if ( dataSource->data().contains("serviceProvider") ) {
             const QString providerId = dataSource->value("serviceProvider").toString();
@@ -420,12 +437,11 @@ void PublicTransportEngine::slotSourceRemoved( const QString &sourceName )
 
         // The data source is no longer used, delete it
         delete dataSource;
-    } else if ( nonAmbiguousName.startsWith(sourceTypeKeyword(ServiceProviderSource)) ) {
+    } else if ( key.type() == ServiceProviderSource ) {
         // A "ServiceProvider xx_xx" data source was removed, data for these sources
         // is stored in the "ServiceProviders" data source object in m_dataSources.
         // Remove not installed providers also from the "ServiceProviders" data source.
-        const QString providerId = nonAmbiguousName.mid(
-                QString(sourceTypeKeyword(ServiceProviderSource)).length() + 1 );
+        const QString providerId = key.providerId();
         if ( !providerId.isEmpty() && !isProviderUsed(providerId) ) {
             // Test if the provider is installed
             const QStringList providerPaths = ServiceProviderGlobal::installedProviders();
@@ -578,52 +594,45 @@ QVariantHash PublicTransportEngine::serviceProviderData( const ServiceProviderDa
 QVariantHash PublicTransportEngine::locations()
 {
     QVariantHash ret;
-    const QStringList providers = ServiceProviderGlobal::installedProviders();
 
-    // Update ServiceProviders source to fill m_erroneousProviders
+    // Update ServiceProviders source to fill m_erroneousProviders and the provider index
     updateServiceProviderSource();
 
-    foreach( const QString &provider, providers ) {
-        if ( QFileInfo(provider).isSymLink() ) {
-            // Service provider XML file is a symlink for a default service provider, skip it
+    foreach( const ServiceProviderIndex::Entry &entry, m_providerIndex.entries() ) {
+        if ( entry.location.isEmpty() ) {
+            // No location code in the file name or the provider file is a symlink
+            // for a default service provider, skip it
             continue;
         }
 
-        const QString providerFileName = QFileInfo( provider ).fileName();
-        const QString providerId = ServiceProviderGlobal::idFromFileName( providerFileName );
-        if ( m_erroneousProviders.contains(providerId) ) {
+        if ( m_erroneousProviders.contains(entry.id) ) {
             // Service provider is erroneous
             continue;
         }
 
-        const int pos = providerFileName.indexOf('_');
-        if ( pos > 0 ) {
-            // Found an underscore (not the first character)
-            // Cut location code from the service providers XML filename
-            const QString location = providerFileName.mid( 0, pos ).toLower();
-            if ( !ret.contains(location) ) {
-                // Location is not already added to [ret]
-                // Get the filename of the default provider for the current location
-                const QString defaultProviderFileName =
-                        ServiceProviderGlobal::defaultProviderForLocation( location );
-
-                // Extract service provider ID from the filename
-                const QString defaultProviderId =
-                        ServiceProviderGlobal::idFromFileName( defaultProviderFileName );
-
-                // Store location values in a hash and insert it into [ret]
-                QVariantHash locationHash;
-                locationHash.insert( "name", location );
-                if ( location == "international" ) {
-                    locationHash.insert( "description", i18n("International providers. "
-                                         "There is one for getting flight departures/arrivals.") );
-                } else {
-                    locationHash.insert( "description", i18n("Service providers for %1.",
-                            KGlobal::locale()->countryCodeToName(location)) );
-                }
-                locationHash.insert( "defaultProvider", defaultProviderId );
-                ret.insert( location, locationHash );
+        const QString &location = entry.location;
+        if ( !ret.contains(location) ) {
+            // Location is not already added to [ret]
+            // Get the filename of the default provider for the current location
+            const QString defaultProviderFileName =
+                    ServiceProviderGlobal::defaultProviderForLocation( location );
+
+            // Extract service provider ID from the filename
+            const QString defaultProviderId =
+                    ServiceProviderGlobal::idFromFileName( defaultProviderFileName );
+
+            // Store location values in a hash and insert it into [ret]
+            QVariantHash locationHash;
+            locationHash.insert( "name", location );
+            if ( location == "international" ) {
+                locationHash.insert( "description", i18n("International providers. "
+                                     "There is one for getting flight departures/arrivals.") );
+            } else {
+                locationHash.insert( "description", i18n("Service providers for %1.",
+                        KGlobal::locale()->countryCodeToName(location)) );
             }
+            locationHash.insert( "defaultProvider", defaultProviderId );
+            ret.insert( location, locationHash );
         }
     }
 
@@ -674,12 +683,12 @@ PublicTransportEngine::ProviderPointer PublicTransportEngine::providerFromId(
         }
 
         // Connect provider, when it was created successfully
-        connect( provider, SIGNAL(departuresReceived(ServiceProvider*,QUrl,DepartureInfoList,GlobalTimetableInfo,DepartureRequest)),
-                 this, SLOT(departuresReceived(ServiceProvider*,QUrl,DepartureInfoList,GlobalTimetableInfo,DepartureRequest)) );
-        connect( provider, SIGNAL(arrivalsReceived(ServiceProvider*,QUrl,ArrivalInfoList,GlobalTimetableInfo,ArrivalRequest)),
-                 this, SLOT(arrivalsReceived(ServiceProvider*,QUrl,ArrivalInfoList,GlobalTimetableInfo,ArrivalRequest)) );
-        connect( provider, SIGNAL(journeysReceived(ServiceProvider*,QUrl,JourneyInfoList,GlobalTimetableInfo,JourneyRequest)),
-                 this, SLOT(journeysReceived(ServiceProvider*,QUrl,JourneyInfoList,GlobalTimetableInfo,JourneyRequest)) );
+        connect( provider, SIGNAL(departuresReceived(ServiceProvider*,QUrl,DepartureInfoList,GlobalTimetableInfo,DepartureRequest,int,bool)),
+                 this, SLOT(departuresReceived(ServiceProvider*,QUrl,DepartureInfoList,GlobalTimetableInfo,DepartureRequest,int,bool)) );
+        connect( provider, SIGNAL(arrivalsReceived(ServiceProvider*,QUrl,ArrivalInfoList,GlobalTimetableInfo,ArrivalRequest,int,bool)),
+                 this, SLOT(arrivalsReceived(ServiceProvider*,QUrl,ArrivalInfoList,GlobalTimetableInfo,ArrivalRequest,int,bool)) );
+        connect( provider, SIGNAL(journeysReceived(ServiceProvider*,QUrl,JourneyInfoList,GlobalTimetableInfo,JourneyRequest,int,bool)),
+                 this, SLOT(journeysReceived(ServiceProvider*,QUrl,JourneyInfoList,GlobalTimetableInfo,JourneyRequest,int,bool)) );
         connect( provider, SIGNAL(stopsReceived(ServiceProvider*,QUrl,StopInfoList,StopSuggestionRequest)),
                  this, SLOT(stopsReceived(ServiceProvider*,QUrl,StopInfoList,StopSuggestionRequest)) );
         connect( provider, SIGNAL(additionalDataReceived(ServiceProvider*,QUrl,TimetableData,AdditionalDataRequest)),
@@ -687,6 +696,9 @@ PublicTransportEngine::ProviderPointer PublicTransportEngine::providerFromId(
         connect( provider, SIGNAL(requestFailed(ServiceProvider*,ErrorCode,QString,QUrl,const AbstractRequest*)),
                  this, SLOT(requestFailed(ServiceProvider*,ErrorCode,QString,QUrl,const AbstractRequest*)) );
 
+        // Limit requests to the provider by a budget derived from its minimal fetch wait time
+        m_updateScheduler->setProviderMinFetchWait( id, provider->minFetchWait() );
+
         // Create a ProviderPointer for the created provider and
         // add it to the list of currently used providers
         const ProviderPointer pointer( provider );
@@ -709,7 +721,7 @@ bool PublicTransportEngine::updateServiceProviderForCountrySource( const SourceR
 
         // The defaultParameter stored in data is a location code
         // (ie. "international" or a two letter country code)
-        QVariantHash locations = m_dataSources[ sourceTypeKeyword(LocationsSource) ]->data();
+        QVariantHash locations = m_dataSources[ SourceKey(LocationsSource) ]->data();
         QVariantHash locationCountry = locations[ data.defaultParameter.toLower() ].toHash();
         QString defaultProvider = locationCountry[ "defaultProvider" ].toString();
         if ( defaultProvider.isEmpty() ) {
@@ -730,10 +742,29 @@ bool PublicTransportEngine::updateProviderData( const QString &providerId,
 {
     QVariantHash providerData;
     QString errorMessage;
+    bool isValid;
     ProvidersDataSource *providersSource = providersDataSource();
 
-    // Test if the provider is valid
-    if ( testServiceProvider(providerId, &providerData, &errorMessage, cache) ) {
+    if ( m_providerIndex.contains(providerId) && !m_providers.contains(providerId) &&
+         !m_cachedProviders.contains(providerId) )
+    {
+        // The provider was not modified since it was indexed, use the indexed data and test result
+        const ServiceProviderIndex::Entry entry = m_providerIndex.entry( providerId );
+        providerData = entry.providerData;
+        errorMessage = entry.errorMessage;
+        isValid = entry.isValid;
+        if ( !isValid ) {
+            m_erroneousProviders.insert( providerId, errorMessage );
+            updateErroneousServiceProviderSource();
+        }
+    } else {
+        // Test if the provider is valid and add the result to the index
+        isValid = testServiceProvider( providerId, &providerData, &errorMessage, cache );
+        m_providerIndex.insert( ServiceProviderIndex::createEntry(
+                providerId, providerData, isValid, errorMessage) );
+    }
+
+    if ( isValid ) {
         QVariantHash stateData;
         const QString state = updateProviderState( providerId, &stateData,
                 providerData["type"].toString(), providerData.value("feedUrl").toString() );
@@ -772,6 +803,10 @@ bool PublicTransportEngine::updateServiceProviderSource()
             QStringList loadedProviders;
             m_erroneousProviders.clear();
             QSharedPointer<KConfig> cache = ServiceProviderGlobal::cache();
+
+            // Remove index entries of modified and uninstalled providers,
+            // these get tested and read again in updateProviderData()
+            m_providerIndex.update( providers );
             foreach( const QString &provider, providers ) {
                 const QString providerId =
                         ServiceProviderGlobal::idFromFileName( KUrl(provider).fileName() );
@@ -801,7 +836,10 @@ bool PublicTransportEngine::updateServiceProviderSource()
         }
 
         // Insert the data source
-        m_dataSources.insert( name, providersSource );
+        m_dataSources.insert( SourceKey(ServiceProvidersSource), providersSource );
+
+        // Write updated entries to the provider index
+        m_providerIndex.save();
     }
 
     // Remove all old data, some service providers may have been updated and are now erroneous
@@ -1070,27 +1108,17 @@ bool PublicTransportEngine::updateErroneousServiceProviderSource()
 bool PublicTransportEngine::updateLocationSource()
 {
     const QLatin1String name = sourceTypeKeyword( LocationsSource );
-    if ( m_dataSources.contains(name) ) {
-        setData( name, m_dataSources[name]->data() );
+    const SourceKey key( LocationsSource );
+    if ( m_dataSources.contains(key) ) {
+        setData( name, m_dataSources[key]->data() );
     } else {
         SimpleDataSource *dataSource = new SimpleDataSource( name, locations() );
-        m_dataSources.insert( name, dataSource );
+        m_dataSources.insert( key, dataSource );
         setData( name, dataSource->data() );
     }
     return true;
 }
 
-QString PublicTransportEngine::providerIdFromSourceName( const QString &sourceName )
-{
-    const int pos = sourceName.indexOf( ' ' );
-    if ( pos == -1 ) { //|| pos = sourceName.length() - 1 ) {
-        return QString();
-    }
-
-    const int endPos = sourceName.indexOf( '|', pos + 1 );
-    return fixProviderId( sourceName.mid(pos + 1, endPos - pos - 1).trimmed() );
-}
-
 ParseDocumentMode PublicTransportEngine::parseModeFromSourceType(
         PublicTransportEngine::SourceType type )
 {
@@ -1126,30 +1154,37 @@ bool PublicTransportEngine::enoughDataAvailable( DataSource *dataSource,
 
 bool PublicTransportEngine::updateTimetableDataSource( const SourceRequestData &data )
 {
-    const QString nonAmbiguousName = disambiguateSourceName( data.name );
-    bool containsDataSource = m_dataSources.contains( nonAmbiguousName );
-    if ( containsDataSource && isSourceUpToDate(nonAmbiguousName) &&
-         enoughDataAvailable(m_dataSources[nonAmbiguousName], data) )
+    const SourceKey key = sourceKey( data.name );
+    bool containsDataSource = m_dataSources.contains( key );
+    if ( containsDataSource && isSourceUpToDate(key) &&
+         enoughDataAvailable(m_dataSources[key], data) )
     { // Data is stored in the map and up to date
         TimetableDataSource *dataSource =
-                dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+                dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
         dataSource->addUsingDataSource( QSharedPointer<AbstractRequest>(data.request->clone()),
                                         data.name, data.request->dateTime(), data.request->count() );
         setData( data.name, dataSource->data() );
-    } else if ( m_runningSources.contains(nonAmbiguousName) ) {
-        // Source gets already processed
+    } else if ( m_runningSources.contains(key) ) {
+        // Source gets already processed, eg. for another requester of the same stop suggestions,
+        // publish the results also to this source name
         kDebug() << "Source already gets processed, please wait" << data.name;
+        TimetableDataSource *dataSource = containsDataSource
+                ? dynamic_cast< TimetableDataSource* >( m_dataSources[key] ) : 0;
+        if ( dataSource && data.request ) {
+            dataSource->addUsingDataSource( QSharedPointer<AbstractRequest>(data.request->clone()),
+                    data.name, data.request->dateTime(), data.request->count() );
+        }
     } else if ( data.parseMode == ParseInvalid || !data.request ) {
         kWarning() << "Invalid source" << data.name;
         return false;
     } else { // Request new data
         TimetableDataSource *dataSource = containsDataSource
-                ? dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] )
-                : new TimetableDataSource(nonAmbiguousName);
+                ? dynamic_cast< TimetableDataSource* >( m_dataSources[key] )
+                : new TimetableDataSource(key.toString());
         dataSource->clear();
         dataSource->addUsingDataSource( QSharedPointer<AbstractRequest>(data.request->clone()),
                                         data.name, data.request->dateTime(), data.request->count() );
-        m_dataSources[ nonAmbiguousName ] = dataSource;
+        m_dataSources[ key ] = dataSource;
 
         // Start the request
         request( data );
@@ -1180,7 +1215,8 @@ TimetableDataSource *PublicTransportEngine::testDataSourceForAdditionalDataReque
         const QString &sourceName )
 {
     // Try to get a pointer to the provider with the provider ID from the source name
-    const QString providerId = providerIdFromSourceName( sourceName );
+    const SourceKey key = sourceKey( sourceName );
+    const QString providerId = key.providerId();
     const ProviderPointer provider = providerFromId( providerId );
     if ( provider.isNull() || provider->type() == Enums::InvalidProvider ) {
         emit additionalDataRequestFinished( sourceName, -1, false,
@@ -1197,8 +1233,7 @@ TimetableDataSource *PublicTransportEngine::testDataSourceForAdditionalDataReque
     }
 
     // Test if the source with the given name is cached
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    if ( !m_dataSources.contains(key) ) {
         emit additionalDataRequestFinished( sourceName, -1, false,
                 "Data source to update not found: " + sourceName );
         return 0;
@@ -1206,7 +1241,7 @@ TimetableDataSource *PublicTransportEngine::testDataSourceForAdditionalDataReque
 
     // Get the data list, currently only for departures/arrivals TODO: journeys
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     if ( !dataSource ) {
         emit additionalDataRequestFinished( sourceName, -1, false,
                 "Data source is not a timetable data source: " + sourceName );
@@ -1258,18 +1293,34 @@ bool PublicTransportEngine::requestAdditionalData( const QString &sourceName,
         return false;
     }
 
-    // Store state of additional data in the timetable item
+    // Store state of additional data in the timetable item and count the request before
+    // starting it, the provider may finish or fail the request before it returns
     item["additionalDataState"] = "busy";
     items[ itemNumber ] = item;
     dataSource->setTimetableItems( items );
+    dataSource->additionalDataRequestStarted();
 
     // Found data of the timetable item to update
     const SourceRequestData sourceData( dataSource->name() );
     const ProviderPointer provider = providerFromId( dataSource->providerId() );
     Q_ASSERT( provider );
-    provider->requestAdditionalData( AdditionalDataRequest(dataSource->name(), itemNumber,
+    if ( !provider->requestAdditionalData(AdditionalDataRequest(dataSource->name(), itemNumber,
             sourceData.request->stop(), sourceData.request->stopId(), dateTime, transportLine,
-            target, sourceData.request->city(), routeDataUrl) );
+            target, sourceData.request->city(), routeDataUrl)) )
+    {
+        // The request was not started, undo the count and replace the "busy" state
+        // with an error, which gets published by the caller
+        dataSource->additionalDataRequestFinished();
+        const QString errorMessage = i18nc("@info/plain",
+                                           "The additional data request could not be started.");
+        items = dataSource->timetableItems();
+        item = items[ itemNumber ].toHash();
+        item[ "additionalDataState" ] = "error";
+        item[ "additionalDataError" ] = errorMessage;
+        items[ itemNumber ] = item;
+        dataSource->setTimetableItems( items );
+        emit additionalDataRequestFinished( sourceName, itemNumber, false, errorMessage );
+    }
     return true;
 }
 
@@ -1295,103 +1346,192 @@ QString PublicTransportEngine::fixProviderId( const QString &providerId )
     return defaultProviderId;
 }
 
-QString PublicTransportEngine::disambiguateSourceName( const QString &sourceName )
-{
-    // Remove count argument
-    QString ret = sourceName;
-    ret.remove( QRegExp("(count=[^\\|]+)") );
-
-    // Round time parameter values to 15 minutes precision
-    QRegExp rx( "(time=[^\\|]+|datetime=[^\\|]+)" );
-    if ( rx.indexIn(ret) != -1 ) {
-        // Get the time value
-        const QString timeParameter = rx.cap( 1 );
-        QDateTime time;
-        if ( timeParameter.startsWith(QLatin1String("time=")) ) {
-            time = QDateTime( QDate::currentDate(),
-                              QTime::fromString(timeParameter.mid(5), "hh:mm") );
-        } else { // startsWith "datetime="
-            time = QDateTime::fromString( timeParameter.mid(9), Qt::ISODate );
-            if ( !time.isValid() ) {
-                time = QDateTime::fromString( timeParameter.mid(9) );
+PublicTransportEngine::SourceKey::SourceKey( SourceType type, const QString &providerId )
+        : m_type(type), m_providerId(providerId)
+{
+    updateHash();
+}
+
+PublicTransportEngine::SourceKey PublicTransportEngine::SourceKey::parse(
+        const QString &sourceName )
+{
+    // Names of parameters stored in keys, ordered like the Parameter enumerables.
+    // Values of parameters with caseInsensitive set to true get converted to lower case
+    static const struct {
+        const char *name;
+        bool caseInsensitive;
+    } parameterInfos[ ParameterCount ] = {
+        { "city", true },
+        { "stop", true },
+        { "stopid", false },
+        { "originstop", true },
+        { "originstopid", false },
+        { "targetstop", true },
+        { "targetstopid", false },
+        { "timeoffset", false },
+        { "datetime", false },
+        { "longitude", false },
+        { "latitude", false }
+    };
+
+    SourceKey key( sourceTypeFromName(sourceName) );
+    if ( !key.isValid() ) {
+        return key;
+    }
+
+    // Read parameters delimited with '|' following the source type keyword,
+    // only the first "time" or "datetime" parameter gets used
+    const QChar *data = sourceName.constData();
+    const int length = sourceName.length();
+    int pos = qstrlen( sourceTypeKeyword(key.m_type).latin1() );
+    bool timeParameterFound = false;
+    while ( pos < length ) {
+        // Find the end of the current parameter and the position of the first '='
+        int end = pos;
+        int assignmentPos = -1;
+        while ( end < length && data[end] != '|' ) {
+            if ( assignmentPos == -1 && data[end] == '=' ) {
+                assignmentPos = end;
             }
+            ++end;
         }
 
-        // Round 15 minutes
-        qint64 msecs = time.toMSecsSinceEpoch();
-        time = QDateTime::fromMSecsSinceEpoch( msecs - msecs % (1000 * 60 * 15) );
-
-        // Replace old time parameter with a new one
-        ret.replace( rx.pos(), rx.matchedLength(),
-                     QLatin1String("datetime=") + time.toString(Qt::ISODate) );
-    }
+        // Trim the parameter
+        int start = pos;
+        int stop = end;
+        pos = end + 1;
+        while ( start < stop && data[start].isSpace() ) {
+            ++start;
+        }
+        while ( stop > start && data[stop - 1].isSpace() ) {
+            --stop;
+        }
+        if ( start == stop ) {
+            continue;
+        }
 
-    // Read parameters to reorder them afterwards
-    const SourceType type = sourceTypeFromName( ret );
-    const QString typeKeyword = sourceTypeKeyword( type );
-    const QStringList parameterPairs = ret.mid( typeKeyword.length() )
-            .trimmed().split( '|', QString::SkipEmptyParts );
-    QString defaultParameter;
-    QHash< QString, QString > parameters;
-    for ( int i = 0; i < parameterPairs.length(); ++i ) {
-        const QString parameter = parameterPairs.at( i ).trimmed();
-        const int pos = parameter.indexOf( '=' );
-        if ( pos == -1 ) {
+        if ( assignmentPos == -1 ) {
             // No parameter name given, this is the default parameter, eg. the provider ID
-            defaultParameter = fixProviderId( parameter );
-        } else {
-            // Only add parameters with non-empty parameter name and value,
-            // make parameter value lower case (eg. stop names)
-            const QString parameterName = parameter.left( pos );
-            const QString parameterValue = parameter.mid( pos + 1 ).trimmed();
-            if ( !parameterName.isEmpty() && !parameterValue.isEmpty() ) {
-                parameters[ parameterName ] = parameterValue;
+            key.m_providerId = fixProviderId( sourceName.mid(start, stop - start) );
+            continue;
+        }
+
+        // Only use parameters with non-empty parameter name and value
+        const QStringRef parameterName = sourceName.midRef( start, assignmentPos - start );
+        int valueStart = assignmentPos + 1;
+        while ( valueStart < stop && data[valueStart].isSpace() ) {
+            ++valueStart;
+        }
+        if ( parameterName.isEmpty() || valueStart == stop ) {
+            continue;
+        }
+        const QString parameterValue = sourceName.mid( valueStart, stop - valueStart );
+
+        const bool isTime = parameterName == QLatin1String("time");
+        if ( isTime || parameterName == QLatin1String("datetime") ) {
+            if ( timeParameterFound ) {
+                continue;
+            }
+            timeParameterFound = true;
+
+            // Get the time value
+            QDateTime time;
+            if ( isTime ) {
+                key.m_parseDate = QDate::currentDate();
+                time = QDateTime( key.m_parseDate, QTime::fromString(parameterValue, "hh:mm") );
+            } else {
+                time = QDateTime::fromString( parameterValue, Qt::ISODate );
+                if ( !time.isValid() ) {
+                    time = QDateTime::fromString( parameterValue );
+                }
             }
+
+            // Round 15 minutes
+            const qint64 msecs = time.toMSecsSinceEpoch();
+            time = QDateTime::fromMSecsSinceEpoch( msecs - msecs % (1000 * 60 * 15) );
+            key.m_parameters[ DateTimeParameter ] = time.toString( Qt::ISODate );
+            continue;
         }
-    }
 
-    // Build non-ambiguous source name with standardized parameter order
-    ret = typeKeyword + ' ' + defaultParameter;
-    if ( parameters.contains(QLatin1String("city")) ) {
-        ret += "|city=" + parameters["city"].toLower();
-    }
-    if ( parameters.contains(QLatin1String("stop")) ) {
-        ret += "|stop=" + parameters["stop"].toLower();
-    }
-    if ( parameters.contains(QLatin1String("stopid")) ) {
-        ret += "|stopid=" + parameters["stopid"];
-    }
-    if ( parameters.contains(QLatin1String("originstop")) ) {
-        ret += "|originstop=" + parameters["originstop"].toLower();
-    }
-    if ( parameters.contains(QLatin1String("originstopid")) ) {
-        ret += "|originstopid=" + parameters["originstopid"];
-    }
-    if ( parameters.contains(QLatin1String("targetstop")) ) {
-        ret += "|targetstop=" + parameters["targetstop"].toLower();
+        for ( int i = 0; i < ParameterCount; ++i ) {
+            if ( i != DateTimeParameter &&
+                 parameterName == QLatin1String(parameterInfos[i].name) )
+            {
+                key.m_parameters[ i ] = parameterInfos[i].caseInsensitive
+                        ? parameterValue.toLower() : parameterValue;
+                break;
+            }
+        }
     }
-    if ( parameters.contains(QLatin1String("targetstopid")) ) {
-        ret += "|targetstopid=" + parameters["targetstopid"];
+
+    if ( key.m_providerId.isEmpty() && isDataRequestingSourceType(key.m_type) ) {
+        // No provider ID given, use the default provider for the users country
+        key.m_providerId = fixProviderId( QString() );
     }
-    if ( parameters.contains(QLatin1String("timeoffset")) ) {
-        ret += "|timeoffset=" + parameters["timeoffset"];
+
+    key.updateHash();
+    return key;
+}
+
+QString PublicTransportEngine::SourceKey::toString() const
+{
+    // Names of parameters stored in keys, ordered like the Parameter enumerables
+    static const char *parameterNames[ ParameterCount ] = { "city", "stop", "stopid",
+            "originstop", "originstopid", "targetstop", "targetstopid", "timeoffset",
+            "datetime", "longitude", "latitude" };
+
+    // Build non-ambiguous source name with standardized parameter order
+    QString name = sourceTypeKeyword( m_type );
+    if ( !m_providerId.isEmpty() || isDataRequestingSourceType(m_type) ) {
+        name += ' ' + m_providerId;
     }
-    if ( parameters.contains(QLatin1String("time")) ) {
-        ret += "|time=" + parameters["time"];
+    for ( int i = 0; i < ParameterCount; ++i ) {
+        if ( !m_parameters[i].isEmpty() ) {
+            name.append( '|' ).append( QLatin1String(parameterNames[i]) )
+                .append( '=' ).append( m_parameters[i] );
+        }
     }
-    if ( parameters.contains(QLatin1String("datetime")) ) {
-        ret += "|datetime=" + parameters["datetime"];
+    return name;
+}
+
+bool PublicTransportEngine::SourceKey::operator ==(
+        const PublicTransportEngine::SourceKey &other ) const
+{
+    if ( m_hash != other.m_hash || m_type != other.m_type ||
+         m_providerId != other.m_providerId )
+    {
+        return false;
     }
-    if ( parameters.contains(QLatin1String("count")) ) {
-        ret += "|count=" + parameters["count"];
+    for ( int i = 0; i < ParameterCount; ++i ) {
+        if ( m_parameters[i] != other.m_parameters[i] ) {
+            return false;
+        }
     }
-    if ( parameters.contains(QLatin1String("longitude")) ) {
-        ret += "|longitude=" + parameters["longitude"];
+    return true;
+}
+
+void PublicTransportEngine::SourceKey::updateHash()
+{
+    m_hash = ::qHash( static_cast<int>(m_type) ) ^ ::qHash( m_providerId );
+    for ( int i = 0; i < ParameterCount; ++i ) {
+        m_hash = 31 * m_hash + ::qHash( m_parameters[i] );
     }
-    if ( parameters.contains(QLatin1String("latitude")) ) {
-        ret += "|latitude=" + parameters["latitude"];
+}
+
+PublicTransportEngine::SourceKey PublicTransportEngine::sourceKey(
+        const QString &sourceName ) const
+{
+    const SourceKey *cachedKey = m_sourceKeyCache.object( sourceName );
+    if ( cachedKey && (!cachedKey->dependsOnCurrentDate() ||
+                       cachedKey->parseDate() == QDate::currentDate()) )
+    {
+        return *cachedKey;
     }
-    return ret;
+
+    // Parse the source name and cache the key, replaces outdated keys
+    const SourceKey key = SourceKey::parse( sourceName );
+    m_sourceKeyCache.insert( sourceName, new SourceKey(key) );
+    return key;
 }
 
 void PublicTransportEngine::serviceProviderDirChanged( const QString &path )
@@ -1413,9 +1553,9 @@ void PublicTransportEngine::deleteProvider( const QString &providerId,
                                             bool keepProviderDataSources )
 {
     // Clear all cached data
-    const QStringList cachedSources = m_dataSources.keys();
-    foreach( const QString &cachedSource, cachedSources ) {
-        const QString currentProviderId = providerIdFromSourceName( cachedSource );
+    const QList< SourceKey > cachedSources = m_dataSources.keys();
+    foreach( const SourceKey &cachedSource, cachedSources ) {
+        const QString currentProviderId = cachedSource.providerId();
         if ( currentProviderId == providerId ) {
             // Disconnect provider and abort all running requests,
             // take provider from the provider list without caching it
@@ -1424,7 +1564,7 @@ void PublicTransportEngine::deleteProvider( const QString &providerId,
                 disconnect( provider.data(), 0, this, 0 );
                 provider->abortAllRequests();
             }
-            m_runningSources.removeOne( cachedSource );
+            m_runningSources.remove( cachedSource );
 
             if ( keepProviderDataSources ) {
                 // Update data source for the provider
@@ -1432,7 +1572,7 @@ void PublicTransportEngine::deleteProvider( const QString &providerId,
                         dynamic_cast< TimetableDataSource* >( m_dataSources[cachedSource] );
                 if ( timetableSource ) {
                     // Stop automatic updates
-                    timetableSource->stopUpdateTimer();
+                    m_updateScheduler->unschedule( cachedSource.toString() );
 
                     // Update manually
                     foreach ( const QString &sourceName, timetableSource->usingDataSources() ) {
@@ -1441,6 +1581,7 @@ void PublicTransportEngine::deleteProvider( const QString &providerId,
                 }
             } else {
                 // Delete data source for the provider
+                m_updateScheduler->unschedule( cachedSource.toString() );
                 delete m_dataSources.take( cachedSource );
             }
         }
@@ -1462,13 +1603,26 @@ void PublicTransportEngine::reloadChangedProviders()
     }
 
     // Remove cached locations source to have it updated
-    delete m_dataSources.take( sourceTypeKeyword(LocationsSource) );
+    delete m_dataSources.take( SourceKey(LocationsSource) );
+
+    // Cached source keys may contain the ID of a changed default provider
+    m_sourceKeyCache.clear();
 
-    // Clear all cached data (use the new provider to parse the data again)
-    const QStringList cachedSources = m_dataSources.keys();
     const QSharedPointer< KConfig > cache = ServiceProviderGlobal::cache();
-    foreach( const QString &cachedSource, cachedSources ) {
-        const QString providerId = providerIdFromSourceName( cachedSource );
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    // Remove index entries of providers with modified included script files,
+    // modified provider files get detected in updateServiceProviderSource()
+    foreach ( const QString &providerId, m_providerIndex.providerIds() ) {
+        if ( !ServiceProviderScript::isTestResultUnchanged(providerId, cache) ) {
+            m_providerIndex.remove( providerId );
+        }
+    }
+#endif
+
+    // Clear all cached data (use the new provider to parse the data again)
+    const QList< SourceKey > cachedSources = m_dataSources.keys();
+    foreach( const SourceKey &cachedSource, cachedSources ) {
+        const QString providerId = cachedSource.providerId();
         if ( !providerId.isEmpty() &&
              (ServiceProviderGlobal::isSourceFileModified(providerId, cache)
 #ifdef BUILD_PROVIDER_TYPE_SCRIPT
@@ -1479,6 +1633,7 @@ void PublicTransportEngine::reloadChangedProviders()
             m_providers.remove( providerId );
             m_cachedProviders.remove( providerId );
             m_erroneousProviders.remove( providerId );
+            m_providerIndex.remove( providerId );
 
             updateProviderData( providerId, cache );
 
@@ -1486,7 +1641,7 @@ void PublicTransportEngine::reloadChangedProviders()
                     dynamic_cast< TimetableDataSource* >( m_dataSources[cachedSource] );
             if ( timetableSource ) {
                 // Stop automatic updates
-                timetableSource->stopUpdateTimer();
+                m_updateScheduler->unschedule( cachedSource.toString() );
 
                 // Update manually
                 foreach ( const QString &sourceName, timetableSource->usingDataSources() ) {
@@ -1514,6 +1669,8 @@ const QLatin1String PublicTransportEngine::sourceTypeKeyword( SourceType sourceT
         return QLatin1String("Locations");
     case VehicleTypesSource:
         return QLatin1String("VehicleTypes");
+    case UpdateSchedulerSource:
+        return QLatin1String("UpdateScheduler");
     case DeparturesSource:
         return QLatin1String("Departures");
     case ArrivalsSource:
@@ -1547,6 +1704,8 @@ PublicTransportEngine::SourceType PublicTransportEngine::sourceTypeFromName(
         return LocationsSource;
     } else if ( sourceName.compare(sourceTypeKeyword(VehicleTypesSource)) == 0 ) {
         return VehicleTypesSource;
+    } else if ( sourceName.compare(sourceTypeKeyword(UpdateSchedulerSource)) == 0 ) {
+        return UpdateSchedulerSource;
     } else if ( sourceName.startsWith(sourceTypeKeyword(DeparturesSource)) ) {
         return DeparturesSource;
     } else if ( sourceName.startsWith(sourceTypeKeyword(ArrivalsSource)) ) {
@@ -1677,6 +1836,14 @@ PublicTransportEngine::SourceRequestData::SourceRequestData( const QString &name
                         kWarning() << "Bad value for 'count' in source name:" << parameterValue;
                         request->setCount( 20 );
                     }
+                } else if ( parameterName == QLatin1String("requester") ) {
+                    StopSuggestionRequest *stopRequest =
+                            dynamic_cast< StopSuggestionRequest* >( request );
+                    if ( !stopRequest ) {
+                        kWarning() << "The 'requester' parameter is only used for stop suggestion requests";
+                    } else {
+                        stopRequest->setRequester( parameterValue );
+                    }
                 } else if ( dynamic_cast<StopsByGeoPositionRequest*>(request) ) {
                     StopsByGeoPositionRequest *stopRequest =
                             dynamic_cast< StopsByGeoPositionRequest* >( request );
@@ -1805,6 +1972,8 @@ bool PublicTransportEngine::requestOrUpdateSourceEvent( const SourceRequestData
         return updateErroneousServiceProviderSource();
     case LocationsSource:
         return updateLocationSource();
+    case UpdateSchedulerSource:
+        return updateUpdateSchedulerSource();
     case DeparturesSource:
     case ArrivalsSource:
     case StopsSource:
@@ -1846,46 +2015,63 @@ void PublicTransportEngine::initVehicleTypesSource()
     setData( sourceTypeKeyword(VehicleTypesSource), vehicleTypes );
 }
 
+bool PublicTransportEngine::updateUpdateSchedulerSource()
+{
+    const QLatin1String name = sourceTypeKeyword( UpdateSchedulerSource );
+    removeAllData( name );
+    setData( name, m_updateScheduler->diagnostics() );
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    setData( name, "scriptExecutor", ScriptExecutor::instance()->diagnostics() );
+#endif
+    return true;
+}
+
+void PublicTransportEngine::updateSchedulerDiagnosticsChanged()
+{
+    // Only publish diagnostic data if the data source is connected,
+    // setData() would otherwise create the data source
+    if ( containerForSource(sourceTypeKeyword(UpdateSchedulerSource)) ) {
+        updateUpdateSchedulerSource();
+    }
+}
+
 void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
         const QUrl &requestUrl, const DepartureInfoList &items,
         const GlobalTimetableInfo &globalInfo, const DepartureRequest &request,
-        bool deleteDepartureInfos, bool isDepartureData )
+        int chunkIndex, bool isLastChunk, bool isDepartureData )
 {
     Q_UNUSED( requestUrl );
     Q_UNUSED( provider );
-    Q_UNUSED( deleteDepartureInfos );
     const QString sourceName = request.sourceName();
     DEBUG_ENGINE_JOBS( items.count() << (isDepartureData ? "departures" : "arrivals")
-                       << "received" << sourceName );
+                       << "received" << sourceName << "chunk" << chunkIndex
+                       << (isLastChunk ? "(last)" : "") );
 
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    const SourceKey key = sourceKey( sourceName );
+    if ( !m_dataSources.contains(key) ) {
         kWarning() << "Data source already removed";
         return;
     }
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     Q_ASSERT( dataSource );
-    m_runningSources.removeOne( nonAmbiguousName );
-    QVariantList departuresData;
+    m_runningSources.remove( key );
     const QString itemKey = isDepartureData ? "departures" : "arrivals";
+    const QString appendedItemsKey = isDepartureData ? "appendedDepartures" : "appendedArrivals";
 
-    foreach( const DepartureInfoPtr &departureInfo, items ) {
-        QVariantHash departureData;
-        TimetableData departure = departureInfo->data();
-        for ( TimetableData::ConstIterator it = departure.constBegin();
-              it != departure.constEnd(); ++it )
-        {
-            if ( it.value().isValid() ) {
-                departureData.insert( Global::timetableInformationToString(it.key()), it.value() );
-            }
-        }
+    // Following chunks only contain new items, only these get converted
+    QVariantList departuresData;
+    departuresData.reserve( items.count() );
 
-        departureData.insert( "Nightline", departureInfo->isNightLine() );
-        departureData.insert( "Expressline", departureInfo->isExpressLine() );
+    foreach( const DepartureInfo &departureInfo, items ) {
+        QVariantHash departureData = departureInfo.toVariantHash();
+        departureData.insert( "Nightline", departureInfo.isNightLine() );
+        departureData.insert( "Expressline", departureInfo.isExpressLine() );
 
         // Add existing additional data
-        const uint hash = TimetableDataSource::hashForDeparture( departure, isDepartureData );
+        const quint64 hash = TimetableDataSource::hashForDeparture( departureInfo.departureDateTime(),
+                departureInfo.vehicleType(), departureInfo.transportLine(),
+                departureInfo.target(), isDepartureData );
         if ( dataSource->additionalData().contains(hash) ) {
             // Found already downloaded additional data, add it to the updated departure data
             const TimetableData additionalData = dataSource->additionalData( hash );
@@ -1915,12 +2101,20 @@ void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
     // Cleanup the data source later
     startDataSourceCleanupLater( dataSource );
 
-    dataSource->setValue( itemKey, departuresData );
-
-//     if ( deleteDepartureInfos ) {
-//         kDebug() << "Delete" << items.count() << "departures/arrivals";
-//         qDeleteAll( departures );
-//     }
+    if ( chunkIndex == 0 ) {
+        dataSource->setValue( itemKey, departuresData );
+    } else {
+        // Append to the items of previous chunks in place. Only the items of the first chunk
+        // were published completely, only the first append after that copies them
+        dataSource->appendTimetableItems( departuresData );
+        if ( !isLastChunk ) {
+            // Publish only the appended items,
+            // all items get published when the last chunk marks them complete
+            publishAppendedItems( dataSource, appendedItemsKey, departuresData );
+            return;
+        }
+        removeAppendedItems( dataSource, appendedItemsKey );
+    }
 
     // Fill the data source with general information
     const QDateTime dateTime = QDateTime::currentDateTime();
@@ -1929,11 +2123,17 @@ void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
     dataSource->setValue( "requestUrl", requestUrl );
     dataSource->setValue( "parseMode", request.parseModeName() );
     dataSource->setValue( "error", false );
+    dataSource->setValue( "complete", isLastChunk );
     dataSource->setValue( "updated", dateTime );
 
-    // Store a proposal for the next download time
-    QDateTime last = items.isEmpty() ? dateTime
-            : items.last()->value(Enums::DepartureDateTime).toDateTime();
+    // Store a proposal for the next download time, the last chunk may not contain any items
+    QDateTime last = dateTime;
+    if ( !items.isEmpty() ) {
+        last = items.last().departureDateTime();
+    } else if ( chunkIndex > 0 && !dataSource->timetableItems().isEmpty() ) {
+        last = dataSource->timetableItems().last().toHash().value(
+                Global::timetableInformationToString(Enums::DepartureDateTime) ).toDateTime();
+    }
     dataSource->setNextDownloadTimeProposal( dateTime.addSecs(dateTime.secsTo(last) / 3) );
     const QDateTime nextUpdateTime = provider->nextUpdateTime( dataSource->updateFlags(),
             dateTime, dataSource->nextDownloadTimeProposal(), dataSource->data() );
@@ -1947,18 +2147,31 @@ void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
 
     // Publish the data source and cache it
     publishData( dataSource );
-    m_dataSources[ nonAmbiguousName ] = dataSource;
+    m_dataSources[ key ] = dataSource;
 
     int msecsUntilUpdate = dateTime.msecsTo( nextUpdateTime );
     Q_ASSERT( msecsUntilUpdate >= 10000 ); // Make sure to not produce too many updates by mistake
     DEBUG_ENGINE_JOBS( "Update data source in"
                        << KGlobal::locale()->prettyFormatDuration(msecsUntilUpdate) );
-    if ( !dataSource->updateTimer() ) {
-        QTimer *updateTimer = new QTimer( this );
-        connect( updateTimer, SIGNAL(timeout()), this, SLOT(updateTimeout()) );
-        dataSource->setUpdateTimer( updateTimer );
+    m_updateScheduler->schedule( key.toString(), provider->id(), nextUpdateTime );
+}
+
+void PublicTransportEngine::publishAppendedItems( TimetableDataSource *dataSource,
+                                                  const QString &appendedItemsKey,
+                                                  const QVariantList &items )
+{
+    foreach ( const QString &usingDataSource, dataSource->usingDataSources() ) {
+        setData( usingDataSource, appendedItemsKey, items );
+        setData( usingDataSource, "complete", false );
+    }
+}
+
+void PublicTransportEngine::removeAppendedItems( TimetableDataSource *dataSource,
+                                                 const QString &appendedItemsKey )
+{
+    foreach ( const QString &usingDataSource, dataSource->usingDataSources() ) {
+        removeData( usingDataSource, appendedItemsKey );
     }
-    dataSource->updateTimer()->start( msecsUntilUpdate );
 }
 
 void PublicTransportEngine::startDataSourceCleanupLater( TimetableDataSource *dataSource )
@@ -1972,23 +2185,30 @@ void PublicTransportEngine::startDataSourceCleanupLater( TimetableDataSource *da
     dataSource->cleanupTimer()->start();
 }
 
-void PublicTransportEngine::updateTimeout()
+void PublicTransportEngine::scheduledUpdatesDue( const QString &providerId,
+                                                 const QStringList &sourceNames )
 {
-    // Find the timetable data source to which the timer belongs which timeout() signal was emitted
-    QTimer *timer = qobject_cast< QTimer* >( sender() );
-    TimetableDataSource *dataSource = dataSourceFromTimer( timer );
-    if ( !dataSource ) {
-        // No data source found that started the timer,
-        // should not happen the data source should have deleted the timer on destruction
-        kWarning() << "Timeout received from an unknown update timer";
-        return;
-    }
+    DEBUG_ENGINE_JOBS( "Scheduled updates due for" << providerId << sourceNames );
+    Q_UNUSED( providerId );
+    foreach ( const QString &nonAmbiguousName, sourceNames ) {
+        TimetableDataSource *dataSource = dynamic_cast< TimetableDataSource* >(
+                m_dataSources.value(sourceKey(nonAmbiguousName)) );
+        if ( !dataSource ) {
+            // The data source should have been unscheduled when it was removed
+            kWarning() << "Scheduled update for an unknown data source" << nonAmbiguousName;
+            continue;
+        }
 
-    // Found the timetable data source of the timer,
-    // requests updates for all connected sources (possibly multiple combined stops)
-    foreach ( const QString &sourceName, dataSource->usingDataSources() ) {
-        updateTimetableDataSource( SourceRequestData(sourceName) );
-    }  // TODO FIXME Do not update while running additional data requests?
+        // Request updates for all connected sources (possibly multiple combined stops)
+        foreach ( const QString &sourceName, dataSource->usingDataSources() ) {
+            SourceRequestData sourceData( sourceName );
+            if ( sourceData.request ) {
+                // Execute automatic updates with a lower priority than new requests
+                sourceData.request->setBackgroundUpdate();
+            }
+            updateTimetableDataSource( sourceData );
+        }  // TODO FIXME Do not update while running additional data requests?
+    }
 }
 
 void PublicTransportEngine::cleanupTimeout()
@@ -2015,10 +2235,10 @@ void PublicTransportEngine::additionalDataReceived( ServiceProvider *provider,
     Q_UNUSED( requestUrl );
 
     // Check if the destination data source exists
-    const QString nonAmbiguousName = disambiguateSourceName( request.sourceName() );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    const SourceKey key = sourceKey( request.sourceName() );
+    if ( !m_dataSources.contains(key) ) {
         kWarning() << "Additional data received for a source that was already removed:"
-                   << nonAmbiguousName;
+                   << key.toString();
         emit additionalDataRequestFinished( request.sourceName(), request.itemNumber(), false,
                                             "Data source to update was already removed" );
         return;
@@ -2026,13 +2246,14 @@ void PublicTransportEngine::additionalDataReceived( ServiceProvider *provider,
 
     // Get the list of timetable items from the existing data source
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     Q_ASSERT( dataSource );
     QVariantList items = dataSource->timetableItems();
     if ( request.itemNumber() >= items.count() ) {
         emit additionalDataRequestFinished( request.sourceName(), request.itemNumber(), false,
                 QString("Item %1 not found in the data source (with %2 items)")
                 .arg(request.itemNumber()).arg(items.count()) );
+        additionalDataRequestDone( dataSource );
         return;
     }
 
@@ -2080,6 +2301,7 @@ void PublicTransportEngine::additionalDataReceived( ServiceProvider *provider,
         item[ "additionalDataError" ] = errorMessage;
         items[ request.itemNumber() ] = item;
         dataSource->setTimetableItems( items );
+        additionalDataRequestDone( dataSource );
         return;
     }
 
@@ -2091,44 +2313,44 @@ void PublicTransportEngine::additionalDataReceived( ServiceProvider *provider,
 
     // Also store received additional data separately
     // to not loose additional data after updating the data source
-    const uint hash = TimetableDataSource::hashForDeparture( item,
+    const quint64 hash = TimetableDataSource::hashForDeparture( item,
             dataSource->timetableItemKey() != QLatin1String("arrivals") );
     dataSource->setAdditionalData( hash, _data );
     startDataSourceCleanupLater( dataSource );
+    additionalDataRequestDone( dataSource );
 
-    QTimer *updateDelayTimer;
-    if ( dataSource->updateAdditionalDataDelayTimer() ) {
-        // Use existing timer, restart it with a longer interval and
-        // publish the new data of the data source after the timeout
-        updateDelayTimer = dataSource->updateAdditionalDataDelayTimer();
-        updateDelayTimer->setInterval( 250 );
-    } else {
-        // Create timer with a shorter interval, but directly publish the new data of the
-        // data source. The timer is used here to delay further publishing of new data,
-        // ie. combine multiple updates and publish them at once.
+    // Emit result
+    emit additionalDataRequestFinished( request.sourceName(), request.itemNumber(), true );
+}
+
+void PublicTransportEngine::additionalDataRequestDone( TimetableDataSource *dataSource )
+{
+    dataSource->additionalDataRequestFinished();
+    if ( dataSource->runningAdditionalDataRequests() == 0 ) {
+        // All requests for the data source are done, publish all received additional data at once
+        dataSource->setUpdateAdditionalDataDelayTimer( 0 ); // Deletes the timer
         publishData( dataSource );
-        updateDelayTimer = new QTimer( this );
-        updateDelayTimer->setInterval( 150 );
+    } else if ( !dataSource->updateAdditionalDataDelayTimer() ) {
+        // More requests are running, publish the additional data received so far after a delay.
+        // The timer does not get restarted for further results, otherwise publishing could get
+        // delayed until all requests are done
+        QTimer *updateDelayTimer = new QTimer( this );
+        updateDelayTimer->setSingleShot( true );
+        updateDelayTimer->setInterval( ADDITIONAL_DATA_PUBLISH_INTERVAL );
         connect( updateDelayTimer, SIGNAL(timeout()),
                  this, SLOT(updateDataSourcesWithNewAdditionData()) );
         dataSource->setUpdateAdditionalDataDelayTimer( updateDelayTimer );
+        updateDelayTimer->start();
     }
-
-    // (Re-)start the additional data update timer
-    updateDelayTimer->start();
-
-    // Emit result
-    emit additionalDataRequestFinished( request.sourceName(), request.itemNumber(), true );
 }
 
 TimetableDataSource *PublicTransportEngine::dataSourceFromTimer( QTimer *timer ) const
 {
-    for ( QHash< QString, DataSource* >::ConstIterator it = m_dataSources.constBegin();
+    for ( QHash< SourceKey, DataSource* >::ConstIterator it = m_dataSources.constBegin();
           it != m_dataSources.constEnd(); ++it )
     {
         TimetableDataSource *dataSource = dynamic_cast< TimetableDataSource* >( *it );
         if ( dataSource && (dataSource->updateAdditionalDataDelayTimer() == timer ||
-                            dataSource->updateTimer() == timer ||
                             dataSource->cleanupTimer() == timer) )
         {
             return dataSource;
@@ -2149,90 +2371,87 @@ void PublicTransportEngine::updateDataSourcesWithNewAdditionData()
         return;
     }
 
-    const int interval = updateDelayTimer->interval();
+    // Publish additional data received so far, the next received additional data
+    // starts a new timer, if more requests are running
     dataSource->setUpdateAdditionalDataDelayTimer( 0 ); // Deletes the timer
-
-    // Do the upate, but only after long delays,
-    // because the update is already done before short delays
-    if ( interval > 150 ) {
-        // Was delayed for a longer time
-        publishData( dataSource );
-    }
+    publishData( dataSource );
 }
 
 void PublicTransportEngine::departuresReceived( ServiceProvider *provider,
         const QUrl &requestUrl, const DepartureInfoList &departures,
         const GlobalTimetableInfo &globalInfo, const DepartureRequest &request,
-        bool deleteDepartureInfos )
+        int chunkIndex, bool isLastChunk )
 {
     timetableDataReceived( provider, requestUrl, departures, globalInfo, request,
-                           deleteDepartureInfos, true );
+                           chunkIndex, isLastChunk, true );
 }
 
 void PublicTransportEngine::arrivalsReceived( ServiceProvider *provider, const QUrl &requestUrl,
         const ArrivalInfoList &arrivals, const GlobalTimetableInfo &globalInfo,
-        const ArrivalRequest &request, bool deleteDepartureInfos )
+        const ArrivalRequest &request, int chunkIndex, bool isLastChunk )
 {
     timetableDataReceived( provider, requestUrl, arrivals, globalInfo, request,
-                           deleteDepartureInfos, false );
+                           chunkIndex, isLastChunk, false );
 }
 
 void PublicTransportEngine::journeysReceived( ServiceProvider* provider,
         const QUrl &requestUrl, const JourneyInfoList &journeys,
         const GlobalTimetableInfo &globalInfo,
         const JourneyRequest &request,
-        bool deleteJourneyInfos )
+        int chunkIndex, bool isLastChunk )
 {
     Q_UNUSED( provider );
-    Q_UNUSED( deleteJourneyInfos );
     const QString sourceName = request.sourceName();
-    DEBUG_ENGINE_JOBS( journeys.count() << "journeys received" << sourceName );
+    DEBUG_ENGINE_JOBS( journeys.count() << "journeys received" << sourceName
+                       << "chunk" << chunkIndex << (isLastChunk ? "(last)" : "") );
 
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    m_runningSources.removeOne( nonAmbiguousName );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
-        kWarning() << "Data source already removed" << nonAmbiguousName;
+    const SourceKey key = sourceKey( sourceName );
+    m_runningSources.remove( key );
+    if ( !m_dataSources.contains(key) ) {
+        kWarning() << "Data source already removed" << key.toString();
         return;
     }
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     if ( !dataSource ) {
-        kWarning() << "Data source already deleted" << nonAmbiguousName;
+        kWarning() << "Data source already deleted" << key.toString();
         return;
     }
-    dataSource->clear();
-    QVariantList journeysData;
-    foreach( const JourneyInfoPtr &journeyInfo, journeys ) {
-        if ( !journeyInfo->isValid() ) {
-            continue;
-        }
 
-        QVariantHash journeyData;
-        TimetableData journey = journeyInfo->data();
-        for ( TimetableData::ConstIterator it = journey.constBegin();
-              it != journey.constEnd(); ++it )
-        {
-            if ( it.value().isValid() ) {
-                journeyData.insert( Global::timetableInformationToString(it.key()), it.value() );
-            }
+    // Following chunks only contain new journeys, only these get converted
+    QVariantList newJourneysData;
+    foreach( const JourneyInfo &journeyInfo, journeys ) {
+        if ( !journeyInfo.isValid() ) {
+            continue;
         }
 
-        journeysData << journeyData;
+        newJourneysData << journeyInfo.toVariantHash();
     }
 
-    dataSource->setValue( "journeys", journeysData );
+    if ( chunkIndex == 0 ) {
+        dataSource->clear();
+        dataSource->setValue( "journeys", newJourneysData );
+    } else {
+        // Append to the journeys of previous chunks in place, see timetableDataReceived()
+        dataSource->appendTimetableItems( newJourneysData );
+        if ( !isLastChunk ) {
+            publishAppendedItems( dataSource, "appendedJourneys", newJourneysData );
+            return;
+        }
+        removeAppendedItems( dataSource, "appendedJourneys" );
+    }
 
-    int journeyCount = journeys.count();
+    const QVariantList journeysData = dataSource->timetableItems();
+    int journeyCount = journeysData.count();
     QDateTime first, last;
     if ( journeyCount > 0 ) {
-        first = journeys.first()->value(Enums::DepartureDateTime).toDateTime();
-        last = journeys.last()->value(Enums::DepartureDateTime).toDateTime();
+        const QString departureKey =
+                Global::timetableInformationToString( Enums::DepartureDateTime );
+        first = journeysData.first().toHash().value( departureKey ).toDateTime();
+        last = journeysData.last().toHash().value( departureKey ).toDateTime();
     } else {
         first = last = QDateTime::currentDateTime();
     }
-//     if ( deleteJourneyInfos ) {
-//         qDeleteAll( journeys ); TODO
-//     }
 
     // Store a proposal for the next download time
     int secs = ( journeyCount / 3 ) * first.secsTo( last );
@@ -2245,11 +2464,12 @@ void PublicTransportEngine::journeysReceived( ServiceProvider* provider,
     dataSource->setValue( "requestUrl", requestUrl );
     dataSource->setValue( "parseMode", request.parseModeName() );
     dataSource->setValue( "error", false );
+    dataSource->setValue( "complete", isLastChunk );
     dataSource->setValue( "updated", QDateTime::currentDateTime() );
     dataSource->setValue( "nextAutomaticUpdate", downloadTime );
     dataSource->setValue( "minManualUpdateTime", downloadTime ); // TODO
     setData( sourceName, dataSource->data() );
-    m_dataSources[ nonAmbiguousName ] = dataSource;
+    m_dataSources[ key ] = dataSource;
 }
 
 void PublicTransportEngine::stopsReceived( ServiceProvider *provider,
@@ -2260,28 +2480,32 @@ void PublicTransportEngine::stopsReceived( ServiceProvider *provider,
     Q_UNUSED( deleteStopInfos );
 
     const QString sourceName = request.sourceName();
-    m_runningSources.removeOne( disambiguateSourceName(sourceName) );
+    const SourceKey key = sourceKey( sourceName );
+    m_runningSources.remove( key );
     DEBUG_ENGINE_JOBS( stops.count() << "stop suggestions received" << sourceName );
 
     QVariantList stopsData;
-    foreach( const StopInfoPtr &stopInfo, stops ) {
-        QVariantHash stopData;
-        TimetableData stop = stopInfo->data();
-        for ( TimetableData::ConstIterator it = stop.constBegin();
-              it != stop.constEnd(); ++it )
-        {
-            if ( it.value().isValid() ) {
-                stopData.insert( Global::timetableInformationToString(it.key()), it.value() );
-            }
-        }
-        stopsData << stopData;
+    foreach( const StopInfo &stopInfo, stops ) {
+        stopsData << stopInfo.toVariantHash();
+    }
+
+    // Publish the stops to all source names for the same stop suggestions,
+    // these can differ in the requester parameter
+    TimetableDataSource *dataSource = m_dataSources.contains( key )
+            ? dynamic_cast< TimetableDataSource* >( m_dataSources[key] ) : 0;
+    QStringList sourceNames = dataSource ? dataSource->usingDataSources() : QStringList();
+    if ( !sourceNames.contains(sourceName) ) {
+        sourceNames << sourceName;
+    }
+    const QDateTime updated = QDateTime::currentDateTime();
+    foreach ( const QString &name, sourceNames ) {
+        setData( name, "stops", stopsData );
+        setData( name, "serviceProvider", provider->id() );
+        setData( name, "requestUrl", requestUrl );
+        setData( name, "parseMode", request.parseModeName() );
+        setData( name, "error", false );
+        setData( name, "updated", updated );
     }
-    setData( sourceName, "stops", stopsData );
-    setData( sourceName, "serviceProvider", provider->id() );
-    setData( sourceName, "requestUrl", requestUrl );
-    setData( sourceName, "parseMode", request.parseModeName() );
-    setData( sourceName, "error", false );
-    setData( sourceName, "updated", QDateTime::currentDateTime() );
 
 //     if ( deleteStopInfos ) {
 //         qDeleteAll( stops ); TODO
@@ -2303,11 +2527,11 @@ void PublicTransportEngine::requestFailed( ServiceProvider *provider,
                 additionalDataRequest->itemNumber(), false, errorMessage );
 
         // Check if the destination data source exists
-        const QString nonAmbiguousName = disambiguateSourceName( request->sourceName() );
-        if ( m_dataSources.contains(nonAmbiguousName) ) {
+        const SourceKey key = sourceKey( request->sourceName() );
+        if ( m_dataSources.contains(key) ) {
             // Get the list of timetable items from the existing data source
             TimetableDataSource *dataSource =
-                    dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+                    dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
             Q_ASSERT( dataSource );
             QVariantList items = dataSource->timetableItems();
             if ( additionalDataRequest->itemNumber() < items.count() ) {
@@ -2319,14 +2543,14 @@ void PublicTransportEngine::requestFailed( ServiceProvider *provider,
 
                 items[ additionalDataRequest->itemNumber() ] = item;
                 dataSource->setTimetableItems( items );
-
-                // Publish updated fields
-                publishData( dataSource );
             } else {
                 kWarning() << "Timetable item" << additionalDataRequest->itemNumber()
                            << "not found in data source" << request->sourceName()
                            << "additional data error discarded";
             }
+
+            // Publish updated fields together with other finished additional data requests
+            additionalDataRequestDone( dataSource );
         } else {
             kWarning() << "Data source" << request->sourceName()
                        << "not found, additional data error discarded";
@@ -2338,9 +2562,24 @@ void PublicTransportEngine::requestFailed( ServiceProvider *provider,
     }
 
     // Remove erroneous source from running sources list
-    m_runningSources.removeOne( disambiguateSourceName(request->sourceName()) );
+    const SourceKey key = sourceKey( request->sourceName() );
+    m_runningSources.remove( key );
 
     const QString sourceName = request->sourceName();
+    if ( errorCode == ErrorRequestCancelled && m_dataSources.contains(key) ) {
+        // The request was superseded by a newer request of the requester of sourceName,
+        // but the same data might still be needed for other source names, ie. other requesters
+        TimetableDataSource *dataSource =
+                dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
+        if ( dataSource ) {
+            dataSource->removeUsingDataSource( sourceName );
+            if ( dataSource->usageCount() > 0 ) {
+                updateTimetableDataSource(
+                        SourceRequestData(dataSource->usingDataSources().first()) );
+            }
+        }
+    }
+
     setData( sourceName, "serviceProvider", provider->id() );
     setData( sourceName, "requestUrl", requestUrl );
     setData( sourceName, "parseMode", request->parseModeName() );
@@ -2354,8 +2593,8 @@ void PublicTransportEngine::requestFailed( ServiceProvider *provider,
 bool PublicTransportEngine::requestUpdate( const QString &sourceName )
 {
     // Find the TimetableDataSource object for sourceName
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    const SourceKey key = sourceKey( sourceName );
+    if ( !m_dataSources.contains(key) ) {
         kWarning() << "Not an existing timetable data source:" << sourceName;
         emit updateRequestFinished( sourceName, false,
                 i18nc("@info", "Data source is not an existing timetable data source: %1",
@@ -2363,7 +2602,7 @@ bool PublicTransportEngine::requestUpdate( const QString &sourceName )
         return false;
     }
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     if ( !dataSource ) {
         kWarning() << "Internal error: Invalid pointer to the data source stored";
         emit updateRequestFinished( sourceName, false,
@@ -2381,8 +2620,19 @@ bool PublicTransportEngine::requestUpdate( const QString &sourceName )
         return false;
     }
 
-    // Stop automatic updates
-    dataSource->stopUpdateTimer();
+    // Manual updates are not delayed by the update scheduler, but still take from the request
+    // budget of the provider. Reject the update if the budget is exhausted
+    if ( !m_updateScheduler->takeToken(dataSource->providerId()) ) {
+        kDebug() << "No request budget left for provider" << dataSource->providerId()
+                 << "update request rejected";
+        emit updateRequestFinished( sourceName, false,
+                i18nc("@info", "Update request rejected, too many requests to the provider, "
+                      "please try again later") );
+        return false;
+    }
+
+    // Stop automatic updates, they get scheduled again when the new data arrives
+    m_updateScheduler->unschedule( key.toString() );
 
     // Start the request
     const bool result = request( sourceName );
@@ -2398,14 +2648,14 @@ bool PublicTransportEngine::requestMoreItems( const QString &sourceName,
                                               Enums::MoreItemsDirection direction )
 {
     // Find the TimetableDataSource object for sourceName
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    const SourceKey key = sourceKey( sourceName );
+    if ( !m_dataSources.contains(key) ) {
         kWarning() << "Not an existing timetable data source:" << sourceName;
         emit moreItemsRequestFinished( sourceName, direction, false,
                 i18nc("@info", "Data source is not an existing timetable data source: %1",
                       sourceName) );
         return false;
-    } else if ( m_runningSources.contains(nonAmbiguousName) ) {
+    } else if ( m_runningSources.contains(key) ) {
         // The data source currently gets processed or updated, including requests for more items
         kDebug() << "Source currently gets processed, please wait" << sourceName;
         emit moreItemsRequestFinished( sourceName, direction, false,
@@ -2414,7 +2664,7 @@ bool PublicTransportEngine::requestMoreItems( const QString &sourceName,
     }
 
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     if ( !dataSource ) {
         kWarning() << "Internal error: Invalid pointer to the data source stored";
         emit moreItemsRequestFinished( sourceName, direction, false, "Internal error" );
@@ -2454,7 +2704,7 @@ bool PublicTransportEngine::requestMoreItems( const QString &sourceName,
     }
 
     // Start the request
-    m_runningSources << nonAmbiguousName;
+    m_runningSources << key;
     provider->requestMoreItems( MoreItemsRequest(sourceName, request, requestData, direction) );
     emit moreItemsRequestFinished( sourceName, direction );
     return true;
@@ -2481,7 +2731,7 @@ bool PublicTransportEngine::request( const SourceRequestData &data )
         // Service provider couldn't be created
         // Remove erroneous source from running sources list
         const QString sourceName = data.request->sourceName();
-        m_runningSources.removeOne( disambiguateSourceName(sourceName) );
+        m_runningSources.remove( sourceKey(sourceName) );
 
         ProvidersDataSource *dataSource = providersDataSource();
         const QString state = dataSource->providerState( data.defaultParameter );
@@ -2514,7 +2764,7 @@ bool PublicTransportEngine::request( const SourceRequestData &data )
 
     // Store source name as currently being processed, to not start another
     // request if there is already a running one
-    m_runningSources << disambiguateSourceName( data.name );
+    m_runningSources << sourceKey( data.name );
 
     // Start the request
     provider->request( data.request );
@@ -2534,8 +2784,8 @@ int PublicTransportEngine::minSecsUntilUpdate( const QString &sourceName, QStrin
 int PublicTransportEngine::getSecsUntilUpdate( const QString &sourceName, QString *errorMessage,
                                                UpdateFlags updateFlags )
 {
-    const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    const SourceKey key = sourceKey( sourceName );
+    if ( !m_dataSources.contains(key) ) {
         // The data source is not a timetable data source or does not exist
         if ( errorMessage ) {
             *errorMessage = i18nc("@info", "Data source is not an existing timetable "
@@ -2544,7 +2794,7 @@ int PublicTransportEngine::getSecsUntilUpdate( const QString &sourceName, QStrin
         return -1;
     }
     TimetableDataSource *dataSource = dynamic_cast< TimetableDataSource* >(
-            m_dataSources[nonAmbiguousName] );
+            m_dataSources[key] );
     if ( !dataSource ) {
         kWarning() << "Internal error: Invalid pointer to the data source stored";
         return -1;
@@ -2568,15 +2818,15 @@ QDateTime PublicTransportEngine::sourceUpdateTime( TimetableDataSource *dataSour
                                      dataSource->nextDownloadTimeProposal(), dataSource->data() );
 }
 
-bool PublicTransportEngine::isSourceUpToDate( const QString &nonAmbiguousName,
+bool PublicTransportEngine::isSourceUpToDate( const SourceKey &key,
                                               UpdateFlags updateFlags )
 {
-    if ( !m_dataSources.contains(nonAmbiguousName) ) {
+    if ( !m_dataSources.contains(key) ) {
         return false;
     }
 
     TimetableDataSource *dataSource =
-            dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
+            dynamic_cast< TimetableDataSource* >( m_dataSources[key] );
     if ( !dataSource ) {
         // The data source is not a timetable data source, no periodic updates needed
         return true;
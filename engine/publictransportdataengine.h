@@ -28,10 +28,16 @@
 #include "config.h"
 #include "enums.h"
 #include "departureinfo.h"
+#include "serviceproviderindex.h"
 
 // Plasma includes
 #include <Plasma/DataEngine>
 
+// Qt includes
+#include <QCache>
+#include <QDate>
+#include <QSet>
+
 class AbstractRequest;
 class AbstractTimetableItemRequest;
 class StopSuggestionRequest;
@@ -49,6 +55,8 @@ class DepartureInfo;
 class JourneyInfo;
 class StopInfo;
 
+class UpdateScheduler;
+
 class KJob;
 
 class QTimer;
@@ -95,6 +103,9 @@ public:
                 * (libpublictransporthelper) enumerations. The information stored in this
                 * data source can also be retrieved from PublicTransport::VehicleType
                 * using libpublictransporthelper. See also @ref usage_vehicletypes_sec.  */
+        UpdateSchedulerSource = 6, /**< The source contains diagnostic data of the scheduler
+                * for automatic timetable data source updates, eg. queue depths and wait times
+                * per provider. See also @ref usage_updatescheduler_sec. */
 
         // Data sources providing timetable data
         DeparturesSource = 10, /**< The source contains timetable data for departures.
@@ -137,6 +148,102 @@ public:
                 * data sources. */
     };
 
+    /**
+     * @brief A non ambiguous key for a data source, parsed from a data source name.
+     *
+     * Source names with only a different parameter order, different case in parameter values
+     * (eg. stop names) or times that are less than 15 minutes apart result in equal keys.
+     * Date and time parameters get replaced by a @c datetime parameter with the time rounded
+     * to 15 minutes, the @c count parameter gets ignored. Without doing this eg. departure
+     * data sources with only little different time values would @em not share their
+     * departures and download them twice.
+     *
+     * Keys get parsed in a single pass over the source name using parse(), the hash value
+     * gets computed once. Use PublicTransportEngine::sourceKey() to get cached keys.
+     **/
+    class SourceKey {
+    public:
+        /** @brief Parameters stored in keys, in the order used by toString(). */
+        enum Parameter {
+            CityParameter = 0,
+            StopParameter,
+            StopIdParameter,
+            OriginStopParameter,
+            OriginStopIdParameter,
+            TargetStopParameter,
+            TargetStopIdParameter,
+            TimeOffsetParameter,
+            DateTimeParameter,
+            LongitudeParameter,
+            LatitudeParameter,
+
+            ParameterCount /**< The number of parameters, not a valid parameter. */
+        };
+
+        /** @brief Create a key for a source of the given @p type without parameters. */
+        explicit SourceKey( SourceType type = InvalidSourceName,
+                            const QString &providerId = QString() );
+
+        /** @brief Parse the given @p sourceName in a single pass. */
+        static SourceKey parse( const QString &sourceName );
+
+        /** @brief Whether or not this key is valid. */
+        bool isValid() const { return m_type != InvalidSourceName; };
+
+        /** @brief The type of the data source. */
+        SourceType type() const { return m_type; };
+
+        /** @brief The ID of the used provider, if any. */
+        QString providerId() const { return m_providerId; };
+
+        /** @brief The value of the given @p parameter or an empty string if not given. */
+        QString parameter( Parameter parameter ) const { return m_parameters[parameter]; };
+
+        /**
+         * @brief Whether or not this key depends on the date at which it was parsed.
+         *
+         * This is the case for source names with a @c time parameter, which refers to the
+         * current date. Cached keys get invalid when the date has changed.
+         **/
+        bool dependsOnCurrentDate() const { return m_parseDate.isValid(); };
+
+        /** @brief The date at which this key was parsed, if dependsOnCurrentDate(). */
+        QDate parseDate() const { return m_parseDate; };
+
+        /**
+         * @brief Get the non ambiguous source name for this key.
+         *
+         * Parameters get written in a standardized order. Parsing the returned name
+         * results in a key equal to this key.
+         **/
+        QString toString() const;
+
+        /** @brief The hash value of this key, computed once when the key gets created. */
+        uint hash() const { return m_hash; };
+
+        bool operator ==( const SourceKey &other ) const;
+        bool operator !=( const SourceKey &other ) const { return !operator ==(other); };
+
+    private:
+        void updateHash();
+
+        SourceType m_type;
+        QString m_providerId;
+        QString m_parameters[ ParameterCount ];
+        QDate m_parseDate;
+        uint m_hash;
+    };
+
+    /**
+     * @brief Get the non ambiguous key for the given @p sourceName.
+     *
+     * Parsed keys are cached by source name in a least recently used cache with
+     * SOURCE_KEY_CACHE_SIZE entries. Keys that depend on the current date get parsed again
+     * when the date has changed.
+     * @see SourceKey
+     **/
+    SourceKey sourceKey( const QString &sourceName ) const;
+
     /** @brief Get the keyword used in source names associated with the given @p sourceType. */
     static const QLatin1String sourceTypeKeyword( SourceType sourceType );
 
@@ -154,9 +261,6 @@ public:
     static bool isDataRequestingSourceType( SourceType sourceType ) {
         return static_cast< int >( sourceType ) >= 10; };
 
-    /** @brief Get the ID of the provider used for the source with the given @p sourceName. */
-    static QString providerIdFromSourceName( const QString &sourceName );
-
     /** @brief Remove words from the beginning/end of stop names that occur in most names. */
     static QStringList removeCityNameFromStops( const QStringList &stopNames );
 
@@ -264,6 +368,18 @@ public:
      **/
     static const int PROVIDER_CLEANUP_TIMEOUT;
 
+    /** @brief The maximal number of parsed source keys to keep cached, see sourceKey(). */
+    static const int SOURCE_KEY_CACHE_SIZE;
+
+    /**
+     * @brief The interval in milliseconds to publish additional data while requests are running.
+     *
+     * Additional data of a data source gets published once when all running additional data
+     * requests for the data source are done. If requests are still running after this interval,
+     * the additional data received so far gets published.
+     **/
+    static const int ADDITIONAL_DATA_PUBLISH_INTERVAL;
+
 signals:
     /**
      * @brief Emitted when a request for additional data has been finished.
@@ -324,8 +440,17 @@ protected slots:
      **/
     void networkStateChanged( uint state );
 
-    /** @brief The update timeout for a timetable data source was reached. */
-    void updateTimeout();
+    /**
+     * @brief Automatic updates for timetable data sources of @p providerId are due.
+     *
+     * This slot is connected to UpdateScheduler::updatesDue().
+     * @param providerId The ID of the provider used by the data sources to update.
+     * @param sourceNames The non ambiguous names of the data sources to update.
+     **/
+    void scheduledUpdatesDue( const QString &providerId, const QStringList &sourceNames );
+
+    /** @brief Publish new diagnostic data of the update scheduler, if the source is connected. */
+    void updateSchedulerDiagnosticsChanged();
 
     /** @brief The cleanup timeout for a timetable data source was reached. */
     void cleanupTimeout();
@@ -352,6 +477,11 @@ protected slots:
      * @param departures The departures that were received.
      * @param globalInfo Global information that affects all departures.
      * @param request Information about the request for the here received @p departures.
+     * @param chunkIndex The index of the chunk of @p departures, 0 replaces existing departures
+     *   in the data source, higher indices get appended.
+     * @param isLastChunk Whether or not this is the last chunk, which marks the departures
+     *   of the data source complete. Only first and last chunks publish all departures,
+     *   other chunks only publish the appended departures.
      *
      * @see ServiceProvider::useSeparateCityValue()
      **/
@@ -359,7 +489,7 @@ protected slots:
             const QUrl &requestUrl, const DepartureInfoList &departures,
             const GlobalTimetableInfo &globalInfo,
             const DepartureRequest &request,
-            bool deleteDepartureInfos = true );
+            int chunkIndex = 0, bool isLastChunk = true );
 
     /**
      * @brief Arrivals were received.
@@ -369,6 +499,8 @@ protected slots:
      * @param arrivals The arrivals that were received.
      * @param globalInfo Global information that affects all arrivals.
      * @param request Information about the request for the here received @p arrivals.
+     * @param chunkIndex The index of the chunk of @p arrivals, see departuresReceived().
+     * @param isLastChunk Whether or not this is the last chunk, see departuresReceived().
      *
      * @see ServiceProvider::useSeparateCityValue()
      **/
@@ -376,7 +508,7 @@ protected slots:
             const QUrl &requestUrl, const ArrivalInfoList &arrivals,
             const GlobalTimetableInfo &globalInfo,
             const ArrivalRequest &request,
-            bool deleteDepartureInfos = true );
+            int chunkIndex = 0, bool isLastChunk = true );
 
     /**
      * @brief Journeys were received.
@@ -386,6 +518,8 @@ protected slots:
      * @param journeys The journeys that were received.
      * @param globalInfo Global information that affects all journeys.
      * @param request Information about the request for the here received @p journeys.
+     * @param chunkIndex The index of the chunk of @p journeys, see departuresReceived().
+     * @param isLastChunk Whether or not this is the last chunk, see departuresReceived().
      *
      * @see ServiceProvider::useSeparateCityValue()
      **/
@@ -393,7 +527,7 @@ protected slots:
             const QUrl &requestUrl, const JourneyInfoList &journeys,
             const GlobalTimetableInfo &globalInfo,
             const JourneyRequest &request,
-            bool deleteJourneyInfos = true );
+            int chunkIndex = 0, bool isLastChunk = true );
 
     /**
      * @brief Stop suggestions were received.
@@ -441,8 +575,9 @@ protected slots:
     /**
      * @brief Update data sources which have new additional data available.
      *
-     * This slot gets used to combine too many data source updates in short time
-     * into a single update.
+     * This slot gets called by the timer of a data source, which gets started when additional
+     * data was received while other additional data requests are still running, see
+     * additionalDataRequestDone().
      **/
     void updateDataSourcesWithNewAdditionData();
 
@@ -569,14 +704,17 @@ protected:
     /** @brief Fill the VehicleTypes data source. */
     void initVehicleTypesSource();
 
+    /** @brief Updates the "UpdateScheduler" data source with diagnostic data. */
+    bool updateUpdateSchedulerSource();
+
     /**
      * @brief Wheather or not the data source with the given @p name is up to date.
      *
-     * @param nonAmbiguousName The (non ambiguous) name of the source to be checked.
+     * @param key The non ambiguous key of the source to be checked.
      * @return @c True, if the data source is up to date. @c False, otherwise.
-     * @see disambiguateSourceName()
+     * @see sourceKey()
      **/
-    bool isSourceUpToDate( const QString &nonAmbiguousName,
+    bool isSourceUpToDate( const SourceKey &key,
                            UpdateFlags updateFlags = DefaultUpdateFlags );
 
     /**
@@ -627,7 +765,19 @@ private:
             const QUrl &requestUrl, const DepartureInfoList &items,
             const GlobalTimetableInfo &globalInfo,
             const DepartureRequest &request,
-            bool deleteDepartureInfos = true, bool isDepartureData = true );
+            int chunkIndex = 0, bool isLastChunk = true, bool isDepartureData = true );
+
+    /**
+     * @brief Publish timetable @p items appended to @p dataSource by a chunk of results.
+     *
+     * Only the appended @p items get published under @p appendedItemsKey, eg.
+     * "appendedDepartures", the complete list of items gets published with the last chunk.
+     **/
+    void publishAppendedItems( TimetableDataSource *dataSource, const QString &appendedItemsKey,
+                               const QVariantList &items );
+
+    /** @brief Remove appended items published by publishAppendedItems() from @p dataSource. */
+    void removeAppendedItems( TimetableDataSource *dataSource, const QString &appendedItemsKey );
 
     /**
      * @brief Gets information about @p provider for a service provider data source.
@@ -705,21 +855,6 @@ private:
      **/
     static bool isStateDataCached( const QString &stateDataKey );
 
-    /**
-     * @brief Disambiguates the given @p sourceName.
-     *
-     * Date and time parameters get replaced by a @c datetime parameter, with the time rounded to
-     * 15 minutes to use one data source object for all sources that are less than 15 minutes apart
-     * from each other.
-     * Parameters get reordered to a standard order, so that data source names with only a
-     * different parameter order point to the same DataSource object. Parameter values get
-     * converted to lower case (eg. stop names).
-     *
-     * Without doing this eg. departure data sources with only little different time values
-     * will @em not share their departures and download them twice.
-     **/
-    static QString disambiguateSourceName( const QString &sourceName );
-
     /** @brief If @p providerId is empty return the default provider for the users country. */
     static QString fixProviderId( const QString &providerId );
 
@@ -748,7 +883,9 @@ private:
     /**
      * @brief Update all provider data including the provider state.
      *
-     * Uses updateProviderState() to update the state of the provider.
+     * Uses updateProviderState() to update the state of the provider. Provider data gets read
+     * from the provider index if the provider was not modified since it was indexed, otherwise
+     * testServiceProvider() gets used and the result gets added to the index.
      **/
     bool updateProviderData( const QString &providerId,
                              const QSharedPointer<KConfig> &cache = QSharedPointer<KConfig>(0) );
@@ -761,6 +898,9 @@ private:
     // Implementation for the requestAdditionalData() slot,
     // call testDataSourceForAdditionalDataRequests() before and publishData() afterwards.
     // Both functions only need to be called once for multiple calls to this function.
+    // Returns true if the item was changed, ie. it's state is "busy" or "error" if the request
+    // could not be started. Then the data source needs to be published
+    // (that is done by the requestAdditionalData() slot).
     bool requestAdditionalData( const QString &sourceName, int updateItem,
                                 TimetableDataSource *dataSource );
 
@@ -768,15 +908,26 @@ private:
     // if 0 gets returned all additional data requests on sourceName will fail
     TimetableDataSource *testDataSourceForAdditionalDataRequests( const QString &sourceName );
 
+    // Should be called when an additional data request for dataSource is done (successful or not),
+    // publishes the data source when no more requests are running or starts a timer to
+    // publish the data source later
+    void additionalDataRequestDone( TimetableDataSource *dataSource );
+
     QHash< QString, ProviderPointer > m_providers; // Currently used providers by ID
     QHash< QString, ProviderPointer > m_cachedProviders; // Unused but still cached providers by ID
     QVariantHash m_erroneousProviders; // Error messages for erroneous providers by ID
-    QHash< QString, DataSource* > m_dataSources; // Data objects for data sources, stored by
-                                                 // unambiguous data source name
+    ServiceProviderIndex m_providerIndex; // Indexed data of installed providers
+    QHash< SourceKey, DataSource* > m_dataSources; // Data objects for data sources, stored by
+                                                   // non ambiguous source key
     QFileSystemWatcher *m_fileSystemWatcher; // Watches provider installation directories
     QTimer *m_providerUpdateDelayTimer; // Delays updates after changes in installation directories
     QTimer *m_cleanupTimer; // Cleanup cached providers after PROVIDER_CLEANUP_TIMEOUT
-    QStringList m_runningSources; // Sources which are currently being processed
+    UpdateScheduler *m_updateScheduler; // Schedules automatic updates of timetable data sources
+    QSet< SourceKey > m_runningSources; // Sources which are currently being processed
+    mutable QCache< QString, SourceKey > m_sourceKeyCache; // Parsed keys by source name
 };
 
+/** @brief Get the hash value of the given source @p key, to use it as key in QHash. */
+inline uint qHash( const PublicTransportEngine::SourceKey &key ) { return key.hash(); }
+
 #endif // Multiple inclusion guard
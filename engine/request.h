@@ -40,12 +40,13 @@ class AbstractRequest {
 public:
     AbstractRequest( const QString &sourceName = QString(),
                      ParseDocumentMode parseMode = ParseInvalid )
-            : m_sourceName(sourceName), m_parseMode(parseMode)
+            : m_sourceName(sourceName), m_parseMode(parseMode), m_backgroundUpdate(false)
     {
     };
 
     AbstractRequest( const AbstractRequest &request )
-            : m_sourceName(request.m_sourceName), m_parseMode(request.m_parseMode)
+            : m_sourceName(request.m_sourceName), m_parseMode(request.m_parseMode),
+              m_backgroundUpdate(request.m_backgroundUpdate)
     {
     };
 
@@ -68,6 +69,14 @@ public:
     QString parseModeName() const;
     static QString parseModeName( ParseDocumentMode parseMode );
 
+    /**
+     * @brief Whether or not the request is an automatic update of an existing data source.
+     * Background updates get executed with a lower priority than requests for new data.
+     **/
+    bool isBackgroundUpdate() const { return m_backgroundUpdate; };
+
+    void setBackgroundUpdate( bool background = true ) { m_backgroundUpdate = background; };
+
 
 #ifdef BUILD_PROVIDER_TYPE_SCRIPT
     virtual QScriptValue toScriptValue( QScriptEngine *engine ) const = 0;
@@ -79,6 +88,7 @@ public:
 protected:
     QString m_sourceName;
     ParseDocumentMode m_parseMode;
+    bool m_backgroundUpdate;
 };
 
 class AbstractTimetableItemRequest : public AbstractRequest {
@@ -155,7 +165,7 @@ public:
         : AbstractTimetableItemRequest(sourceName, stop, QString(), QDateTime(),
                                        count, city, parseMode) {};
     StopSuggestionRequest( const StopSuggestionRequest &other )
-        : AbstractTimetableItemRequest(other) {};
+        : AbstractTimetableItemRequest(other), m_requester(other.m_requester) {};
 
     virtual AbstractRequest *clone() const { return new StopSuggestionRequest(*this); };
     virtual QString argumentsString() const;
@@ -166,6 +176,18 @@ public:
     /** @brief Get the name of the script function that is associated with this request. */
     virtual QString functionName() const;
 #endif
+
+    /**
+     * @brief An ID of the requesting object, eg. a stop line edit, if given in the source name.
+     * Queued stop suggestion requests of a requester get cancelled when the same requester
+     * sends a newer stop suggestion request.
+     **/
+    QString requester() const { return m_requester; };
+
+    void setRequester( const QString &requester ) { m_requester = requester; };
+
+protected:
+    QString m_requester;
 };
 
 class StopsByGeoPositionRequest : public StopSuggestionRequest {
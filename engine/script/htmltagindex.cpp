@@ -0,0 +1,347 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "htmltagindex.h"
+
+// Own includes
+#include "regexpcache.h"
+
+// Qt includes
+#include <QRegExp>
+#include <QThreadStorage>
+#include <QtAlgorithms>
+
+namespace ScriptApi {
+
+const int HtmlTagIndex::MAXIMUM_CACHED_DOCUMENTS = 4;
+const int HtmlTagIndex::MINIMUM_CACHED_DOCUMENT_LENGTH = 1024;
+
+// Recently used indices of the current thread, the most recently used index first
+static QThreadStorage< QList<HtmlTagIndex::Ptr>* > indexCache;
+
+static inline bool isTagNameCharacter( const QChar &c )
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('-') || c == QLatin1Char('_') ||
+           c == QLatin1Char(':') || c == QLatin1Char('.');
+}
+
+static inline bool tagPositionLessThan( const HtmlTagIndex::Tag &tag, int position )
+{
+    return tag.position < position;
+}
+
+static inline bool tagLessThan( const HtmlTagIndex::Tag &tag1, const HtmlTagIndex::Tag &tag2 )
+{
+    return tag1.position < tag2.position;
+}
+
+static inline bool closingTagPositionLessThan( const HtmlTagIndex::ClosingTag &tag, int position )
+{
+    return tag.position < position;
+}
+
+HtmlTagIndex::HtmlTagIndex( const QString &document )
+        : m_document(document), m_tagCount(0)
+{
+    parse();
+}
+
+HtmlTagIndex::Ptr HtmlTagIndex::forDocument( const QString &document )
+{
+    if ( document.length() < MINIMUM_CACHED_DOCUMENT_LENGTH ) {
+        // Indexing short documents is cheap, do not let them replace cached indices
+        return Ptr( new HtmlTagIndex(document) );
+    }
+
+    if ( !indexCache.hasLocalData() ) {
+        indexCache.setLocalData( new QList<Ptr>() );
+    }
+    QList< Ptr > *cache = indexCache.localData();
+    for ( int i = 0; i < cache->count(); ++i ) {
+        const Ptr index = cache->at( i );
+
+        // Strings passed from scripts are usually copies, but compare the data pointers first
+        const QString &indexedDocument = index->document();
+        if ( (indexedDocument.constData() == document.constData() &&
+              indexedDocument.length() == document.length()) || indexedDocument == document )
+        {
+            cache->move( i, 0 );
+            return index;
+        }
+    }
+
+    const Ptr index( new HtmlTagIndex(document) );
+    cache->prepend( index );
+    while ( cache->count() > MAXIMUM_CACHED_DOCUMENTS ) {
+        cache->removeLast();
+    }
+    return index;
+}
+
+void HtmlTagIndex::clearCache()
+{
+    if ( indexCache.hasLocalData() ) {
+        indexCache.localData()->clear();
+    }
+}
+
+void HtmlTagIndex::parse()
+{
+    const QChar *data = m_document.constData();
+    const int length = m_document.length();
+
+    // Indices of opening tags without a matching closing tag, by tag name
+    QHash< QString, QVector<int> > openTags;
+
+    int pos = 0;
+    while ( (pos = m_document.indexOf(QLatin1Char('<'), pos)) != -1 && pos + 1 < length ) {
+        const QChar next = data[ pos + 1 ];
+        if ( next == QLatin1Char('!') || next == QLatin1Char('?') ) {
+            // Skip comments, doctype and processing instructions
+            int end;
+            if ( m_document.midRef(pos + 2, 2) == QLatin1String("--") ) {
+                end = m_document.indexOf( QLatin1String("-->"), pos + 4 );
+                pos = end == -1 ? length : end + 3;
+            } else {
+                end = m_document.indexOf( QLatin1Char('>'), pos + 2 );
+                pos = end == -1 ? length : end + 1;
+            }
+            continue;
+        } else if ( next == QLatin1Char('/') ) {
+            // Read a closing tag
+            int i = pos + 2;
+            while ( i < length && isTagNameCharacter(data[i]) ) {
+                ++i;
+            }
+            if ( i == pos + 2 ) {
+                // No tag name, not a closing tag
+                ++pos;
+                continue;
+            }
+            const int end = m_document.indexOf( QLatin1Char('>'), i );
+            if ( end == -1 ) {
+                break;
+            }
+
+            const QString name = m_document.mid( pos + 2, i - pos - 2 ).toLower();
+            ClosingTag closingTag;
+            closingTag.position = pos;
+            closingTag.endPosition = end + 1;
+            m_closingTags[ name ] << closingTag;
+
+            // Match with the innermost open tag with the same name
+            QHash< QString, QVector<int> >::Iterator openIt = openTags.find( name );
+            if ( openIt != openTags.end() && !openIt->isEmpty() ) {
+                Tag &tag = m_tags[ name ][ openIt->last() ];
+                tag.closingPosition = closingTag.position;
+                tag.endPosition = closingTag.endPosition;
+                openIt->remove( openIt->count() - 1 );
+            }
+            pos = end + 1;
+            continue;
+        } else if ( !next.isLetter() ) {
+            // Not a tag, eg. "a < b"
+            ++pos;
+            continue;
+        }
+
+        // Read an opening tag, first the tag name
+        int i = pos + 1;
+        while ( i < length && isTagNameCharacter(data[i]) ) {
+            ++i;
+        }
+        const QString name = m_document.mid( pos + 1, i - pos - 1 ).toLower();
+
+        // Read attributes until the end of the tag
+        const int firstAttribute = m_attributes.count();
+        bool selfClosing = false;
+        int end = -1;
+        while ( i < length ) {
+            const QChar c = data[ i ];
+            if ( c.isSpace() ) {
+                ++i;
+                continue;
+            } else if ( c == QLatin1Char('>') ) {
+                end = i;
+                break;
+            } else if ( c == QLatin1Char('/') ) {
+                if ( i + 1 < length && data[i + 1] == QLatin1Char('>') ) {
+                    selfClosing = true;
+                    end = i + 1;
+                    break;
+                }
+                ++i;
+                continue;
+            }
+
+            // Read the attribute name
+            const int nameStart = i;
+            while ( i < length && !data[i].isSpace() && data[i] != QLatin1Char('=') &&
+                    data[i] != QLatin1Char('>') && data[i] != QLatin1Char('/') &&
+                    data[i] != QLatin1Char('"') && data[i] != QLatin1Char('\'') )
+            {
+                ++i;
+            }
+            if ( i == nameStart ) {
+                // Stray quotation mark
+                ++i;
+                continue;
+            }
+
+            Attribute attribute;
+            attribute.namePosition = nameStart;
+            attribute.nameLength = i - nameStart;
+            attribute.valuePosition = i;
+            attribute.valueLength = 0;
+
+            // Read the attribute value, if any
+            int valueStart = i;
+            while ( valueStart < length && data[valueStart].isSpace() ) {
+                ++valueStart;
+            }
+            if ( valueStart < length && data[valueStart] == QLatin1Char('=') ) {
+                i = valueStart + 1;
+                while ( i < length && data[i].isSpace() ) {
+                    ++i;
+                }
+                if ( i < length && (data[i] == QLatin1Char('"') || data[i] == QLatin1Char('\'')) ) {
+                    // Quoted value, may contain '>'
+                    const int valueEnd = m_document.indexOf( data[i], i + 1 );
+                    attribute.valuePosition = i + 1;
+                    attribute.valueLength = (valueEnd == -1 ? length : valueEnd) - i - 1;
+                    i = valueEnd == -1 ? length : valueEnd + 1;
+                } else {
+                    // Unquoted value
+                    attribute.valuePosition = i;
+                    while ( i < length && !data[i].isSpace() && data[i] != QLatin1Char('>') &&
+                            data[i] != QLatin1Char('"') && data[i] != QLatin1Char('\'') )
+                    {
+                        ++i;
+                    }
+                    attribute.valueLength = i - attribute.valuePosition;
+                }
+            }
+            m_attributes << attribute;
+        }
+        if ( end == -1 ) {
+            // Unterminated tag or attribute value, do not handle it as tag
+            m_attributes.resize( firstAttribute );
+            ++pos;
+            continue;
+        }
+
+        QVector< Tag > &tags = m_tags[ name ];
+        QVector< int > &open = openTags[ name ];
+        Tag tag;
+        tag.name = name;
+        tag.position = pos;
+        tag.contentsPosition = end + 1;
+        tag.closingPosition = -1;
+        tag.endPosition = end + 1;
+        tag.depth = open.count();
+        tag.selfClosing = selfClosing;
+        tag.firstAttribute = firstAttribute;
+        tag.attributeCount = m_attributes.count() - firstAttribute;
+        if ( !selfClosing ) {
+            open << tags.count();
+        }
+        tags << tag;
+        ++m_tagCount;
+        pos = end + 1;
+
+        // The contents of script and style tags are no HTML, skip to the closing tag
+        if ( !selfClosing && (name == QLatin1String("script") || name == QLatin1String("style")) ) {
+            const int closing = m_document.indexOf( QLatin1String("</") + name, pos,
+                                                    Qt::CaseInsensitive );
+            pos = closing == -1 ? length : closing;
+        }
+    }
+}
+
+bool HtmlTagIndex::isPlainTagName( const QString &tagName )
+{
+    if ( tagName.isEmpty() ) {
+        return false;
+    }
+    for ( int i = 0; i < tagName.length(); ++i ) {
+        if ( !isTagNameCharacter(tagName[i]) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVector< HtmlTagIndex::Tag > HtmlTagIndex::tags( const QString &tagName ) const
+{
+    if ( isPlainTagName(tagName) ) {
+        return m_tags.value( tagName.toLower() );
+    }
+
+    // Use tagName as regular expression, merge tags of all matching names
+    QRegExp tagNameRegExp = RegExpCache::regExp( tagName, Qt::CaseInsensitive );
+    QVector< Tag > tags;
+    for ( QHash<QString, QVector<Tag> >::ConstIterator it = m_tags.constBegin();
+          it != m_tags.constEnd(); ++it )
+    {
+        if ( tagNameRegExp.exactMatch(it.key()) ) {
+            tags << *it;
+        }
+    }
+    qSort( tags.begin(), tags.end(), tagLessThan );
+    return tags;
+}
+
+int HtmlTagIndex::firstTagIndex( const QVector<Tag> &tags, int position )
+{
+    return qLowerBound( tags.constBegin(), tags.constEnd(), position, tagPositionLessThan )
+            - tags.constBegin();
+}
+
+HtmlTagIndex::ClosingTag HtmlTagIndex::nextClosingTag( const QString &tagName,
+                                                       int position ) const
+{
+    const QHash< QString, QVector<ClosingTag> >::ConstIterator it =
+            m_closingTags.constFind( tagName.toLower() );
+    if ( it != m_closingTags.constEnd() ) {
+        const QVector< ClosingTag >::ConstIterator closingIt = qLowerBound(
+                it->constBegin(), it->constEnd(), position, closingTagPositionLessThan );
+        if ( closingIt != it->constEnd() ) {
+            return *closingIt;
+        }
+    }
+
+    ClosingTag closingTag;
+    closingTag.position = -1;
+    closingTag.endPosition = -1;
+    return closingTag;
+}
+
+QVariantMap HtmlTagIndex::attributes( const Tag &tag ) const
+{
+    QVariantMap attributes;
+    for ( int i = tag.firstAttribute; i < tag.firstAttribute + tag.attributeCount; ++i ) {
+        const Attribute &attribute = m_attributes[ i ];
+        attributes.insert( m_document.mid(attribute.namePosition, attribute.nameLength),
+                           m_document.mid(attribute.valuePosition, attribute.valueLength) );
+    }
+    return attributes;
+}
+
+} // namespace ScriptApi
@@ -0,0 +1,147 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains an index of the HTML tags in a document, used by script helpers.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef HTMLTAGINDEX_HEADER
+#define HTMLTAGINDEX_HEADER
+
+// Qt includes
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QVariantMap>
+#include <QSharedPointer>
+
+namespace ScriptApi {
+
+/**
+ * @brief An index of all HTML tags in a document, built in a single pass.
+ *
+ * The document gets tokenized once, all opening tags get stored with their positions and
+ * attributes, ordered by position and grouped by their (lower case) name. Closing tags get
+ * matched with opening tags of the same name using a stack, ie. nested tags with the same
+ * name are handled correctly. Quoted attribute values may contain '>' characters, comments
+ * and the contents of &lt;script&gt;/&lt;style&gt; tags are skipped.
+ *
+ * Helper::findHtmlTags(), Helper::findFirstHtmlTag() and Helper::findNamedHtmlTags() use
+ * forDocument() to get the index for a document. Scripts usually call these functions many
+ * times with the same document (eg. using the "position" option in a loop), therefore the last
+ * used indices get cached for the current thread. ScriptJob clears the cache when it finishes.
+ **/
+class HtmlTagIndex {
+public:
+    typedef QSharedPointer< const HtmlTagIndex > Ptr;
+
+    /** @brief An opening HTML tag in the indexed document. */
+    struct Tag {
+        QString name; /**< The lower case name of the tag. */
+        int position; /**< The position of the '<' of the opening tag. */
+        int contentsPosition; /**< The position of the first character after the opening tag. */
+        int closingPosition; /**< The position of the matching closing tag or -1. */
+        int endPosition; /**< The position after the matching closing tag, if any,
+                            * otherwise the same as contentsPosition. */
+        int depth; /**< The number of enclosing tags with the same name. */
+        bool selfClosing; /**< Whether or not the opening tag ends with "/>". */
+        int firstAttribute; /**< Index of the first attribute of the tag. */
+        int attributeCount; /**< The number of attributes of the tag. */
+    };
+
+    /** @brief A closing HTML tag in the indexed document. */
+    struct ClosingTag {
+        int position; /**< The position of the '<' of the closing tag or -1. */
+        int endPosition; /**< The position of the first character after the closing tag. */
+    };
+
+    /** @brief The maximal number of cached indices per thread. */
+    static const int MAXIMUM_CACHED_DOCUMENTS;
+
+    /** @brief The minimal length of documents for which indices get cached. */
+    static const int MINIMUM_CACHED_DOCUMENT_LENGTH;
+
+    /** @brief Create an index of the HTML tags in @p document. */
+    explicit HtmlTagIndex( const QString &document );
+
+    /**
+     * @brief Get an index for @p document.
+     *
+     * If an index for an equal document was recently used in the current thread, it gets
+     * returned. Otherwise a new index gets created and cached (if @p document is not too short).
+     **/
+    static Ptr forDocument( const QString &document );
+
+    /** @brief Remove all cached indices of the current thread. */
+    static void clearCache();
+
+    /** @brief The indexed document. */
+    const QString &document() const { return m_document; };
+
+    /**
+     * @brief Get all opening tags with @p tagName ordered by position.
+     *
+     * If @p tagName contains characters which are not allowed in HTML tag names, it gets used
+     * as regular expression pattern, which needs to match tag names exactly (case insensitive).
+     **/
+    QVector< Tag > tags( const QString &tagName ) const;
+
+    /** @brief Get the index of the first tag in @p tags at or after @p position. */
+    static int firstTagIndex( const QVector<Tag> &tags, int position );
+
+    /**
+     * @brief Get the first closing tag with @p tagName at or after @p position.
+     *
+     * This does not take nesting into account, use Tag::closingPosition for the matching
+     * closing tag. If there is no such closing tag, ClosingTag::position is -1.
+     **/
+    ClosingTag nextClosingTag( const QString &tagName, int position ) const;
+
+    /**
+     * @brief Get the attributes of @p tag.
+     *
+     * The attribute names are the keys of the returned map, with the attribute values as values.
+     * Attributes without value get an empty string as value.
+     **/
+    QVariantMap attributes( const Tag &tag ) const;
+
+    /** @brief The number of indexed opening tags. */
+    int tagCount() const { return m_tagCount; };
+
+private:
+    struct Attribute {
+        int namePosition;
+        int nameLength;
+        int valuePosition;
+        int valueLength;
+    };
+
+    void parse();
+    static bool isPlainTagName( const QString &tagName );
+
+    const QString m_document;
+    QHash< QString, QVector<Tag> > m_tags; // Opening tags by lower case name
+    QHash< QString, QVector<ClosingTag> > m_closingTags; // Closing tags by lower case name
+    QVector< Attribute > m_attributes;
+    int m_tagCount;
+};
+
+} // namespace ScriptApi
+
+#endif // Multiple inclusion guard
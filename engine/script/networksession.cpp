@@ -0,0 +1,249 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "networksession.h"
+
+// Own includes
+#include "sharednetworkcache.h"
+
+// KDE includes
+#include <KGlobal>
+#include <KDebug>
+
+// Qt includes
+#include <QNetworkReply>
+#include <QThread>
+#include <QElapsedTimer>
+
+const int NetworkSession::DEFAULT_MAXIMUM_REQUESTS_PER_HOST = 8;
+
+// Maximal time in milliseconds to wait for a free request slot, the cap gets ignored afterwards.
+// Prevents dead locks if a job waits for a slot that is used by a hanging request of the same
+// job, which can only be aborted by a timer of the waiting job thread.
+static const int MAXIMUM_SLOT_WAIT_TIME = 10000;
+
+class NetworkSessionRegistry {
+public:
+    NetworkSessionRegistry() : thread(new QThread()) {
+        thread->setObjectName( "NetworkSessionThread" );
+        thread->start();
+    };
+
+    ~NetworkSessionRegistry() {
+        // Stop the network thread, sessions get deleted directly afterwards
+        thread->quit();
+        thread->wait();
+        sessions.clear();
+        delete thread;
+    };
+
+    QMutex mutex;
+    QThread *thread;
+    QHash< QString, NetworkSession::Ptr > sessions; // Sessions by provider ID
+};
+
+K_GLOBAL_STATIC( NetworkSessionRegistry, sessionRegistry )
+
+// Deleter for NetworkSession::Ptr, sessions live in the network thread
+static void deleteSession( NetworkSession *session )
+{
+    if ( !sessionRegistry.isDestroyed() && session->thread()->isRunning() ) {
+        session->deleteLater();
+    } else {
+        delete session;
+    }
+}
+
+NetworkSession::NetworkSession( bool useCache )
+        : QObject(), m_manager(new QNetworkAccessManager(this)),
+          m_maximumRequestsPerHost(DEFAULT_MAXIMUM_REQUESTS_PER_HOST)
+{
+    setCacheEnabled( useCache );
+}
+
+NetworkSession::~NetworkSession()
+{
+}
+
+NetworkSession::Ptr NetworkSession::create( bool useCache )
+{
+    NetworkSession *session = new NetworkSession( useCache );
+
+    // Move the session and it's manager to the network thread,
+    // it has not processed any events or requests yet
+    session->moveToThread( sessionRegistry->thread );
+    return Ptr( session, deleteSession );
+}
+
+NetworkSession::Ptr NetworkSession::forProvider( const QString &providerId, bool useCache )
+{
+    QMutexLocker locker( &sessionRegistry->mutex );
+    Ptr session = sessionRegistry->sessions.value( providerId );
+    if ( session ) {
+        // The provider may have been modified, update the cache setting in the network thread
+        QMetaObject::invokeMethod( session.data(), "setCacheEnabled", Qt::QueuedConnection,
+                                   Q_ARG(bool, useCache) );
+    } else {
+        session = create( useCache );
+        sessionRegistry->sessions.insert( providerId, session );
+    }
+    return session;
+}
+
+void NetworkSession::setCacheEnabled( bool useCache )
+{
+    if ( useCache == (m_manager->cache() != 0) ) {
+        return;
+    }
+
+    // The manager takes ownership of the cache object and deletes a previously set cache
+    m_manager->setCache( useCache ? new SharedNetworkCache() : 0 );
+}
+
+QNetworkReply *NetworkSession::get( const QNetworkRequest &request )
+{
+    return dispatch( QNetworkAccessManager::GetOperation, request );
+}
+
+QNetworkReply *NetworkSession::head( const QNetworkRequest &request )
+{
+    return dispatch( QNetworkAccessManager::HeadOperation, request );
+}
+
+QNetworkReply *NetworkSession::post( const QNetworkRequest &request, const QByteArray &data )
+{
+    return dispatch( QNetworkAccessManager::PostOperation, request, data );
+}
+
+QNetworkReply *NetworkSession::dispatch( QNetworkAccessManager::Operation operation,
+                                         const QNetworkRequest &request,
+                                         const QByteArray &data )
+{
+    if ( QThread::currentThread() == thread() ) {
+        // Called from the network thread, waiting for a free slot would block forever
+        return createReply( operation, request, data );
+    }
+
+    // Wait until there is a free request slot for the host
+    const QString host = request.url().host();
+    m_mutex.lock();
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+    while ( m_runningRequests.value(host) >= m_maximumRequestsPerHost ) {
+        const qint64 remainingTime = MAXIMUM_SLOT_WAIT_TIME - waitTimer.elapsed();
+        if ( remainingTime <= 0 ) {
+            kDebug() << "Waited too long for a free request slot for" << host;
+            break;
+        }
+        m_requestFinished.wait( &m_mutex, remainingTime );
+    }
+    m_mutex.unlock();
+
+    // Create the reply in the network thread and wait for it
+    QNetworkReply *reply = 0;
+    QMetaObject::invokeMethod( this, "createReply", Qt::BlockingQueuedConnection,
+                               Q_RETURN_ARG(QNetworkReply*, reply),
+                               Q_ARG(int, operation), Q_ARG(QNetworkRequest, request),
+                               Q_ARG(QByteArray, data) );
+    return reply;
+}
+
+QNetworkReply *NetworkSession::createReply( int operation, const QNetworkRequest &request,
+                                            const QByteArray &data )
+{
+    QNetworkReply *reply;
+    switch ( operation ) {
+    case QNetworkAccessManager::GetOperation: {
+        // Allow to send multiple GET requests on one connection without waiting for replies
+        QNetworkRequest pipelinedRequest( request );
+        pipelinedRequest.setAttribute( QNetworkRequest::HttpPipeliningAllowedAttribute, true );
+        reply = m_manager->get( pipelinedRequest );
+        break;
+    } case QNetworkAccessManager::HeadOperation:
+        reply = m_manager->head( request );
+        break;
+    case QNetworkAccessManager::PostOperation:
+        reply = m_manager->post( request, data );
+        break;
+    default:
+        kWarning() << "Unsupported network operation" << operation;
+        return 0;
+    }
+
+    const QString host = request.url().host();
+    m_mutex.lock();
+    ++m_runningRequests[ host ];
+    m_replyHosts.insert( reply, host );
+    m_mutex.unlock();
+
+    connect( reply, SIGNAL(finished()), this, SLOT(replyFinished()) );
+    connect( reply, SIGNAL(destroyed(QObject*)), this, SLOT(replyDestroyed(QObject*)) );
+    return reply;
+}
+
+void NetworkSession::replyFinished()
+{
+    QMutexLocker locker( &m_mutex );
+    releaseRequest( sender() );
+}
+
+void NetworkSession::replyDestroyed( QObject *reply )
+{
+    // Only releases the request, if the reply was deleted before it finished
+    QMutexLocker locker( &m_mutex );
+    releaseRequest( reply );
+}
+
+void NetworkSession::releaseRequest( QObject *reply )
+{
+    QHash< QObject*, QString >::Iterator it = m_replyHosts.find( reply );
+    if ( it == m_replyHosts.end() ) {
+        // Already released
+        return;
+    }
+
+    const QString host = *it;
+    m_replyHosts.erase( it );
+    if ( --m_runningRequests[host] <= 0 ) {
+        m_runningRequests.remove( host );
+    }
+    m_requestFinished.wakeAll();
+}
+
+int NetworkSession::maximumRequestsPerHost() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_maximumRequestsPerHost;
+}
+
+void NetworkSession::setMaximumRequestsPerHost( int maximumRequests )
+{
+    QMutexLocker locker( &m_mutex );
+    m_maximumRequestsPerHost = qMax( 1, maximumRequests );
+    m_requestFinished.wakeAll();
+}
+
+int NetworkSession::runningRequestCount( const QString &host ) const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_runningRequests.value( host );
+}
+
+#include "networksession.moc"
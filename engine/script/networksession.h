@@ -0,0 +1,133 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the network session used by all script jobs of a provider.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef NETWORKSESSION_HEADER
+#define NETWORKSESSION_HEADER
+
+// Qt includes
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+
+class QNetworkReply;
+
+/**
+ * @brief A long-lived QNetworkAccessManager, shared by all script jobs of a provider.
+ *
+ * QNetworkAccessManager keeps HTTP connections open (keep-alive) and reuses them for later
+ * requests to the same host, but only for requests of the same manager object. Script jobs
+ * are short-lived and run in different threads, a manager created by a job would need a new
+ * TCP/TLS handshake for each request. Therefore the manager of a session lives in a dedicated
+ * network thread. Use forProvider() to get the session of a provider, which stays alive until
+ * the data engine gets unloaded.
+ *
+ * Requests can be started from any thread using get(), head() and post(), they get dispatched
+ * into the network thread. The created QNetworkReply objects also live in the network thread.
+ * Their signals can be connected to objects in other threads using queued connections, but
+ * the reply should only be read after it emitted finished(). Use QMetaObject::invokeMethod()
+ * to abort a reply from another thread.
+ *
+ * At most maximumRequestsPerHost() requests run concurrently for each host, if more requests
+ * get started the calling thread waits until a running request to the host has finished.
+ * Callers should therefore not hold locks needed by other threads while starting requests.
+ * QNetworkAccessManager opens up to six connections per host, GET requests of a session are
+ * allowed to get pipelined on these connections, if the server supports it.
+ **/
+class NetworkSession : public QObject {
+    Q_OBJECT
+
+public:
+    typedef QSharedPointer< NetworkSession > Ptr;
+
+    /** @brief The default maximal number of concurrently running requests per host. */
+    static const int DEFAULT_MAXIMUM_REQUESTS_PER_HOST;
+
+    /** @brief Destructor. */
+    virtual ~NetworkSession();
+
+    /**
+     * @brief Get the session for the provider with @p providerId.
+     *
+     * The session gets created if it does not exist yet.
+     * @param providerId The ID of the provider for which to get the session.
+     * @param useCache Whether or not to use the HTTP cache shared by all sessions,
+     *   see SharedNetworkCache.
+     **/
+    static Ptr forProvider( const QString &providerId, bool useCache = true );
+
+    /**
+     * @brief Create a new session, which is not shared with providers.
+     *
+     * @param useCache Whether or not to use the HTTP cache shared by all sessions.
+     **/
+    static Ptr create( bool useCache = false );
+
+    /** @brief Start a GET request, can be called from any thread. */
+    QNetworkReply *get( const QNetworkRequest &request );
+
+    /** @brief Start a HEAD request, can be called from any thread. */
+    QNetworkReply *head( const QNetworkRequest &request );
+
+    /** @brief Start a POST request sending @p data, can be called from any thread. */
+    QNetworkReply *post( const QNetworkRequest &request, const QByteArray &data );
+
+    /** @brief The maximal number of concurrently running requests per host. */
+    int maximumRequestsPerHost() const;
+
+    /** @brief Set the maximal number of concurrently running requests per host. */
+    void setMaximumRequestsPerHost( int maximumRequests );
+
+    /** @brief The number of currently running requests to @p host. */
+    int runningRequestCount( const QString &host ) const;
+
+protected slots:
+    // Called in the network thread
+    QNetworkReply *createReply( int operation, const QNetworkRequest &request,
+                                const QByteArray &data );
+    void setCacheEnabled( bool useCache );
+    void replyFinished();
+    void replyDestroyed( QObject *reply );
+
+private:
+    explicit NetworkSession( bool useCache );
+
+    QNetworkReply *dispatch( QNetworkAccessManager::Operation operation,
+                             const QNetworkRequest &request,
+                             const QByteArray &data = QByteArray() );
+
+    // Decrease the running request count of the host of @p reply, m_mutex needs to be locked
+    void releaseRequest( QObject *reply );
+
+    QNetworkAccessManager *m_manager;
+    mutable QMutex m_mutex;
+    QWaitCondition m_requestFinished;
+    int m_maximumRequestsPerHost;
+    QHash< QString, int > m_runningRequests; // Running request counts by host
+    QHash< QObject*, QString > m_replyHosts;
+};
+
+#endif // Multiple inclusion guard
@@ -0,0 +1,382 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "persistentstorage.h"
+
+// KDE includes
+#include <KSaveFile>
+#include <KDebug>
+
+// Qt includes
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStringList>
+
+namespace ScriptApi {
+
+const quint32 PersistentStorage::STORAGE_MAGIC = 0x50545354; // "PTST"
+const quint32 PersistentStorage::STORAGE_VERSION = 1;
+const int PersistentStorage::MINIMUM_COMPACTION_RECORDS = 64;
+
+PersistentStorage::FileLocker::FileLocker( PersistentStorage *storage, bool wait )
+        : m_storage(storage), m_locked(false)
+{
+    if ( m_storage->m_lockDepth > 0 ) {
+        // Already locked by an outer FileLocker
+        ++m_storage->m_lockDepth;
+        m_locked = true;
+        return;
+    }
+
+    // Stale locks of crashed processes get removed
+    KLockFile::LockFlags flags = KLockFile::ForceFlag;
+    if ( !wait ) {
+        flags |= KLockFile::NoBlockFlag;
+    }
+    const KLockFile::LockResult result = m_storage->m_lockFile->lock( flags );
+    if ( result == KLockFile::LockOK ) {
+        m_storage->m_lockDepth = 1;
+        m_locked = true;
+    } else if ( wait || result != KLockFile::LockFail ) {
+        kWarning() << "Cannot lock storage file" << m_storage->m_fileName << result;
+    }
+}
+
+PersistentStorage::FileLocker::~FileLocker()
+{
+    if ( m_locked && --m_storage->m_lockDepth == 0 ) {
+        m_storage->m_lockFile->unlock();
+    }
+}
+
+PersistentStorage::PersistentStorage( const QString &fileName )
+        : m_fileName(fileName), m_lockFile(new KLockFile(fileName + QLatin1String(".lock"))),
+          m_lockDepth(0), m_loaded(false), m_fileSize(0), m_recordCount(0)
+{
+}
+
+bool PersistentStorage::exists() const
+{
+    return QFile::exists( m_fileName );
+}
+
+bool PersistentStorage::contains( const QString &name )
+{
+    update();
+    const QHash< QString, Entry >::ConstIterator it = m_entries.constFind( name );
+    return it != m_entries.constEnd() &&
+           it->expirationTime > QDateTime::currentDateTime().toTime_t();
+}
+
+QVariant PersistentStorage::value( const QString &name, const QVariant &defaultValue )
+{
+    update();
+    const QHash< QString, Entry >::ConstIterator it = m_entries.constFind( name );
+    if ( it == m_entries.constEnd() ||
+         it->expirationTime <= QDateTime::currentDateTime().toTime_t() )
+    {
+        return defaultValue;
+    }
+    return it->value;
+}
+
+uint PersistentStorage::expirationTime( const QString &name )
+{
+    update();
+    return m_entries.value( name ).expirationTime;
+}
+
+QStringList PersistentStorage::names()
+{
+    update();
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    QStringList names;
+    for ( QHash<QString, Entry>::ConstIterator it = m_entries.constBegin();
+          it != m_entries.constEnd(); ++it )
+    {
+        if ( it->expirationTime > now ) {
+            names << it.key();
+        }
+    }
+    return names;
+}
+
+bool PersistentStorage::insert( const QString &name, const QVariant &value,
+                                uint expirationTime )
+{
+    if ( value.type() >= QVariant::LastCoreType ) {
+        kDebug() << "Invalid data type, only QVariant core types are supported" << value.type();
+        return false;
+    }
+
+    FileLocker locker( this );
+    if ( !locker.isLocked() ) {
+        return false;
+    }
+
+    update();
+    const Entry entry( value, expirationTime );
+    if ( !appendRecord(InsertRecord, name, entry) ) {
+        return false;
+    }
+    m_entries.insert( name, entry );
+    compactIfNeeded();
+    return true;
+}
+
+void PersistentStorage::remove( const QString &name )
+{
+    FileLocker locker( this );
+    if ( !locker.isLocked() ) {
+        return;
+    }
+
+    update();
+    if ( m_entries.remove(name) > 0 ) {
+        appendRecord( RemoveRecord, name );
+        compactIfNeeded();
+    }
+}
+
+void PersistentStorage::clear()
+{
+    FileLocker locker( this );
+    if ( !locker.isLocked() ) {
+        return;
+    }
+
+    update();
+    m_entries.clear();
+    if ( !compact() ) {
+        appendRecord( ClearRecord );
+    }
+}
+
+void PersistentStorage::removeExpired()
+{
+    FileLocker locker( this );
+    if ( !locker.isLocked() ) {
+        return;
+    }
+
+    update();
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    QHash< QString, Entry >::Iterator it = m_entries.begin();
+    while ( it != m_entries.end() ) {
+        if ( it->expirationTime <= now ) {
+            kDebug() << "Lifetime of storage data" << it.key() << "has expired";
+            it = m_entries.erase( it );
+        } else {
+            ++it;
+        }
+    }
+    compactIfNeeded();
+}
+
+void PersistentStorage::update()
+{
+    if ( !m_loaded || QFileInfo(m_fileName).size() != m_fileSize ) {
+        // Lock the file while reading it, if no other process holds the lock.
+        // Reading does not wait for the lock, the file only gets read again later
+        // if another process has not finished writing
+        FileLocker locker( this, false );
+        load();
+    }
+}
+
+void PersistentStorage::load()
+{
+    m_loaded = true;
+    m_entries.clear();
+    m_fileSize = 0;
+    m_recordCount = 0;
+
+    QFile file( m_fileName );
+    if ( !file.exists() ) {
+        return;
+    }
+
+    // Without the lock another process may currently write to the file, do not change it then
+    const bool locked = m_lockDepth > 0;
+    if ( !file.open(locked ? QIODevice::ReadWrite : QIODevice::ReadOnly) ) {
+        kWarning() << "Cannot open storage file" << m_fileName << file.errorString();
+        m_fileSize = file.size(); // Do not try again until the file gets changed
+        return;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    quint32 magic, version;
+    stream >> magic >> version;
+    if ( stream.status() != QDataStream::Ok ||
+         magic != STORAGE_MAGIC || version != STORAGE_VERSION )
+    {
+        if ( locked ) {
+            kDebug() << "Discard invalid storage file" << m_fileName;
+            file.resize( 0 );
+        } else {
+            // Read the file again before the next access, eg. if another process is currently
+            // writing the header into a new file
+            kDebug() << "Invalid storage file, the file is not locked" << m_fileName;
+            m_fileSize = -1;
+        }
+        return;
+    }
+
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    qint64 validSize = file.pos();
+    while ( !stream.atEnd() ) {
+        QByteArray record;
+        stream >> record;
+        if ( stream.status() != QDataStream::Ok ) {
+            kDebug() << "Incomplete record at the end of storage file" << m_fileName;
+            break;
+        }
+        validSize = file.pos();
+        ++m_recordCount;
+
+        QDataStream recordStream( record );
+        recordStream.setVersion( QDataStream::Qt_4_6 );
+        quint8 type;
+        QString name;
+        recordStream >> type;
+        switch ( type ) {
+        case InsertRecord: {
+            Entry entry;
+            recordStream >> name >> entry.expirationTime >> entry.value;
+            if ( recordStream.status() == QDataStream::Ok && entry.expirationTime > now ) {
+                m_entries.insert( name, entry );
+            } else {
+                // Expired values get dropped with the next compaction
+                m_entries.remove( name );
+            }
+            break;
+        } case RemoveRecord:
+            recordStream >> name;
+            m_entries.remove( name );
+            break;
+        case ClearRecord:
+            m_entries.clear();
+            break;
+        default:
+            kDebug() << "Unknown record type" << type << "in storage file" << m_fileName;
+            break;
+        }
+    }
+
+    // Remove an incomplete record, new records get appended after the last valid one.
+    // If the file is not locked, the record may currently get appended by another process,
+    // then the file gets read again before the next access, because the size differs
+    if ( locked && validSize < file.size() ) {
+        file.resize( validSize );
+    }
+    m_fileSize = validSize;
+}
+
+QByteArray PersistentStorage::encodeRecord( RecordType type, const QString &name,
+                                            const Entry &entry )
+{
+    QByteArray record;
+    QDataStream stream( &record, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream << static_cast<quint8>( type );
+    if ( type != ClearRecord ) {
+        stream << name;
+    }
+    if ( type == InsertRecord ) {
+        stream << static_cast<quint32>( entry.expirationTime ) << entry.value;
+    }
+    return record;
+}
+
+bool PersistentStorage::appendRecord( RecordType type, const QString &name, const Entry &entry )
+{
+    QFile file( m_fileName );
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Append) ) {
+        kWarning() << "Cannot write storage file" << m_fileName << file.errorString();
+        return false;
+    }
+
+    // Write the header into new files and the record in one call
+    const qint64 sizeBefore = file.size();
+    QByteArray data;
+    QDataStream stream( &data, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    if ( sizeBefore == 0 ) {
+        stream << STORAGE_MAGIC << STORAGE_VERSION;
+    }
+    stream << encodeRecord( type, name, entry );
+    if ( file.write(data) != data.length() ) {
+        kWarning() << "Cannot write storage file" << m_fileName << file.errorString();
+        m_fileSize = -1; // Read the file again before the next access
+        return false;
+    }
+
+    // If another process has changed the file, it gets read again before the next access
+    m_fileSize = sizeBefore == m_fileSize ? sizeBefore + data.length() : -1;
+    ++m_recordCount;
+    return true;
+}
+
+void PersistentStorage::compactIfNeeded()
+{
+    if ( m_recordCount >= MINIMUM_COMPACTION_RECORDS && m_recordCount > 2 * m_entries.count() ) {
+        compact();
+    }
+}
+
+bool PersistentStorage::compact()
+{
+    // Write the current values into a new file, which replaces the old one
+    KSaveFile file( m_fileName );
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        kWarning() << "Cannot write storage file" << m_fileName << file.errorString();
+        return false;
+    }
+
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    QByteArray data;
+    QDataStream stream( &data, QIODevice::WriteOnly );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream << STORAGE_MAGIC << STORAGE_VERSION;
+    int recordCount = 0;
+    for ( QHash<QString, Entry>::ConstIterator it = m_entries.constBegin();
+          it != m_entries.constEnd(); ++it )
+    {
+        if ( it->expirationTime > now ) {
+            stream << encodeRecord( InsertRecord, it.key(), *it );
+            ++recordCount;
+        }
+    }
+
+    if ( file.write(data) != data.length() || !file.finalize() ) {
+        kWarning() << "Cannot write storage file" << m_fileName << file.errorString();
+        file.abort();
+        return false;
+    }
+
+    m_fileSize = data.length();
+    m_recordCount = recordCount;
+    return true;
+}
+
+} // namespace ScriptApi
@@ -0,0 +1,166 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the binary key-value store used for persistent script storage.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef PERSISTENTSTORAGE_HEADER
+#define PERSISTENTSTORAGE_HEADER
+
+// KDE includes
+#include <KLockFile>
+
+// Qt includes
+#include <QString>
+#include <QVariant>
+#include <QHash>
+#include <QStringList>
+
+namespace ScriptApi {
+
+/**
+ * @brief A binary key-value store in a file, with a lifetime for each value.
+ *
+ * Used by Storage for the persistent data of one provider. Each change gets appended to the
+ * file as a record, the file never gets rewritten for single changes. All values get read into
+ * memory when the store is used the first time. Values get serialized using QDataStream, ie.
+ * there is no length limit and no string encoding as for KConfig.
+ *
+ * Expired values are handled lazily, they are treated as not existing and get dropped when
+ * the file gets compacted. The file gets compacted, ie. rewritten with only the current values,
+ * if it contains more than twice as many records as values (and at least
+ * MINIMUM_COMPACTION_RECORDS records).
+ *
+ * If the file was changed by another process (the size differs from the expected size),
+ * it gets read again before the next access. The engine and eg. TimetableMate can use the same
+ * file, all changes to the file are done while holding an advisory lock (a KLockFile next to
+ * the file). Reading the file also takes the lock, if it is free. An incomplete record at the end
+ * of the file, eg. after a crash while writing, only gets removed while holding the lock,
+ * otherwise it may be a record that another process is currently appending.
+ *
+ * @note This class is not thread safe, Storage protects it with a lock.
+ **/
+class PersistentStorage {
+public:
+    /** @brief Identifies storage files, written at the beginning of the file. */
+    static const quint32 STORAGE_MAGIC;
+
+    /** @brief The version of the file format, files with other versions get discarded. */
+    static const quint32 STORAGE_VERSION;
+
+    /** @brief The minimal number of records in the file before it gets compacted. */
+    static const int MINIMUM_COMPACTION_RECORDS;
+
+    /** @brief Create a store using the file @p fileName, which gets created if needed. */
+    explicit PersistentStorage( const QString &fileName );
+
+    /** @brief The name of the used file. */
+    QString fileName() const { return m_fileName; };
+
+    /** @brief Whether or not the file of the store exists. */
+    bool exists() const;
+
+    /** @brief Whether or not there is a value with @p name, which has not expired. */
+    bool contains( const QString &name );
+
+    /** @brief Get the value with @p name or @p defaultValue if there is no such value. */
+    QVariant value( const QString &name, const QVariant &defaultValue = QVariant() );
+
+    /** @brief The expiration time (as time_t) of the value with @p name or 0. */
+    uint expirationTime( const QString &name );
+
+    /** @brief Get the names of all values that have not expired. */
+    QStringList names();
+
+    /**
+     * @brief Store @p value with @p name.
+     *
+     * @param name The name of the value to store.
+     * @param value The value to store, only QVariant core types are supported.
+     * @param expirationTime The time (as time_t) after which the value gets removed.
+     * @return True, if the value was written, false otherwise.
+     **/
+    bool insert( const QString &name, const QVariant &value, uint expirationTime );
+
+    /** @brief Remove the value with @p name. */
+    void remove( const QString &name );
+
+    /** @brief Remove all values. */
+    void clear();
+
+    /** @brief Remove expired values from memory, compacts the file if needed. */
+    void removeExpired();
+
+private:
+    enum RecordType {
+        InsertRecord = 1,
+        RemoveRecord = 2,
+        ClearRecord = 3
+    };
+
+    struct Entry {
+        Entry( const QVariant &value = QVariant(), uint expirationTime = 0 )
+                : value(value), expirationTime(expirationTime) {};
+
+        QVariant value;
+        uint expirationTime; // as time_t
+    };
+
+    // Locks the file for the lifetime of the FileLocker, if possible. If @p wait is false and
+    // another process holds the lock, the file does not get locked.
+    // Can be nested, the file gets unlocked when the outermost FileLocker gets destroyed
+    class FileLocker {
+    public:
+        explicit FileLocker( PersistentStorage *storage, bool wait = true );
+        ~FileLocker();
+        bool isLocked() const { return m_locked; };
+
+    private:
+        PersistentStorage *m_storage;
+        bool m_locked;
+    };
+    friend class FileLocker;
+
+    // Read the file if it was not read yet or if it was changed by another process
+    void update();
+
+    // Read the file, an incomplete record at the end only gets removed if the file is locked
+    void load();
+
+    // The following functions expect the file to be locked
+    bool appendRecord( RecordType type, const QString &name = QString(),
+                       const Entry &entry = Entry() );
+    void compactIfNeeded();
+    bool compact();
+
+    static QByteArray encodeRecord( RecordType type, const QString &name, const Entry &entry );
+
+    const QString m_fileName;
+    KLockFile::Ptr m_lockFile;
+    int m_lockDepth; // The number of existing FileLocker objects which locked the file
+    QHash< QString, Entry > m_entries;
+    bool m_loaded;
+    qint64 m_fileSize; // The expected size of the file
+    int m_recordCount; // The number of records in the file
+};
+
+} // namespace ScriptApi
+
+#endif // Multiple inclusion guard
@@ -0,0 +1,115 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "regexpcache.h"
+
+// KDE includes
+#include <KGlobal>
+
+// Qt includes
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace ScriptApi {
+
+const int RegExpCache::MAXIMUM_SIZE = 256;
+
+struct RegExpCacheKey {
+    RegExpCacheKey( const QString &pattern, Qt::CaseSensitivity caseSensitivity, bool minimal,
+                    QRegExp::PatternSyntax syntax )
+            : pattern(pattern),
+              options((caseSensitivity == Qt::CaseSensitive ? 1 : 0) | (minimal ? 2 : 0) |
+                      (static_cast<int>(syntax) << 2)) {};
+
+    bool operator ==( const RegExpCacheKey &other ) const {
+        return options == other.options && pattern == other.pattern;
+    };
+
+    QString pattern;
+    int options;
+};
+
+inline uint qHash( const RegExpCacheKey &key )
+{
+    return qHash( key.pattern ) ^ key.options;
+}
+
+class RegExpCacheData {
+public:
+    RegExpCacheData() : cache(RegExpCache::MAXIMUM_SIZE) {};
+
+    QMutex mutex;
+    QCache< RegExpCacheKey, QRegExp > cache; // Uses a cost of 1 for each regular expression
+    QAtomicInt hitCount;
+    QAtomicInt missCount;
+};
+
+K_GLOBAL_STATIC( RegExpCacheData, regExpCacheData )
+
+QRegExp RegExpCache::regExp( const QString &pattern, Qt::CaseSensitivity caseSensitivity,
+                             bool minimal, QRegExp::PatternSyntax syntax )
+{
+    const RegExpCacheKey key( pattern, caseSensitivity, minimal, syntax );
+    {
+        // QCache::object() also marks the regular expression as recently used
+        QMutexLocker locker( &regExpCacheData->mutex );
+        const QRegExp *cachedRegExp = regExpCacheData->cache.object( key );
+        if ( cachedRegExp ) {
+            regExpCacheData->hitCount.ref();
+            return *cachedRegExp;
+        }
+    }
+
+    // Compile the pattern without holding the lock,
+    // copying the QRegExp compiles it and shares the compiled pattern with the copy
+    QRegExp *regExp = new QRegExp( pattern, caseSensitivity, syntax );
+    regExp->setMinimal( minimal );
+    const QRegExp result = *regExp;
+
+    QMutexLocker locker( &regExpCacheData->mutex );
+    regExpCacheData->missCount.ref();
+    regExpCacheData->cache.insert( key, regExp );
+    return result;
+}
+
+int RegExpCache::hitCount()
+{
+    return regExpCacheData->hitCount;
+}
+
+int RegExpCache::missCount()
+{
+    return regExpCacheData->missCount;
+}
+
+int RegExpCache::count()
+{
+    QMutexLocker locker( &regExpCacheData->mutex );
+    return regExpCacheData->cache.count();
+}
+
+void RegExpCache::clear()
+{
+    QMutexLocker locker( &regExpCacheData->mutex );
+    regExpCacheData->cache.clear();
+}
+
+} // namespace ScriptApi
@@ -0,0 +1,78 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains a cache of compiled regular expressions used by script helpers.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef REGEXPCACHE_HEADER
+#define REGEXPCACHE_HEADER
+
+// Qt includes
+#include <QRegExp>
+
+namespace ScriptApi {
+
+/**
+ * @brief A process wide cache of compiled regular expressions.
+ *
+ * The script helper functions get called many times with the same patterns, eg. for each
+ * found HTML tag in Helper::findHtmlTags() or for each time string in Helper::matchTime().
+ * Instead of constructing a new QRegExp object, which needs to parse the pattern again,
+ * use regExp() to get a copy of a cached QRegExp object. Copies share the compiled pattern
+ * but not the match state, ie. the returned object can be used independently in any thread.
+ *
+ * The cache is bounded to MAXIMUM_SIZE regular expressions, the least recently used
+ * regular expressions get removed first. Cache hits and misses get counted, TimetableMate
+ * shows them in the statistics after each script run.
+ **/
+class RegExpCache {
+public:
+    /** @brief The maximal number of cached regular expressions. */
+    static const int MAXIMUM_SIZE;
+
+    /**
+     * @brief Get a regular expression for @p pattern, compiled only once.
+     *
+     * @param pattern The pattern of the regular expression.
+     * @param caseSensitivity Whether or not the regular expression should match case sensitive.
+     * @param minimal Whether or not the regular expression should use minimal matching.
+     * @param syntax The syntax of @p pattern.
+     **/
+    static QRegExp regExp( const QString &pattern,
+                           Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive,
+                           bool minimal = false,
+                           QRegExp::PatternSyntax syntax = QRegExp::RegExp );
+
+    /** @brief The number of regular expressions that were found in the cache. */
+    static int hitCount();
+
+    /** @brief The number of regular expressions that needed to be compiled. */
+    static int missCount();
+
+    /** @brief The number of currently cached regular expressions. */
+    static int count();
+
+    /** @brief Remove all regular expressions from the cache. */
+    static void clear();
+};
+
+} // namespace ScriptApi
+
+#endif // Multiple inclusion guard
@@ -23,6 +23,7 @@
 // Own includes
 #include "config.h"
 #include "scriptapi.h"
+#include "htmltagindex.h"
 #include "script/serviceproviderscript.h"
 #include "serviceproviderdata.h"
 #include "request.h"
@@ -47,11 +48,14 @@
 #include <QEventLoop>
 #include <QFileInfo>
 #include <QApplication>
+#include <QThread>
 
 ScriptJob::ScriptJob( const ScriptData &data, const QSharedPointer< Storage > &scriptStorage,
                       QObject* parent )
-    : ThreadWeaver::Job(parent), m_engine(0), m_mutex(new QMutex(QMutex::Recursive)),
-      m_data(data), m_eventLoop(0), m_published(0), m_quit(false), m_success(true)
+    : ThreadWeaver::Job(parent), m_engine(0), m_enginePool(0),
+      m_mutex(new QMutex(QMutex::Recursive)),
+      m_data(data), m_eventLoop(0), m_queueWaitTime(-1), m_priority(0), m_published(0),
+      m_publishedChunks(0), m_quit(false), m_success(true)
 {
     Q_ASSERT_X( data.isValid(), "ScriptJob constructor", "Needs valid script data" );
 
@@ -145,6 +149,9 @@ void ScriptAgent::checkExecution()
 void ScriptJob::run()
 {
     m_mutex->lock();
+    if ( m_queueTimer.isValid() ) {
+        m_queueWaitTime = m_queueTimer.elapsed();
+    }
     if ( !loadScript(m_data.program) ) {
         kDebug() << "Script could not be loaded correctly";
         m_mutex->unlock();
@@ -280,8 +287,8 @@ void ScriptJob::run()
         }
     }
 
-    // Publish remaining items, if any
-    publish();
+    // Publish remaining items, if any, and mark the results complete
+    publishChunk( true );
 
     // Cleanup
     cleanup();
@@ -296,12 +303,55 @@ void ScriptJob::cleanup()
     if ( !m_objects.result.isNull() ) {
         disconnect( m_objects.result.data(), 0, this, 0 );
     }
+
+    // Free indices of documents parsed by the script in this thread
+    ScriptApi::HtmlTagIndex::clearCache();
     if ( m_engine ) {
-        m_engine->deleteLater();
+        // Reuse the engine only if the job finished successfully and nothing is left running
+        const bool reusable = m_enginePool && m_success && !m_quit &&
+                m_engine->thread() == QThread::currentThread() &&
+                !m_engine->isEvaluating() && !m_engine->hasUncaughtException() &&
+                (m_objects.network.isNull() || !m_objects.network->hasRunningRequests());
+        if ( reusable ) {
+            m_enginePool->release( m_engine );
+        } else {
+            m_engine->deleteLater();
+        }
         m_engine = 0;
     }
 }
 
+void ScriptJob::setEnginePool( ScriptEnginePool *enginePool )
+{
+    QMutexLocker locker( m_mutex );
+    m_enginePool = enginePool;
+}
+
+int ScriptJob::priority() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_priority;
+}
+
+void ScriptJob::setPriority( int priority )
+{
+    QMutexLocker locker( m_mutex );
+    m_priority = priority;
+}
+
+void ScriptJob::markEnqueued()
+{
+    QMutexLocker locker( m_mutex );
+    m_queueTimer.start();
+    m_queueWaitTime = -1;
+}
+
+qint64 ScriptJob::queueWaitTime() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_queueWaitTime;
+}
+
 void ScriptJob::handleError( const QString &errorMessage )
 {
     QMutexLocker locker( m_mutex );
@@ -349,6 +399,196 @@ bool importExtension( QScriptEngine *engine, const QString &extension )
     }
 }
 
+const int ScriptEnginePool::DEFAULT_MAXIMUM_IDLE_ENGINES = 2;
+const int ScriptEnginePool::DEFAULT_IDLE_TIMEOUT = 5 * 60 * 1000; // 5 minutes
+
+ScriptEnginePool::ScriptEnginePool( QObject *parent )
+        : QObject(parent), m_evictionTimer(new QTimer(this)), m_evictionScheduled(false),
+          m_maximumIdleEngines(DEFAULT_MAXIMUM_IDLE_ENGINES), m_idleTimeout(DEFAULT_IDLE_TIMEOUT)
+{
+    m_evictionTimer->setSingleShot( true );
+    connect( m_evictionTimer, SIGNAL(timeout()), this, SLOT(evictIdleEngines()) );
+}
+
+ScriptEnginePool::~ScriptEnginePool()
+{
+    QMutexLocker locker( &m_mutex );
+    foreach ( const IdleEngine &idleEngine, m_idleEngines ) {
+        delete idleEngine.engine;
+    }
+}
+
+QScriptEngine *ScriptEnginePool::acquire()
+{
+    QMutexLocker locker( &m_mutex );
+    if ( m_idleEngines.isEmpty() ) {
+        return 0;
+    }
+
+    // Use the most recently released engine, the others may get evicted
+    QScriptEngine *engine = m_idleEngines.takeLast().engine;
+    engine->moveToThread( QThread::currentThread() );
+    return engine;
+}
+
+bool ScriptEnginePool::isPlainObject( const QScriptValue &value )
+{
+    return value.isObject() && !value.isFunction() && !value.isQObject() &&
+           !value.isQMetaObject() && !value.isVariant() && !value.isRegExp() && !value.isDate();
+}
+
+ScriptEnginePool::PropertySnapshot ScriptEnginePool::takeSnapshot( const QScriptValue &object )
+{
+    PropertySnapshot snapshot;
+    QScriptValueIterator it( object );
+    while ( it.hasNext() ) {
+        it.next();
+        snapshot.insert( it.name(), it.value() );
+    }
+    return snapshot;
+}
+
+void ScriptEnginePool::restoreSnapshot( QScriptValue object, const PropertySnapshot &snapshot )
+{
+    // Remove added properties and restore reassigned ones
+    QScriptValueIterator it( object );
+    while ( it.hasNext() ) {
+        it.next();
+        const PropertySnapshot::ConstIterator initial = snapshot.constFind( it.name() );
+        if ( initial == snapshot.constEnd() ) {
+            it.remove();
+        } else if ( !it.value().strictlyEquals(*initial) ) {
+            // Keep the flags, eg. to restore read only properties
+            object.setProperty( it.name(), *initial, it.flags() );
+        }
+    }
+
+    // Restore deleted properties
+    for ( PropertySnapshot::ConstIterator initial = snapshot.constBegin();
+          initial != snapshot.constEnd(); ++initial )
+    {
+        if ( !object.property(initial.key(), QScriptValue::ResolveLocal).isValid() ) {
+            object.setProperty( initial.key(), *initial );
+        }
+    }
+}
+
+void ScriptEnginePool::initialized( QScriptEngine *engine )
+{
+    // Remember the global properties of the initialized engine with their values and the
+    // members of global plain objects/arrays, they get restored on release
+    GlobalSnapshot snapshot;
+    snapshot.properties = takeSnapshot( engine->globalObject() );
+    for ( PropertySnapshot::ConstIterator it = snapshot.properties.constBegin();
+          it != snapshot.properties.constEnd(); ++it )
+    {
+        if ( isPlainObject(*it) ) {
+            snapshot.members.insert( it.key(), takeSnapshot(*it) );
+        }
+    }
+
+    QMutexLocker locker( &m_mutex );
+    m_globalSnapshots.insert( engine, snapshot );
+}
+
+void ScriptEnginePool::release( QScriptEngine *engine )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !m_globalSnapshots.contains(engine) || m_idleEngines.count() >= m_maximumIdleEngines ) {
+        // Not initialized or the pool is full
+        m_globalSnapshots.remove( engine );
+        engine->deleteLater();
+        return;
+    }
+
+    // Restore the global state of the initialized engine, first the members of global
+    // plain objects/arrays (using the initial objects), then the global properties
+    const GlobalSnapshot &snapshot = m_globalSnapshots[ engine ];
+    for ( QHash<QString, PropertySnapshot>::ConstIterator it = snapshot.members.constBegin();
+          it != snapshot.members.constEnd(); ++it )
+    {
+        restoreSnapshot( snapshot.properties[it.key()], *it );
+    }
+    restoreSnapshot( engine->globalObject(), snapshot.properties );
+    engine->clearExceptions();
+
+    // Remove the thread affinity, the engine gets moved to the thread of the next job in acquire()
+    engine->moveToThread( 0 );
+
+    IdleEngine idleEngine;
+    idleEngine.engine = engine;
+    idleEngine.idleTime.start();
+    m_idleEngines << idleEngine;
+
+    if ( !m_evictionScheduled ) {
+        // Start the timer in the thread of the pool
+        m_evictionScheduled = true;
+        QMetaObject::invokeMethod( m_evictionTimer, "start", Qt::QueuedConnection,
+                                   Q_ARG(int, m_idleTimeout) );
+    }
+}
+
+void ScriptEnginePool::evictIdleEngines()
+{
+    QMutexLocker locker( &m_mutex );
+    int nextEviction = -1;
+    QList< IdleEngine >::Iterator it = m_idleEngines.begin();
+    while ( it != m_idleEngines.end() ) {
+        const qint64 idleTime = it->idleTime.elapsed();
+        if ( idleTime >= m_idleTimeout ) {
+            // Idle engines have no thread affinity and can be deleted here
+            m_globalSnapshots.remove( it->engine );
+            delete it->engine;
+            it = m_idleEngines.erase( it );
+        } else {
+            const int remainingTime = int( m_idleTimeout - idleTime );
+            nextEviction = nextEviction == -1 ? remainingTime : qMin( nextEviction, remainingTime );
+            ++it;
+        }
+    }
+
+    m_evictionScheduled = nextEviction != -1;
+    if ( m_evictionScheduled ) {
+        m_evictionTimer->start( nextEviction );
+    }
+}
+
+int ScriptEnginePool::maximumIdleEngines() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_maximumIdleEngines;
+}
+
+void ScriptEnginePool::setMaximumIdleEngines( int maximumIdleEngines )
+{
+    QMutexLocker locker( &m_mutex );
+    m_maximumIdleEngines = maximumIdleEngines;
+    while ( m_idleEngines.count() > m_maximumIdleEngines ) {
+        // Delete least recently released engines first
+        const IdleEngine idleEngine = m_idleEngines.takeFirst();
+        m_globalSnapshots.remove( idleEngine.engine );
+        delete idleEngine.engine;
+    }
+}
+
+int ScriptEnginePool::idleTimeout() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_idleTimeout;
+}
+
+void ScriptEnginePool::setIdleTimeout( int idleTimeout )
+{
+    QMutexLocker locker( &m_mutex );
+    m_idleTimeout = idleTimeout;
+}
+
+int ScriptEnginePool::idleEngineCount() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_idleEngines.count();
+}
+
 bool ScriptJob::waitFor( QObject *sender, const char *signal, WaitForType type, int *timeout )
 {
     if ( *timeout <= 0 ) {
@@ -545,8 +785,19 @@ bool ScriptJob::loadScript( const QSharedPointer< QScriptProgram > &script )
         return false;
     }
 
-    // Create script engine
     QMutexLocker locker( m_mutex );
+    m_engine = m_enginePool ? m_enginePool->acquire() : 0;
+    if ( m_engine ) {
+        // The pooled engine has already imported extensions and evaluated the script program,
+        // only attach new objects for this job (the Storage object is shared)
+        m_objects.createObjects( m_data );
+        m_objects.attachJobObjects( m_engine );
+        connect( m_objects.result.data(), SIGNAL(publish()), this, SLOT(publish()),
+                 Qt::DirectConnection );
+        return true;
+    }
+
+    // Create script engine
     m_engine = new QScriptEngine();
     foreach ( const QString &extension, m_data.provider.scriptExtensions() ) {
         if ( !importExtension(m_engine, extension) ) {
@@ -587,6 +838,10 @@ bool ScriptJob::loadScript( const QSharedPointer< QScriptProgram > &script )
         cleanup();
         return false;
     } else {
+        if ( m_enginePool ) {
+            // Remember the initialized state of the engine to reuse it in later jobs
+            m_enginePool->initialized( m_engine );
+        }
         return true;
     }
 }
@@ -600,15 +855,23 @@ bool ScriptJob::hasDataToBePublished() const
 void ScriptJob::publish()
 {
     // This slot gets run in the thread of this job
-    // Only publish, if there is data which is not already published
-    if ( hasDataToBePublished() ) {
+    publishChunk( false );
+}
+
+void ScriptJob::publishChunk( bool isLastChunk )
+{
+    // Only publish, if there is data which is not already published or if the last chunk
+    // needs to mark already published departures/arrivals/journeys complete
+    if ( hasDataToBePublished() ||
+         (isLastChunk && m_publishedChunks > 0 && m_objects.isValid()) )
+    {
         m_mutex->lock();
         GlobalTimetableInfo globalInfo;
         const QList< TimetableData > data = m_objects.result->data().mid( m_published );
         const ResultObject::Features features = m_objects.result->features();
         const ResultObject::Hints hints = m_objects.result->hints();
         const QString lastUserUrl = m_objects.network->lastUserUrl();
-        const bool couldNeedForcedUpdate = m_published > 0;
+        const int chunkIndex = m_publishedChunks++;
         const MoreItemsRequest *moreItemsRequest = dynamic_cast<const MoreItemsRequest*>(request());
         const AbstractRequest *_request =
                 moreItemsRequest ? moreItemsRequest->request().data() : request();
@@ -626,7 +889,7 @@ void ScriptJob::publish()
                     *dynamic_cast<const DepartureRequest*>(_request);
             m_mutex->unlock();
             emit departuresReady( data, features, hints, lastUserUrl, globalInfo,
-                                  departureRequest, couldNeedForcedUpdate );
+                                  departureRequest, chunkIndex, isLastChunk );
             break;
         }
         case ParseForArrivals: {
@@ -634,7 +897,7 @@ void ScriptJob::publish()
             const ArrivalRequest arrivalRequest = *dynamic_cast<const ArrivalRequest*>(_request);
             m_mutex->unlock();
             emit arrivalsReady( data, features, hints, lastUserUrl, globalInfo,
-                                arrivalRequest, couldNeedForcedUpdate );
+                                arrivalRequest, chunkIndex, isLastChunk );
             break;
         }
         case ParseForJourneysByDepartureTime:
@@ -643,20 +906,30 @@ void ScriptJob::publish()
             const JourneyRequest journeyRequest = *dynamic_cast<const JourneyRequest*>(_request);
             m_mutex->unlock();
             emit journeysReady( data, features, hints, lastUserUrl, globalInfo,
-                                journeyRequest, couldNeedForcedUpdate );
+                                journeyRequest, chunkIndex, isLastChunk );
             break;
         }
         case ParseForStopSuggestions: {
+            if ( data.isEmpty() ) {
+                // Stop suggestions do not get marked complete, nothing new to publish
+                m_mutex->unlock();
+                break;
+            }
+
             Q_ASSERT(dynamic_cast<const StopSuggestionRequest*>(_request));
             const StopSuggestionRequest stopSuggestionRequest =
                     *dynamic_cast< const StopSuggestionRequest* >( _request );
             m_mutex->unlock();
             emit stopSuggestionsReady( data, features, hints, lastUserUrl, globalInfo,
-                                       stopSuggestionRequest, couldNeedForcedUpdate );
+                                       stopSuggestionRequest, chunkIndex );
             break;
         }
         case ParseForAdditionalData: {
-            if ( data.count() > 1 ) {
+            if ( data.isEmpty() ) {
+                // Additional data was already published
+                m_mutex->unlock();
+                break;
+            } else if ( data.count() > 1 ) {
                 kWarning() << "The script added more than one result in an additional data request";
                 kDebug() << "All received additional data for item"
                          << dynamic_cast<const AdditionalDataRequest*>(_request)->itemNumber()
@@ -686,7 +959,7 @@ void ScriptJob::publish()
             m_mutex->unlock();
 
             emit additionalDataReady( additionalData, features, hints, lastUserUrl, globalInfo,
-                                      additionalDataRequest, couldNeedForcedUpdate );
+                                      additionalDataRequest, chunkIndex );
             break;
         }
 
@@ -728,6 +1001,20 @@ QString ScriptJob::sourceName() const
     return request()->sourceName();
 }
 
+bool ScriptJob::isBackgroundUpdate() const
+{
+    QMutexLocker locker( m_mutex );
+    return request()->isBackgroundUpdate();
+}
+
+QString ScriptJob::requester() const
+{
+    QMutexLocker locker( m_mutex );
+    const StopSuggestionRequest *stopSuggestionRequest =
+            dynamic_cast< const StopSuggestionRequest* >( request() );
+    return stopSuggestionRequest ? stopSuggestionRequest->requester() : QString();
+}
+
 const AbstractRequest *ScriptJob::cloneRequest() const
 {
     QMutexLocker locker( m_mutex );
@@ -37,8 +37,11 @@
 // Qt includes
 #include <QScriptEngineAgent> // Base class
 #include <QPointer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QScriptValue>
 
-class QMutex;
+class QTimer;
 class AbstractRequest;
 class DepartureRequest;
 class ArrivalRequest;
@@ -112,6 +115,114 @@ protected slots:
 /** @brief Implements the script function 'importExtension()'. */
 bool importExtension( QScriptEngine *engine, const QString &extension );
 
+/**
+ * @brief A pool of initialized script engines of one provider for reuse in ScriptJob's.
+ *
+ * Initializing a QScriptEngine for a provider script is expensive: script extensions need to
+ * be imported and the whole script program needs to be evaluated, including included files.
+ * Engines that finished a job successfully get released to this pool and the next job of the
+ * same provider acquires an already initialized engine, only new job objects ("result",
+ * "network", "helper") get attached using ScriptObjects::attachJobObjects().
+ *
+ * The pool remembers the properties of the global object after the script program was
+ * evaluated, including the members of global plain objects and arrays. When the engine gets
+ * released, global properties added by a job are removed and reassigned global variables get
+ * their initial values back. Members of global plain objects/arrays are restored the same way,
+ * deeper nested values that were changed in place by a job are not restored.
+ *
+ * Script engines are QObjects with thread affinity, but ThreadWeaver may run the jobs in any
+ * of it's threads. Released engines therefore have no thread affinity and get moved to the
+ * thread of the acquiring job. Engines idle for longer than idleTimeout() get deleted and
+ * maximally maximumIdleEngines() engines are kept in the pool.
+ *
+ * All functions are thread safe.
+ **/
+class ScriptEnginePool : public QObject {
+    Q_OBJECT
+
+public:
+    /** @brief Create a new script engine pool. */
+    explicit ScriptEnginePool( QObject *parent = 0 );
+
+    /** @brief Destructor, deletes all idle engines. */
+    virtual ~ScriptEnginePool();
+
+    /**
+     * @brief Take an initialized engine from the pool.
+     *
+     * The engine gets moved to the current thread.
+     * @return An initialized engine or 0, if no idle engine is available. In that case a new
+     *   engine should be initialized and added to the pool using initialized().
+     **/
+    QScriptEngine *acquire();
+
+    /**
+     * @brief Notify the pool that @p engine was just initialized.
+     *
+     * Must be called after the script program was evaluated in @p engine successfully, to
+     * remember the global properties and their values of the initialized engine.
+     **/
+    void initialized( QScriptEngine *engine );
+
+    /**
+     * @brief Release @p engine to the pool for use in later jobs.
+     *
+     * Must be called in the thread of @p engine. Global properties added since initialized()
+     * get removed, changed global properties get restored. If @p engine was not initialized
+     * using initialized() or the pool is full, @p engine gets deleted.
+     **/
+    void release( QScriptEngine *engine );
+
+    /** @brief The maximal number of idle engines kept in the pool. */
+    int maximumIdleEngines() const;
+
+    /** @brief Set the maximal number of idle engines kept in the pool. */
+    void setMaximumIdleEngines( int maximumIdleEngines );
+
+    /** @brief Time in milliseconds after which idle engines get deleted. */
+    int idleTimeout() const;
+
+    /** @brief Set the time in milliseconds after which idle engines get deleted. */
+    void setIdleTimeout( int idleTimeout );
+
+    /** @brief The number of engines that are currently idle in the pool. */
+    int idleEngineCount() const;
+
+    /** @brief The default maximal number of idle engines kept in the pool. */
+    static const int DEFAULT_MAXIMUM_IDLE_ENGINES;
+
+    /** @brief The default time in milliseconds after which idle engines get deleted. */
+    static const int DEFAULT_IDLE_TIMEOUT;
+
+protected slots:
+    /** @brief Delete engines that were idle for longer than idleTimeout(). */
+    void evictIdleEngines();
+
+private:
+    struct IdleEngine {
+        QScriptEngine *engine;
+        QElapsedTimer idleTime;
+    };
+
+    typedef QHash< QString, QScriptValue > PropertySnapshot;
+    struct GlobalSnapshot {
+        PropertySnapshot properties; // Properties of the global object
+        QHash< QString, PropertySnapshot > members; // Members of global plain objects/arrays
+    };
+
+    static PropertySnapshot takeSnapshot( const QScriptValue &object );
+    static void restoreSnapshot( QScriptValue object, const PropertySnapshot &snapshot );
+    static bool isPlainObject( const QScriptValue &value );
+
+    mutable QMutex m_mutex;
+    QList< IdleEngine > m_idleEngines; // Most recently released engines last
+    QHash< QScriptEngine*, GlobalSnapshot > m_globalSnapshots; // Of initialized engines
+    QTimer *m_evictionTimer;
+    bool m_evictionScheduled;
+    int m_maximumIdleEngines;
+    int m_idleTimeout;
+};
+
 /**
  * @brief Executes a script.
  **/
@@ -153,41 +264,84 @@ public:
     /** @brief Get the data source name associated with this job. */
     QString sourceName() const;
 
+    /** @brief Whether or not the request of this job is an automatic update. */
+    bool isBackgroundUpdate() const;
+
+    /**
+     * @brief The requester of a stop suggestion request, see StopSuggestionRequest::requester().
+     * For other requests or if no requester was given an empty string gets returned.
+     **/
+    QString requester() const;
+
     /** @brief Return a copy of the object containing inforamtion about the request of this job. */
     const AbstractRequest *cloneRequest() const;
 
+    /**
+     * @brief Use initialized script engines from @p enginePool.
+     *
+     * Must be called before the job gets started. Without an engine pool a new engine gets
+     * initialized and deleted afterwards for each job.
+     **/
+    void setEnginePool( ScriptEnginePool *enginePool );
+
+    /** @brief Overwritten from ThreadWeaver::Job, jobs with higher priority get executed first. */
+    virtual int priority() const;
+
+    /** @brief Set the priority of this job, must be called before the job gets enqueued. */
+    void setPriority( int priority );
+
+    /** @brief Start measuring the queue wait time, gets called when the job gets enqueued. */
+    void markEnqueued();
+
+    /**
+     * @brief The time in milliseconds the job was waiting in the queue before it got started.
+     * If the job was not started yet or markEnqueued() was not called, -1 gets returned.
+     **/
+    qint64 queueWaitTime() const;
+
 signals:
-    /** @brief Signals ready TimetableData items. */
+    /**
+     * @brief Signals ready TimetableData items.
+     *
+     * Each time the script publishes results only the items added since the last publish get
+     * emitted. @p chunkIndex is 0 for the first chunk of results and gets incremented for each
+     * following chunk, which should be appended to the items of the previous chunks.
+     * @p isLastChunk is true for the chunk published when the script has finished, it may be empty
+     * if all items were already published in previous chunks.
+     **/
     void departuresReady( const QList<TimetableData> &departures,
                           ResultObject::Features features, ResultObject::Hints hints,
                           const QString &url, const GlobalTimetableInfo &globalInfo,
-                          const DepartureRequest &request, bool couldNeedForcedUpdate = false );
+                          const DepartureRequest &request, int chunkIndex = 0,
+                          bool isLastChunk = true );
 
     /** @brief Signals ready TimetableData items. */
     void arrivalsReady( const QList<TimetableData> &arrivals,
                         ResultObject::Features features, ResultObject::Hints hints,
                         const QString &url, const GlobalTimetableInfo &globalInfo,
-                        const ArrivalRequest &request, bool couldNeedForcedUpdate = false );
+                        const ArrivalRequest &request, int chunkIndex = 0,
+                        bool isLastChunk = true );
 
     /** @brief Signals ready TimetableData items. */
     void journeysReady( const QList<TimetableData> &journeys,
                         ResultObject::Features features, ResultObject::Hints hints,
                         const QString &url, const GlobalTimetableInfo &globalInfo,
-                        const JourneyRequest &request, bool couldNeedForcedUpdate = false );
+                        const JourneyRequest &request, int chunkIndex = 0,
+                        bool isLastChunk = true );
 
     /** @brief Signals ready TimetableData items. */
     void stopSuggestionsReady( const QList<TimetableData> &stops,
                                ResultObject::Features features, ResultObject::Hints hints,
                                const QString &url, const GlobalTimetableInfo &globalInfo,
                                const StopSuggestionRequest &request,
-                               bool couldNeedForcedUpdate = false );
+                               int chunkIndex = 0 );
 
     /** @brief Signals ready additional data for a TimetableData item. */
     void additionalDataReady( const TimetableData &data,
                               ResultObject::Features features, ResultObject::Hints hints,
                               const QString &url, const GlobalTimetableInfo &globalInfo,
                               const AdditionalDataRequest &request,
-                              bool couldNeedForcedUpdate = false );
+                              int chunkIndex = 0 );
 
 protected slots:
     /** @brief Handle the ResultObject::publish() signal by emitting dataReady(). */
@@ -207,16 +361,28 @@ protected:
 
     bool hasDataToBePublished() const;
 
+    /**
+     * @brief Emit items not already published in a chunk.
+     * @param isLastChunk Whether or not the script has finished. If true and previous chunks were
+     *   published, the chunk gets emitted also without new items to mark completion.
+     **/
+    void publishChunk( bool isLastChunk );
+
     void handleError( const QString &errorMessage );
 
     void cleanup();
 
     QScriptEngine *m_engine;
+    ScriptEnginePool *m_enginePool;
     QMutex *m_mutex;
     ScriptData m_data;
     ScriptObjects m_objects;
     QEventLoop *m_eventLoop;
+    QElapsedTimer m_queueTimer;
+    qint64 m_queueWaitTime;
+    int m_priority;
     int m_published;
+    int m_publishedChunks;
     bool m_quit;
     bool m_success;
     QString m_errorString;
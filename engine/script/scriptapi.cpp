@@ -24,6 +24,11 @@
 #include "config.h"
 #include "global.h"
 #include "serviceproviderglobal.h"
+#include "networksession.h"
+#include "sharednetworkcache.h"
+#include "htmltagindex.h"
+#include "regexpcache.h"
+#include "persistentstorage.h"
 
 // KDE includes
 #include <KStandardDirs>
@@ -89,7 +94,9 @@ void NetworkRequest::abort()
     // isRunning() returned true => m_reply != 0
     m_mutex->lockInline();
     disconnect( m_reply, 0, this, 0 );
-    m_reply->abort();
+    // The reply lives in the thread of the NetworkSession, abort it there.
+    // The reply gets deleted afterwards, because the events are processed in order
+    QMetaObject::invokeMethod( m_reply, "abort", Qt::QueuedConnection );
     m_reply->deleteLater();
     m_reply = 0;
     const QString url = m_url;
@@ -185,6 +192,11 @@ void NetworkRequest::slotFinished()
         kWarning() << "Reply object already deleted, aborted?";
         return;
     }
+    if ( !m_reply->isFinished() ) {
+        // Queued call for a previous reply, eg. after a redirection
+        m_mutex->unlockInline();
+        return;
+    }
 
     if ( m_reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid() ) {
         if ( m_redirectUrl.isValid() ) {
@@ -211,9 +223,13 @@ void NetworkRequest::slotFinished()
 
     const int size = m_reply->size();
     const int statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    SharedNetworkCache::recordReply( m_reply );
 
     // Read all data, decode it and give it to the script
-    m_data.append( m_reply->readAll() );
+    const QByteArray newData = m_reply->readAll();
+    m_data.append( newData );
+    const bool emitReadyRead = m_reply->thread() != thread() && !newData.isEmpty() &&
+                               receivers(SIGNAL(readyRead(QByteArray))) > 0;
 
     if ( m_data.isEmpty() ) {
         kWarning() << "Error downloading" << m_url
@@ -244,6 +260,9 @@ void NetworkRequest::slotFinished()
     const QVariant userData = m_userData;
     m_mutex->unlockInline();
 
+    if ( emitReadyRead ) {
+        emit readyRead( newData );
+    }
     emit finished( data, hasError, errorString, statusCode, size, url, userData );
 }
 
@@ -262,14 +281,25 @@ void NetworkRequest::started( QNetworkReply* reply, int timeout )
         QTimer::singleShot( timeout, this, SLOT(abort()) );
     }
 
-    // Connect to signals of reply only when the associated signals of this class are connected
-    if ( receivers(SIGNAL(readyRead(QByteArray))) > 0 ) {
+    // Connect to signals of reply only when the associated signals of this class are connected.
+    // Replies of a NetworkSession live in another thread and may not be read while they
+    // receive data, for them readyRead() gets emitted once in slotFinished()
+    if ( receivers(SIGNAL(readyRead(QByteArray))) > 0 && m_reply->thread() == thread() ) {
         connect( m_reply, SIGNAL(readyRead()), this, SLOT(slotReadyRead()) );
     }
     connect( m_reply, SIGNAL(finished()), this, SLOT(slotFinished()) );
+
+    // The reply lives in the network thread and may have finished before finished() got
+    // connected, eg. for replies from the HTTP cache. A queued call of slotFinished() for
+    // a reply that finished after connecting gets ignored, m_reply is then already 0
+    const bool finished = m_reply->isFinished();
     m_mutex->unlockInline();
 
     emit started();
+
+    if ( finished ) {
+        slotFinished();
+    }
 }
 
 bool NetworkRequest::isValid() const
@@ -373,9 +403,11 @@ QNetworkRequest* NetworkRequest::request() const
     return m_request;
 }
 
-Network::Network( const QByteArray &fallbackCharset, QObject* parent )
+Network::Network( const QByteArray &fallbackCharset,
+                  const QSharedPointer< NetworkSession > &session, QObject* parent )
         : QObject(parent), m_mutex(new QMutex(QMutex::Recursive)),
-          m_fallbackCharset(fallbackCharset), m_manager(new QNetworkAccessManager()),
+          m_fallbackCharset(fallbackCharset),
+          m_session(session ? session : NetworkSession::create()),
           m_quit(false), m_synchronousRequestCount(0), m_lastDownloadAborted(false)
 {
     qRegisterMetaType< NetworkRequest* >( "NetworkRequest*" );
@@ -403,7 +435,6 @@ Network::~Network()
     }
 
     delete m_mutex;
-    m_manager->deleteLater();
 }
 
 NetworkRequest* Network::createRequest( const QString& url, const QString &userUrl )
@@ -477,8 +508,9 @@ void Network::slotRequestRedirected( const QUrl &newUrl )
     NetworkRequest::Ptr sharedRequest = getSharedRequest( request );
     Q_ASSERT( sharedRequest ); // This slot should only be connected to signals of NetworkRequest
 
+    // Do not lock the mutex while the session may wait for a free request slot of the host
+    QNetworkReply *reply = m_session->get( *request->request() );
     m_mutex->lockInline();
-    QNetworkReply *reply = m_manager->get( *request->request() );
     m_lastUrl = newUrl.toString();
     m_mutex->unlockInline();
 
@@ -537,9 +569,10 @@ void Network::get( NetworkRequest* request, int timeout )
         return;
     }
 
-    // Create a get request
+    // Create a get request, the mutex is not locked while the session may wait for a free
+    // request slot of the host, the session is thread safe
+    QNetworkReply *reply = m_session->get( *request->request() );
     m_mutex->lockInline();
-    QNetworkReply *reply = m_manager->get( *request->request() );
     m_lastUrl = request->url();
     m_lastUserUrl = request->userUrl();
     m_mutex->unlockInline();
@@ -553,9 +586,9 @@ void Network::head( NetworkRequest* request, int timeout )
         return;
     }
 
-    // Create a head request
+    // Create a head request, see get()
+    QNetworkReply *reply = m_session->head( *request->request() );
     m_mutex->lockInline();
-    QNetworkReply *reply = m_manager->head( *request->request() );
     m_lastUrl = request->url();
     m_lastUserUrl = request->userUrl();
     m_mutex->unlockInline();
@@ -569,9 +602,9 @@ void Network::post( NetworkRequest* request, int timeout )
         return;
     }
 
-    // Create a head request
+    // Create a post request, see get()
+    QNetworkReply *reply = m_session->post( *request->request(), request->postDataByteArray() );
     m_mutex->lockInline();
-    QNetworkReply *reply = m_manager->post( *request->request(), request->postDataByteArray() );
     m_lastUrl = request->url();
     m_lastUserUrl = request->userUrl();
     m_mutex->unlockInline();
@@ -603,8 +636,9 @@ QByteArray Network::getSynchronous( const QString &url, const QString &userUrl,
     QNetworkRequest request( url );
     DEBUG_NETWORK("Start synchronous request" << url);
 
+    // Do not lock the mutex while the session may wait for a free request slot of the host
+    QNetworkReply *reply = m_session->get( request );
     m_mutex->lockInline();
-    QNetworkReply *reply = m_manager->get( request );
     ++m_synchronousRequestCount;
     m_lastUrl = url;
     m_lastUserUrl = userUrl.isEmpty() ? url : userUrl;
@@ -636,6 +670,11 @@ QByteArray Network::getSynchronous( const QString &url, const QString &userUrl,
         // Check if the timeout occured before the request finished
         if ( quit ) {
             DEBUG_NETWORK("Cancelled, destroyed or timeout while downloading" << url);
+
+            // Abort the reply in the network thread to free the request slot of the host,
+            // the reply gets deleted afterwards, because the events are processed in order
+            QMetaObject::invokeMethod( reply, "abort", Qt::QueuedConnection );
+            reply->deleteLater();
             emitSynchronousRequestFinished( url, QByteArray(), true );
             return QByteArray();
         }
@@ -655,9 +694,9 @@ QByteArray Network::getSynchronous( const QString &url, const QString &userUrl,
             request.setUrl( redirectUrl );
             DEBUG_NETWORK("Redirected to" << redirectUrl);
 
+            reply->deleteLater();
+            reply = m_session->get( request );
             m_mutex->lock();
-            delete reply;
-            reply = m_manager->get( request );
             m_lastUrl = redirectUrl.toString();
             m_mutex->unlock();
 
@@ -670,6 +709,7 @@ QByteArray Network::getSynchronous( const QString &url, const QString &userUrl,
 
     const int time = start.msecsTo( QTime::currentTime() );
     const int statusCode = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    SharedNetworkCache::recordReply( reply );
     DEBUG_NETWORK("Waited" << (time / 1000.0) << "seconds for download of"
                   << url << "Status:" << statusCode);
 
@@ -833,19 +873,18 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
         }
 
         // Create info object for the timetable data
-        PublicTransportInfoPtr info;
+        PublicTransportInfo info;
         if ( parseMode == ParseForJourneysByDepartureTime ||
              parseMode == ParseForJourneysByArrivalTime )
         {
-            info = QSharedPointer<JourneyInfo>( new JourneyInfo(timetableData) );
+            info = JourneyInfo( timetableData );
         } else if ( parseMode == ParseForDepartures || parseMode == ParseForArrivals ) {
-            info = QSharedPointer<DepartureInfo>( new DepartureInfo(timetableData) );
+            info = DepartureInfo( timetableData );
         } else if ( parseMode == ParseForStopSuggestions ) {
-            info = QSharedPointer<StopInfo>( new StopInfo(timetableData) );
+            info = StopInfo( timetableData );
         }
 
-        if ( !info->isValid() ) {
-            info.clear();
+        if ( !info.isValid() ) {
             continue;
         }
 
@@ -855,7 +894,7 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
              removeFirstWord.isEmpty() && removeLastWord.isEmpty() )
         {
             // First count the first/last word of the target stop name
-            const QString target = info->value( Enums::Target ).toString();
+            const QString target = info.target();
             int pos = target.indexOf( ' ' );
             if ( pos > 0 && ++firstWordCounts[target.left(pos)] >= maxWordOccurrence ) {
                 removeFirstWord = target.left(pos);
@@ -867,9 +906,8 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
             }
 
             // Check if route stop names are available
-            if ( info->contains(Enums::RouteStops) ) {
-                QStringList stops = info->value( Enums::RouteStops ).toStringList();
-                QString target = info->value( Enums::Target ).toString();
+            if ( info.contains(Enums::RouteStops) ) {
+                QStringList stops = info.value( Enums::RouteStops ).toStringList();
 
                 // TODO Break if 70% or at least three of the route stop names
                 // begin/end with the same word
@@ -938,38 +976,38 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
         if ( !removeFirstWord.isEmpty() ) {
             // Remove removeFirstWord from all stop names
             for ( int i = 0; i < infoList->count(); ++i ) {
-                QSharedPointer<PublicTransportInfo> info = infoList->at( i );
-                QString target = info->value( Enums::Target ).toString();
+                PublicTransportInfo &info = (*infoList)[ i ];
+                QString target = info.target();
                 if ( target.startsWith(removeFirstWord) ) {
                     target = target.mid( removeFirstWord.length() + 1 );
-                    info->insert( Enums::TargetShortened, target );
+                    info.insert( Enums::TargetShortened, target );
                 }
 
-                QStringList stops = info->value( Enums::RouteStops ).toStringList();
+                QStringList stops = info.value( Enums::RouteStops ).toStringList();
                 for ( int i = 0; i < stops.count(); ++i ) {
                     if ( stops[i].startsWith(removeFirstWord) ) {
                         stops[i] = stops[i].mid( removeFirstWord.length() + 1 );
                     }
                 }
-                info->insert( Enums::RouteStopsShortened, stops );
+                info.insert( Enums::RouteStopsShortened, stops );
             }
         } else if ( !removeLastWord.isEmpty() ) {
             // Remove removeLastWord from all stop names
             for ( int i = 0; i < infoList->count(); ++i ) {
-                QSharedPointer<PublicTransportInfo> info = infoList->at( i );
-                QString target = info->value( Enums::Target ).toString();
+                PublicTransportInfo &info = (*infoList)[ i ];
+                QString target = info.target();
                 if ( target.endsWith(removeLastWord) ) {
                     target = target.left( target.length() - removeLastWord.length() );
-                    info->insert( Enums::TargetShortened, target );
+                    info.insert( Enums::TargetShortened, target );
                 }
 
-                QStringList stops = info->value( Enums::RouteStops ).toStringList();
+                QStringList stops = info.value( Enums::RouteStops ).toStringList();
                 for ( int i = 0; i < stops.count(); ++i ) {
                     if ( stops[i].endsWith(removeLastWord) ) {
                         stops[i] = stops[i].left( stops[i].length() - removeLastWord.length() );
                     }
                 }
-                info->insert( Enums::RouteStopsShortened, stops );
+                info.insert( Enums::RouteStopsShortened, stops );
             }
         }
     }
@@ -1097,11 +1135,19 @@ void ResultObject::addData( const QVariantMap &item )
     m_mutex->lockInline();
     TimetableData data;
     for ( QVariantMap::ConstIterator it = item.constBegin(); it != item.constEnd(); ++it ) {
-        bool ok;
-        Enums::TimetableInformation info =
-                static_cast< Enums::TimetableInformation >( it.key().toInt(&ok) );
-        if ( !ok || info == Enums::Nothing ) {
-            info = Global::timetableInformationFromString( it.key() );
+        // Scripts use the same few property names for all items, only map new names
+        Enums::TimetableInformation info;
+        const QHash< QString, Enums::TimetableInformation >::ConstIterator cachedInfo =
+                m_timetableInformationCache.constFind( it.key() );
+        if ( cachedInfo != m_timetableInformationCache.constEnd() ) {
+            info = *cachedInfo;
+        } else {
+            bool ok;
+            info = static_cast< Enums::TimetableInformation >( it.key().toInt(&ok) );
+            if ( !ok || info == Enums::Nothing ) {
+                info = Global::timetableInformationFromString( it.key() );
+            }
+            m_timetableInformationCache.insert( it.key(), info );
         }
         const QVariant value = it.value();
         if ( info == Enums::Nothing ) {
@@ -1220,28 +1266,29 @@ void ResultObject::addData( const QVariantMap &item )
 QString Helper::trim( const QString& str )
 {
     return QString(str).trimmed()
-                       .replace( QRegExp("^(&nbsp;)+|(&nbsp;)+$", Qt::CaseInsensitive), QString() )
+                       .replace( RegExpCache::regExp("^(&nbsp;)+|(&nbsp;)+$", Qt::CaseInsensitive),
+                                QString() )
                        .trimmed();
 }
 
 QString Helper::simplify( const QString &str )
 {
-    return QString(str).replace( QRegExp("(&nbsp;)+", Qt::CaseInsensitive), QString() )
+    return QString(str).replace( RegExpCache::regExp("(&nbsp;)+", Qt::CaseInsensitive), QString() )
                        .simplified();
 }
 
 QString Helper::stripTags( const QString& str )
 {
     const QString attributePattern = "\\w+(?:\\s*=\\s*(?:\"[^\"]*\"|'[^']*'|[^\"'>\\s]+))?";
-    QRegExp rx( QString("<\\/?\\w+(?:\\s+%1)*(?:\\s*/)?>").arg(attributePattern) );
-    rx.setMinimal( true );
+    QRegExp rx = RegExpCache::regExp( QString("<\\/?\\w+(?:\\s+%1)*(?:\\s*/)?>")
+                                      .arg(attributePattern), Qt::CaseSensitive, true );
     return QString( str ).remove( rx );
 }
 
 QString Helper::camelCase( const QString& str )
 {
     QString ret = str.toLower();
-    QRegExp rx( "(^\\w)|\\W(\\w)" );
+    QRegExp rx = RegExpCache::regExp( "(^\\w)|\\W(\\w)" );
     int pos = 0;
     while ( (pos = rx.indexIn(ret, pos)) != -1 ) {
         if ( rx.pos(2) == -1 || rx.pos(2) >= ret.length() ) {
@@ -1277,14 +1324,14 @@ QVariantMap Helper::matchTime( const QString& str, const QString& format )
               .replace( "ap", "(am|pm)" );
 
     QVariantMap ret;
-    QRegExp rx( pattern );
+    QRegExp rx = RegExpCache::regExp( pattern );
     if ( rx.indexIn(str) != -1 ) {
         QTime time = QTime::fromString( rx.cap(), format );
         ret.insert( "hour", time.hour() );
         ret.insert( "minute", time.minute() );
     } else if ( format != "hh:mm" ) {
         // Try default format if the one specified doesn't work
-        QRegExp rx2( "\\d{1,2}:\\d{2}" );
+        QRegExp rx2 = RegExpCache::regExp( "\\d{1,2}:\\d{2}" );
         if ( rx2.indexIn(str) != -1 ) {
             QTime time = QTime::fromString( rx2.cap(), "hh:mm" );
             ret.insert( "hour", time.hour() );
@@ -1310,13 +1357,13 @@ QDate Helper::matchDate( const QString& str, const QString& format )
               .replace( "yyyy", "\\d{4}" )
               .replace( "yy", "\\d{2}" );
 
-    QRegExp rx( pattern );
+    QRegExp rx = RegExpCache::regExp( pattern );
     QDate date;
     if ( rx.indexIn(str) != -1 ) {
         date = QDate::fromString( rx.cap(), format );
     } else if ( format != "yyyy-MM-dd" ) {
         // Try default format if the one specified doesn't work
-        QRegExp rx2( "\\d{2,4}-\\d{2}-\\d{2}" );
+        QRegExp rx2 = RegExpCache::regExp( "\\d{2,4}-\\d{2}-\\d{2}" );
         if ( rx2.indexIn(str) != -1 ) {
             date = QDate::fromString( rx2.cap(), "yyyy-MM-dd" );
         }
@@ -1427,48 +1474,32 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
     const QString namePositionRegExpPattern = namePosition.contains("regexp")
             ? namePosition["regexp"].toString() : QString();
 
-    // Create regular expression that matches HTML elements with or without attributes.
-    // Since QRegExp offers no way to retreive multiple matches of the same capture group
-    // the whole attribute string gets matched here and then analyzed in another loop
-    // using attributeRegExp.
-    // Matching the attributes with all details here is required to prevent eg. having a match
-    // end after a ">" character in a string in an attribute.
-    const QString attributePattern = "\\w+(?:\\s*=\\s*(?:\"[^\"]*\"|'[^']*'|[^\"'>\\s]+))?";
-    QRegExp htmlTagRegExp( noContent
-            ? QString("<%1((?:\\s+%2)*)(?:\\s*/)?>").arg(tagName).arg(attributePattern)
-            : QString("<%1((?:\\s+%2)*)>").arg(tagName).arg(attributePattern),
-                           // TODO TEST does this need a "\\s*" before the ">"?
-//             : QString("<%1((?:\\s+%2)*)>%3</%1\\s*>").arg(tagName).arg(attributePattern)
-//                     .arg(contentsRegExpPattern),
-            Qt::CaseInsensitive );
-    QRegExp htmlCloseTagRegExp( QString("</%1\\s*>").arg(tagName), Qt::CaseInsensitive );
-    QRegExp contentsRegExp( contentsRegExpPattern, Qt::CaseInsensitive );
-    htmlTagRegExp.setMinimal( true );
-
-    // Match attributes with or without value, with single/double/not quoted value
-    QRegExp attributeRegExp( "(\\w+)(?:\\s*=\\s*(?:\"([^\"]*)\"|'([^']*)'|([^\"'>\\s]+)))?",
-                             Qt::CaseInsensitive );
+    // Get the index of all HTML tags in str, it gets created only once for repeated calls
+    // with the same document
+    const HtmlTagIndex::Ptr index = HtmlTagIndex::forDocument( str );
+    const QVector< HtmlTagIndex::Tag > tags = index->tags( tagName );
+    QRegExp contentsRegExp = RegExpCache::regExp( contentsRegExpPattern, Qt::CaseInsensitive );
 
     QVariantList foundTags;
-    while ( (foundTags.count() < maxCount || maxCount <= 0) &&
-            (position = htmlTagRegExp.indexIn(str, position)) != -1 )
+    for ( int i = HtmlTagIndex::firstTagIndex(tags, position);
+          i < tags.count() && (foundTags.count() < maxCount || maxCount <= 0); ++i )
     {
-        if ( debug ) {
-            kDebug() << "Test match at" << position << htmlTagRegExp.cap().left(500);
+        const HtmlTagIndex::Tag &tag = tags[ i ];
+        if ( tag.position < position ) {
+            // Inside a previously found tag
+            continue;
+        } else if ( tag.selfClosing && !noContent ) {
+            // Self closing tags only get matched with the "noContent" option
+            continue;
         }
-        const QString attributeString = htmlTagRegExp.cap( 1 );
-        QString tagContents; // = noContent ? QString() : htmlTagRegExp.cap( 2 );
-
-        QVariantMap foundAttributes;
-        int attributePos = 0;
-        while ( (attributePos = attributeRegExp.indexIn(attributeString, attributePos)) != -1 ) {
-            const int valueCap = attributeRegExp.cap(2).isEmpty() ?
-                    (attributeRegExp.cap(3).isEmpty() ? 4 : 3) : 2;
-            foundAttributes.insert( attributeRegExp.cap(1), attributeRegExp.cap(valueCap) );
-            attributePos += attributeRegExp.matchedLength();
+        if ( debug ) {
+            kDebug() << "Test match at" << tag.position
+                     << str.mid(tag.position, tag.contentsPosition - tag.position).left(500);
         }
+
+        QVariantMap foundAttributes = index->attributes( tag );
         if ( debug ) {
-            kDebug() << "Found attributes" << foundAttributes << "in" << attributeString;
+            kDebug() << "Found attributes" << foundAttributes;
         }
 
         // Test if the attributes match
@@ -1479,7 +1510,7 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
             if ( !foundAttributes.contains(it.key()) ) {
                 // Did not find exact attribute name, try to use it as regular expression pattern
                 attributesMatch = false;
-                QRegExp attributeNameRegExp( it.key(), Qt::CaseInsensitive );
+                QRegExp attributeNameRegExp = RegExpCache::regExp( it.key(), Qt::CaseInsensitive );
                 foreach ( const QString &attributeName, foundAttributes.keys() ) {
                     if ( attributeNameRegExp.indexIn(attributeName) != -1 ) {
                         // Matched the attribute name
@@ -1500,7 +1531,8 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
             const QString value = foundAttributes[ it.key() ].toString();
             const QString valueRegExpPattern = it.value().toString();
             if ( !(value.isEmpty() && valueRegExpPattern.isEmpty()) ) {
-                QRegExp valueRegExp( valueRegExpPattern, Qt::CaseInsensitive );
+                QRegExp valueRegExp = RegExpCache::regExp( valueRegExpPattern,
+                                                           Qt::CaseInsensitive );
                 if ( valueRegExp.indexIn(value) == -1 ) {
                     // Attribute value regexp did not matched
                     attributesMatch = false;
@@ -1514,59 +1546,35 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
                 }
             }
         }
-
-        // Search for new opening HTML tags (with same tag name) before the closing HTML tag
-        int endPosition = htmlTagRegExp.pos() + htmlTagRegExp.matchedLength();
         if ( !attributesMatch ) {
-            position = endPosition;
+            // Continue with the next tag, which may be a child tag
             continue;
         }
+
+        QString tagContents;
+        int endPosition = tag.contentsPosition;
         if ( !noContent ) {
+            int closingPosition;
             if ( noNesting ) {
-                // "noNesting" option set, simply search for next closing tag, no matter if it is
+                // "noNesting" option set, simply use the next closing tag, no matter if it is
                 // a nested tag or not
-                const int posClosing = htmlCloseTagRegExp.indexIn( str, endPosition );
-                const int contentsBegin = htmlTagRegExp.pos() + htmlTagRegExp.matchedLength();
-                tagContents = str.mid( contentsBegin, posClosing - contentsBegin );
-                endPosition = htmlCloseTagRegExp.pos() + htmlCloseTagRegExp.matchedLength();
+                const HtmlTagIndex::ClosingTag closingTag =
+                        index->nextClosingTag( tag.name, tag.contentsPosition );
+                closingPosition = closingTag.position;
+                endPosition = closingTag.endPosition;
             } else {
-                // Find next closing tag, skipping nested tags.
-                // Get string after the opening HTML tag
-                const QString rest = str.mid( htmlTagRegExp.pos() + htmlTagRegExp.matchedLength() );
-
-                int posClosing = htmlCloseTagRegExp.indexIn( rest );
-                if ( posClosing == -1 ) {
-                    position = htmlTagRegExp.pos() + htmlTagRegExp.matchedLength();
-                    if ( debug ) {
-                        kDebug() << "Closing tag" << tagName << "could not be found";
-                    }
-                    position = endPosition;
-                    continue;
-                }
-
-                // Search for nested opening tags in between the main opening tag and the
-                // next closing tag
-                int posOpening = htmlTagRegExp.indexIn( rest.left(posClosing) );
-                while ( posOpening != -1 ) {
-                    // Found a nested tag, find the next closing tag
-                    posClosing = htmlCloseTagRegExp.indexIn( rest,
-                            posClosing + htmlCloseTagRegExp.matchedLength() );
-                    if ( posClosing == -1 ) {
-                        position = htmlTagRegExp.pos() + htmlTagRegExp.matchedLength();
-                        if ( debug ) {
-                            kDebug() << "Closing tag" << tagName << "could not be found";
-                        }
-                        break;
-                    }
+                // Use the matching closing tag, nested tags were skipped by the index
+                closingPosition = tag.closingPosition;
+                endPosition = tag.endPosition;
+            }
 
-                    // Search for more nested opening tags
-                    posOpening = htmlTagRegExp.indexIn( rest.left(posClosing),
-                            posOpening + htmlTagRegExp.matchedLength() );
+            if ( closingPosition == -1 ) {
+                if ( debug ) {
+                    kDebug() << "Closing tag" << tagName << "could not be found";
                 }
-
-                tagContents = rest.left( posClosing );
-                endPosition += htmlCloseTagRegExp.pos() + htmlCloseTagRegExp.matchedLength();
+                continue;
             }
+            tagContents = str.mid( tag.contentsPosition, closingPosition - tag.contentsPosition );
         }
 
         // Match contents, only use regular expression if one was given in the options argument
@@ -1590,7 +1598,7 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
         // Construct a result object
         QVariantMap result;
         result.insert( "contents", tagContents );
-        result.insert( "position", position );
+        result.insert( "position", tag.position );
         result.insert( "endPosition", endPosition );
         result.insert( "attributes", foundAttributes );
 
@@ -1603,7 +1611,7 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
         }
 
         if ( debug ) {
-            kDebug() << "Found HTML tag" << tagName << "at" << position << foundAttributes;
+            kDebug() << "Found HTML tag" << tagName << "at" << tag.position << foundAttributes;
         }
         foundTags << result;
         position = endPosition;
@@ -1629,7 +1637,7 @@ QString Helper::getTagName( const QVariantMap &searchResult, const QString &type
             : searchResult["contents"].toString() );
     if ( !regExp.isEmpty() ) {
         // Use "regexp" property of namePosition to match the header name
-        QRegExp namePositionRegExp( regExp, Qt::CaseInsensitive );
+        QRegExp namePositionRegExp = RegExpCache::regExp( regExp, Qt::CaseInsensitive );
         if ( namePositionRegExp.indexIn(name) != -1 ) {
             name = namePositionRegExp.cap( qMin(1, namePositionRegExp.captureCount()) );
         }
@@ -1670,7 +1678,7 @@ QVariantMap Helper::findNamedHtmlTags( const QString &str, const QString &tagNam
         // Check if the newly found name was already found
         // and decide what to do based on the "ambiguousNameResolution" option
         if ( ambiguousNameResolution == QLatin1String("addnumber") && foundTagsMap.contains(name) ) {
-            QRegExp rx( "(\\d+)$" );
+            QRegExp rx = RegExpCache::regExp( "(\\d+)$" );
             if ( rx.indexIn(name) != -1 ) {
                 name += QString::number( rx.cap(1).toInt() + 1 );
             } else {
@@ -1698,37 +1706,13 @@ public:
     StoragePrivate( const QString &serviceProvider )
             : readWriteLock(new QReadWriteLock(QReadWriteLock::Recursive)),
               readWriteLockPersistent(new QReadWriteLock(QReadWriteLock::Recursive)),
-              serviceProvider(serviceProvider), lastLifetimeCheck(0), config(0) {
+              serviceProvider(serviceProvider), lastLifetimeCheck(0), persistentStorage(0) {
     };
 
     ~StoragePrivate() {
         delete readWriteLock;
         delete readWriteLockPersistent;
-        delete config;
-    };
-
-    void readPersistentData() {
-        // Delete already read config object
-        if ( config ) {
-            delete config;
-        }
-
-        config = new KConfig( ServiceProviderGlobal::cacheFileName(), KConfig::SimpleConfig );
-    };
-
-    KConfigGroup persistentGroup() {
-        if ( !config ) {
-            readPersistentData();
-        }
-        return config->group( serviceProvider ).group( QLatin1String("storage") );
-    };
-
-    quint16 checkLength( const QByteArray &data ) {
-        if ( data.length() > 65535 ) {
-            kDebug() << "Data is too long, only 65535 bytes are supported" << data.length();
-        }
-
-        return static_cast<quint16>( data.length() );
+        delete persistentStorage;
     };
 
     QReadWriteLock *readWriteLock;
@@ -1736,8 +1720,7 @@ public:
     QVariantMap data;
     const QString serviceProvider;
     uint lastLifetimeCheck; // as time_t
-    KConfig *config;
-    KConfigGroup lastPersistentGroup;
+    PersistentStorage *persistentStorage; // Created on first use, see Storage::persistentStorage()
 };
 
 Storage::Storage( const QString &serviceProviderId, QObject *parent )
@@ -1791,20 +1774,10 @@ void Storage::clear()
 
 int Storage::lifetime( const QString& name )
 {
-    QReadLocker locker( d->readWriteLockPersistent );
-    return lifetime( name, d->persistentGroup() );
-}
-
-int Storage::lifetime( const QString& name, const KConfigGroup& group )
-{
-    QReadLocker locker( d->readWriteLockPersistent );
-    return lifetimeNoLock( name, group );
-}
-
-int Storage::lifetimeNoLock( const QString &name, const KConfigGroup &group )
-{
-    const uint lifetimeTime_t = group.readEntry( name + LIFETIME_ENTRYNAME_SUFFIX, 0 );
-    return QDateTime::currentDateTime().daysTo( QDateTime::fromTime_t(lifetimeTime_t) );
+    // Reading may also load the storage file, therefore use a write lock for all persistent data
+    QWriteLocker locker( d->readWriteLockPersistent );
+    const uint expirationTime = persistentStorage()->expirationTime( name );
+    return QDateTime::currentDateTime().daysTo( QDateTime::fromTime_t(expirationTime) );
 }
 
 void Storage::checkLifetime()
@@ -1817,26 +1790,52 @@ void Storage::checkLifetime()
         return;
     }
 
-    // Try to load script features from a cache file
-    KConfigGroup group = d->persistentGroup();
-    QMap< QString, QString > data = group.entryMap();
-    for ( QMap< QString, QString >::ConstIterator it = data.constBegin();
-          it != data.constEnd(); ++it )
-    {
-        if ( it.key().endsWith(LIFETIME_ENTRYNAME_SUFFIX) ) {
-            // Do not check lifetime of entries which store the lifetime of the real data entries
+    persistentStorage()->removeExpired();
+    d->lastLifetimeCheck = QDateTime::currentDateTime().toTime_t();
+}
+
+PersistentStorage *Storage::persistentStorage() const
+{
+    if ( !d->persistentStorage ) {
+        d->persistentStorage = new PersistentStorage(
+                ServiceProviderGlobal::storageFileName(d->serviceProvider) );
+        if ( !d->persistentStorage->exists() ) {
+            migratePersistentData();
+        }
+    }
+    return d->persistentStorage;
+}
+
+void Storage::migratePersistentData() const
+{
+    // Older versions stored persistent data in the "storage" group of the provider
+    // in the cache file, move it to the storage file
+    const QSharedPointer< KConfig > cache = ServiceProviderGlobal::cache();
+    KConfigGroup providerGroup = cache->group( d->serviceProvider );
+    if ( !providerGroup.hasGroup(QLatin1String("storage")) ) {
+        return;
+    }
+
+    KConfigGroup group = providerGroup.group( QLatin1String("storage") );
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    const QStringList names = group.keyList();
+    foreach ( const QString &name, names ) {
+        if ( name.endsWith(LIFETIME_ENTRYNAME_SUFFIX) ) {
+            // Do not migrate entries which store the lifetime of the real data entries
             continue;
         }
-        const int remainingLifetime = lifetimeNoLock( it.key(), group );
-        if ( remainingLifetime <= 0 ) {
-            // Lifetime has expired
-            kDebug() << "Lifetime of storage data" << it.key() << "for" << d->serviceProvider
-                     << "has expired" << remainingLifetime;
-            removePersistent( it.key(), group );
+
+        const uint expirationTime = group.readEntry( name + LIFETIME_ENTRYNAME_SUFFIX, 0 );
+        const QByteArray data = group.readEntry( name, QByteArray() );
+        if ( expirationTime > now && !data.isEmpty() ) {
+            d->persistentStorage->insert( name, decodeData(data), expirationTime );
         }
     }
 
-    d->lastLifetimeCheck = QDateTime::currentDateTime().toTime_t();
+    kDebug() << "Migrated persistent data of" << d->serviceProvider << "to"
+             << d->persistentStorage->fileName();
+    group.deleteGroup();
+    cache->sync();
 }
 
 bool Storage::hasData( const QString &name ) const
@@ -1847,83 +1846,8 @@ bool Storage::hasData( const QString &name ) const
 
 bool Storage::hasPersistentData( const QString &name ) const
 {
-    QReadLocker locker( d->readWriteLockPersistent );
-    KConfigGroup group = d->persistentGroup();
-    return group.hasKey( name );
-}
-
-QByteArray Storage::encodeData( const QVariant &data ) const
-{
-    // Store the type of the variant, because it is needed to read the QVariant with the correct
-    // type using KConfigGroup::readEntry()
-    const uchar type = static_cast<uchar>( data.type() );
-    if ( type >= QVariant::LastCoreType ) {
-        kDebug() << "Invalid data type, only QVariant core types are supported" << data.type();
-        return QByteArray();
-    }
-
-    // Write type into the first byte
-    QByteArray encodedData;
-    encodedData[0] = type;
-
-    // Write data
-    if ( data.canConvert(QVariant::ByteArray) ) {
-        encodedData += data.toByteArray();
-    } else if ( data.canConvert(QVariant::String) ) {
-        encodedData += data.toString().toUtf8();
-    } else {
-        switch ( data.type() ) {
-        case QVariant::StringList:
-        case QVariant::List: {
-            // Lists are stored like this (one entry after the other):
-            // "<2 Bytes: Value length><Value>"
-            const QVariantList list = data.toList();
-            foreach ( const QVariant &item, list ) {
-                // Encode current list item
-                QByteArray encodedItem = encodeData( item );
-
-                // Construct a QByteArray which contains the length in two bytes (0 .. 65535)
-                const quint16 length = d->checkLength( encodedItem );
-                const QByteArray baLength( (const char*)&length, sizeof(length) );
-
-                // Use 2 bytes for the length of the data, append data
-                encodedData += baLength;
-                encodedData += encodedItem;
-            }
-            break;
-        }
-        case QVariant::Map: {
-            // Maps are stored like this (one entry after the other):
-            // "<2 Bytes: Key length><Key><2 Bytes: Value length><Value>"
-            const QVariantMap map = data.toMap();
-            for ( QVariantMap::ConstIterator it = map.constBegin(); it != map.constEnd(); ++it ) {
-                // Encode current key and value
-                QByteArray encodedKey = it.key().toUtf8();
-                QByteArray encodedValue = encodeData( it.value() );
-
-                // Construct QByteArrays which contain the lengths in two bytes each (0 .. 65535)
-                const quint16 lengthKey = d->checkLength( encodedKey );
-                const quint16 lengthValue = d->checkLength( encodedValue );
-                const QByteArray baLengthKey( (const char*)&lengthKey, sizeof(lengthKey) );
-                const QByteArray baLengthValue( (const char*)&lengthValue, sizeof(lengthValue) );
-
-                // Use 2 bytes for the length of the key, append key
-                encodedData += baLengthKey;
-                encodedData += encodedKey;
-
-                // Use 2 bytes for the length of the value, append value
-                encodedData += baLengthValue;
-                encodedData += encodedValue;
-            }
-            break;
-        }
-        default:
-            kDebug() << "Cannot convert from type" << data.type();
-            return QByteArray();
-        }
-    }
-
-    return encodedData;
+    QWriteLocker locker( d->readWriteLockPersistent );
+    return persistentStorage()->contains( name );
 }
 
 QVariant Storage::decodeData( const QByteArray &data ) const
@@ -2027,42 +1951,27 @@ void Storage::writePersistent( const QString& name, const QVariant& data, uint l
         lifetime = MAX_LIFETIME;
     }
 
-    // Try to load script features from a cache file
     QWriteLocker locker( d->readWriteLockPersistent );
-    KConfigGroup group = d->persistentGroup();
-    group.writeEntry( name + LIFETIME_ENTRYNAME_SUFFIX,
-                      QDateTime::currentDateTime().addDays(lifetime).toTime_t() );
-    group.writeEntry( name, encodeData(data) );
+    persistentStorage()->insert( name, data,
+                                 QDateTime::currentDateTime().addDays(lifetime).toTime_t() );
 }
 
 QVariant Storage::readPersistent( const QString& name, const QVariant& defaultData )
-{
-    // Try to load script features from a cache file
-    QWriteLocker locker( d->readWriteLockPersistent );
-    const QByteArray data = d->persistentGroup().readEntry( name, QByteArray() );
-    return data.isEmpty() ? defaultData : decodeData(data);
-}
-
-void Storage::removePersistent( const QString& name, KConfigGroup& group )
 {
     QWriteLocker locker( d->readWriteLockPersistent );
-    group.deleteEntry( name + LIFETIME_ENTRYNAME_SUFFIX );
-    group.deleteEntry( name );
+    return persistentStorage()->value( name, defaultData );
 }
 
 void Storage::removePersistent( const QString& name )
 {
-    // Try to load script features from a cache file
     QWriteLocker locker( d->readWriteLockPersistent );
-    KConfigGroup group = d->persistentGroup();
-    removePersistent( name, group );
+    persistentStorage()->remove( name );
 }
 
 void Storage::clearPersistent()
 {
-    // Try to load script features from a cache file
     QWriteLocker locker( d->readWriteLockPersistent );
-    d->persistentGroup().deleteGroup();
+    persistentStorage()->clear();
 }
 
 QString Network::lastUrl() const
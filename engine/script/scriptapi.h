@@ -41,8 +41,8 @@ class QScriptContextInfo;
 class QNetworkRequest;
 class QReadWriteLock;
 class QNetworkReply;
-class QNetworkAccessManager;
 class QMutex;
+class NetworkSession;
 
 /** @brief Stores information about a departure/arrival/journey/stop suggestion. */
 typedef QHash<Enums::TimetableInformation, QVariant> TimetableData;
@@ -206,6 +206,8 @@ Q_SIGNALS:
     /**
      * @brief Emitted when new data is available for this request.
      *
+     * @note Requests are executed in the network thread of the provider's NetworkSession,
+     *   therefore this currently gets emitted only once with all data, before finished().
      * @param data New downloaded data for this request.
      **/
     void readyRead( const QByteArray &data );
@@ -283,6 +285,11 @@ private:
  * @note One request object created with createRequest() can @em not be used multiple times in
  *   parallel. To start another request create a new request object.
  * @note There is a global 60 seconds timeout for all network requests to finish.
+ * @note GET requests use a shared HTTP cache, unless disabled in the provider plugin XML file
+ *   using \<useHttpCache\>false\</useHttpCache\>. Cached documents get revalidated with the
+ *   server according to their HTTP headers.
+ * @note Requests of all script jobs of a provider use the same connections, which are kept
+ *   alive between jobs, see NetworkSession.
  **/
 class Network : public QObject, public QScriptable {
     Q_OBJECT
@@ -296,8 +303,20 @@ public:
     /** @brief The default timeout in milliseconds for network requests. */
     static const int DEFAULT_TIMEOUT = 30000;
 
-    /** @brief Constructor. */
-    explicit Network( const QByteArray &fallbackCharset = QByteArray(), QObject* parent = 0 );
+    /**
+     * @brief Constructor.
+     *
+     * @param fallbackCharset The charset to use for decoding documents, if it cannot be detected.
+     * @param session The network session to use for requests, eg. the one of the provider
+     *   returned by NetworkSession::forProvider(). Connections to the provider get reused by
+     *   all Network objects using the same session. If this is null, a new session without
+     *   HTTP cache gets created.
+     * @param parent The parent object.
+     **/
+    explicit Network( const QByteArray &fallbackCharset = QByteArray(),
+                      const QSharedPointer< NetworkSession > &session
+                            = QSharedPointer< NetworkSession >(),
+                      QObject* parent = 0 );
 
     /** @brief Destructor. */
     virtual ~Network();
@@ -548,7 +567,7 @@ protected:
 private:
     QMutex *m_mutex;
     const QByteArray m_fallbackCharset;
-    QNetworkAccessManager *m_manager;
+    QSharedPointer< NetworkSession > m_session;
     bool m_quit;
     int m_synchronousRequestCount;
     QString m_lastUrl;
@@ -914,6 +933,10 @@ public:
      *   child tags. You can use this function again on the contents string of a found top level
      *   tag to find its child tags.
      *
+     * @note All HTML tags in @p str get indexed once, following calls with the same string
+     *   (eg. with another "position" option) only search the index. Tags inside comments and
+     *   &lt;script&gt;/&lt;style&gt; tags are ignored.
+     *
      * @b Example:
      * @code
      * // This matches all &lt;div&gt; tags found in html which
@@ -1291,6 +1314,8 @@ Q_SIGNALS:
      * could be to only call publish() after the first few data items (similar to the AutoPublish
      * feature). That way visualizations get the first dataset very quickly, eg. the data that
      * fits into the current view. Remaining data will then be added after the script is finished.
+     * Only the items added since the last call get processed by the data engine and appended to
+     * the already published items.
      *
      * @note Do not call publish() too often, because it causes some overhead. Visualizations
      *   will get notified about the updated data source and process it at whole, ie. not only
@@ -1362,6 +1387,9 @@ public Q_SLOTS:
 private:
     QList< TimetableData > m_timetableData;
 
+    // Maps property names used by the script to TimetableInformation values
+    QHash< QString, Enums::TimetableInformation > m_timetableInformationCache;
+
     // Protect data from concurrent access by the script in a separate thread and usage in C++
     QMutex *m_mutex;
     Features m_features;
@@ -1372,6 +1400,7 @@ Q_DECLARE_OPERATORS_FOR_FLAGS( ResultObject::Features )
 Q_DECLARE_OPERATORS_FOR_FLAGS( ResultObject::Hints )
 
 class StoragePrivate;
+class PersistentStorage;
 /** @ingroup scriptApi
  * @{ */
 /**
@@ -1411,7 +1440,8 @@ class StoragePrivate;
  * like shown above are gone. To write data persistently to disk use readPersistent(),
  * writePersistent() and removePersistent(). Persistently stored data has a lifetime which can be
  * specified as argument to writePersistent() and defaults to one week.
- * The maximum lifetime is one month.
+ * The maximum lifetime is one month. Persistent data gets stored in a binary file for each
+ * service provider, which gets read once when it is first used, see PersistentStorage.
  *
  * @code
  * // Write a single value persistently and read it again
@@ -1455,8 +1485,8 @@ public:
     /**
      * @brief Create a new Storage instance.
      *
-     * @param serviceProviderId Used to find the right place in the service provider cache file
-     *   to read/write persistent data.
+     * @param serviceProviderId Used to find the file to read/write persistent data,
+     *   see ServiceProviderGlobal::storageFileName().
      * @param parent The parent QObject.
      **/
     Storage( const QString &serviceProviderId, QObject *parent = 0 );
@@ -1564,8 +1594,7 @@ public Q_SLOTS:
      *
      * @param name A name to access the written data with.
      * @param data The data to write to disk. The type of the data can also be QVariantMap (ie.
-     *   script objects) or list types (gets encoded to QByteArray). Length of the data is limited
-     *   to 65535 bytes.
+     *   script objects) or list types. The length of the data is not limited.
      * @param lifetime The lifetime in days of the data. Limited to 30 days and defaults to 7 days.
      *
      * @see lifetime
@@ -1605,10 +1634,13 @@ public Q_SLOTS:
     void clearPersistent();
 
 private:
-    int lifetime( const QString &name, const KConfigGroup &group );
-    int lifetimeNoLock( const QString &name, const KConfigGroup &group );
-    void removePersistent( const QString &name, KConfigGroup &group );
-    QByteArray encodeData( const QVariant &data ) const;
+    // Get the store for persistent data, d->readWriteLockPersistent needs to be locked for writing
+    PersistentStorage *persistentStorage() const;
+
+    // Move persistent data from the provider cache file, where it was stored by older versions
+    void migratePersistentData() const;
+
+    // Decode data stored in the provider cache file by older versions
     QVariant decodeData( const QByteArray &data ) const;
 
     StoragePrivate *d;
@@ -0,0 +1,171 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "scriptexecutor.h"
+
+// Own includes
+#include "script_thread.h"
+
+// KDE includes
+#include <ThreadWeaver/Weaver>
+#include <ThreadWeaver/ResourceRestrictionPolicy>
+#include <KGlobal>
+#include <KDebug>
+
+const int ScriptExecutor::DEFAULT_MAXIMUM_THREADS = 4;
+const int ScriptExecutor::DEFAULT_PROVIDER_CONCURRENCY = 2;
+
+K_GLOBAL_STATIC( ScriptExecutor, globalScriptExecutor )
+
+ScriptExecutor::ScriptExecutor( int maximumThreads )
+        : m_weaver(new ThreadWeaver::Weaver())
+{
+    m_weaver->setMaximumNumberOfThreads( maximumThreads );
+}
+
+ScriptExecutor::~ScriptExecutor()
+{
+    // Remove queued jobs and wait for running jobs, before deleting the policies used by them
+    m_weaver->dequeue();
+    m_weaver->finish();
+    delete m_weaver;
+    qDeleteAll( m_providerPolicies );
+}
+
+ScriptExecutor *ScriptExecutor::instance()
+{
+    return globalScriptExecutor;
+}
+
+ScriptExecutor::JobPriority ScriptExecutor::priorityForJob( const ScriptJob *job )
+{
+    if ( qobject_cast<const StopSuggestionsJob*>(job) ||
+         qobject_cast<const StopsByGeoPositionJob*>(job) )
+    {
+        return StopSuggestionsPriority;
+    } else if ( qobject_cast<const AdditionalDataJob*>(job) ) {
+        return AdditionalDataPriority;
+    } else if ( job->isBackgroundUpdate() ) {
+        return BackgroundUpdatePriority;
+    } else {
+        return TimetablePriority;
+    }
+}
+
+ThreadWeaver::ResourceRestrictionPolicy *ScriptExecutor::providerPolicy(
+        const QString &providerId )
+{
+    ThreadWeaver::ResourceRestrictionPolicy *policy = m_providerPolicies.value( providerId );
+    if ( !policy ) {
+        policy = new ThreadWeaver::ResourceRestrictionPolicy( DEFAULT_PROVIDER_CONCURRENCY );
+        m_providerPolicies.insert( providerId, policy );
+    }
+    return policy;
+}
+
+void ScriptExecutor::enqueue( ScriptJob *job, const QString &providerId )
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        job->assignQueuePolicy( providerPolicy(providerId) );
+    }
+
+    // The priority must be set before enqueueing, the weaver sorts the queue when adding jobs
+    job->setPriority( priorityForJob(job) );
+    job->markEnqueued();
+    m_weaver->enqueue( job );
+}
+
+bool ScriptExecutor::dequeue( ScriptJob *job )
+{
+    return m_weaver->dequeue( job );
+}
+
+void ScriptExecutor::recordQueueWaitTime( const ScriptJob *job )
+{
+    const qint64 waitTime = job->queueWaitTime();
+    if ( waitTime < 0 ) {
+        return;
+    }
+
+    QMutexLocker locker( &m_mutex );
+    WaitStatistics &statistics = m_waitStatistics[ job->priority() ];
+    ++statistics.count;
+    statistics.totalWaitTime += waitTime;
+    statistics.maxWaitTime = qMax( statistics.maxWaitTime, waitTime );
+}
+
+int ScriptExecutor::providerConcurrency( const QString &providerId ) const
+{
+    QMutexLocker locker( &m_mutex );
+    const ThreadWeaver::ResourceRestrictionPolicy *policy = m_providerPolicies.value( providerId );
+    return policy ? policy->cap() : DEFAULT_PROVIDER_CONCURRENCY;
+}
+
+void ScriptExecutor::setProviderConcurrency( const QString &providerId, int maximumJobs )
+{
+    QMutexLocker locker( &m_mutex );
+    providerPolicy( providerId )->setCap( qMax(1, maximumJobs) );
+}
+
+int ScriptExecutor::queueLength() const
+{
+    return m_weaver->queueLength();
+}
+
+QVariantHash ScriptExecutor::diagnostics() const
+{
+    QMutexLocker locker( &m_mutex );
+    QVariantHash waitTimes;
+    for ( QHash<int, WaitStatistics>::ConstIterator it = m_waitStatistics.constBegin();
+          it != m_waitStatistics.constEnd(); ++it )
+    {
+        QString name;
+        switch ( it.key() ) {
+        case StopSuggestionsPriority:
+            name = "stopSuggestions";
+            break;
+        case TimetablePriority:
+            name = "timetable";
+            break;
+        case BackgroundUpdatePriority:
+            name = "backgroundUpdate";
+            break;
+        case AdditionalDataPriority:
+            name = "additionalData";
+            break;
+        default:
+            kWarning() << "Unknown job priority" << it.key();
+            continue;
+        }
+
+        QVariantHash statistics;
+        statistics.insert( "count", it->count );
+        statistics.insert( "averageWaitTime", it->count == 0 ? 0 : it->totalWaitTime / it->count );
+        statistics.insert( "maxWaitTime", it->maxWaitTime );
+        waitTimes.insert( name, statistics );
+    }
+
+    QVariantHash data;
+    data.insert( "queueLength", m_weaver->queueLength() );
+    data.insert( "maximumThreads", m_weaver->maximumNumberOfThreads() );
+    data.insert( "waitTimes", waitTimes );
+    return data;
+}
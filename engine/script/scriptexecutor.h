@@ -0,0 +1,132 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the executor for jobs of scripted service providers.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef SCRIPTEXECUTOR_HEADER
+#define SCRIPTEXECUTOR_HEADER
+
+// Qt includes
+#include <QHash>
+#include <QMutex>
+#include <QVariant>
+
+class ScriptJob;
+namespace ThreadWeaver {
+    class Weaver;
+    class ResourceRestrictionPolicy;
+}
+
+/**
+ * @brief Executes ScriptJobs of all scripted service providers in a dedicated thread pool.
+ *
+ * The global ThreadWeaver instance is shared with the rest of the process and has no limits
+ * per provider. A slow provider could occupy all worker threads there, while interactive
+ * requests wait behind automatic updates. This executor uses an own ThreadWeaver::Weaver with
+ * a bounded number of threads (DEFAULT_MAXIMUM_THREADS) and limits the number of concurrently
+ * running jobs per provider (DEFAULT_PROVIDER_CONCURRENCY).
+ *
+ * Queued jobs get executed in the order of their JobPriority, see priorityForJob(). The time
+ * jobs wait in the queue gets collected per priority using recordQueueWaitTime() and is
+ * available using diagnostics().
+ **/
+class ScriptExecutor {
+public:
+    /** @brief Priorities of script jobs, jobs with higher priority get executed first. */
+    enum JobPriority {
+        AdditionalDataPriority = 0, /**< Requests for additional data of timetable items. */
+        BackgroundUpdatePriority = 10, /**< Automatic updates of existing data sources. */
+        TimetablePriority = 20, /**< New departures/arrivals/journeys, eg. visible in an applet. */
+        StopSuggestionsPriority = 30 /**< Interactive stop suggestion requests. */
+    };
+
+    /** @brief Create a new executor using maximally @p maximumThreads threads. */
+    explicit ScriptExecutor( int maximumThreads = DEFAULT_MAXIMUM_THREADS );
+
+    /** @brief Destructor, waits for running jobs to finish. */
+    ~ScriptExecutor();
+
+    /** @brief Get the global executor instance, used by all scripted service providers. */
+    static ScriptExecutor *instance();
+
+    /** @brief Get the priority with which @p job should be executed. */
+    static JobPriority priorityForJob( const ScriptJob *job );
+
+    /**
+     * @brief Enqueue @p job for the provider with @p providerId.
+     *
+     * The priority of @p job gets set using priorityForJob(). The job does not get started
+     * while there are already providerConcurrency() running jobs of the same provider.
+     **/
+    void enqueue( ScriptJob *job, const QString &providerId );
+
+    /**
+     * @brief Remove @p job from the queue.
+     * @return @c True, if the job was removed, ie. it was not started yet, @c false otherwise.
+     **/
+    bool dequeue( ScriptJob *job );
+
+    /** @brief Add the queue wait time of the started @p job to the statistics. */
+    void recordQueueWaitTime( const ScriptJob *job );
+
+    /** @brief The maximal number of concurrently running jobs of the provider @p providerId. */
+    int providerConcurrency( const QString &providerId ) const;
+
+    /** @brief Set the maximal number of concurrently running jobs of @p providerId. */
+    void setProviderConcurrency( const QString &providerId, int maximumJobs );
+
+    /** @brief The number of queued jobs, which are not started yet. */
+    int queueLength() const;
+
+    /**
+     * @brief Get diagnostic data about the executor.
+     *
+     * Contains "queueLength" and "maximumThreads" fields and a "waitTimes" field with a
+     * QVariantHash for each job priority, see @ref usage_updatescheduler_sec.
+     **/
+    QVariantHash diagnostics() const;
+
+    /** @brief The default maximal number of threads used to execute scripts. */
+    static const int DEFAULT_MAXIMUM_THREADS;
+
+    /** @brief The default maximal number of concurrently running jobs per provider. */
+    static const int DEFAULT_PROVIDER_CONCURRENCY;
+
+private:
+    struct WaitStatistics {
+        WaitStatistics() : count(0), totalWaitTime(0), maxWaitTime(0) {};
+
+        int count;
+        qint64 totalWaitTime;
+        qint64 maxWaitTime;
+    };
+
+    // Get the concurrency policy for @p providerId, create it if it does not exist.
+    // m_mutex needs to be locked.
+    ThreadWeaver::ResourceRestrictionPolicy *providerPolicy( const QString &providerId );
+
+    ThreadWeaver::Weaver *m_weaver;
+    mutable QMutex m_mutex;
+    QHash< QString, ThreadWeaver::ResourceRestrictionPolicy* > m_providerPolicies;
+    QHash< int, WaitStatistics > m_waitStatistics; // By JobPriority
+};
+
+#endif // Multiple inclusion guard
@@ -22,6 +22,7 @@
 
 // Own includes
 #include "script_thread.h"
+#include "networksession.h"
 
 // KDE includes
 #include <KLocalizedString>
@@ -78,7 +79,9 @@ void ScriptObjects::createObjects( const ScriptData &data )
         storage = QSharedPointer< Storage >( new Storage(data.provider.id()) );
     }
     if ( !network ) {
-        network = QSharedPointer< Network >( new Network(data.provider.fallbackCharset()) );
+        // Use the long-lived session of the provider to reuse connections of previous jobs
+        network = QSharedPointer< Network >( new Network(data.provider.fallbackCharset(),
+                NetworkSession::forProvider(data.provider.id(), data.provider.useHttpCache())) );
     }
     if ( !result ) {
         result = QSharedPointer< ResultObject >( new ResultObject() );
@@ -175,14 +178,7 @@ bool ScriptObjects::attachToEngine( QScriptEngine *engine, const ScriptData &dat
     engine->globalObject().setProperty( "DataStream", streamMeta, flags );
 
     // Make the objects available to the script
-    engine->globalObject().setProperty( "helper", helper.isNull()
-            ? engine->undefinedValue() : engine->newQObject(helper.data()), flags );
-    engine->globalObject().setProperty( "network", network.isNull()
-            ? engine->undefinedValue() : engine->newQObject(network.data()), flags );
-    engine->globalObject().setProperty( "storage", storage.isNull()
-            ? engine->undefinedValue() : engine->newQObject(storage.data()), flags );
-    engine->globalObject().setProperty( "result", result.isNull()
-            ? engine->undefinedValue() : engine->newQObject(result.data()), flags );
+    attachJobObjects( engine );
     engine->globalObject().setProperty( "enums",
             engine->newQMetaObject(&ResultObject::staticMetaObject), flags );
     engine->globalObject().setProperty( "PublicTransport",
@@ -207,3 +203,16 @@ bool ScriptObjects::attachToEngine( QScriptEngine *engine, const ScriptData &dat
 
     return true;
 }
+
+void ScriptObjects::attachJobObjects( QScriptEngine *engine )
+{
+    const QScriptValue::PropertyFlags flags = QScriptValue::ReadOnly | QScriptValue::Undeletable;
+    engine->globalObject().setProperty( "helper", helper.isNull()
+            ? engine->undefinedValue() : engine->newQObject(helper.data()), flags );
+    engine->globalObject().setProperty( "network", network.isNull()
+            ? engine->undefinedValue() : engine->newQObject(network.data()), flags );
+    engine->globalObject().setProperty( "storage", storage.isNull()
+            ? engine->undefinedValue() : engine->newQObject(storage.data()), flags );
+    engine->globalObject().setProperty( "result", result.isNull()
+            ? engine->undefinedValue() : engine->newQObject(result.data()), flags );
+}
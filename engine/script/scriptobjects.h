@@ -58,6 +58,12 @@ struct ScriptObjects {
                         const QSharedPointer< QScriptProgram > &scriptProgram );
     void createObjects( const ScriptData &data = ScriptData() );
     bool attachToEngine( QScriptEngine *engine, const ScriptData &data );
+
+    /**
+     * @brief Attach only the per job objects to an already initialized @p engine.
+     * Replaces the "helper", "network", "storage" and "result" objects in @p engine.
+     **/
+    void attachJobObjects( QScriptEngine *engine );
     void moveToThread( QThread *thread );
     QThread *currentThread() const;
 
@@ -23,6 +23,7 @@
 // Own includes
 #include "scriptapi.h"
 #include "script_thread.h"
+#include "scriptexecutor.h"
 #include "serviceproviderglobal.h"
 #include "serviceproviderdata.h"
 #include "serviceprovidertestdata.h"
@@ -35,7 +36,6 @@
 #include <KConfigGroup>
 #include <KStandardDirs>
 #include <KDebug>
-#include <ThreadWeaver/Weaver>
 #include <ThreadWeaver/Job>
 
 // Qt includes
@@ -59,7 +59,8 @@ const char *ServiceProviderScript::SCRIPT_FUNCTION_GETADDITIONALDATA = "getAddit
 ServiceProviderScript::ServiceProviderScript( const ServiceProviderData *data, QObject *parent,
                                               const QSharedPointer<KConfig> &cache )
         : ServiceProvider(data, parent),
-          m_scriptStorage(QSharedPointer<Storage>(new Storage(data->id())))
+          m_scriptStorage(QSharedPointer<Storage>(new Storage(data->id()))),
+          m_enginePool(new ScriptEnginePool(this))
 {
     m_scriptState = WaitingForScriptUsage;
     m_scriptFeatures = readScriptFeatures( cache.isNull() ? ServiceProviderGlobal::cache() : cache );
@@ -86,6 +87,12 @@ void ServiceProviderScript::abortAllRequests()
 {
     // Abort all running jobs and wait for them to finish for proper cleanup
     foreach ( ScriptJob *job, m_runningJobs ) {
+        if ( ScriptExecutor::instance()->dequeue(job) ) {
+            // The job was not started yet
+            job->deleteLater();
+            continue;
+        }
+
         kDebug() << "Abort job" << job;
 
         // Create an event loop to wait for the job to finish,
@@ -430,92 +437,86 @@ QList<Enums::ProviderFeature> ServiceProviderScript::features() const
 void ServiceProviderScript::departuresReady( const QList<TimetableData> &data,
         ResultObject::Features features, ResultObject::Hints hints, const QString &url,
         const GlobalTimetableInfo &globalInfo, const DepartureRequest &request,
-        bool couldNeedForcedUpdate )
+        int chunkIndex, bool isLastChunk )
 {
 //     TODO use hints
-    if ( data.isEmpty() ) {
+    if ( data.isEmpty() && chunkIndex == 0 ) {
         kDebug() << "The script didn't find any departures" << request.sourceName();
         emit requestFailed( this, ErrorParsingFailed,
                            i18n("Error while parsing the departure document."), url, &request );
     } else {
-        // Create PublicTransportInfo objects for new data and combine with already published data
+        // Create PublicTransportInfo objects only for the newly published data,
+        // the engine appends them to the data of previous chunks. The last chunk may be empty,
+        // it marks the data of previous chunks complete
         PublicTransportInfoList newResults;
         ResultObject::dataList( data, &newResults, request.parseMode(),
                                 m_data->defaultVehicleType(), &globalInfo, features, hints );
-        PublicTransportInfoList results = (m_publishedData[request.sourceName()] << newResults);
         DepartureInfoList departures;
-        foreach( const PublicTransportInfoPtr &info, results ) {
-            departures << info.dynamicCast<DepartureInfo>();
+        foreach( const PublicTransportInfo &info, newResults ) {
+            departures << DepartureInfo( info );
         }
 
-        emit departuresReceived( this, url, departures, globalInfo, request );
-        if ( couldNeedForcedUpdate ) {
-            emit forceUpdate();
-        }
+        emit departuresReceived( this, url, departures, globalInfo, request, chunkIndex,
+                                 isLastChunk );
     }
 }
 
 void ServiceProviderScript::arrivalsReady( const QList< TimetableData > &data,
         ResultObject::Features features, ResultObject::Hints hints, const QString &url,
         const GlobalTimetableInfo &globalInfo, const ArrivalRequest &request,
-        bool couldNeedForcedUpdate )
+        int chunkIndex, bool isLastChunk )
 {
 //     TODO use hints
-    if ( data.isEmpty() ) {
+    if ( data.isEmpty() && chunkIndex == 0 ) {
         kDebug() << "The script didn't find any arrivals" << request.sourceName();
         emit requestFailed( this, ErrorParsingFailed,
                            i18n("Error while parsing the arrival document."), url, &request );
     } else {
-        // Create PublicTransportInfo objects for new data and combine with already published data
+        // Create PublicTransportInfo objects only for the newly published data
         PublicTransportInfoList newResults;
         ResultObject::dataList( data, &newResults, request.parseMode(),
                                 m_data->defaultVehicleType(), &globalInfo, features, hints );
-        PublicTransportInfoList results = (m_publishedData[request.sourceName()] << newResults);
         ArrivalInfoList arrivals;
-        foreach( const PublicTransportInfoPtr &info, results ) {
-            arrivals << info.dynamicCast<ArrivalInfo>();
+        foreach( const PublicTransportInfo &info, newResults ) {
+            arrivals << ArrivalInfo( info );
         }
 
-        emit arrivalsReceived( this, url, arrivals, globalInfo, request );
-        if ( couldNeedForcedUpdate ) {
-            emit forceUpdate();
-        }
+        emit arrivalsReceived( this, url, arrivals, globalInfo, request, chunkIndex,
+                               isLastChunk );
     }
 }
 
 void ServiceProviderScript::journeysReady( const QList<TimetableData> &data,
         ResultObject::Features features, ResultObject::Hints hints, const QString &url,
         const GlobalTimetableInfo &globalInfo, const JourneyRequest &request,
-        bool couldNeedForcedUpdate )
+        int chunkIndex, bool isLastChunk )
 {
-    Q_UNUSED( couldNeedForcedUpdate );
 //     TODO use hints
-    if ( data.isEmpty() ) {
+    if ( data.isEmpty() && chunkIndex == 0 ) {
         kDebug() << "The script didn't find any journeys" << request.sourceName();
         emit requestFailed( this, ErrorParsingFailed,
                            i18n("Error while parsing the journey document."), url, &request );
     } else {
-        // Create PublicTransportInfo objects for new data and combine with already published data
+        // Create PublicTransportInfo objects only for the newly published data
         PublicTransportInfoList newResults;
         ResultObject::dataList( data, &newResults, request.parseMode(),
                                 m_data->defaultVehicleType(), &globalInfo, features, hints );
-        PublicTransportInfoList results =
-                (m_publishedData[request.sourceName()] << newResults);
         JourneyInfoList journeys;
-        foreach( const PublicTransportInfoPtr &info, results ) {
-            journeys << info.dynamicCast<JourneyInfo>();
+        foreach( const PublicTransportInfo &info, newResults ) {
+            journeys << JourneyInfo( info );
         }
 
-        emit journeysReceived( this, url, journeys, globalInfo, request );
+        emit journeysReceived( this, url, journeys, globalInfo, request, chunkIndex,
+                               isLastChunk );
     }
 }
 
 void ServiceProviderScript::stopSuggestionsReady( const QList<TimetableData> &data,
         ResultObject::Features features, ResultObject::Hints hints, const QString &url,
         const GlobalTimetableInfo &globalInfo, const StopSuggestionRequest &request,
-        bool couldNeedForcedUpdate )
+        int chunkIndex )
 {
-    Q_UNUSED( couldNeedForcedUpdate );
+    Q_UNUSED( chunkIndex );
 //     TODO use hints
     kDebug() << "Received" << data.count() << "items";
 
@@ -524,11 +525,11 @@ void ServiceProviderScript::stopSuggestionsReady( const QList<TimetableData> &da
     ResultObject::dataList( data, &newResults, request.parseMode(),
                             m_data->defaultVehicleType(), &globalInfo, features, hints );
     PublicTransportInfoList results( m_publishedData[request.sourceName()] << newResults );
-    kDebug() << "Results:" << results;
+    kDebug() << "Results:" << results.count();
 
     StopInfoList stops;
-    foreach( const PublicTransportInfoPtr &info, results ) {
-        stops << info.dynamicCast<StopInfo>();
+    foreach( const PublicTransportInfo &info, results ) {
+        stops << StopInfo( info );
     }
 
     emit stopsReceived( this, url, stops, request );
@@ -537,12 +538,12 @@ void ServiceProviderScript::stopSuggestionsReady( const QList<TimetableData> &da
 void ServiceProviderScript::additionalDataReady( const TimetableData &data,
         ResultObject::Features features, ResultObject::Hints hints, const QString &url,
         const GlobalTimetableInfo &globalInfo, const AdditionalDataRequest &request,
-        bool couldNeedForcedUpdate )
+        int chunkIndex )
 {
     Q_UNUSED( features );
     Q_UNUSED( hints );
     Q_UNUSED( globalInfo );
-    Q_UNUSED( couldNeedForcedUpdate );
+    Q_UNUSED( chunkIndex );
     if ( data.isEmpty() ) {
         kDebug() << "The script didn't find any new data" << request.sourceName();
         emit requestFailed( this, ErrorParsingFailed,
@@ -575,6 +576,10 @@ void ServiceProviderScript::jobDone( ThreadWeaver::Job* job )
     ScriptJob *scriptJob = qobject_cast< ScriptJob* >( job );
     Q_ASSERT( scriptJob );
 
+    // Record the queue wait time here, when the job was started it may not be set yet,
+    // the started() signal gets received before run() stops the queue timer
+    ScriptExecutor::instance()->recordQueueWaitTime( scriptJob );
+
     m_publishedData.remove( scriptJob->sourceName() );
     m_runningJobs.removeOne( scriptJob );
     scriptJob->deleteLater();
@@ -593,8 +598,8 @@ void ServiceProviderScript::requestDepartures( const DepartureRequest &request )
 {
     if ( lazyLoadScript() ) {
         DepartureJob *job = new DepartureJob( m_scriptData, m_scriptStorage, request, this );
-        connect( job, SIGNAL(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,bool)),
-                this, SLOT(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,bool)) );
+        connect( job, SIGNAL(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,int,bool)),
+                this, SLOT(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,int,bool)) );
         enqueue( job );
     }
 }
@@ -603,8 +608,8 @@ void ServiceProviderScript::requestArrivals( const ArrivalRequest &request )
 {
     if ( lazyLoadScript() ) {
         ArrivalJob *job = new ArrivalJob( m_scriptData, m_scriptStorage, request, this );
-        connect( job, SIGNAL(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,bool)),
-                 this, SLOT(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,bool)) );
+        connect( job, SIGNAL(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,int,bool)),
+                 this, SLOT(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,int,bool)) );
         enqueue( job );
     }
 }
@@ -613,8 +618,8 @@ void ServiceProviderScript::requestJourneys( const JourneyRequest &request )
 {
     if ( lazyLoadScript() ) {
         JourneyJob *job = new JourneyJob( m_scriptData, m_scriptStorage, request, this );
-        connect( job, SIGNAL(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,bool)),
-                 this, SLOT(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,bool)) );
+        connect( job, SIGNAL(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,int,bool)),
+                 this, SLOT(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,int,bool)) );
         enqueue( job );
     }
 }
@@ -623,8 +628,8 @@ void ServiceProviderScript::requestStopSuggestions( const StopSuggestionRequest
 {
     if ( lazyLoadScript() ) {
         StopSuggestionsJob *job = new StopSuggestionsJob( m_scriptData, m_scriptStorage, request, this );
-        connect( job, SIGNAL(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,bool)),
-                 this, SLOT(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,bool)) );
+        connect( job, SIGNAL(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,int)),
+                 this, SLOT(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,int)) );
         enqueue( job );
     }
 }
@@ -635,20 +640,23 @@ void ServiceProviderScript::requestStopsByGeoPosition(
     if ( lazyLoadScript() ) {
         StopsByGeoPositionJob *job = new StopsByGeoPositionJob(
                 m_scriptData, m_scriptStorage, request, this );
-        connect( job, SIGNAL(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,bool)),
-                 this, SLOT(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,bool)) );
+        connect( job, SIGNAL(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,int)),
+                 this, SLOT(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,int)) );
         enqueue( job );
     }
 }
 
-void ServiceProviderScript::requestAdditionalData( const AdditionalDataRequest &request )
+bool ServiceProviderScript::requestAdditionalData( const AdditionalDataRequest &request )
 {
-    if ( lazyLoadScript() ) {
-        AdditionalDataJob *job = new AdditionalDataJob( m_scriptData, m_scriptStorage, request, this );
-        connect( job, SIGNAL(additionalDataReady(TimetableData,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,AdditionalDataRequest,bool)),
-                 this, SLOT(additionalDataReady(TimetableData,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,AdditionalDataRequest,bool)) );
-        enqueue( job );
+    if ( !lazyLoadScript() ) {
+        return false;
     }
+
+    AdditionalDataJob *job = new AdditionalDataJob( m_scriptData, m_scriptStorage, request, this );
+    connect( job, SIGNAL(additionalDataReady(TimetableData,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,AdditionalDataRequest,int)),
+             this, SLOT(additionalDataReady(TimetableData,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,AdditionalDataRequest,int)) );
+    enqueue( job );
+    return true;
 }
 
 void ServiceProviderScript::requestMoreItems( const MoreItemsRequest &moreItemsRequest )
@@ -656,12 +664,12 @@ void ServiceProviderScript::requestMoreItems( const MoreItemsRequest &moreItemsR
     if ( lazyLoadScript() ) {
         // Create a MoreItemsJob and connect ready signals for more departures/arrivals/journeys
         MoreItemsJob *job = new MoreItemsJob( m_scriptData, m_scriptStorage, moreItemsRequest, this );
-        connect( job, SIGNAL(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,bool)),
-                this, SLOT(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,bool)) );
-        connect( job, SIGNAL(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,bool)),
-                 this, SLOT(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,bool)) );
-        connect( job, SIGNAL(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,bool)),
-                 this, SLOT(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,bool)) );
+        connect( job, SIGNAL(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,int,bool)),
+                this, SLOT(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,int,bool)) );
+        connect( job, SIGNAL(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,int,bool)),
+                 this, SLOT(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,int,bool)) );
+        connect( job, SIGNAL(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,int,bool)),
+                 this, SLOT(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,int,bool)) );
         enqueue( job );
     }
 }
@@ -669,10 +677,45 @@ void ServiceProviderScript::requestMoreItems( const MoreItemsRequest &moreItemsR
 void ServiceProviderScript::enqueue( ScriptJob *job )
 {
     m_runningJobs << job;
+    job->setEnginePool( m_enginePool );
     connect( job, SIGNAL(started(ThreadWeaver::Job*)), this, SLOT(jobStarted(ThreadWeaver::Job*)) );
     connect( job, SIGNAL(done(ThreadWeaver::Job*)), this, SLOT(jobDone(ThreadWeaver::Job*)) );
     connect( job, SIGNAL(failed(ThreadWeaver::Job*)), this, SLOT(jobFailed(ThreadWeaver::Job*)) );
-    ThreadWeaver::Weaver::instance()->enqueue( job );
+    cancelSupersededJobs( job );
+    ScriptExecutor::instance()->enqueue( job, m_data->id() );
+}
+
+void ServiceProviderScript::cancelSupersededJobs( ScriptJob *newJob )
+{
+    // Only stop suggestion requests with a requester ID can supersede other requests
+    const QString requester = newJob->requester();
+    if ( requester.isEmpty() ) {
+        return;
+    }
+
+    const QString sourceName = newJob->sourceName();
+    QList< ScriptJob* >::Iterator it = m_runningJobs.begin();
+    while ( it != m_runningJobs.end() ) {
+        // Only cancel jobs of the same kind (stop suggestions by name or by geo position)
+        // from the same requester
+        ScriptJob *job = *it;
+        if ( job == newJob || job->sourceName() == sourceName ||
+             job->metaObject() != newJob->metaObject() || job->requester() != requester ||
+             !ScriptExecutor::instance()->dequeue(job) )
+        {
+            // Not a superseded stop suggestion job or the job was already started
+            ++it;
+            continue;
+        }
+
+        kDebug() << "Cancel superseded stop suggestion job" << job->sourceName();
+        it = m_runningJobs.erase( it );
+        disconnect( job, 0, this, 0 );
+        emit requestFailed( this, ErrorRequestCancelled,
+                            i18nc("@info/plain", "The request was superseded by a newer "
+                                  "stop suggestion request."), QUrl(), job->cloneRequest() );
+        job->deleteLater();
+    }
 }
 
 void ServiceProviderScript::import( const QString &import, QScriptEngine *engine )
@@ -31,6 +31,7 @@
 #include "scriptobjects.h"
 
 class ScriptJob;
+class ScriptEnginePool;
 namespace ScriptApi {
     class Storage;
 }
@@ -180,7 +181,7 @@ public:
      * @brief Requests additional data as described in @p request.
      * When the additional data is completely received additionDataReceived() gets emitted.
      **/
-    virtual void requestAdditionalData( const AdditionalDataRequest &request );
+    virtual bool requestAdditionalData( const AdditionalDataRequest &request );
 
     /**
      * @brief Request more items for a data source as described in @p moreItemsRequest.
@@ -197,37 +198,44 @@ public:
     virtual int minFetchWait( UpdateFlags updateFlags = DefaultUpdateFlags ) const;
 
 protected slots:
-    /** @brief Departure @p data is ready, emits departuresReceived(). */
+    /**
+     * @brief Departure @p data is ready, emits departuresReceived().
+     * Only the newly published departures get emitted together with @p chunkIndex and
+     * @p isLastChunk.
+     **/
     void departuresReady( const QList<TimetableData> &data,
                           ResultObject::Features features, ResultObject::Hints hints,
                           const QString &url, const GlobalTimetableInfo &globalInfo,
-                          const DepartureRequest &request, bool couldNeedForcedUpdate = false );
+                          const DepartureRequest &request, int chunkIndex = 0,
+                          bool isLastChunk = true );
 
     /** @brief Arrival @p data is ready, emits arrivalsReceived(). */
     void arrivalsReady( const QList<TimetableData> &data,
                         ResultObject::Features features, ResultObject::Hints hints,
                         const QString &url, const GlobalTimetableInfo &globalInfo,
-                        const ArrivalRequest &request, bool couldNeedForcedUpdate = false );
+                        const ArrivalRequest &request, int chunkIndex = 0,
+                        bool isLastChunk = true );
 
     /** @brief Journey @p data is ready, emits journeysReceived(). */
     void journeysReady( const QList<TimetableData> &data, ResultObject::Features features,
                         ResultObject::Hints hints, const QString &url,
                         const GlobalTimetableInfo &globalInfo,
-                        const JourneyRequest &request, bool couldNeedForcedUpdate = false );
+                        const JourneyRequest &request, int chunkIndex = 0,
+                        bool isLastChunk = true );
 
     /** @brief Stop suggestion @p data is ready, emits stopsReceived(). */
     void stopSuggestionsReady( const QList<TimetableData> &data, ResultObject::Features features,
                                ResultObject::Hints hints, const QString &url,
                                const GlobalTimetableInfo &globalInfo,
                                const StopSuggestionRequest &request,
-                               bool couldNeedForcedUpdate = false );
+                               int chunkIndex = 0 );
 
     /** @brief Additional @p data is ready, emits additionalDataReceived(). */
     void additionalDataReady( const TimetableData &data,
                             ResultObject::Features features, ResultObject::Hints hints,
                             const QString &url, const GlobalTimetableInfo &globalInfo,
                             const AdditionalDataRequest &request,
-                            bool couldNeedForcedUpdate = false );
+                            int chunkIndex = 0 );
 
     /** @brief A @p job was started. */
     void jobStarted( ThreadWeaver::Job *job );
@@ -253,9 +261,23 @@ protected:
     /** @brief Run script provider specific tests. */
     virtual bool runTests( QString *errorMessage = 0 ) const;
 
-    /** @brief Enqueue @p job in the job queue. */
+    /**
+     * @brief Enqueue @p job in the queue of the ScriptExecutor.
+     *
+     * Queued stop suggestion jobs of the same kind and requester for other source names get
+     * cancelled when a new stop suggestion job gets enqueued, their results would be outdated,
+     * eg. when the user continues typing a stop name.
+     **/
     void enqueue( ScriptJob *job );
 
+    /**
+     * @brief Cancel queued stop suggestion jobs, which got superseded by @p newJob.
+     *
+     * Only jobs of the same class as @p newJob with the same StopSuggestionRequest::requester()
+     * get cancelled. Jobs without a requester never get cancelled.
+     **/
+    void cancelSupersededJobs( ScriptJob *newJob );
+
 private:
     static bool checkIncludedFiles( const QSharedPointer<KConfig> &cache,
                                     const QString &providerId = QString() );
@@ -268,6 +290,7 @@ private:
 
     ScriptData m_scriptData;
     QSharedPointer< Storage > m_scriptStorage;
+    ScriptEnginePool *m_enginePool; // Initialized script engines for reuse in jobs
     QList< ScriptJob* > m_runningJobs;
 };
 
@@ -0,0 +1,140 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "sharednetworkcache.h"
+
+// KDE includes
+#include <KGlobal>
+#include <KStandardDirs>
+
+// Qt includes
+#include <QNetworkDiskCache>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QMutex>
+#include <QMutexLocker>
+
+const qint64 SharedNetworkCache::MAXIMUM_CACHE_SIZE = 10 * 1024 * 1024;
+
+class SharedDiskCache {
+public:
+    SharedDiskCache() : cache(new QNetworkDiskCache()) {
+        cache->setCacheDirectory( KGlobal::dirs()->saveLocation("cache",
+                "plasma_engine_publictransport/http/") );
+        cache->setMaximumCacheSize( SharedNetworkCache::MAXIMUM_CACHE_SIZE );
+    };
+
+    ~SharedDiskCache() {
+        delete cache;
+    };
+
+    QMutex mutex;
+    QNetworkDiskCache *cache;
+    QAtomicInt hitCount;
+    QAtomicInt missCount;
+};
+
+K_GLOBAL_STATIC( SharedDiskCache, sharedDiskCache )
+
+SharedNetworkCache::SharedNetworkCache( QObject *parent )
+        : QAbstractNetworkCache(parent)
+{
+}
+
+SharedNetworkCache::~SharedNetworkCache()
+{
+}
+
+QNetworkCacheMetaData SharedNetworkCache::metaData( const QUrl &url )
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    return sharedDiskCache->cache->metaData( url );
+}
+
+void SharedNetworkCache::updateMetaData( const QNetworkCacheMetaData &metaData )
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    sharedDiskCache->cache->updateMetaData( metaData );
+}
+
+QIODevice *SharedNetworkCache::data( const QUrl &url )
+{
+    // The returned device is owned by the caller and independent of the disk cache
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    return sharedDiskCache->cache->data( url );
+}
+
+bool SharedNetworkCache::remove( const QUrl &url )
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    return sharedDiskCache->cache->remove( url );
+}
+
+qint64 SharedNetworkCache::cacheSize() const
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    return sharedDiskCache->cache->cacheSize();
+}
+
+QIODevice *SharedNetworkCache::prepare( const QNetworkCacheMetaData &metaData )
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    return sharedDiskCache->cache->prepare( metaData );
+}
+
+void SharedNetworkCache::insert( QIODevice *device )
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    sharedDiskCache->cache->insert( device );
+}
+
+void SharedNetworkCache::clear()
+{
+    QMutexLocker locker( &sharedDiskCache->mutex );
+    sharedDiskCache->cache->clear();
+}
+
+void SharedNetworkCache::recordReply( const QNetworkReply *reply )
+{
+    if ( reply->operation() != QNetworkAccessManager::GetOperation ||
+         !reply->manager() || !reply->manager()->cache() )
+    {
+        return;
+    }
+
+    // Also true for stale data that was revalidated by the server ("304 Not Modified")
+    if ( reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool() ) {
+        sharedDiskCache->hitCount.ref();
+    } else {
+        sharedDiskCache->missCount.ref();
+    }
+}
+
+int SharedNetworkCache::hitCount()
+{
+    return sharedDiskCache->hitCount;
+}
+
+int SharedNetworkCache::missCount()
+{
+    return sharedDiskCache->missCount;
+}
+
+#include "sharednetworkcache.moc"
@@ -0,0 +1,85 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the HTTP cache shared by all scripted service providers.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef SHAREDNETWORKCACHE_HEADER
+#define SHAREDNETWORKCACHE_HEADER
+
+// Qt includes
+#include <QAbstractNetworkCache>
+
+class QNetworkReply;
+
+/**
+ * @brief A network cache for QNetworkAccessManager's, which stores data in one shared disk cache.
+ *
+ * Each ScriptApi::Network object uses an own QNetworkAccessManager, which lives in the thread
+ * of the script job. A QNetworkDiskCache is not thread safe and cannot be used by multiple
+ * QNetworkAccessManager's. Therefore each manager gets an own SharedNetworkCache object, which
+ * forwards all calls to one process wide QNetworkDiskCache while holding a global mutex.
+ *
+ * The size of the disk cache is limited to MAXIMUM_CACHE_SIZE. QNetworkAccessManager uses the
+ * cached data according to the "Cache-Control" and "Expires" headers of replies and revalidates
+ * stale data using "ETag" and "Last-Modified" (conditional requests). For replies that were
+ * (partly) loaded from the cache recordReply() counts a hit, otherwise a miss.
+ **/
+class SharedNetworkCache : public QAbstractNetworkCache {
+    Q_OBJECT
+
+public:
+    /** @brief The maximal size in bytes of the shared disk cache. */
+    static const qint64 MAXIMUM_CACHE_SIZE;
+
+    /** @brief Create a new cache object, which uses the shared disk cache. */
+    explicit SharedNetworkCache( QObject *parent = 0 );
+
+    /** @brief Destructor, the shared disk cache does not get deleted. */
+    virtual ~SharedNetworkCache();
+
+    virtual QNetworkCacheMetaData metaData( const QUrl &url );
+    virtual void updateMetaData( const QNetworkCacheMetaData &metaData );
+    virtual QIODevice *data( const QUrl &url );
+    virtual bool remove( const QUrl &url );
+    virtual qint64 cacheSize() const;
+    virtual QIODevice *prepare( const QNetworkCacheMetaData &metaData );
+    virtual void insert( QIODevice *device );
+
+public slots:
+    virtual void clear();
+
+public:
+    /**
+     * @brief Count a cache hit or miss for the finished @p reply.
+     *
+     * Nothing gets counted if the QNetworkAccessManager of @p reply does not use a cache
+     * or if @p reply is not for a GET request.
+     **/
+    static void recordReply( const QNetworkReply *reply );
+
+    /** @brief The number of replies that were loaded from the cache. */
+    static int hitCount();
+
+    /** @brief The number of replies that were not loaded from the cache. */
+    static int missCount();
+};
+
+#endif // Multiple inclusion guard
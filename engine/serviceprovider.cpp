@@ -163,11 +163,11 @@ void ServiceProvider::requestJourneys( const JourneyRequest &request )
     return;
 }
 
-void ServiceProvider::requestAdditionalData( const AdditionalDataRequest &request )
+bool ServiceProvider::requestAdditionalData( const AdditionalDataRequest &request )
 {
     Q_UNUSED( request );
     kDebug() << "Not implemented";
-    return;
+    return false;
 }
 
 void ServiceProvider::requestMoreItems( const MoreItemsRequest &moreItemsRequest )
@@ -248,8 +248,10 @@ public:
      * When the additional data is completely received additionalDataReceived() gets emitted.
      * The default implementation does nothing.
      * @param request Information about the additional data request.
+     * @return @c True, if the request was started, ie. additionalDataReceived() or
+     *   requestFailed() gets emitted later. @c False, if the request could not be started.
      **/
-    virtual void requestAdditionalData( const AdditionalDataRequest &request );
+    virtual bool requestAdditionalData( const AdditionalDataRequest &request );
 
     /** @brief Request more items for a data source. */
     virtual void requestMoreItems( const MoreItemsRequest &moreItemsRequest );
@@ -319,11 +321,16 @@ signals:
      * @param requestUrl The url used to request the information.
      * @param departures A list of departures that were received.
      * @param request Information about the request for the just received departure list.
+     * @param chunkIndex The index of the chunk of results in @p departures. Providers may emit
+     *   results in multiple chunks, a chunk index of 0 starts a new result and replaces
+     *   previously received departures, higher indices contain only departures to be appended.
+     * @param isLastChunk Whether or not this is the last chunk of results. The last chunk may not
+     *   contain any departures, if it only marks the departures of previous chunks complete.
      * @see ServiceProvider::useSeperateCityValue()
      **/
     void departuresReceived( ServiceProvider *provider, const QUrl &requestUrl,
             const DepartureInfoList &departures, const GlobalTimetableInfo &globalInfo,
-            const DepartureRequest &request );
+            const DepartureRequest &request, int chunkIndex = 0, bool isLastChunk = true );
 
     /**
      * @brief Emitted when a new arrival list has been received.
@@ -332,11 +339,13 @@ signals:
      * @param requestUrl The url used to request the information.
      * @param arrivals A list of arrivals that were received.
      * @param request Information about the request for the just received arrival list.
+     * @param chunkIndex The index of the chunk of results in @p arrivals, see departuresReceived().
+     * @param isLastChunk Whether or not this is the last chunk, see departuresReceived().
      * @see ServiceProvider::useSeperateCityValue()
      **/
     void arrivalsReceived( ServiceProvider *provider, const QUrl &requestUrl,
             const ArrivalInfoList &arrivals, const GlobalTimetableInfo &globalInfo,
-            const ArrivalRequest &request );
+            const ArrivalRequest &request, int chunkIndex = 0, bool isLastChunk = true );
 
     /**
      * @brief Emitted when a new journey list has been received.
@@ -345,11 +354,13 @@ signals:
      * @param requestUrl The url used to request the information.
      * @param journeys A list of journeys that were received.
      * @param request Information about the request for the just received journey list.
+     * @param chunkIndex The index of the chunk of results in @p journeys, see departuresReceived().
+     * @param isLastChunk Whether or not this is the last chunk, see departuresReceived().
      * @see ServiceProvider::useSeperateCityValue()
      **/
     void journeysReceived( ServiceProvider *provider, const QUrl &requestUrl,
             const JourneyInfoList &journeys, const GlobalTimetableInfo &globalInfo,
-            const JourneyRequest &request );
+            const JourneyRequest &request, int chunkIndex = 0, bool isLastChunk = true );
 
     /**
      * @brief Emitted when a list of stops has been received.
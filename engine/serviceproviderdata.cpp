@@ -56,6 +56,7 @@ ServiceProviderData::ServiceProviderData( const Enums::ServiceProviderType& type
     m_fileFormatVersion = "1.1"; // Current version of the file structure of the .pts-file
     m_useSeparateCityValue = false;
     m_onlyUseCitiesInList = false;
+    m_useHttpCache = true;
     m_defaultVehicleType = Enums::UnknownVehicleType;
     m_minFetchWait = 0;
     m_sampleLongitude = m_sampleLatitude = 0.0;
@@ -80,6 +81,7 @@ ServiceProviderData::ServiceProviderData( const Enums::ServiceProviderType &type
     m_fileFormatVersion = fileVersion;
     m_useSeparateCityValue = useSeparateCityValue;
     m_onlyUseCitiesInList = onlyUseCitiesInList;
+    m_useHttpCache = true;
     m_url = url;
     m_shortUrl = shortUrl;
     m_minFetchWait = minFetchWait;
@@ -113,6 +115,7 @@ ServiceProviderData &ServiceProviderData::operator=( const ServiceProviderData &
     m_fileFormatVersion = data.m_fileFormatVersion;
     m_useSeparateCityValue = data.m_useSeparateCityValue;
     m_onlyUseCitiesInList = data.m_onlyUseCitiesInList;
+    m_useHttpCache = data.m_useHttpCache;
     m_url = data.m_url;
     m_shortUrl = data.m_shortUrl;
     m_minFetchWait = data.m_minFetchWait;
@@ -156,6 +159,7 @@ bool ServiceProviderData::operator ==( const ServiceProviderData &data ) const
            m_fileFormatVersion == data.m_fileFormatVersion &&
            m_useSeparateCityValue == data.m_useSeparateCityValue &&
            m_onlyUseCitiesInList == data.m_onlyUseCitiesInList &&
+           m_useHttpCache == data.m_useHttpCache &&
            m_url == data.m_url &&
            m_shortUrl == data.m_shortUrl &&
            m_minFetchWait == data.m_minFetchWait &&
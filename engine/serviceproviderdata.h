@@ -78,6 +78,7 @@ class ServiceProviderData : public QObject {
     Q_PROPERTY( int minFetchWait READ minFetchWait CONSTANT )
     Q_PROPERTY( bool useSeparateCityValue READ useSeparateCityValue CONSTANT )
     Q_PROPERTY( bool onlyUseCitiesInList READ onlyUseCitiesInList CONSTANT )
+    Q_PROPERTY( bool useHttpCache READ useHttpCache CONSTANT )
     Q_PROPERTY( QString fileName READ fileName CONSTANT )
     Q_PROPERTY( QStringList sampleStopNames READ sampleStopNames CONSTANT )
     Q_PROPERTY( QString sampleCity READ sampleCity CONSTANT )
@@ -232,6 +233,15 @@ public:
      **/
     bool onlyUseCitiesInList() const { return m_onlyUseCitiesInList; };
 
+    /**
+     * @brief Whether or not network requests of the provider may use the shared HTTP cache.
+     *
+     * @return true (default) if GET requests can be answered using cached replies.
+     * @return false if all requests should be sent to the server, eg. because it sends wrong
+     *   caching headers.
+     **/
+    bool useHttpCache() const { return m_useHttpCache; };
+
     /**
      * @brief Get a value for the given city that is used by the service provider.
      *
@@ -479,6 +489,9 @@ public:
     void setOnlyUseCitiesInList( bool onlyUseCitiesInList ) {
         m_onlyUseCitiesInList = onlyUseCitiesInList; };
 
+    /** @brief Set whether or not network requests may use the shared HTTP cache. */
+    void setUseHttpCache( bool useHttpCache ) { m_useHttpCache = useHttpCache; };
+
     void setSampleStops( const QStringList &sampleStopNames )
             { m_sampleStopNames = sampleStopNames; }; // For journeys at least two stop names are required
     void setSampleCity( const QString &sampleCity ) { m_sampleCity = sampleCity; };
@@ -547,6 +560,7 @@ protected:
     QString m_credit;
     bool m_useSeparateCityValue;
     bool m_onlyUseCitiesInList;
+    bool m_useHttpCache;
     QHash<QString, QString> m_hashCityNameToValue; // The city value is used for the url (e.g. "ba" for city name "bratislava").
 
     // Sample data, used to test service provider plugins
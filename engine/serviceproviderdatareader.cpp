@@ -345,6 +345,8 @@ ServiceProviderData *ServiceProviderDataReader::readProviderData( const QString
                 serviceProviderData->setUseSeparateCityValue( readBooleanElement() );
             } else if ( name().compare(QLatin1String("onlyUseCitiesInList"), Qt::CaseInsensitive) == 0 ) {
                 serviceProviderData->setOnlyUseCitiesInList( readBooleanElement() );
+            } else if ( name().compare(QLatin1String("useHttpCache"), Qt::CaseInsensitive) == 0 ) {
+                serviceProviderData->setUseHttpCache( readBooleanElement() );
             } else if ( name().compare(QLatin1String("defaultVehicleType"), Qt::CaseInsensitive) == 0 ) {
                 serviceProviderData->setDefaultVehicleType(
                         Global::vehicleTypeFromString(readElementText()) );
@@ -93,6 +93,12 @@ QString ServiceProviderGlobal::cacheFileName()
             .append( QLatin1String("datacache") );
 }
 
+QString ServiceProviderGlobal::storageFileName( const QString &providerId )
+{
+    return KGlobal::dirs()->saveLocation("data", "plasma_engine_publictransport/storage/")
+            .append( providerId ).append( QLatin1String(".bin") );
+}
+
 QSharedPointer< KConfig > ServiceProviderGlobal::cache()
 {
     return QSharedPointer< KConfig >( new KConfig(cacheFileName(), KConfig::SimpleConfig) );
@@ -122,6 +128,12 @@ void ServiceProviderGlobal::cleanupCache( const QSharedPointer< KConfig > &_cach
 void ServiceProviderGlobal::clearCache( const QString &providerId,
                                         const QSharedPointer< KConfig > &_cache, bool syncCache )
 {
+    // Remove data stored persistently by the provider
+    const QString storageFile = storageFileName( providerId );
+    if ( QFile::exists(storageFile) ) {
+        QFile::remove( storageFile );
+    }
+
     QSharedPointer< KConfig > cache = _cache.isNull() ? ServiceProviderGlobal::cache() : _cache;
     if ( !cache->hasGroup(providerId) ) {
         // No data cached for the provider
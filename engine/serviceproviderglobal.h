@@ -118,12 +118,20 @@ public:
      **/
     static QString cacheFileName();
 
+    /**
+     * @brief Get the name of the file for data stored persistently by the provider @p providerId.
+     *
+     * Scripts store data persistently using Storage::writePersistent().
+     **/
+    static QString storageFileName( const QString &providerId );
+
     /** @brief Cleanup the cache from old entries for no longer installed providers. */
     static void cleanupCache( const QSharedPointer<KConfig> &cache = QSharedPointer<KConfig>() );
 
     /**
      * @brief Clear all values for the provider with the given @p providerId from the @p cache.
      *
+     * The file with data stored persistently by the provider also gets removed.
      * Should be called when a provider was uninstalled.
      **/
     static void clearCache( const QString &providerId,
@@ -0,0 +1,221 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "serviceproviderindex.h"
+
+// Own includes
+#include "serviceproviderglobal.h"
+
+// KDE includes
+#include <KDebug>
+#include <KGlobal>
+#include <KLocale>
+#include <KSaveFile>
+#include <KStandardDirs>
+
+// Qt includes
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+
+const quint32 ServiceProviderIndex::INDEX_MAGIC = 0x50545049; // "PTPI"
+const quint32 ServiceProviderIndex::INDEX_VERSION = 1;
+
+QDataStream &operator<<( QDataStream &stream, const ServiceProviderIndex::Entry &entry )
+{
+    return stream << entry.id << entry.fileName << entry.modifiedTime
+                  << entry.scriptFileName << entry.scriptModifiedTime << entry.location
+                  << entry.isValid << entry.errorMessage << entry.providerData;
+}
+
+QDataStream &operator>>( QDataStream &stream, ServiceProviderIndex::Entry &entry )
+{
+    return stream >> entry.id >> entry.fileName >> entry.modifiedTime
+                  >> entry.scriptFileName >> entry.scriptModifiedTime >> entry.location
+                  >> entry.isValid >> entry.errorMessage >> entry.providerData;
+}
+
+bool ServiceProviderIndex::Entry::isUpToDate( const QString &filePath ) const
+{
+    if ( filePath != fileName || QFileInfo(fileName).lastModified() != modifiedTime ) {
+        // Another provider file with the same ID is installed now or the file was modified
+        return false;
+    }
+
+    // Scripted providers are also modified, if their script file was modified
+    return scriptFileName.isEmpty() ||
+           QFileInfo(scriptFileName).lastModified() == scriptModifiedTime;
+}
+
+ServiceProviderIndex::ServiceProviderIndex( const QString &fileName )
+        : m_fileName(fileName), m_modified(false)
+{
+}
+
+QString ServiceProviderIndex::indexFileName()
+{
+    return KGlobal::dirs()->saveLocation("data", "plasma_engine_publictransport/")
+            .append( QLatin1String("providerindex") );
+}
+
+ServiceProviderIndex::Entry ServiceProviderIndex::createEntry( const QString &providerId,
+        const QVariantHash &providerData, bool isValid, const QString &errorMessage )
+{
+    Entry entry;
+    entry.id = providerId;
+    entry.fileName = providerData.contains("fileName")
+            ? providerData["fileName"].toString()
+            : ServiceProviderGlobal::fileNameFromId( providerId );
+    entry.isValid = isValid;
+    entry.errorMessage = errorMessage;
+    entry.providerData = providerData;
+    if ( entry.fileName.isEmpty() ) {
+        // The provider is not installed
+        return entry;
+    }
+
+    const QFileInfo fileInfo( entry.fileName );
+    entry.modifiedTime = fileInfo.lastModified();
+    entry.scriptFileName = providerData.value( "scriptFileName" ).toString();
+    if ( !entry.scriptFileName.isEmpty() ) {
+        entry.scriptModifiedTime = QFileInfo( entry.scriptFileName ).lastModified();
+    }
+
+    // Symlinks are used for default providers, do not use them for locations
+    const QString fileName = fileInfo.fileName();
+    const int pos = fileName.indexOf( '_' );
+    if ( pos > 0 && !fileInfo.isSymLink() ) {
+        // Cut location code from the provider file name
+        entry.location = fileName.left( pos ).toLower();
+    }
+    return entry;
+}
+
+bool ServiceProviderIndex::load()
+{
+    m_entries.clear();
+    m_modified = false;
+
+    QFile file( m_fileName );
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        // No index was written yet
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    quint32 magic, version;
+    QString language;
+    stream >> magic >> version >> language;
+    if ( magic != INDEX_MAGIC || version != INDEX_VERSION ) {
+        kDebug() << "Discard provider index with unsupported format" << m_fileName;
+        m_modified = true;
+        return false;
+    } else if ( language != KGlobal::locale()->language() ) {
+        // Indexed provider data contains translated strings, eg. feature names
+        kDebug() << "Discard provider index for another language" << language;
+        m_modified = true;
+        return false;
+    }
+
+    QList< Entry > entries;
+    stream >> entries;
+    if ( stream.status() != QDataStream::Ok ) {
+        kWarning() << "Provider index is corrupted, it gets rebuild" << m_fileName;
+        m_modified = true;
+        return false;
+    }
+
+    foreach ( const Entry &entry, entries ) {
+        m_entries.insert( entry.id, entry );
+    }
+    return true;
+}
+
+bool ServiceProviderIndex::save()
+{
+    if ( !m_modified ) {
+        return true;
+    }
+
+    KSaveFile file( m_fileName );
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        kWarning() << "Cannot write provider index" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream << INDEX_MAGIC << INDEX_VERSION << KGlobal::locale()->language()
+           << m_entries.values();
+    if ( !file.finalize() ) {
+        kWarning() << "Cannot write provider index" << m_fileName << file.errorString();
+        return false;
+    }
+
+    m_modified = false;
+    return true;
+}
+
+void ServiceProviderIndex::update( const QStringList &installedProviderPaths )
+{
+    QSet< QString > installedProviderIds;
+    foreach ( const QString &filePath, installedProviderPaths ) {
+        const QString providerId = ServiceProviderGlobal::idFromFileName( filePath );
+        installedProviderIds.insert( providerId );
+
+        QHash< QString, Entry >::Iterator it = m_entries.find( providerId );
+        if ( it != m_entries.end() && !it->isUpToDate(filePath) ) {
+            kDebug() << "Provider was modified since it was indexed" << providerId;
+            m_entries.erase( it );
+            m_modified = true;
+        }
+    }
+
+    // Remove entries of no longer installed providers
+    QHash< QString, Entry >::Iterator it = m_entries.begin();
+    while ( it != m_entries.end() ) {
+        if ( installedProviderIds.contains(it.key()) ) {
+            ++it;
+        } else {
+            it = m_entries.erase( it );
+            m_modified = true;
+        }
+    }
+}
+
+void ServiceProviderIndex::insert( const ServiceProviderIndex::Entry &entry )
+{
+    if ( entry.fileName.isEmpty() ) {
+        // Do not index providers that are not installed
+        return;
+    }
+
+    m_entries.insert( entry.id, entry );
+    m_modified = true;
+}
+
+void ServiceProviderIndex::remove( const QString &providerId )
+{
+    if ( m_entries.remove(providerId) > 0 ) {
+        m_modified = true;
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the index of metadata of all installed service providers.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef SERVICEPROVIDERINDEX_HEADER
+#define SERVICEPROVIDERINDEX_HEADER
+
+// Qt includes
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+#include <QVariant>
+
+/**
+ * @brief An index of metadata of all installed service providers, stored in a single file.
+ *
+ * Without the index all provider plugin XML files need to be read (and possibly tested) to fill
+ * the "ServiceProviders" data source. The index stores the provider data published in that
+ * data source together with the modification times of the provider files and the test result.
+ * It gets loaded with a single read and only providers that were modified since they were
+ * indexed need to be read again. The full XML file of a provider only gets parsed when the
+ * provider gets created.
+ *
+ * The index gets updated incrementally, update() removes entries of uninstalled or modified
+ * providers, new entries get added using insert() after a provider was tested.
+ **/
+class ServiceProviderIndex {
+public:
+    /** @brief Indexed metadata of a single service provider. */
+    struct Entry {
+        Entry() : isValid(false) {};
+
+        /** @brief Whether or not this entry is still up to date with the provider files. */
+        bool isUpToDate( const QString &filePath ) const;
+
+        QString id; /**< The ID of the provider. */
+        QString fileName; /**< The path to the provider plugin XML file. */
+        QDateTime modifiedTime; /**< The modification time of @p fileName. */
+        QString scriptFileName; /**< The path to the script file, if any. */
+        QDateTime scriptModifiedTime; /**< The modification time of @p scriptFileName. */
+        QString location; /**< The location code, empty for symlinks to default providers. */
+        bool isValid; /**< Whether or not the provider passed it's tests. */
+        QString errorMessage; /**< An error message if @p isValid is @c false. */
+        QVariantHash providerData; /**< Data of the provider for the "ServiceProviders" source. */
+    };
+
+    /** @brief Create a new index, stored in @p fileName, use load() to read it. */
+    explicit ServiceProviderIndex( const QString &fileName = indexFileName() );
+
+    /** @brief The default file name of the provider index. */
+    static QString indexFileName();
+
+    /**
+     * @brief Create an index entry for the provider with @p providerId.
+     *
+     * @param providerId The ID of the provider.
+     * @param providerData Data of the provider as published in the "ServiceProviders" source.
+     * @param isValid Whether or not the provider passed it's tests.
+     * @param errorMessage An error message if @p isValid is @c false.
+     * @return The new entry, which has an empty fileName if the provider is not installed.
+     **/
+    static Entry createEntry( const QString &providerId, const QVariantHash &providerData,
+                              bool isValid, const QString &errorMessage = QString() );
+
+    /** @brief Read the index file, returns @c false if it is missing or outdated. */
+    bool load();
+
+    /** @brief Write the index file if it was modified since it was last loaded/saved. */
+    bool save();
+
+    /** @brief Whether or not the index was modified since it was last loaded/saved. */
+    bool isModified() const { return m_modified; };
+
+    /**
+     * @brief Remove entries of providers that are no longer installed or were modified.
+     * @param installedProviderPaths File paths of all installed providers,
+     *   see ServiceProviderGlobal::installedProviders().
+     **/
+    void update( const QStringList &installedProviderPaths );
+
+    /** @brief Whether or not there is an entry for the provider with @p providerId. */
+    bool contains( const QString &providerId ) const {
+        return m_entries.contains( providerId );
+    };
+
+    /** @brief Get the entry for the provider with @p providerId. */
+    Entry entry( const QString &providerId ) const { return m_entries.value(providerId); };
+
+    /** @brief Get all entries in the index. */
+    QList< Entry > entries() const { return m_entries.values(); };
+
+    /** @brief Get the IDs of all providers in the index. */
+    QStringList providerIds() const { return m_entries.keys(); };
+
+    /** @brief Insert/replace @p entry, entries without a file name are ignored. */
+    void insert( const Entry &entry );
+
+    /** @brief Remove the entry for the provider with @p providerId, if any. */
+    void remove( const QString &providerId );
+
+    /** @brief Identifies provider index files. */
+    static const quint32 INDEX_MAGIC;
+
+    /** @brief The version of the index file format, older files get discarded. */
+    static const quint32 INDEX_VERSION;
+
+private:
+    QString m_fileName;
+    QHash< QString, Entry > m_entries;
+    bool m_modified;
+};
+
+#endif // Multiple inclusion guard
@@ -0,0 +1,202 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "NetworkSessionTest.h"
+#include "script/scriptapi.h"
+#include "script/networksession.h"
+
+#include <QtTest/QTest>
+#include <QTcpSocket>
+#include <QEventLoop>
+#include <QTimer>
+
+LocalHttpServer::LocalHttpServer( QObject *parent )
+        : QTcpServer(parent), m_connectionCount(0), m_requestCount(0)
+{
+    connect( this, SIGNAL(newConnection()), this, SLOT(newClient()) );
+}
+
+QString LocalHttpServer::url( const QString &path ) const
+{
+    return QString("http://127.0.0.1:%1%2").arg( serverPort() ).arg( path );
+}
+
+void LocalHttpServer::newClient()
+{
+    while ( hasPendingConnections() ) {
+        QTcpSocket *socket = nextPendingConnection();
+        ++m_connectionCount;
+        m_buffers.insert( socket, QByteArray() );
+        connect( socket, SIGNAL(readyRead()), this, SLOT(readRequests()) );
+        connect( socket, SIGNAL(disconnected()), this, SLOT(clientDisconnected()) );
+    }
+}
+
+void LocalHttpServer::readRequests()
+{
+    QTcpSocket *socket = qobject_cast< QTcpSocket* >( sender() );
+    QByteArray &buffer = m_buffers[ socket ];
+    buffer.append( socket->readAll() );
+
+    // Answer all complete requests in the buffer, requests have no body
+    int end;
+    while ( (end = buffer.indexOf("\r\n\r\n")) != -1 ) {
+        const QByteArray request = buffer.left( end );
+        buffer.remove( 0, end + 4 );
+        if ( request.contains(" /hang ") ) {
+            // Never answer requests for this path, used to test timeouts
+            continue;
+        }
+        ++m_requestCount;
+
+        const bool isHead = request.startsWith( "HEAD " );
+        const QByteArray body = "<html><body><table><tr><td>Departure " +
+                QByteArray::number(m_requestCount) + "</td></tr></table></body></html>";
+        socket->write( "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/html; charset=utf-8\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Connection: keep-alive\r\n"
+                       "Content-Length: " + QByteArray::number(body.length()) + "\r\n\r\n" );
+        if ( !isHead ) {
+            socket->write( body );
+        }
+    }
+}
+
+void LocalHttpServer::clientDisconnected()
+{
+    QTcpSocket *socket = qobject_cast< QTcpSocket* >( sender() );
+    m_buffers.remove( socket );
+    socket->deleteLater();
+}
+
+void NetworkSessionTest::initTestCase()
+{
+    m_server = new LocalHttpServer( this );
+    QVERIFY( m_server->listen(QHostAddress::LocalHost) );
+}
+
+void NetworkSessionTest::init()
+{
+}
+
+void NetworkSessionTest::cleanupTestCase()
+{
+    delete m_server;
+}
+
+void NetworkSessionTest::connectionReuseTest()
+{
+    const int connectionCount = m_server->connectionCount();
+    const NetworkSession::Ptr session = NetworkSession::create();
+
+    // Use multiple short-lived Network objects, like script jobs do
+    for ( int i = 0; i < 3; ++i ) {
+        ScriptApi::Network network( QByteArray(), session );
+        const QByteArray data = network.getSynchronous( m_server->url() );
+        QVERIFY( data.contains("<table>") );
+    }
+
+    // All requests should have been sent over the same kept-alive connection
+    QCOMPARE( m_server->connectionCount() - connectionCount, 1 );
+    QCOMPARE( session->runningRequestCount("127.0.0.1"), 0 );
+}
+
+void NetworkSessionTest::separateSessionsTest()
+{
+    const int connectionCount = m_server->connectionCount();
+    for ( int i = 0; i < 3; ++i ) {
+        // Each Network object creates an own session if none is given
+        ScriptApi::Network network;
+        const QByteArray data = network.getSynchronous( m_server->url() );
+        QVERIFY( data.contains("<table>") );
+    }
+
+    QCOMPARE( m_server->connectionCount() - connectionCount, 3 );
+}
+
+void NetworkSessionTest::asynchronousRequestsTest()
+{
+    const int connectionCount = m_server->connectionCount();
+    const int requestCount = m_server->requestCount();
+    const NetworkSession::Ptr session = NetworkSession::create();
+    ScriptApi::Network network( QByteArray(), session );
+
+    QEventLoop loop;
+    connect( &network, SIGNAL(allRequestsFinished()), &loop, SLOT(quit()) );
+    QTimer::singleShot( 10000, &loop, SLOT(quit()) );
+    QList< ScriptApi::NetworkRequest* > requests;
+    for ( int i = 0; i < 10; ++i ) {
+        ScriptApi::NetworkRequest *request =
+                network.createRequest( m_server->url(QString("/departures/%1").arg(i)) );
+        requests << request;
+        network.get( request );
+    }
+    loop.exec();
+
+    QCOMPARE( network.hasRunningRequests(), false );
+    QCOMPARE( m_server->requestCount() - requestCount, 10 );
+    foreach ( ScriptApi::NetworkRequest *request, requests ) {
+        QVERIFY( request->isFinished() );
+    }
+
+    // Not more connections than requests allowed per host
+    QVERIFY( m_server->connectionCount() - connectionCount <=
+             NetworkSession::DEFAULT_MAXIMUM_REQUESTS_PER_HOST );
+}
+
+void NetworkSessionTest::synchronousTimeoutTest()
+{
+    const NetworkSession::Ptr session = NetworkSession::create();
+    ScriptApi::Network network( QByteArray(), session );
+    const QByteArray data = network.getSynchronous( m_server->url("/hang"), QString(), 200 );
+    QVERIFY( data.isEmpty() );
+
+    // The timed out reply should get aborted in the network thread and free it's request slot
+    for ( int i = 0; i < 50 && session->runningRequestCount("127.0.0.1") > 0; ++i ) {
+        QTest::qWait( 20 );
+    }
+    QCOMPARE( session->runningRequestCount("127.0.0.1"), 0 );
+}
+
+void NetworkSessionTest::sequentialRequestsBenchmark_data()
+{
+    QTest::addColumn< bool >( "sharedSession" );
+
+    QTest::newRow( "New session for each Network" ) << false;
+    QTest::newRow( "Shared session" ) << true;
+}
+
+void NetworkSessionTest::sequentialRequestsBenchmark()
+{
+    QFETCH( bool, sharedSession );
+    const NetworkSession::Ptr session = sharedSession ? NetworkSession::create()
+                                                      : NetworkSession::Ptr();
+
+    QBENCHMARK {
+        // Simulate ten script jobs, each requesting one document
+        for ( int i = 0; i < 10; ++i ) {
+            ScriptApi::Network network( QByteArray(), session );
+            network.getSynchronous( m_server->url() );
+        }
+    }
+}
+
+QTEST_MAIN(NetworkSessionTest)
+#include "NetworkSessionTest.moc"
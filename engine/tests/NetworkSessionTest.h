@@ -0,0 +1,92 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef NETWORKSESSIONTEST_H
+#define NETWORKSESSIONTEST_H
+
+#include <QtCore/QObject>
+#include <QTcpServer>
+#include <QHash>
+
+class QTcpSocket;
+
+/**
+ * @brief A minimal local HTTP/1.1 server, used instead of real provider servers.
+ *
+ * Answers each request with a small HTML document and keeps connections open. Pipelined
+ * requests on one connection get answered in order. Requests for "/hang" never get answered.
+ **/
+class LocalHttpServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit LocalHttpServer( QObject *parent = 0 );
+
+    /** @brief The URL of a document on this server. */
+    QString url( const QString &path = "/departures" ) const;
+
+    /** @brief The number of accepted TCP connections. */
+    int connectionCount() const { return m_connectionCount; };
+
+    /** @brief The number of answered requests. */
+    int requestCount() const { return m_requestCount; };
+
+protected slots:
+    void newClient();
+    void readRequests();
+    void clientDisconnected();
+
+private:
+    int m_connectionCount;
+    int m_requestCount;
+    QHash< QTcpSocket*, QByteArray > m_buffers;
+};
+
+/** @brief Test NetworkSession and connection reuse of ScriptApi::Network objects. */
+class NetworkSessionTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanupTestCase();
+
+    // Sequential Network objects using the same session should use one connection
+    void connectionReuseTest();
+
+    // Network objects without shared session need a new connection for each request
+    void separateSessionsTest();
+
+    // Asynchronous requests of one session to one host, may get pipelined
+    void asynchronousRequestsTest();
+
+    // Timed out synchronous requests should get aborted and release their request slot
+    void synchronousTimeoutTest();
+
+    // Compare sequential requests of short-lived Network objects with and without shared session
+    void sequentialRequestsBenchmark_data();
+    void sequentialRequestsBenchmark();
+
+private:
+    LocalHttpServer *m_server;
+};
+
+#endif // NETWORKSESSIONTEST_H
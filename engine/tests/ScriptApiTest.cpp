@@ -19,10 +19,20 @@
 
 #include "ScriptApiTest.h"
 #include "script/scriptapi.h"
+#include "script/sharednetworkcache.h"
+#include "script/htmltagindex.h"
+#include "script/regexpcache.h"
+#include "script/persistentstorage.h"
+
+#include <KLockFile>
 
 #include <QtTest/QTest>
 #include <QSignalSpy>
 #include <QTimer>
+#include <QNetworkCacheMetaData>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 
 void ScriptApiTest::initTestCase()
 {
@@ -651,6 +661,132 @@ void ScriptApiTest::helperFindNamedHtmlTagsTest()
     }
 }
 
+void ScriptApiTest::htmlTagIndexTest()
+{
+    const QString html = "<!-- <p>Comment</p> --><script>if ( a<b ) { x = '<p>'; }</script>"
+                         "<P class=test>One <p>Two</p></P><p/><br>";
+    ScriptApi::HtmlTagIndex index( html );
+
+    // Tags in comments and scripts get skipped, nested tags get matched with their closing tag
+    const QVector< ScriptApi::HtmlTagIndex::Tag > tags = index.tags( "p" );
+    QCOMPARE( tags.count(), 3 );
+    QCOMPARE( tags[0].position, html.indexOf("<P") );
+    QCOMPARE( tags[0].closingPosition, html.indexOf("</P>") );
+    QCOMPARE( tags[0].endPosition, html.indexOf("</P>") + 4 );
+    QCOMPARE( tags[0].depth, 0 );
+    QCOMPARE( index.attributes(tags[0]).value("class").toString(), QString("test") );
+    QCOMPARE( tags[1].closingPosition, html.indexOf("</p>") );
+    QCOMPARE( tags[1].depth, 1 );
+    QVERIFY( tags[2].selfClosing );
+    QCOMPARE( index.tags("br").count(), 1 );
+    QCOMPARE( index.tags("br").first().closingPosition, -1 );
+    QCOMPARE( index.nextClosingTag("p", tags[0].contentsPosition).position, tags[1].closingPosition );
+
+    // Tag names can be regular expressions
+    QCOMPARE( index.tags("p|br").count(), 4 );
+
+    // Indices of longer documents get cached, also for copies of the document
+    const QString document = html.repeated( 100 );
+    const ScriptApi::HtmlTagIndex::Ptr cachedIndex =
+            ScriptApi::HtmlTagIndex::forDocument( document );
+    QCOMPARE( cachedIndex->tagCount(), 500 );
+    QVERIFY( ScriptApi::HtmlTagIndex::forDocument(QString(document.constData(), document.length()))
+             == cachedIndex );
+    ScriptApi::HtmlTagIndex::clearCache();
+    QVERIFY( ScriptApi::HtmlTagIndex::forDocument(document) != cachedIndex );
+    ScriptApi::HtmlTagIndex::clearCache();
+}
+
+void ScriptApiTest::regExpCacheTest()
+{
+    ScriptApi::RegExpCache::clear();
+    const int hitCount = ScriptApi::RegExpCache::hitCount();
+    const int missCount = ScriptApi::RegExpCache::missCount();
+
+    // The first request compiles the pattern, the options are part of the key
+    QRegExp rx1 = ScriptApi::RegExpCache::regExp( "(\\d+):(\\d+)" );
+    QRegExp rx2 = ScriptApi::RegExpCache::regExp( "(\\d+):(\\d+)" );
+    QRegExp rx3 = ScriptApi::RegExpCache::regExp( "(\\d+):(\\d+)", Qt::CaseInsensitive );
+    QCOMPARE( ScriptApi::RegExpCache::missCount() - missCount, 2 );
+    QCOMPARE( ScriptApi::RegExpCache::hitCount() - hitCount, 1 );
+    QCOMPARE( ScriptApi::RegExpCache::count(), 2 );
+    QCOMPARE( rx3.caseSensitivity(), Qt::CaseInsensitive );
+
+    // Copies do not share the match state
+    QCOMPARE( rx1.indexIn("at 15:28"), 3 );
+    QCOMPARE( rx2.indexIn("23:05"), 0 );
+    QCOMPARE( rx1.cap(1), QString("15") );
+    QCOMPARE( rx2.cap(1), QString("23") );
+
+    // The cache is bounded
+    for ( int i = 0; i < ScriptApi::RegExpCache::MAXIMUM_SIZE + 10; ++i ) {
+        ScriptApi::RegExpCache::regExp( QString("pattern%1").arg(i) );
+    }
+    QCOMPARE( ScriptApi::RegExpCache::count(), ScriptApi::RegExpCache::MAXIMUM_SIZE );
+    ScriptApi::RegExpCache::clear();
+    QCOMPARE( ScriptApi::RegExpCache::count(), 0 );
+}
+
+void ScriptApiTest::helperFindHtmlTagsBenchmark_data()
+{
+    QTest::addColumn<QString>("html");
+
+    // Generate a departure page of about 200 KB
+    QString html = "<html><head><title>Departures</title>"
+            "<script type=\"text/javascript\">if ( a<b ) { document.write('<tr>'); }</script>"
+            "</head><body><div id=\"content\"><table class=\"departures\">";
+    for ( int i = 0; i < 1000; ++i ) {
+        html += QString( "<tr class=\"%1\"><td class=\"time\">%2:%3</td>"
+                "<td class=\"line\"><img src=\"tram.png\" alt=\"Tram\" /> %4</td>"
+                "<td class=\"target\"><a href=\"stop?id=%5&amp;mode=dep\">Target %5</a></td>"
+                "<td class=\"platform\">Platform %6</td></tr>\n" )
+                .arg( i % 2 == 0 ? "even" : "odd" ).arg( (i / 60) % 24, 2, 10, QLatin1Char('0') )
+                .arg( i % 60, 2, 10, QLatin1Char('0') ).arg( i % 20 ).arg( i % 50 ).arg( i % 4 );
+    }
+    html += "</table></div></body></html>";
+    QTest::newRow("generated") << html;
+
+    // Add saved provider pages
+    const QDir samplesDir( QString::fromLocal8Bit(qgetenv("PUBLICTRANSPORT_HTML_SAMPLES")) );
+    if ( !samplesDir.path().isEmpty() && samplesDir.exists() ) {
+        const QStringList fileNames = samplesDir.entryList( QStringList() << "*.html" << "*.htm",
+                                                            QDir::Files );
+        foreach ( const QString &fileName, fileNames ) {
+            QFile file( samplesDir.filePath(fileName) );
+            if ( file.open(QIODevice::ReadOnly) ) {
+                QTest::newRow( fileName.toUtf8() ) << ScriptApi::Helper::decodeHtml( file.readAll() );
+            }
+        }
+    }
+}
+
+void ScriptApiTest::helperFindHtmlTagsBenchmark()
+{
+    QFETCH(QString, html);
+
+    QVariantMap namePosition;
+    namePosition.insert( "type", "attribute" );
+    namePosition.insert( "name", "class" );
+    QVariantMap columnOptions;
+    columnOptions.insert( "namePosition", namePosition );
+
+    QBENCHMARK {
+        // Each script job starts without cached indices
+        ScriptApi::HtmlTagIndex::clearCache();
+
+        const QVariantMap table = ScriptApi::Helper::findFirstHtmlTag( html, "table" );
+        const QString tableContents = table["found"].toBool() ? table["contents"].toString() : html;
+        QVariantMap rowOptions;
+        QVariantMap row;
+        while ( (row = ScriptApi::Helper::findFirstHtmlTag(tableContents, "tr", rowOptions))
+                ["found"].toBool() )
+        {
+            ScriptApi::Helper::findNamedHtmlTags( row["contents"].toString(), "td", columnOptions );
+            rowOptions.insert( "position", row["endPosition"] );
+        }
+    }
+}
+
 void ScriptApiTest::storageReadWriteTest_data()
 {
     QTest::addColumn<QString>("name");
@@ -718,6 +854,75 @@ void ScriptApiTest::storageReadWritePersistentTest()
     QVERIFY( !storage.hasPersistentData(name) );
 }
 
+void ScriptApiTest::persistentStorageTest()
+{
+    const QString fileName = QDir::tempPath() + "/publictransport_storage_test.bin";
+    QFile::remove( fileName );
+    const uint expirationTime = QDateTime::currentDateTime().addDays( 1 ).toTime_t();
+    const uint expiredTime = QDateTime::currentDateTime().addDays( -1 ).toTime_t();
+
+    {
+        ScriptApi::PersistentStorage storage( fileName );
+        QVERIFY( storage.insert("value1", 123, expirationTime) );
+        QVERIFY( storage.insert("value2", QVariantList() << "abc" << 5, expirationTime) );
+        QVERIFY( storage.insert("expired", "old", expiredTime) );
+        QVERIFY( storage.insert("removed", QByteArray(100000, 'x'), expirationTime) );
+        storage.remove( "removed" );
+        QVERIFY( !storage.contains("expired") );
+        QCOMPARE( storage.value("expired", 5), QVariant(5) );
+    }
+
+    // Read the values again from the file
+    {
+        ScriptApi::PersistentStorage storage( fileName );
+        QVERIFY( storage.exists() );
+        QCOMPARE( storage.value("value1"), QVariant(123) );
+        QCOMPARE( storage.value("value2"), QVariant(QVariantList() << "abc" << 5) );
+        QCOMPARE( storage.expirationTime("value1"), expirationTime );
+        QVERIFY( !storage.contains("removed") );
+        QCOMPARE( storage.names().count(), 2 );
+
+        // Overwrite a value often, the file gets compacted
+        for ( int i = 0; i < ScriptApi::PersistentStorage::MINIMUM_COMPACTION_RECORDS * 2; ++i ) {
+            QVERIFY( storage.insert("counter", i, expirationTime) );
+        }
+        // The removed 100 KB value is gone
+        QVERIFY( QFileInfo(fileName).size() < 10000 );
+    }
+
+    // An incomplete record at the end of the file does not get removed while another process
+    // holds the lock, it may currently append the record
+    QFile file( fileName );
+    QVERIFY( file.open(QIODevice::WriteOnly | QIODevice::Append) );
+    file.write( QByteArray("\0\0\1\0incomplete", 14) );
+    file.close();
+    const qint64 sizeWithIncompleteRecord = QFileInfo( fileName ).size();
+    {
+        KLockFile lockFile( fileName + ".lock" );
+        QCOMPARE( lockFile.lock(KLockFile::NoBlockFlag), KLockFile::LockOK );
+        ScriptApi::PersistentStorage storage( fileName );
+        QCOMPARE( storage.value("counter"),
+                  QVariant(ScriptApi::PersistentStorage::MINIMUM_COMPACTION_RECORDS * 2 - 1) );
+        QCOMPARE( QFileInfo(fileName).size(), sizeWithIncompleteRecord );
+        lockFile.unlock();
+    }
+
+    // Without a lock held by another process the incomplete record gets removed
+    {
+        ScriptApi::PersistentStorage storage( fileName );
+        QCOMPARE( storage.value("counter"),
+                  QVariant(ScriptApi::PersistentStorage::MINIMUM_COMPACTION_RECORDS * 2 - 1) );
+        QVERIFY( storage.insert("value3", "test", expirationTime) );
+    }
+    {
+        ScriptApi::PersistentStorage storage( fileName );
+        QCOMPARE( storage.value("value3"), QVariant("test") );
+        storage.clear();
+        QVERIFY( storage.names().isEmpty() );
+    }
+    QFile::remove( fileName );
+}
+
 void ScriptApiTest::resultFeaturesHintsTest()
 {
     ScriptApi::ResultObject result( this );
@@ -968,5 +1173,35 @@ void ScriptApiTest::networkAsynchronousMultipleTest()
     QCOMPARE( network.lastUrl(), url2 );
 }
 
+void ScriptApiTest::networkSharedCacheTest()
+{
+    // Insert data using one cache object
+    const QUrl url( "http://www.example.com/publictransport/cachetest" );
+    const QByteArray data( "<html>cached</html>" );
+    SharedNetworkCache cache1;
+    cache1.remove( url );
+
+    QNetworkCacheMetaData metaData;
+    metaData.setUrl( url );
+    metaData.setSaveToDisk( true );
+    metaData.setExpirationDate( QDateTime::currentDateTime().addSecs(60) );
+    QIODevice *device = cache1.prepare( metaData );
+    QVERIFY( device );
+    device->write( data );
+    cache1.insert( device );
+
+    // The data should be available using another cache object, eg. from another script job
+    SharedNetworkCache cache2;
+    QCOMPARE( cache2.metaData(url).url(), url );
+    QIODevice *cachedDevice = cache2.data( url );
+    QVERIFY( cachedDevice );
+    QCOMPARE( cachedDevice->readAll(), data );
+    delete cachedDevice;
+
+    // Removing the data using one object removes it for all objects
+    QVERIFY( cache2.remove(url) );
+    QVERIFY( !cache1.metaData(url).isValid() );
+}
+
 QTEST_MAIN(ScriptApiTest)
 #include "ScriptApiTest.moc"
@@ -119,6 +119,18 @@ private slots:
     void helperFindNamedHtmlTagsTest_data();
     void helperFindNamedHtmlTagsTest();
 
+    // Test HtmlTagIndex, used by the Helper::find*HtmlTag*() functions
+    void htmlTagIndexTest();
+
+    // Test RegExpCache, used by Helper functions
+    void regExpCacheTest();
+
+    // Benchmark parsing a departure table using Helper::findFirstHtmlTag() and
+    // Helper::findNamedHtmlTags() like provider scripts do. Saved provider HTML pages get
+    // added from the directory in the PUBLICTRANSPORT_HTML_SAMPLES environment variable
+    void helperFindHtmlTagsBenchmark_data();
+    void helperFindHtmlTagsBenchmark();
+
     // No testing of deprecated Helper::extractBlock()
 
     // Test Storage::read(), Storage::writePersistent(), Storage::remove() and Storage::hasData()
@@ -130,6 +142,9 @@ private slots:
     void storageReadWritePersistentTest_data();
     void storageReadWritePersistentTest();
 
+    // Test PersistentStorage, used by Storage for persistent data
+    void persistentStorageTest();
+
     // TODO Test Storage::write/read[Persistent]( const QVariantMap &map );
 
     // Test ResultObject::features(), ResultObject::hints(), ResultObject::giveHint(),
@@ -144,6 +159,9 @@ private slots:
     void networkAsynchronousTest();
     void networkAsynchronousAbortTest();
     void networkAsynchronousMultipleTest();
+
+    // SharedNetworkCache
+    void networkSharedCacheTest();
 };
 
 #endif // SCRIPTAPITEST_H
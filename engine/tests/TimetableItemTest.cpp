@@ -0,0 +1,331 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "TimetableItemTest.h"
+#include "departureinfo.h"
+#include "global.h"
+
+#include <QtTest/QTest>
+#include <QMetaEnum>
+#include <QSharedPointer>
+
+#include <cstdlib>
+#include <new>
+
+// Count heap allocations done using operator new, ie. objects, QObject private data, shared
+// pointer reference counters and hash headers. Qt allocates hash nodes using malloc(), these are
+// not counted, but they get allocated for both compared item layouts.
+static int s_allocationCount = 0;
+
+void *operator new( std::size_t size )
+{
+    ++s_allocationCount;
+    void *ptr = std::malloc( size > 0 ? size : 1 );
+    Q_CHECK_PTR( ptr );
+    return ptr;
+}
+
+void *operator new[]( std::size_t size )
+{
+    ++s_allocationCount;
+    void *ptr = std::malloc( size > 0 ? size : 1 );
+    Q_CHECK_PTR( ptr );
+    return ptr;
+}
+
+void operator delete( void *ptr ) throw()
+{
+    std::free( ptr );
+}
+
+void operator delete[]( void *ptr ) throw()
+{
+    std::free( ptr );
+}
+
+// The layout of timetable items before they became implicitly shared values:
+// a QObject holding a TimetableData hash, stored in a QSharedPointer.
+// Like the previous constructor, a Delay of -1 gets inserted if no delay is given
+class QObjectTimetableItem : public QObject {
+public:
+    QObjectTimetableItem( const TimetableData &data ) : m_data(data), m_isValid(false) {
+        if ( !m_data.contains(Enums::Delay) ) {
+            m_data.insert( Enums::Delay, -1 );
+        }
+        m_isValid = m_data.contains( Enums::DepartureDateTime );
+    };
+
+    TimetableData m_data;
+    bool m_isValid;
+};
+
+static TimetableData departureData( int number )
+{
+    TimetableData data;
+    data[ Enums::DepartureDateTime ] = QDateTime( QDate(2013, 5, 1), QTime(10, 0) ).addSecs( number * 60 );
+    data[ Enums::TypeOfVehicle ] = static_cast<int>( Enums::Bus );
+    data[ Enums::TransportLine ] = QString( "Line %1" ).arg( number % 20 );
+    data[ Enums::Target ] = QString( "Target %1" ).arg( number % 7 );
+    return data;
+}
+
+void TimetableItemTest::initTestCase()
+{
+}
+
+void TimetableItemTest::init()
+{}
+
+void TimetableItemTest::cleanup()
+{}
+
+void TimetableItemTest::cleanupTestCase()
+{
+}
+
+void TimetableItemTest::valuesTest()
+{
+    TimetableData data = departureData( 1 );
+    data[ Enums::Platform ] = "3";
+    const DepartureInfo departure( data );
+    QVERIFY( departure.isValid() );
+
+    // Values stored in fixed fields and in the side table
+    foreach ( Enums::TimetableInformation info, data.keys() ) {
+        QVERIFY( departure.contains(info) );
+        QCOMPARE( departure.value(info), data[info] );
+    }
+    QCOMPARE( departure.departureDateTime(), data[Enums::DepartureDateTime].toDateTime() );
+    QCOMPARE( departure.vehicleType(), Enums::Bus );
+    QCOMPARE( departure.transportLine(), QString("Line 1") );
+    QCOMPARE( departure.target(), QString("Target 1") );
+
+    // A Delay of -1 gets inserted if no delay was given
+    QCOMPARE( departure.delay(), -1 );
+    data.insert( Enums::Delay, -1 );
+    QCOMPARE( departure.data(), data );
+
+    // Remove a value stored in a fixed field
+    DepartureInfo modified = departure;
+    modified.remove( Enums::Target );
+    QVERIFY( !modified.contains(Enums::Target) );
+    QVERIFY( !modified.value(Enums::Target).isValid() );
+    QVERIFY( !modified.data().contains(Enums::Target) );
+    QVERIFY( !modified.toVariantHash().contains("Target") );
+}
+
+void TimetableItemTest::sideTableTest()
+{
+    // Values with unexpected types get stored in the side table without conversion
+    TimetableData data = departureData( 2 );
+    data[ Enums::TransportLine ] = 5;
+    data[ Enums::Delay ] = "3";
+    PublicTransportInfo info( data, PublicTransportInfo::NoCorrection );
+    QCOMPARE( info.value(Enums::TransportLine).type(), QVariant::Int );
+    QCOMPARE( info.transportLine(), QString("5") );
+    QCOMPARE( info.value(Enums::Delay).type(), QVariant::String );
+    QCOMPARE( info.delay(), 3 );
+
+    // Inserting a value with the expected type moves it from the side table to a fixed field
+    info.insert( Enums::TransportLine, QString("N5") );
+    QCOMPARE( info.value(Enums::TransportLine).type(), QVariant::String );
+    QCOMPARE( info.transportLine(), QString("N5") );
+    QCOMPARE( info.data().count(), data.count() );
+}
+
+void TimetableItemTest::implicitSharingTest()
+{
+    const DepartureInfo departure( departureData(3) );
+    DepartureInfo copy = departure;
+    copy.insert( Enums::Target, QString("Other Target") );
+    copy.insert( Enums::Platform, QString("1") );
+    QCOMPARE( departure.target(), QString("Target 3") );
+    QVERIFY( !departure.contains(Enums::Platform) );
+    QCOMPARE( copy.target(), QString("Other Target") );
+    QVERIFY( copy.contains(Enums::Platform) );
+}
+
+void TimetableItemTest::copyOnWriteTest()
+{
+    // Copies share the data until they get modified
+    const DepartureInfo departure( departureData(6) );
+    DepartureInfo copy = departure;
+    QVERIFY( copy.isSharedWith(departure) );
+
+    // Reading values does not detach
+    QCOMPARE( copy.target(), departure.target() );
+    QCOMPARE( copy.value(Enums::TransportLine), departure.value(Enums::TransportLine) );
+    copy.toVariantHash();
+    QVERIFY( copy.isSharedWith(departure) );
+
+    // Converting between item types and copying lists shares the data
+    const PublicTransportInfo info = departure;
+    const DepartureInfo converted( info );
+    QVERIFY( converted.isSharedWith(departure) );
+    DepartureInfoList departures;
+    departures << departure;
+    const DepartureInfoList copiedList = departures;
+    QVERIFY( copiedList.first().isSharedWith(departure) );
+
+    // Modifying detaches only the modified copy
+    copy.insert( Enums::Platform, QString("2") );
+    QVERIFY( !copy.isSharedWith(departure) );
+    QVERIFY( converted.isSharedWith(departure) );
+    QVERIFY( !departure.contains(Enums::Platform) );
+}
+
+void TimetableItemTest::conversionTest()
+{
+    PublicTransportInfoList infos;
+    infos << DepartureInfo( departureData(4) ) << DepartureInfo( departureData(5) );
+
+    DepartureInfoList departures;
+    foreach ( const PublicTransportInfo &info, infos ) {
+        departures << DepartureInfo( info );
+    }
+    QCOMPARE( departures.count(), 2 );
+    QVERIFY( departures[0].isValid() );
+    QCOMPARE( departures[1].data(), infos[1].data() );
+}
+
+void TimetableItemTest::departureIdentityTest()
+{
+    // The identity needs to be equal to the one of the helper library,
+    // see PublicTransportHelperTest::departureIdentityTest()
+    const QDateTime dateTime = QDateTime::fromMSecsSinceEpoch( Q_INT64_C(1367402400000) );
+    QCOMPARE( Global::departureIdentity(dateTime, Enums::Bus, " S1 ", "Hauptbahnhof "),
+              Q_UINT64_C(0x49a954f79c142bfb) );
+    QCOMPARE( Global::departureIdentity(dateTime, Enums::Bus, "s1", "hauptbahnhof", true),
+              Q_UINT64_C(0x82d8396581076c18) );
+}
+
+void TimetableItemTest::timetableInformationFromStringTest()
+{
+    // All names of the enumeration need to be found, in any case
+    const QMetaEnum metaEnum = Enums::staticMetaObject.enumerator(
+            Enums::staticMetaObject.indexOfEnumerator("TimetableInformation") );
+    for ( int i = 0; i < metaEnum.keyCount(); ++i ) {
+        const QString name = QLatin1String( metaEnum.key(i) );
+        QCOMPARE( static_cast<int>(Global::timetableInformationFromString(name)),
+                  metaEnum.value(i) );
+        QCOMPARE( static_cast<int>(Global::timetableInformationFromString(name.toLower())),
+                  metaEnum.value(i) );
+        QCOMPARE( static_cast<int>(Global::timetableInformationFromString(name.toUpper())),
+                  metaEnum.value(i) );
+    }
+
+    // Deprecated names
+    QCOMPARE( Global::timetableInformationFromString("JourneyNewsLink"), Enums::JourneyNewsUrl );
+
+    // Unknown names
+    QCOMPARE( Global::timetableInformationFromString(QString()), Enums::Nothing );
+    QCOMPARE( Global::timetableInformationFromString("Departure"), Enums::Nothing );
+    QCOMPARE( Global::timetableInformationFromString("DepartureDateTimes"), Enums::Nothing );
+    QCOMPARE( Global::timetableInformationFromString("A"), Enums::Nothing );
+    QCOMPARE( Global::timetableInformationFromString("Zzz"), Enums::Nothing );
+}
+
+void TimetableItemTest::vehicleTypeFromStringTest()
+{
+    const QMetaEnum metaEnum = Enums::staticMetaObject.enumerator(
+            Enums::staticMetaObject.indexOfEnumerator("VehicleType") );
+    for ( int i = 0; i < metaEnum.keyCount(); ++i ) {
+        const QString name = QLatin1String( metaEnum.key(i) );
+        QCOMPARE( static_cast<int>(Global::vehicleTypeFromString(name)), metaEnum.value(i) );
+        QCOMPARE( static_cast<int>(Global::vehicleTypeFromString(name.toLower())),
+                  metaEnum.value(i) );
+    }
+
+    QCOMPARE( Global::vehicleTypeFromString(QString()), Enums::InvalidVehicleType );
+    QCOMPARE( Global::vehicleTypeFromString("Trams"), Enums::InvalidVehicleType );
+    QCOMPARE( Global::vehicleTypeFromString("Train"), Enums::InvalidVehicleType );
+}
+
+void TimetableItemTest::allocationsBenchmark()
+{
+    const int count = 1000;
+    QList< TimetableData > dataList;
+    for ( int i = 0; i < count; ++i ) {
+        dataList << departureData( i );
+    }
+
+    // Count allocations for the previous QObject based items
+    int allocationsBefore = s_allocationCount;
+    {
+        QList< QSharedPointer<QObjectTimetableItem> > items;
+        items.reserve( count );
+        foreach ( const TimetableData &data, dataList ) {
+            items << QSharedPointer<QObjectTimetableItem>( new QObjectTimetableItem(data) );
+        }
+    }
+    const qreal qobjectAllocations = qreal(s_allocationCount - allocationsBefore) / count;
+
+    // Count allocations for implicitly shared timetable items
+    allocationsBefore = s_allocationCount;
+    {
+        DepartureInfoList departures;
+        departures.reserve( count );
+        foreach ( const TimetableData &data, dataList ) {
+            departures << DepartureInfo( data, PublicTransportInfo::NoCorrection );
+        }
+    }
+    const qreal allocations = qreal(s_allocationCount - allocationsBefore) / count;
+
+    qDebug() << "Allocations per departure, QObject items:" << qobjectAllocations
+             << "implicitly shared items:" << allocations;
+    QVERIFY( allocations < qobjectAllocations );
+}
+
+void TimetableItemTest::createDeparturesBenchmark()
+{
+    QList< TimetableData > dataList;
+    for ( int i = 0; i < 1000; ++i ) {
+        dataList << departureData( i );
+    }
+
+    QBENCHMARK {
+        DepartureInfoList departures;
+        foreach ( const TimetableData &data, dataList ) {
+            departures << DepartureInfo( data );
+        }
+        foreach ( const DepartureInfo &departure, departures ) {
+            departure.toVariantHash();
+        }
+    }
+}
+
+void TimetableItemTest::timetableInformationFromStringBenchmark()
+{
+    // Property names used by a typical script for one departure
+    const QStringList names = QStringList() << "DepartureDateTime" << "TypeOfVehicle"
+            << "TransportLine" << "Target" << "Platform" << "Delay" << "DelayReason"
+            << "JourneyNews" << "RouteStops" << "RouteTimes" << "Operator" << "RouteDataUrl";
+
+    QBENCHMARK {
+        // 200 departures
+        for ( int i = 0; i < 200; ++i ) {
+            foreach ( const QString &name, names ) {
+                Global::timetableInformationFromString( name );
+            }
+        }
+    }
+}
+
+QTEST_MAIN(TimetableItemTest)
+#include "TimetableItemTest.moc"
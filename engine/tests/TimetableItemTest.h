@@ -0,0 +1,49 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TIMETABLEITEMTEST_H
+#define TIMETABLEITEMTEST_H
+
+#include <QtCore/QObject>
+
+class TimetableItemTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void cleanupTestCase();
+
+    void valuesTest();
+    void sideTableTest();
+    void implicitSharingTest();
+    void copyOnWriteTest();
+    void conversionTest();
+    void departureIdentityTest();
+    void timetableInformationFromStringTest();
+    void vehicleTypeFromStringTest();
+
+    void allocationsBenchmark();
+    void createDeparturesBenchmark();
+    void timetableInformationFromStringBenchmark();
+};
+
+#endif // TIMETABLEITEMTEST_H
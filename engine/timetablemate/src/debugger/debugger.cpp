@@ -30,6 +30,7 @@
 // PublicTransport engine includes
 #include <engine/serviceproviderdata.h>
 #include <engine/request.h>
+#include <engine/script/regexpcache.h>
 
 // KDE includes
 #include <KDebug>
@@ -841,6 +842,12 @@ void ScriptRunData::executionStopped( const QDateTime &timestamp )
     }
     m_executionTime += m_executionStartTimestamp.msecsTo( timestamp );
     m_executionStartTimestamp = QDateTime();
+
+    if ( m_state == Finished ) {
+        // Replace the counter values from the start of the run with the differences
+        m_regExpCacheHitCount = RegExpCache::hitCount() - m_regExpCacheHitCount;
+        m_regExpCacheMissCount = RegExpCache::missCount() - m_regExpCacheMissCount;
+    }
 }
 
 void ScriptRunData::executionStarted( const QDateTime &timestamp )
@@ -866,7 +873,8 @@ void ScriptRunData::executionStarted( const QDateTime &timestamp )
 ScriptRunData::ScriptRunData( DebuggerJob *job )
         : m_job(job), m_executionTime(0), m_signalWaitingTime(0), m_interruptTime(0),
           m_synchronousDownloadTime(0), m_asynchronousDownloadSize(0),
-          m_synchronousDownloadSize(0), m_state(Initializing)
+          m_synchronousDownloadSize(0), m_regExpCacheHitCount(RegExpCache::hitCount()),
+          m_regExpCacheMissCount(RegExpCache::missCount()), m_state(Initializing)
 {
     DEBUGGER_JOB_SYNCHRONIZATION_JOB( m_job, "New state: Initializing" );
 }
@@ -117,6 +117,12 @@ public:
     int synchronousDownloadSize() const { return m_synchronousDownloadSize; };
     int totalDownloadSize() const { return m_asynchronousDownloadSize + m_synchronousDownloadSize; };
 
+    /** @brief The number of regular expressions found in the RegExpCache during the run. */
+    int regExpCacheHitCount() const { return m_state == Finished ? m_regExpCacheHitCount : 0; };
+
+    /** @brief The number of regular expressions compiled by the RegExpCache during the run. */
+    int regExpCacheMissCount() const { return m_state == Finished ? m_regExpCacheMissCount : 0; };
+
 protected:
     /** @brief Constructor, directly starts the execution timer. */
     ScriptRunData( DebuggerJob *job = 0 );
@@ -161,6 +167,8 @@ private:
     int m_synchronousDownloadTime;
     int m_asynchronousDownloadSize;
     int m_synchronousDownloadSize;
+    int m_regExpCacheHitCount; // Process wide counters when the run started until it finished
+    int m_regExpCacheMissCount;
     State m_state;
 };
 
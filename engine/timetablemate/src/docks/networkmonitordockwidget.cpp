@@ -21,10 +21,14 @@
 #include "networkmonitordockwidget.h"
 
 // Own includes
+#include "config.h"
 #include "../projectmodel.h"
 #include "../project.h"
 #include "../networkmonitormodel.h"
 #include "../tabs/webtab.h"
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    #include <engine/script/sharednetworkcache.h>
+#endif
 
 // KDE includes
 #include <KLocalizedString>
@@ -38,12 +42,15 @@
 #include <QMenu>
 #include <QApplication>
 #include <QClipboard>
+#include <QBoxLayout>
+#include <QTimer>
 
 NetworkMonitorDockWidget::NetworkMonitorDockWidget( ProjectModel *projectModel,
                                                     KActionMenu *showDocksAction, QWidget *parent )
         : AbstractDockWidget( i18nc("@title:window Dock title", "Network Monitor"),
                              showDocksAction, parent ),
-          m_widget(new QTreeView(this)), m_filterModel(new NetworkMonitorFilterModel(this))
+          m_widget(new QTreeView(this)), m_filterModel(new NetworkMonitorFilterModel(this)),
+          m_cacheLabel(0), m_cacheTimer(0)
 {
     setObjectName( "networkmonitor" );
 
@@ -59,6 +66,8 @@ NetworkMonitorDockWidget::NetworkMonitorDockWidget( ProjectModel *projectModel,
             "<icode>network.get(request)</icode> in your script. Or use the synchronous variants "
             "(see the <interface>Documentation</interface> dock for more inforamtion about the "
             "<icode>network</icode> script object).</para>"
+            "<para>The number of script downloads that were loaded from the HTTP cache "
+            "(hits) or not (misses) is shown below the list.</para>"
             "<para>For a more detailed analysis of network requests and replies you can use the "
             "<interface>Web Inspector</interface> dock or a tool like "
             "<emphasis>wireshark</emphasis>.</para>") );
@@ -71,12 +80,56 @@ NetworkMonitorDockWidget::NetworkMonitorDockWidget( ProjectModel *projectModel,
     m_widget->setMinimumSize( 150, 100 );
     connect( m_widget, SIGNAL(customContextMenuRequested(QPoint)),
              this, SLOT(contextMenu(QPoint)) );
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    // Show statistics of the HTTP cache used by scripts below the request list
+    QWidget *container = new QWidget( this );
+    m_cacheLabel = new QLabel( container );
+    m_cacheLabel->setToolTip( i18nc("@info:tooltip",
+            "Number of script downloads loaded from the HTTP cache (hits) or from the network "
+            "(misses), since TimetableMate was started") );
+    QVBoxLayout *layout = new QVBoxLayout( container );
+    layout->setContentsMargins( 0, 0, 0, 0 );
+    layout->addWidget( m_widget );
+    layout->addWidget( m_cacheLabel );
+    setWidget( container );
+
+    // Update cache statistics while the dock is visible
+    m_cacheTimer = new QTimer( this );
+    m_cacheTimer->setInterval( 1000 );
+    connect( m_cacheTimer, SIGNAL(timeout()), this, SLOT(updateCacheStatistics()) );
+    connect( this, SIGNAL(visibilityChanged(bool)), this, SLOT(visibilityChanged(bool)) );
+    updateCacheStatistics();
+#else
     setWidget( m_widget );
+#endif
 
     connect( projectModel, SIGNAL(activeProjectAboutToChange(Project*,Project*)),
              this, SLOT(activeProjectAboutToChange(Project*,Project*)) );
 }
 
+void NetworkMonitorDockWidget::visibilityChanged( bool visible )
+{
+    if ( !m_cacheTimer ) {
+        return;
+    }
+
+    if ( visible ) {
+        updateCacheStatistics();
+        m_cacheTimer->start();
+    } else {
+        m_cacheTimer->stop();
+    }
+}
+
+void NetworkMonitorDockWidget::updateCacheStatistics()
+{
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    m_cacheLabel->setText( i18nc("@info/plain", "HTTP cache: %1 hits, %2 misses",
+                                 SharedNetworkCache::hitCount(),
+                                 SharedNetworkCache::missCount()) );
+#endif
+}
+
 void NetworkMonitorDockWidget::contextMenu( const QPoint &pos )
 {
     const QModelIndex index = m_widget->indexAt( pos );
@@ -27,13 +27,16 @@ class ProjectModel;
 class Project;
 class AbstractTab;
 class QTreeView;
+class QLabel;
+class QTimer;
 
 /**
  * @brief A dock widget that shows requests of a QNetworkAccessManager.
  *
  * Requests of the QNetworkAccessManager of the currently active projects web tab are shown, if any.
  * A NetworkMonitorFilterModel gets used to filter by the type of the contents that get requested,
- * eg. HTML, XML, Images, CSS, etc.
+ * eg. HTML, XML, Images, CSS, etc. Below the requests the number of cache hits and misses of
+ * the HTTP cache used by scripts gets shown, see SharedNetworkCache.
  **/
 class NetworkMonitorDockWidget : public AbstractDockWidget {
     Q_OBJECT
@@ -51,12 +54,16 @@ protected slots:
     void tabOpenRequest( AbstractTab *tab );
     void tabClosed( QObject *tab );
     void contextMenu( const QPoint &pos );
+    void visibilityChanged( bool visible );
+    void updateCacheStatistics();
 
 private:
     void initModel();
 
     QTreeView *m_widget;
     NetworkMonitorFilterModel *m_filterModel;
+    QLabel *m_cacheLabel;
+    QTimer *m_cacheTimer;
 };
 
 #endif // Multiple inclusion guard
@@ -5224,6 +5224,13 @@ void Project::debugStopped( const ScriptRunData &scriptRunData )
                                 details) );
         }
     }
+    if ( scriptRunData.regExpCacheHitCount() > 0 || scriptRunData.regExpCacheMissCount() > 0 ) {
+        message.append( "<br />" );
+        message.append( i18nc("@info %1 and %2 are numbers of regular expressions",
+                              "- %1 regular expressions reused from the cache, %2 compiled",
+                              scriptRunData.regExpCacheHitCount(),
+                              scriptRunData.regExpCacheMissCount()) );
+    }
     appendOutput( message );
 
     if ( d->scriptTab ) {
@@ -107,6 +107,10 @@ bool ServiceProviderDataWriter::write( QIODevice *device, const ServiceProvider
     if( data->onlyUseCitiesInList() ) {
         writeTextElement( "onlyUseCitiesInList", data->onlyUseCitiesInList() ? "true" : "false" );
     }
+    if( !data->useHttpCache() ) {
+        // The HTTP cache is used by default
+        writeTextElement( "useHttpCache", "false" );
+    }
     if( !data->url().isEmpty() ) {
         writeTextElement( "url", data->url() );
     }
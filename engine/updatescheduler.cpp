@@ -0,0 +1,262 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "updatescheduler.h"
+
+// KDE includes
+#include <KDebug>
+#include <KRandom>
+
+// Qt includes
+#include <QTimer>
+
+const int UpdateScheduler::DEFAULT_BURST = 5;
+const int UpdateScheduler::DEFAULT_REFILL_INTERVAL = 4000; // 15 requests per minute
+const int UpdateScheduler::MIN_REFILL_INTERVAL = 1000;
+const int UpdateScheduler::MAX_JITTER = 15000; // 15 seconds
+const int UpdateScheduler::BATCH_DELAY = 2000; // 2 seconds
+
+UpdateScheduler::ProviderQueue::ProviderQueue()
+        : tokens(UpdateScheduler::DEFAULT_BURST), capacity(UpdateScheduler::DEFAULT_BURST),
+          refillInterval(UpdateScheduler::DEFAULT_REFILL_INTERVAL),
+          lastRefill(QDateTime::currentDateTime()),
+          dispatchedCount(0), lastBatchSize(0), totalWaitTime(0), maxWaitTime(0)
+{
+}
+
+UpdateScheduler::UpdateScheduler( QObject *parent )
+        : QObject(parent), m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot( true );
+    connect( m_timer, SIGNAL(timeout()), this, SLOT(dispatchDueUpdates()) );
+}
+
+UpdateScheduler::~UpdateScheduler()
+{
+}
+
+void UpdateScheduler::schedule( const QString &sourceName, const QString &providerId,
+                                const QDateTime &dueTime )
+{
+    // Replace a previously scheduled update for the data source
+    unschedule( sourceName );
+
+    // Add a random jitter of up to 10% of the time until the update, but maximally MAX_JITTER,
+    // to spread updates of many data sources that were requested at the same time
+    const QDateTime now = QDateTime::currentDateTime();
+    const qint64 msecsUntilDue = qMax( qint64(0), now.msecsTo(dueTime) );
+    const int maxJitter = int( qMin(qint64(MAX_JITTER), msecsUntilDue / 10) );
+    const QDateTime jitteredDueTime = maxJitter <= 0 ? dueTime
+            : dueTime.addMSecs( KRandom::random() % (maxJitter + 1) );
+
+    // Insert sorted by due time into the queue of the provider
+    ProviderQueue &queue = m_queues[ providerId ];
+    int index = queue.updates.count();
+    while ( index > 0 && queue.updates[index - 1].dueTime > jitteredDueTime ) {
+        --index;
+    }
+    queue.updates.insert( index, ScheduledUpdate(sourceName, jitteredDueTime) );
+    m_sourceProviders.insert( sourceName, providerId );
+
+    if ( index == 0 ) {
+        // The new update is the first one in the queue of the provider
+        restartTimer();
+    }
+    emit diagnosticsChanged();
+}
+
+void UpdateScheduler::unschedule( const QString &sourceName )
+{
+    if ( !m_sourceProviders.contains(sourceName) ) {
+        return;
+    }
+
+    const QString providerId = m_sourceProviders.take( sourceName );
+    ProviderQueue &queue = m_queues[ providerId ];
+    for ( int i = 0; i < queue.updates.count(); ++i ) {
+        if ( queue.updates[i].sourceName == sourceName ) {
+            queue.updates.removeAt( i );
+            break;
+        }
+    }
+    emit diagnosticsChanged();
+}
+
+bool UpdateScheduler::takeToken( const QString &providerId )
+{
+    ProviderQueue &queue = m_queues[ providerId ];
+    refillTokens( &queue, QDateTime::currentDateTime() );
+    if ( queue.tokens <= 0 ) {
+        return false;
+    }
+
+    --queue.tokens;
+    return true;
+}
+
+void UpdateScheduler::setProviderBudget( const QString &providerId, int capacity,
+                                         int refillInterval )
+{
+    Q_ASSERT( capacity > 0 && refillInterval > 0 );
+    ProviderQueue &queue = m_queues[ providerId ];
+    queue.capacity = capacity;
+    queue.refillInterval = refillInterval;
+    queue.tokens = qMin( queue.tokens, capacity );
+    restartTimer();
+}
+
+void UpdateScheduler::setProviderMinFetchWait( const QString &providerId, int minFetchWait )
+{
+    setProviderBudget( providerId, DEFAULT_BURST,
+                       qMax(MIN_REFILL_INTERVAL, minFetchWait * 1000 / DEFAULT_BURST) );
+}
+
+int UpdateScheduler::queueDepth( const QString &providerId ) const
+{
+    if ( !providerId.isEmpty() ) {
+        return m_queues.contains(providerId) ? m_queues[providerId].updates.count() : 0;
+    }
+    return m_sourceProviders.count();
+}
+
+void UpdateScheduler::refillTokens( UpdateScheduler::ProviderQueue *queue,
+                                    const QDateTime &now ) const
+{
+    if ( queue->tokens >= queue->capacity ) {
+        // The bucket is full, restart the refill interval
+        queue->lastRefill = now;
+        return;
+    }
+
+    const qint64 refills = queue->lastRefill.msecsTo( now ) / queue->refillInterval;
+    if ( refills > 0 ) {
+        queue->tokens = int( qMin(qint64(queue->capacity), queue->tokens + refills) );
+        queue->lastRefill = queue->lastRefill.addMSecs( refills * queue->refillInterval );
+    }
+}
+
+void UpdateScheduler::dispatchDueUpdates()
+{
+    // Collect batches of due updates first, slots connected to updatesDue() may schedule
+    // new updates and modify the queues
+    const QDateTime now = QDateTime::currentDateTime();
+    QHash< QString, QStringList > batches;
+    for ( QHash<QString, ProviderQueue>::Iterator it = m_queues.begin();
+          it != m_queues.end(); ++it )
+    {
+        ProviderQueue &queue = *it;
+        refillTokens( &queue, now );
+
+        QStringList batch;
+        while ( !queue.updates.isEmpty() && queue.updates.first().dueTime <= now &&
+                queue.tokens > 0 )
+        {
+            const ScheduledUpdate update = queue.updates.takeFirst();
+            m_sourceProviders.remove( update.sourceName );
+            --queue.tokens;
+
+            // Update wait time statistics, the wait time is the time between the due time
+            // and the actual dispatch, caused by batching or a missing token
+            const qint64 waitTime = update.dueTime.msecsTo( now );
+            queue.totalWaitTime += waitTime;
+            queue.maxWaitTime = qMax( queue.maxWaitTime, waitTime );
+            ++queue.dispatchedCount;
+
+            batch << update.sourceName;
+        }
+
+        if ( !batch.isEmpty() ) {
+            queue.lastBatchSize = batch.count();
+            batches.insert( it.key(), batch );
+        } else if ( !queue.updates.isEmpty() && queue.updates.first().dueTime <= now ) {
+            kDebug() << "No request budget left for provider" << it.key() << "delaying"
+                     << queue.updates.count() << "updates";
+        }
+    }
+
+    restartTimer();
+
+    for ( QHash<QString, QStringList>::ConstIterator it = batches.constBegin();
+          it != batches.constEnd(); ++it )
+    {
+        emit updatesDue( it.key(), it.value() );
+    }
+    emit diagnosticsChanged();
+}
+
+void UpdateScheduler::restartTimer()
+{
+    // Find the earliest time at which an update can be dispatched
+    const QDateTime now = QDateTime::currentDateTime();
+    QDateTime nextWakeUp;
+    for ( QHash<QString, ProviderQueue>::Iterator it = m_queues.begin();
+          it != m_queues.end(); ++it )
+    {
+        ProviderQueue &queue = *it;
+        if ( queue.updates.isEmpty() ) {
+            continue;
+        }
+
+        refillTokens( &queue, now );
+        const QDateTime wakeUp = queue.tokens > 0
+                // Wait BATCH_DELAY to dispatch other updates that are due in that time together
+                ? queue.updates.first().dueTime.addMSecs( BATCH_DELAY )
+                // Wait for the next token
+                : queue.lastRefill.addMSecs( queue.refillInterval );
+        if ( !nextWakeUp.isValid() || wakeUp < nextWakeUp ) {
+            nextWakeUp = wakeUp;
+        }
+    }
+
+    if ( nextWakeUp.isValid() ) {
+        m_timer->start( int(qMax(qint64(0), now.msecsTo(nextWakeUp))) );
+    } else {
+        m_timer->stop();
+    }
+}
+
+QVariantHash UpdateScheduler::diagnostics() const
+{
+    QVariantHash providers;
+    for ( QHash<QString, ProviderQueue>::ConstIterator it = m_queues.constBegin();
+          it != m_queues.constEnd(); ++it )
+    {
+        const ProviderQueue &queue = *it;
+        QVariantHash providerData;
+        providerData.insert( "queueDepth", queue.updates.count() );
+        providerData.insert( "tokens", queue.tokens );
+        providerData.insert( "capacity", queue.capacity );
+        providerData.insert( "refillInterval", queue.refillInterval );
+        providerData.insert( "dispatchedCount", queue.dispatchedCount );
+        providerData.insert( "lastBatchSize", queue.lastBatchSize );
+        providerData.insert( "averageWaitTime", queue.dispatchedCount == 0 ? 0
+                             : int(queue.totalWaitTime / queue.dispatchedCount) );
+        providerData.insert( "maxWaitTime", int(queue.maxWaitTime) );
+        if ( !queue.updates.isEmpty() ) {
+            providerData.insert( "nextUpdate", queue.updates.first().dueTime );
+        }
+        providers.insert( it.key(), providerData );
+    }
+
+    QVariantHash data;
+    data.insert( "queueDepth", m_sourceProviders.count() );
+    data.insert( "providers", providers );
+    return data;
+}
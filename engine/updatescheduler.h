@@ -0,0 +1,194 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the scheduler for automatic timetable data source updates.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef UPDATESCHEDULER_HEADER
+#define UPDATESCHEDULER_HEADER
+
+// Qt includes
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+#include <QVariant>
+
+class QTimer;
+
+/**
+ * @brief Schedules automatic updates of timetable data sources for all providers.
+ *
+ * Instead of using one QTimer per timetable data source, all automatic updates get queued here,
+ * ordered by their due time in one queue per provider. Only a single timer is used, which wakes
+ * up for the earliest due update.
+ *
+ * Requests to a provider are limited by a token bucket per provider: each dispatched update
+ * takes one token, tokens get refilled every refill interval up to the bucket capacity. Due
+ * updates without an available token stay queued until a token gets available.
+ *
+ * To avoid many data sources of one provider firing at the same moment (eg. after all sources
+ * were requested at once when the applet was started), a random jitter gets added to each
+ * scheduled time. When an update is due, the scheduler waits a short time (BATCH_DELAY) to
+ * collect other updates due in that time and dispatches them together in one batch using
+ * updatesDue().
+ *
+ * Diagnostic data (queue depth, wait times, available tokens) is available using diagnostics()
+ * and gets published by the engine in the "UpdateScheduler" data source.
+ **/
+class UpdateScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    /** @brief Create a new update scheduler. */
+    explicit UpdateScheduler( QObject *parent = 0 );
+
+    /** @brief Destructor. */
+    virtual ~UpdateScheduler();
+
+    /**
+     * @brief Schedule an update for the data source @p sourceName at @p dueTime.
+     *
+     * If an update is already scheduled for @p sourceName it gets replaced.
+     * A random jitter gets added to @p dueTime, the update never gets dispatched before
+     * @p dueTime.
+     * @param sourceName The (non ambiguous) name of the data source to update.
+     * @param providerId The ID of the provider used by @p sourceName.
+     * @param dueTime The time at which the data source should be updated.
+     **/
+    void schedule( const QString &sourceName, const QString &providerId,
+                   const QDateTime &dueTime );
+
+    /** @brief Remove a scheduled update for @p sourceName, if any. */
+    void unschedule( const QString &sourceName );
+
+    /** @brief Whether or not an update is scheduled for @p sourceName. */
+    bool isScheduled( const QString &sourceName ) const {
+        return m_sourceProviders.contains( sourceName );
+    };
+
+    /**
+     * @brief Take a token from the request budget of @p providerId without queueing.
+     *
+     * This gets used for manual update requests, which should not be delayed, but should
+     * still be accounted for in the request budget of the provider.
+     * @return @c True, if a token was available, @c false otherwise.
+     **/
+    bool takeToken( const QString &providerId );
+
+    /**
+     * @brief Set the request budget for @p providerId.
+     * @param providerId The ID of the provider to set the budget for.
+     * @param capacity The maximum number of tokens, ie. the maximal burst size.
+     * @param refillInterval The time in milliseconds after which one token gets refilled.
+     **/
+    void setProviderBudget( const QString &providerId, int capacity, int refillInterval );
+
+    /**
+     * @brief Set the request budget for @p providerId from its minimal fetch wait time.
+     *
+     * Allows DEFAULT_BURST requests to the provider in @p minFetchWait seconds, ie. one token
+     * gets refilled every @p minFetchWait / DEFAULT_BURST seconds, but not more often than
+     * every MIN_REFILL_INTERVAL milliseconds.
+     * @param providerId The ID of the provider to set the budget for.
+     * @param minFetchWait The minimal time in seconds to wait between two updates of a data
+     *   source, see ServiceProvider::minFetchWait().
+     **/
+    void setProviderMinFetchWait( const QString &providerId, int minFetchWait );
+
+    /** @brief The number of queued updates for @p providerId or for all providers if empty. */
+    int queueDepth( const QString &providerId = QString() ) const;
+
+    /**
+     * @brief Get diagnostic data for all providers with queued or dispatched updates.
+     *
+     * Contains a "queueDepth" field with the number of all queued updates and a "providers"
+     * field with a QVariantHash for each provider, see @ref usage_updatescheduler_sec.
+     **/
+    QVariantHash diagnostics() const;
+
+    /** @brief The default capacity of the token bucket of a provider. */
+    static const int DEFAULT_BURST;
+
+    /** @brief The default time in milliseconds after which a token gets refilled. */
+    static const int DEFAULT_REFILL_INTERVAL;
+
+    /** @brief The minimal refill interval in milliseconds used by setProviderMinFetchWait(). */
+    static const int MIN_REFILL_INTERVAL;
+
+    /** @brief The maximal random jitter in milliseconds added to scheduled times. */
+    static const int MAX_JITTER;
+
+    /** @brief Time in milliseconds to wait after an update is due to batch other updates. */
+    static const int BATCH_DELAY;
+
+signals:
+    /**
+     * @brief Emitted when updates of one provider are due.
+     * @param providerId The ID of the provider used by all data sources in @p sourceNames.
+     * @param sourceNames The (non ambiguous) names of the data sources to update.
+     **/
+    void updatesDue( const QString &providerId, const QStringList &sourceNames );
+
+    /** @brief Emitted when the data returned by diagnostics() has changed. */
+    void diagnosticsChanged();
+
+protected slots:
+    /** @brief Dispatch all due updates of providers with available tokens. */
+    void dispatchDueUpdates();
+
+private:
+    struct ScheduledUpdate {
+        ScheduledUpdate( const QString &sourceName = QString(),
+                         const QDateTime &dueTime = QDateTime() )
+                : sourceName(sourceName), dueTime(dueTime) {};
+
+        QString sourceName;
+        QDateTime dueTime;
+    };
+
+    struct ProviderQueue {
+        ProviderQueue();
+
+        QList< ScheduledUpdate > updates; // Sorted by due time
+        int tokens;
+        int capacity;
+        int refillInterval;
+        QDateTime lastRefill;
+
+        // Statistics
+        int dispatchedCount;
+        int lastBatchSize;
+        qint64 totalWaitTime;
+        qint64 maxWaitTime;
+    };
+
+    // Add tokens to the bucket of @p queue for the time passed since the last refill
+    void refillTokens( ProviderQueue *queue, const QDateTime &now ) const;
+
+    // (Re)start the timer for the next due update or the next refilled token
+    void restartTimer();
+
+    QHash< QString, ProviderQueue > m_queues; // Update queues by provider ID
+    QHash< QString, QString > m_sourceProviders; // Provider IDs of scheduled sources
+    QTimer *m_timer;
+};
+
+#endif // Multiple inclusion guard
@@ -352,24 +352,14 @@ bool DepartureInfo::operator ==( const DepartureInfo& other ) const
 
 void DepartureInfo::generateHash()
 {
-    m_hash = qHash( QString("%1%2%3%4")
-                    .arg(m_departure.toString("dMMyyhhmmss"))
-                    .arg(static_cast<int>(m_vehicleType))
-                    .arg(m_lineString)
-                    .arg(m_target.trimmed().toLower()) );
+    m_hash = Global::departureIdentity( m_departure, m_vehicleType, m_lineString, m_target,
+                                        isArrival() );
 }
 
 void JourneyInfo::generateHash()
 {
-    QString vehicles;
-    foreach( int vehicleType, m_vehicleTypes ) {
-        vehicles += QString::number( static_cast<int>( vehicleType ) );
-    }
-    m_hash = qHash( QString("%1%2%3%4")
-                    .arg(m_departure.toString("dMMyyhhmmss"))
-                    .arg(m_duration)
-                    .arg(m_changes)
-                    .arg(vehicles) );
+    m_hash = Global::journeyIdentity( m_departure, m_duration, m_changes,
+                                      m_vehicleTypes.toList() );
 }
 
 QString DepartureInfo::formatDateFancyFuture( const QDate& date )
@@ -486,7 +476,7 @@ QString DepartureInfo::departureText( bool htmlFormatted, bool displayTimeBold,
 
 uint qHash( const DepartureInfo& departureInfo )
 {
-    return departureInfo.hash();
+    return qHash( departureInfo.hash() );
 }
 
 bool operator <( const JourneyInfo& ji1, const JourneyInfo& ji2 )
@@ -64,12 +64,13 @@ public:
      * engine in the model of the applet after an update. For example a departure which delay has
      * changed is still the same departure and therefore it returns the same hash value.
      *
-     * @return uint The hash value for this item.
+     * @return quint64 The hash value for this item.
+     * @see Global::departureIdentity()
      **/
-    uint hash() const { return m_hash; };
+    quint64 hash() const { return m_hash; };
 
 protected:
-    uint m_hash;
+    quint64 m_hash;
 };
 
 struct PUBLICTRANSPORTHELPER_EXPORT RouteSubJourney {
@@ -445,6 +446,9 @@ public:
     QString dataSource() const { return m_dataSource; };
     int index() const { return m_index; };
 
+    /** @brief Set the index of the departure/arrival in its data source to @p index. */
+    void setIndex( int index ) { m_index = index; };
+
 private:
     void init( const QString &dataSource, int index, DepartureFlags flags = NoDepartureFlags,
                const QString &operatorName = QString(), const QString &line = QString(),
@@ -17,8 +17,9 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
-#ifndef ENUMS_HEADER
-#define ENUMS_HEADER
+// Not ENUMS_HEADER, which is used by enums.h of the data engine
+#ifndef PUBLICTRANSPORTHELPER_ENUMS_HEADER
+#define PUBLICTRANSPORTHELPER_ENUMS_HEADER
 
 /** @file
  * @brief This file contains enumerations used by the public transport helper library.
@@ -21,6 +21,7 @@
 #include "departureinfo.h"
 
 #include <KDebug>
+#include <QtAlgorithms>
 
 /** @brief Namespace for the publictransport helper library. */
 namespace PublicTransport {
@@ -285,7 +286,7 @@ bool Filter::matchString( FilterVariant variant, const QString& filterString,
     case FilterMatchesRegExp:
         return QRegExp( filterString ).indexIn( testString ) != -1;
     case FilterDoesntMatchRegExp:
-        return QRegExp( filterString ).indexIn( testString ) == 0;
+        return QRegExp( filterString ).indexIn( testString ) == -1;
 
     default:
         kDebug() << "Invalid filter variant for string matching:" << variant;
@@ -583,4 +584,301 @@ void FilterSettingsList::set(const FilterSettings& newFilterSettings) {
     *this << newFilterSettings;
 }
 
+CompiledFilter::CompiledFilter( const Filter &filter )
+{
+    m_constraints.reserve( filter.count() );
+    foreach( const Constraint &constraint, filter ) {
+        CompiledConstraint compiled;
+        compiled.type = constraint.type;
+        compiled.variant = constraint.variant;
+        compiled.intValue = 0;
+
+        switch ( constraint.type ) {
+        case FilterByTarget:
+        case FilterByVia:
+        case FilterByNextStop:
+        case FilterByTransportLine:
+            compiled.string = constraint.value.toString();
+            if ( constraint.variant == FilterContains ||
+                 constraint.variant == FilterDoesntContain )
+            {
+                compiled.matcher = QStringMatcher( compiled.string, Qt::CaseInsensitive );
+            } else if ( constraint.variant == FilterMatchesRegExp ||
+                        constraint.variant == FilterDoesntMatchRegExp )
+            {
+                compiled.regExp = QRegExp( compiled.string );
+            }
+            break;
+
+        case FilterByTransportLineNumber:
+        case FilterByDelay:
+            compiled.intValue = constraint.value.toInt();
+            break;
+
+        case FilterByVehicleType:
+        case FilterByDayOfWeek:
+            foreach( const QVariant &value, constraint.value.toList() ) {
+                compiled.values << value.toInt();
+            }
+            qSort( compiled.values );
+            break;
+
+        case FilterByDepartureTime:
+            compiled.time = constraint.value.toTime();
+            break;
+        case FilterByDepartureDate:
+            compiled.date = constraint.value.toDate();
+            break;
+
+        default:
+            break;
+        }
+        m_constraints << compiled;
+    }
+}
+
+bool CompiledFilter::match( const DepartureInfo &departureInfo ) const
+{
+    // Same as Filter::match(), but using the compiled constraint values
+    for ( QVector<CompiledConstraint>::ConstIterator it = m_constraints.constBegin();
+          it != m_constraints.constEnd(); ++it )
+    {
+        const CompiledConstraint &constraint = *it;
+        switch ( constraint.type ) {
+        case FilterByTarget:
+            if ( !constraint.matchString(departureInfo.target()) ) {
+                return false;
+            }
+            break;
+        case FilterByVia: {
+            // Always match if no route items are available, see Filter::match()
+            const QStringList &routeStops = departureInfo.routeStops();
+            if ( routeStops.isEmpty() ) {
+                return true;
+            }
+
+            bool viaMatched = false;
+            foreach( const QString &via, routeStops ) {
+                if ( constraint.matchString(via) ) {
+                    viaMatched = true;
+                    break;
+                }
+            }
+
+            // If no route stop matches, try to match the target
+            if ( !viaMatched && !constraint.matchString(departureInfo.target()) ) {
+                return false;
+            }
+            break;
+        }
+        case FilterByNextStop: {
+            // Always match if no route items are available, see Filter::match()
+            const QStringList &routeStops = departureInfo.routeStops();
+            if ( routeStops.isEmpty() ) {
+                return true;
+            }
+
+            if ( routeStops.count() < 2 || departureInfo.routeExactStops() == 1 ) {
+                // If too less route stops are available use the target as next stop
+                return constraint.matchString( departureInfo.target() );
+            }
+
+            if ( !constraint.matchString(!departureInfo.isArrival() ? routeStops[1]
+                                         : routeStops[routeStops.count() - 2]) )
+            {
+                return false;
+            }
+            break;
+        } case FilterByTransportLine:
+            if ( !constraint.matchString(departureInfo.lineString()) ) {
+                return false;
+            }
+            break;
+
+        case FilterByTransportLineNumber:
+            if ( departureInfo.lineNumber() <= 0 ) {
+                // Invalid line numbers only match with variant DoesntEqual
+                return constraint.variant == FilterDoesntEqual;
+            } else if ( !constraint.matchInt(departureInfo.lineNumber()) ) {
+                return false;
+            }
+            break;
+        case FilterByDelay:
+            if ( departureInfo.delay() < 0 ) {
+                // Invalid delays only match with variant DoesntEqual
+                return constraint.variant == FilterDoesntEqual;
+            } else if ( !constraint.matchInt(departureInfo.delay()) ) {
+                return false;
+            }
+            break;
+
+        case FilterByVehicleType:
+            if ( !constraint.matchList(static_cast<int>(departureInfo.vehicleType())) ) {
+                return false;
+            }
+            break;
+
+        case FilterByDepartureTime:
+            if ( !constraint.matchTime(departureInfo.departure().time()) ) {
+                return false;
+            }
+            break;
+        case FilterByDepartureDate:
+            if ( !constraint.matchDate(departureInfo.departure().date()) ) {
+                return false;
+            }
+            break;
+        case FilterByDayOfWeek:
+            if ( !constraint.matchList(departureInfo.departure().date().dayOfWeek()) ) {
+                return false;
+            }
+            break;
+
+        default:
+            kDebug() << "Filter unknown or invalid" << constraint.type;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CompiledFilter::CompiledConstraint::matchString( const QString &testString ) const
+{
+    switch ( variant ) {
+    case FilterContains:
+        return matcher.indexIn( testString ) != -1;
+    case FilterDoesntContain:
+        return matcher.indexIn( testString ) == -1;
+
+    case FilterEquals:
+        return testString.compare( string, Qt::CaseInsensitive ) == 0;
+    case FilterDoesntEqual:
+        return testString.compare( string, Qt::CaseInsensitive ) != 0;
+
+    case FilterMatchesRegExp:
+        return regExp.indexIn( testString ) != -1;
+    case FilterDoesntMatchRegExp:
+        return regExp.indexIn( testString ) == -1;
+
+    default:
+        kDebug() << "Invalid filter variant for string matching:" << variant;
+        return false;
+    }
+}
+
+bool CompiledFilter::CompiledConstraint::matchInt( int testInt ) const
+{
+    switch ( variant ) {
+    case FilterEquals:
+        return intValue == testInt;
+    case FilterDoesntEqual:
+        return intValue != testInt;
+    case FilterGreaterThan:
+        return testInt > intValue;
+    case FilterLessThan:
+        return testInt < intValue;
+
+    default:
+        kDebug() << "Invalid filter variant for integer matching:" << variant;
+        return false;
+    }
+}
+
+bool CompiledFilter::CompiledConstraint::matchList( int testValue ) const
+{
+    switch ( variant ) {
+    case FilterIsOneOf:
+        return qBinaryFind( values, testValue ) != values.constEnd();
+    case FilterIsntOneOf:
+        return qBinaryFind( values, testValue ) == values.constEnd();
+
+    default:
+        kDebug() << "Invalid filter variant for list matching:" << variant;
+        return false;
+    }
+}
+
+bool CompiledFilter::CompiledConstraint::matchTime( const QTime &testTime ) const
+{
+    switch ( variant ) {
+    case FilterEquals:
+        return testTime == time;
+    case FilterDoesntEqual:
+        return testTime != time;
+
+    case FilterGreaterThan:
+        return testTime > time;
+    case FilterLessThan:
+        return testTime < time;
+
+    default:
+        kDebug() << "Invalid filter variant for time matching:" << variant;
+        return false;
+    }
+}
+
+bool CompiledFilter::CompiledConstraint::matchDate( const QDate &testDate ) const
+{
+    switch ( variant ) {
+    case FilterEquals:
+        return testDate == date;
+    case FilterDoesntEqual:
+        return testDate != date;
+
+    case FilterGreaterThan:
+        return testDate > date;
+    case FilterLessThan:
+        return testDate < date;
+
+    default:
+        kDebug() << "Invalid filter variant for date matching:" << variant;
+        return false;
+    }
+}
+
+CompiledFilterList::CompiledFilterList( const FilterList &filterList )
+{
+    m_filters.reserve( filterList.count() );
+    foreach( const Filter &filter, filterList ) {
+        m_filters << CompiledFilter( filter );
+    }
+}
+
+bool CompiledFilterList::match( const DepartureInfo &departureInfo ) const
+{
+    for ( QVector<CompiledFilter>::ConstIterator it = m_filters.constBegin();
+          it != m_filters.constEnd(); ++it )
+    {
+        if ( it->match(departureInfo) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CompiledFilterSettingsList::CompiledFilterSettingsList(
+        const FilterSettingsList &filterSettingsList )
+{
+    m_filterSettings.reserve( filterSettingsList.count() );
+    foreach ( const FilterSettings &filterSettings, filterSettingsList ) {
+        m_filterSettings << qMakePair( filterSettings.filterAction,
+                                       CompiledFilterList(filterSettings.filters) );
+    }
+}
+
+bool CompiledFilterSettingsList::filterOut( const DepartureInfo &departureInfo ) const
+{
+    // Same as FilterSettingsList::filterOut(), but using the compiled filters
+    for ( QVector< QPair<FilterAction, CompiledFilterList> >::ConstIterator it =
+          m_filterSettings.constBegin(); it != m_filterSettings.constEnd(); ++it )
+    {
+        const bool matches = it->second.match( departureInfo );
+        if ( (it->first == ShowMatching && !matches) || (it->first == HideMatching && matches) ) {
+            return true;
+        }
+    }
+    return false; // No filter settings filtered the departureInfo out
+}
+
 } // namespace Timetable
@@ -27,6 +27,10 @@
 #include "global.h"
 
 #include <QVariant>
+#include <QVector>
+#include <QRegExp>
+#include <QStringMatcher>
+#include <QTime>
 #include <KDebug>
 
 /** @brief Namespace for the publictransport helper library. */
@@ -234,6 +238,99 @@ public:
 };
 bool PUBLICTRANSPORTHELPER_EXPORT operator ==( const FilterSettingsList &l, const FilterSettingsList &r );
 
+/**
+ * @brief A Filter compiled to match many departures/arrivals fast.
+ *
+ * Filter::match() converts the QVariant values of all constraints for each tested
+ * departure/arrival and creates new QRegExp objects for regular expression constraints.
+ * This class converts the constraints of a filter once to typed values, ie. prepared
+ * string matchers, regular expressions, sorted lists of integer values, times and dates.
+ * Matching with a compiled filter gives the same results as Filter::match().
+ *
+ * Use this to apply the same filters to many departures/arrivals, eg. to all departures of a
+ * data source update. Compiled filters do not change when the source filter gets changed.
+ *
+ * @note Compiled filters contain QRegExp objects, which store the last match. Do not use the
+ *   same compiled filter in multiple threads at the same time, compile one for each thread.
+ *
+ * @ingroup filterSystem
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT CompiledFilter {
+public:
+    /** @brief Creates an empty compiled filter, which matches all departures/arrivals. */
+    CompiledFilter() {};
+
+    /** @brief Compiles @p filter. */
+    explicit CompiledFilter( const Filter &filter );
+
+    /** @brief Returns true, if all constraints of this filter match. */
+    bool match( const DepartureInfo &departureInfo ) const;
+
+private:
+    struct CompiledConstraint {
+        FilterType type;
+        FilterVariant variant;
+        QString string; // For string constraints
+        QStringMatcher matcher; // Case insensitive, for FilterContains/FilterDoesNotContain
+        QRegExp regExp; // For FilterMatchesRegExp/FilterDoesNotMatchRegExp
+        int intValue; // For integer constraints
+        QVector< int > values; // Sorted, for list constraints
+        QTime time;
+        QDate date;
+
+        bool matchString( const QString &testString ) const;
+        bool matchInt( int testInt ) const;
+        bool matchList( int testValue ) const;
+        bool matchTime( const QTime &testTime ) const;
+        bool matchDate( const QDate &testDate ) const;
+    };
+
+    QVector< CompiledConstraint > m_constraints;
+};
+
+/**
+ * @brief A compiled FilterList, see CompiledFilter.
+ *
+ * @ingroup filterSystem
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT CompiledFilterList {
+public:
+    /** @brief Creates an empty compiled filter list, which matches no departure/arrival. */
+    CompiledFilterList() {};
+
+    /** @brief Compiles all filters in @p filterList. */
+    explicit CompiledFilterList( const FilterList &filterList );
+
+    /** @brief Returns true, if one of the filters in this list matches. */
+    bool match( const DepartureInfo &departureInfo ) const;
+
+    /** @brief Whether or not this list contains no filter. */
+    bool isEmpty() const { return m_filters.isEmpty(); };
+
+private:
+    QVector< CompiledFilter > m_filters;
+};
+
+/**
+ * @brief A compiled FilterSettingsList, see CompiledFilter.
+ *
+ * @ingroup filterSystem
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT CompiledFilterSettingsList {
+public:
+    /** @brief Creates an empty compiled filter settings list, which filters nothing out. */
+    CompiledFilterSettingsList() {};
+
+    /** @brief Compiles the filters of all filter settings in @p filterSettingsList. */
+    explicit CompiledFilterSettingsList( const FilterSettingsList &filterSettingsList );
+
+    /** @brief Applies all compiled filter configurations on the given @p departureInfo. */
+    bool filterOut( const DepartureInfo &departureInfo ) const;
+
+private:
+    QVector< QPair<FilterAction, CompiledFilterList> > m_filterSettings;
+};
+
 inline QDebug& operator<<(QDebug debug, const Constraint& constraint)
 {
     return debug << "Constraint, type " << constraint.type << ", variant " << constraint.variant;
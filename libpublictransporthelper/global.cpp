@@ -18,6 +18,7 @@
  */
 
 #include "global.h"
+#include "identityhash.h"
 
 #include <KDebug>
 #include <KIconEffect>
@@ -29,6 +30,7 @@
 #include <qmath.h>
 #include <QPainter>
 #include <KColorUtils>
+#include <QDateTime>
 
 // KCatalogLoader got fixed in KDE 4.6.2, before there're linker errors
 #if KDE_VERSION >= KDE_MAKE_VERSION(4,6,2)
@@ -297,4 +299,29 @@ QColor Global::textColorDelayed()
     return KColorUtils::tint( color, Qt::red, 0.5 );
 }
 
+quint64 Global::departureIdentity( const QDateTime &dateTime, VehicleType vehicleType,
+                                   const QString &transportLine, const QString &target,
+                                   bool isArrival )
+{
+    return IdentityHash::departureIdentity( dateTime, static_cast<int>(vehicleType),
+                                            transportLine, target, isArrival );
+}
+
+quint64 Global::journeyIdentity( const QDateTime &departure, int duration, int changes,
+                                 const QList<VehicleType> &vehicleTypes )
+{
+    QList<VehicleType> sortedVehicleTypes = vehicleTypes;
+    qSort( sortedVehicleTypes );
+
+    quint64 hash = IdentityHash::FNV_OFFSET_BASIS;
+    IdentityHash::hashDateTime( &hash, departure );
+    IdentityHash::hashBytes( &hash, duration, 4 );
+    IdentityHash::hashBytes( &hash, changes, 4 );
+    IdentityHash::hashBytes( &hash, sortedVehicleTypes.count(), 4 );
+    foreach ( VehicleType vehicleType, sortedVehicleTypes ) {
+        IdentityHash::hashBytes( &hash, static_cast<int>(vehicleType), 4 );
+    }
+    return hash;
+}
+
 } // namespace Timetable
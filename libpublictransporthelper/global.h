@@ -60,6 +60,29 @@ public:
 
     static QColor textColorOnSchedule();
     static QColor textColorDelayed();
+
+    /**
+     * @brief Gets a stable 64 bit identity for a departure/arrival.
+     *
+     * The seconds since epoch of @p dateTime, @p vehicleType, the arrival flag and
+     * @p transportLine and @p target (without surrounding whitespace and lower cased) get
+     * streamed into a 64 bit FNV-1a hash, without building any intermediate strings.
+     * Departures that only differ in eg. their delay get the same identity.
+     *
+     * @note The data engine also uses this function, the identity needs to stay stable.
+     **/
+    static quint64 departureIdentity( const QDateTime &dateTime, VehicleType vehicleType,
+                                      const QString &transportLine, const QString &target,
+                                      bool isArrival = false );
+
+    /**
+     * @brief Gets a stable 64 bit identity for a journey.
+     *
+     * Like departureIdentity(), but hashes the departure time, @p duration, @p changes and
+     * the (sorted) @p vehicleTypes of the journey.
+     **/
+    static quint64 journeyIdentity( const QDateTime &departure, int duration, int changes,
+                                    const QList<VehicleType> &vehicleTypes );
 };
 
 } // namespace Timetable
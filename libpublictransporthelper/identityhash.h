@@ -0,0 +1,106 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains the 64 bit FNV-1a hash used for timetable item identities.
+*
+* Header only, it only needs QtCore. The data engine uses it without linking the helper library.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef IDENTITYHASH_HEADER
+#define IDENTITYHASH_HEADER
+
+// Qt includes
+#include <QString>
+#include <QDateTime>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+/** @brief Functions to stream values into a 64 bit FNV-1a hash. */
+namespace IdentityHash {
+
+/** @brief The initial value of a hash. */
+const quint64 FNV_OFFSET_BASIS = Q_UINT64_C(14695981039346656037);
+
+/** @brief The prime multiplied to the hash for each byte. */
+const quint64 FNV_PRIME = Q_UINT64_C(1099511628211);
+
+/** @brief Streams the @p byteCount lowest bytes of @p value into @p hash, lowest byte first. */
+inline void hashBytes( quint64 *hash, quint64 value, int byteCount )
+{
+    for ( int i = 0; i < byteCount; ++i ) {
+        *hash ^= (value >> (8 * i)) & 0xff;
+        *hash *= FNV_PRIME;
+    }
+}
+
+/**
+ * @brief Streams @p string into @p hash without surrounding whitespace and lower cased.
+ *
+ * The string gets prefixed with the length of the normalized string.
+ **/
+inline void hashNormalizedString( quint64 *hash, const QString &string )
+{
+    const QChar *begin = string.constData();
+    const QChar *end = begin + string.length();
+    while ( begin < end && begin->isSpace() ) {
+        ++begin;
+    }
+    while ( end > begin && (end - 1)->isSpace() ) {
+        --end;
+    }
+
+    hashBytes( hash, end - begin, 4 );
+    for ( const QChar *c = begin; c < end; ++c ) {
+        hashBytes( hash, c->toLower().unicode(), 2 );
+    }
+}
+
+/** @brief Streams the seconds since epoch of @p dateTime into @p hash. */
+inline void hashDateTime( quint64 *hash, const QDateTime &dateTime )
+{
+    hashBytes( hash, dateTime.isValid() ? dateTime.toMSecsSinceEpoch() / 1000 : 0, 8 );
+}
+
+/**
+ * @brief Gets the identity of a departure/arrival.
+ *
+ * Used by PublicTransport::Global::departureIdentity() and Global::departureIdentity() of the
+ * data engine. The values of the VehicleType enumerations of the engine and the helper library
+ * are the same, @p vehicleType is one of these values.
+ **/
+inline quint64 departureIdentity( const QDateTime &dateTime, int vehicleType,
+                                  const QString &transportLine, const QString &target,
+                                  bool isArrival )
+{
+    quint64 hash = FNV_OFFSET_BASIS;
+    hashDateTime( &hash, dateTime );
+    hashBytes( &hash, vehicleType, 4 );
+    hashBytes( &hash, isArrival ? 1 : 0, 1 );
+    hashNormalizedString( &hash, transportLine );
+    hashNormalizedString( &hash, target );
+    return hash;
+}
+
+} // namespace IdentityHash
+
+} // namespace PublicTransport
+
+#endif // Multiple inclusion guard
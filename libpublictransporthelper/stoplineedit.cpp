@@ -248,6 +248,10 @@ public:
         if ( !city.isEmpty() ) { // m_useSeparateCityValue ) {
             sourceName += QString("|city=%3").arg( city );
         }
+
+        // Identify this line edit as requester, the engine then cancels pending requests
+        // for previously typed stop names
+        sourceName += QString("|requester=%1").arg( quintptr(q), 0, 16 );
         engine->connectSource( sourceName, q );
     };
 
@@ -23,6 +23,8 @@
 #include "../stopwidget.h"
 #include "../locationmodel.h"
 #include "../checkcombobox.h"
+#include "../departureinfo.h"
+#include "../vehicleiconatlas.h"
 
 #include <Plasma/DataEngineManager>
 #include <KComboBox>
@@ -33,6 +35,11 @@
 #include <QSpinBox>
 #include <QTimeEdit>
 #include <QRadioButton>
+#include <QSet>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QApplication>
+#include <QTextStream>
 #include <qsignalspy.h>
 
 void PublicTransportHelperTest::initTestCase()
@@ -863,5 +870,252 @@ void PublicTransportHelperTest::locationModelTest()
     QCOMPARE( model.data(index, LocationCodeRole).toString(), QLatin1String("de") );
 }
 
+void PublicTransportHelperTest::departureIdentityTest()
+{
+    // The identity needs to be stable across builds, it is also used by the data engine
+    const QDateTime dateTime = QDateTime::fromMSecsSinceEpoch( Q_INT64_C(1367402400000) );
+    QCOMPARE( Global::departureIdentity(dateTime, Bus, " S1 ", "Hauptbahnhof "),
+              Q_UINT64_C(0x49a954f79c142bfb) );
+    QCOMPARE( Global::departureIdentity(dateTime, Bus, "s1", "hauptbahnhof", true),
+              Q_UINT64_C(0x82d8396581076c18) );
+
+    // Departures with another delay are the same departure
+    DepartureInfo departure( "source", 0, DepartureInfo::NoDepartureFlags, QString(),
+                             "S1", "Hauptbahnhof", QString(), dateTime, Bus );
+    DepartureInfo delayedDeparture( "source", 1, DepartureInfo::NoDepartureFlags, QString(),
+                                    "S1", "Hauptbahnhof", QString(), dateTime, Bus,
+                                    false, false, QString(), 5 );
+    QCOMPARE( departure.hash(), Q_UINT64_C(0x49a954f79c142bfb) );
+    QCOMPARE( departure.hash(), delayedDeparture.hash() );
+    QCOMPARE( qHash(departure), qHash(delayedDeparture) );
+
+    // An arrival is not the same as a departure
+    DepartureInfo arrival( "source", 0, DepartureInfo::IsArrival, QString(),
+                           "S1", "Hauptbahnhof", QString(), dateTime, Bus );
+    QVERIFY( departure.hash() != arrival.hash() );
+}
+
+void PublicTransportHelperTest::departureIdentityCollisionTest()
+{
+    // Every minute of one day for some lines, targets, vehicle types and departures/arrivals
+    const QDateTime start( QDate(2013, 5, 1), QTime(0, 0) );
+    const QList< VehicleType > vehicleTypes = QList< VehicleType >()
+            << Tram << Bus << RegionalTrain;
+    QSet< quint64 > identities;
+    int count = 0;
+    for ( int minute = 0; minute < 24 * 60; ++minute ) {
+        const QDateTime dateTime = start.addSecs( minute * 60 );
+        for ( int line = 1; line <= 12; ++line ) {
+            const QString lineString = QString::number( line );
+            for ( int target = 0; target < 4; ++target ) {
+                const QString targetString = QString("Target %1").arg( target );
+                foreach ( VehicleType vehicleType, vehicleTypes ) {
+                    identities << Global::departureIdentity( dateTime, vehicleType,
+                                                             lineString, targetString, false )
+                               << Global::departureIdentity( dateTime, vehicleType,
+                                                             lineString, targetString, true );
+                    count += 2;
+                }
+            }
+        }
+    }
+    QCOMPARE( identities.count(), count );
+}
+
+static QList< DepartureInfo > testDepartures( int count )
+{
+    const QDateTime start( QDate(2013, 5, 1), QTime(4, 0) );
+    const QList< VehicleType > vehicleTypes = QList< VehicleType >()
+            << Tram << Bus << Subway << RegionalTrain << Ferry;
+    const QStringList stops = QStringList() << "Hauptbahnhof" << "Marktplatz" << "Am Wasserturm"
+            << "Universität" << "Flughafen" << "Stadion" << "Nordfriedhof";
+    QList< DepartureInfo > departures;
+    for ( int i = 0; i < count; ++i ) {
+        QStringList routeStops;
+        if ( i % 5 != 0 ) {
+            // Some departures without route stops
+            for ( int s = 0; s < 2 + i % 4; ++s ) {
+                routeStops << stops[ (i + s) % stops.count() ];
+            }
+        }
+        const DepartureInfo::DepartureFlags flags = i % 7 == 0
+                ? DepartureInfo::IsArrival : DepartureInfo::NoDepartureFlags;
+        departures << DepartureInfo( "source", i, flags, QString(),
+                QString("%1%2").arg(i % 3 == 0 ? "S" : "").arg(1 + i % 12),
+                stops[i % stops.count()], QString(), start.addSecs(i * 97),
+                vehicleTypes[i % vehicleTypes.count()], false, false, QString(),
+                i % 4 == 0 ? -1 : i % 9, QString(), QString(), QString(),
+                routeStops, QStringList(), QList<QDateTime>(), i % 3 );
+    }
+    return departures;
+}
+
+static FilterSettingsList testFilterSettings()
+{
+    const QVariantList vehicleTypes = QVariantList() << static_cast<int>(Bus)
+            << static_cast<int>(Ferry);
+    const QVariantList daysOfWeek = QVariantList() << 1 << 3;
+    const QList< Constraint > constraints = QList< Constraint >()
+            << Constraint( FilterByTarget, FilterContains, "markt" )
+            << Constraint( FilterByTarget, FilterDoesntContain, "HAUPT" )
+            << Constraint( FilterByTarget, FilterEquals, "stadion" )
+            << Constraint( FilterByTarget, FilterMatchesRegExp, "^(Flug|Uni)" )
+            << Constraint( FilterByTarget, FilterDoesntMatchRegExp, "^Haupt" )
+            << Constraint( FilterByVia, FilterContains, "turm" )
+            << Constraint( FilterByVia, FilterMatchesRegExp, "friedhof$" )
+            << Constraint( FilterByNextStop, FilterEquals, "Marktplatz" )
+            << Constraint( FilterByNextStop, FilterDoesntEqual, "Stadion" )
+            << Constraint( FilterByTransportLine, FilterMatchesRegExp, "^S\\d$" )
+            << Constraint( FilterByTransportLine, FilterDoesntContain, "s1" )
+            << Constraint( FilterByTransportLineNumber, FilterGreaterThan, 6 )
+            << Constraint( FilterByTransportLineNumber, FilterEquals, 3 )
+            << Constraint( FilterByDelay, FilterLessThan, 3 )
+            << Constraint( FilterByDelay, FilterDoesntEqual, 0 )
+            << Constraint( FilterByVehicleType, FilterIsOneOf, vehicleTypes )
+            << Constraint( FilterByVehicleType, FilterIsntOneOf, vehicleTypes )
+            << Constraint( FilterByDepartureTime, FilterGreaterThan, QTime(12, 30) )
+            << Constraint( FilterByDepartureDate, FilterLessThan, QDate(2013, 5, 2) )
+            << Constraint( FilterByDayOfWeek, FilterIsOneOf, daysOfWeek );
+
+    // 20 filters, each with one or two constraints, in ten filter settings
+    FilterSettingsList filterSettingsList;
+    for ( int i = 0; i < 10; ++i ) {
+        FilterSettings filterSettings( QString("Filter %1").arg(i) );
+        filterSettings.filterAction = i % 2 == 0 ? HideMatching : ShowMatching;
+        for ( int f = 0; f < 2; ++f ) {
+            const int index = 2 * i + f;
+            Filter filter;
+            filter << constraints[index];
+            if ( index % 3 == 0 ) {
+                filter << constraints[(index + 7) % constraints.count()];
+            }
+            filterSettings.filters << filter;
+        }
+        filterSettingsList << filterSettings;
+    }
+    return filterSettingsList;
+}
+
+void PublicTransportHelperTest::compiledFilterTest()
+{
+    const QList< DepartureInfo > departures = testDepartures( 500 );
+    const FilterSettingsList filterSettingsList = testFilterSettings();
+    int matchCount = 0;
+    int testCount = 0;
+    foreach ( const FilterSettings &filterSettings, filterSettingsList ) {
+        foreach ( const Filter &filter, filterSettings.filters ) {
+            const CompiledFilter compiledFilter( filter );
+            foreach ( const DepartureInfo &departure, departures ) {
+                const bool matches = filter.match( departure );
+                QCOMPARE( compiledFilter.match(departure), matches );
+                if ( matches ) {
+                    ++matchCount;
+                }
+                ++testCount;
+            }
+        }
+    }
+
+    // The test departures should not all match or all not match
+    QVERIFY( matchCount > 0 && matchCount < testCount );
+
+    const CompiledFilterSettingsList compiledFilterSettingsList( filterSettingsList );
+    foreach ( const DepartureInfo &departure, departures ) {
+        QCOMPARE( compiledFilterSettingsList.filterOut(departure),
+                  filterSettingsList.filterOut(departure) );
+    }
+
+    // Empty compiled filters match everything, empty lists match nothing
+    QVERIFY( CompiledFilter().match(departures.first()) );
+    QVERIFY( !CompiledFilterList().match(departures.first()) );
+    QVERIFY( !CompiledFilterSettingsList().filterOut(departures.first()) );
+}
+
+void PublicTransportHelperTest::filterBenchmark_data()
+{
+    QTest::addColumn< bool >( "compiled" );
+    QTest::newRow( "Filter" ) << false;
+    QTest::newRow( "CompiledFilter" ) << true;
+}
+
+void PublicTransportHelperTest::filterBenchmark()
+{
+    QFETCH( bool, compiled );
+    const QList< DepartureInfo > departures = testDepartures( 1000 );
+    const FilterSettingsList filterSettingsList = testFilterSettings();
+
+    int filteredOut = 0;
+    if ( compiled ) {
+        QBENCHMARK {
+            // Filters get compiled once for all departures, eg. in DepartureProcessor
+            const CompiledFilterSettingsList compiledFilterSettingsList( filterSettingsList );
+            filteredOut = 0;
+            foreach ( const DepartureInfo &departure, departures ) {
+                if ( compiledFilterSettingsList.filterOut(departure) ) {
+                    ++filteredOut;
+                }
+            }
+        }
+    } else {
+        QBENCHMARK {
+            filteredOut = 0;
+            foreach ( const DepartureInfo &departure, departures ) {
+                if ( filterSettingsList.filterOut(departure) ) {
+                    ++filteredOut;
+                }
+            }
+        }
+    }
+    QVERIFY( filteredOut > 0 );
+}
+
+void PublicTransportHelperTest::vehicleIconAtlasTest()
+{
+    QCOMPARE( VehicleIconAtlas::iconKey(Tram), QString("tram") );
+    QCOMPARE( VehicleIconAtlas::iconKey(Bus, VehicleIconAtlas::MonochromeIcon |
+                                             VehicleIconAtlas::EmptyIcon),
+              QString("bus_white_empty") );
+    QVERIFY( VehicleIconAtlas::iconKey(UnknownVehicleType).isEmpty() );
+    QCOMPARE( VehicleIconAtlas::bucketSize(QSize(17, 24)), QSize(24, 24) );
+    QCOMPARE( VehicleIconAtlas::transportLineText("N 1"), QString("N1") );
+    QCOMPARE( VehicleIconAtlas::transportLineText("Airport Express"), QString("AE") );
+
+    // Create an SVG file with two elements, "tram" covers the whole document
+    QTemporaryFile svgFile( QDir::tempPath() + "/vehicleiconatlastest_XXXXXX.svg" );
+    QVERIFY( svgFile.open() );
+    QTextStream stream( &svgFile );
+    stream << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"100\" height=\"100\">"
+              "<rect id=\"tram\" x=\"0\" y=\"0\" width=\"100\" height=\"100\" fill=\"red\"/>"
+              "<rect id=\"bus_empty\" x=\"0\" y=\"0\" width=\"50\" height=\"100\" fill=\"blue\"/>"
+              "</svg>";
+    stream.flush();
+    svgFile.close();
+    const QString svgFilePath = svgFile.fileName();
+
+    // The first icon gets rendered directly, the buckets get rendered in the background
+    VehicleIconAtlas atlas;
+    const QImage tramIcon = atlas.icon( svgFilePath, "tram", QSize(30, 30) );
+    QCOMPARE( tramIcon.size(), QSize(30, 30) );
+    QCOMPARE( atlas.directlyRenderedIconCount(), 1 );
+    atlas.waitForRendering();
+    QCOMPARE( atlas.prerenderedIconCount(), 6 ); // 2 elements in 3 buckets (24, 32, 40)
+
+    // Icons of pre-rendered buckets get scaled, elements are scaled like the document
+    const QImage busIcon = atlas.icon( svgFilePath, "bus_empty", QSize(38, 38) );
+    QCOMPARE( busIcon.size(), QSize(19, 38) );
+    QCOMPARE( atlas.directlyRenderedIconCount(), 1 );
+    QCOMPARE( QColor(busIcon.pixel(10, 20)), QColor(Qt::blue) );
+
+    // Not existing elements give null images
+    QVERIFY( atlas.icon(svgFilePath, "plane", QSize(30, 30)).isNull() );
+
+    // Draw a transport line string into the empty icon
+    const QImage busLineIcon = atlas.iconWithTransportLine( svgFilePath, Bus,
+            VehicleIconAtlas::ColoredIcon, QSize(38, 38), "N 1", QApplication::font() );
+    QCOMPARE( busLineIcon.size(), busIcon.size() );
+    QVERIFY( busLineIcon != busIcon );
+    QCOMPARE( atlas.directlyRenderedIconCount(), 1 );
+}
+
 QTEST_MAIN(PublicTransportHelperTest)
 #include "PublicTransportHelperTest.moc"
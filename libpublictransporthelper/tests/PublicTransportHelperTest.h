@@ -70,6 +70,22 @@ private slots:
 
     void locationModelTest();
 
+    // Tests Global::departureIdentity() and DepartureInfo::hash()
+    void departureIdentityTest();
+
+    // Tests for collisions of Global::departureIdentity() for many similar departures
+    void departureIdentityCollisionTest();
+
+    // Tests CompiledFilter and CompiledFilterSettingsList against Filter/FilterSettingsList
+    void compiledFilterTest();
+
+    // Benchmarks matching 1000 departures with 20 filters, compiled and not compiled
+    void filterBenchmark_data();
+    void filterBenchmark();
+
+    // Tests VehicleIconAtlas with a small SVG file
+    void vehicleIconAtlasTest();
+
 private:
     StopSettings m_stopSettings;
     FilterSettingsList m_filterConfigurations;
@@ -0,0 +1,447 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "vehicleiconatlas.h"
+
+// KDE includes
+#include <KGlobal>
+#include <KDebug>
+
+// Qt includes
+#include <QSvgRenderer>
+#include <QPainter>
+#include <QPainterPath>
+#include <QFontMetrics>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCache>
+#include <QHash>
+#include <QStringList>
+#include <QRegExp>
+#include <qmath.h>
+
+namespace PublicTransport {
+
+const int VehicleIconAtlas::SIZE_BUCKET_STEP = 8;
+const int VehicleIconAtlas::MAXIMUM_BUCKETS = 6;
+const int VehicleIconAtlas::MAXIMUM_CACHED_IMAGES = 300;
+
+K_GLOBAL_STATIC( VehicleIconAtlas, globalVehicleIconAtlas )
+
+// Render the SVG element elementKey, scaled like the whole document gets scaled to size,
+// which is what Plasma::Svg::paint() does after Plasma::Svg::resize()
+static QImage renderElement( QSvgRenderer *renderer, const QString &elementKey,
+                             const QSize &size )
+{
+    const QSize documentSize = renderer->defaultSize();
+    if ( documentSize.isEmpty() ) {
+        return QImage();
+    }
+    const QRectF elementRect = renderer->matrixForElement( elementKey ).mapRect(
+            renderer->boundsOnElement(elementKey) );
+    const QSize imageSize(
+            qMax(1, qRound(elementRect.width() * size.width() / documentSize.width())),
+            qMax(1, qRound(elementRect.height() * size.height() / documentSize.height())) );
+
+    QImage image( imageSize, QImage::Format_ARGB32_Premultiplied );
+    image.fill( Qt::transparent );
+    QPainter painter( &image );
+    painter.setRenderHint( QPainter::Antialiasing );
+    renderer->render( &painter, elementKey, QRectF(QPointF(0, 0), imageSize) );
+    painter.end();
+    return image;
+}
+
+// Get the keys of all SVG elements that can be returned by VehicleIconAtlas::iconKey()
+static QStringList allIconKeys()
+{
+    static const VehicleType vehicles[] = { Tram, Bus, TrolleyBus, Subway, Metro,
+            InterurbanTrain, RegionalTrain, RegionalExpressTrain, InterregionalTrain,
+            IntercityTrain, HighSpeedTrain, Feet, Ship, Plane };
+    QStringList keys;
+    for ( uint i = 0; i < sizeof(vehicles) / sizeof(vehicles[0]); ++i ) {
+        for ( int flags = 0; flags <= 3; ++flags ) {
+            keys << VehicleIconAtlas::iconKey( vehicles[i], VehicleIconAtlas::IconFlags(flags) );
+        }
+    }
+    return keys;
+}
+
+class VehicleIconAtlasPrivate {
+public:
+    // Rendered icons of a bucket by element key
+    typedef QHash< QString, QImage > BucketIcons;
+
+    VehicleIconAtlasPrivate() : prerenderedIconCount(0), directlyRenderedIconCount(0)
+    {
+        images.setMaxCost( VehicleIconAtlas::MAXIMUM_CACHED_IMAGES );
+
+        // Rendering icons is not urgent, do not use more than one thread
+        threadPool.setMaxThreadCount( 1 );
+    };
+
+    ~VehicleIconAtlasPrivate()
+    {
+        threadPool.waitForDone();
+        qDeleteAll( renderers );
+    };
+
+    static QString bucketKey( const QString &svgFilePath, const QSize &bucket )
+    {
+        return QString("%1|%2x%3").arg( svgFilePath ).arg( bucket.width() ).arg( bucket.height() );
+    };
+
+    // private function, mutex is expected to be already locked
+    void prerender( const QString &svgFilePath, const QSize &size );
+
+    // private function, mutex is expected to be already locked
+    QSvgRenderer *renderer( const QString &svgFilePath );
+
+    mutable QMutex mutex;
+    QHash< QString, BucketIcons > icons; // Rendered icons by bucket key
+    QHash< QString, QList<QSize> > buckets; // Buckets by SVG file path, oldest first
+    QCache< QString, QImage > images; // Scaled icons and icons with transport line
+    QHash< QString, QSvgRenderer* > renderers; // Renderers for directly rendered icons
+    QThreadPool threadPool;
+    int prerenderedIconCount;
+    int directlyRenderedIconCount;
+};
+
+/** @brief Renders all icons of an SVG file for a size bucket. */
+class VehicleIconRenderJob : public QRunnable {
+public:
+    VehicleIconRenderJob( VehicleIconAtlasPrivate *d, const QString &svgFilePath,
+                          const QSize &bucket )
+            : d(d), m_svgFilePath(svgFilePath), m_bucket(bucket) {};
+
+    virtual void run()
+    {
+        // Use an own renderer, renderers cannot be shared between threads
+        QSvgRenderer renderer( m_svgFilePath );
+        if ( !renderer.isValid() ) {
+            kDebug() << "Cannot render vehicle icons, invalid SVG file" << m_svgFilePath;
+            return;
+        }
+
+        VehicleIconAtlasPrivate::BucketIcons renderedIcons;
+        foreach ( const QString &elementKey, allIconKeys() ) {
+            if ( renderer.elementExists(elementKey) ) {
+                renderedIcons.insert( elementKey, renderElement(&renderer, elementKey, m_bucket) );
+            }
+        }
+
+        QMutexLocker locker( &d->mutex );
+        QHash< QString, VehicleIconAtlasPrivate::BucketIcons >::Iterator it =
+                d->icons.find( VehicleIconAtlasPrivate::bucketKey(m_svgFilePath, m_bucket) );
+        if ( it == d->icons.end() ) {
+            return; // The bucket was removed in the meantime
+        }
+        for ( VehicleIconAtlasPrivate::BucketIcons::ConstIterator iconIt = renderedIcons.constBegin();
+              iconIt != renderedIcons.constEnd(); ++iconIt )
+        {
+            if ( !it->contains(iconIt.key()) ) {
+                it->insert( iconIt.key(), iconIt.value() );
+            }
+        }
+        d->prerenderedIconCount += renderedIcons.count();
+    };
+
+private:
+    VehicleIconAtlasPrivate *d;
+    const QString m_svgFilePath;
+    const QSize m_bucket;
+};
+
+void VehicleIconAtlasPrivate::prerender( const QString &svgFilePath, const QSize &size )
+{
+    // Also render the neighbouring buckets, which get used when zooming
+    const QSize bucket = VehicleIconAtlas::bucketSize( size );
+    const QSize step( VehicleIconAtlas::SIZE_BUCKET_STEP, VehicleIconAtlas::SIZE_BUCKET_STEP );
+    QList< QSize > newBuckets;
+    newBuckets << bucket - step << bucket << bucket + step;
+
+    QList< QSize > &fileBuckets = buckets[ svgFilePath ];
+    foreach ( const QSize &newBucket, newBuckets ) {
+        const QString key = bucketKey( svgFilePath, newBucket );
+        if ( newBucket.isEmpty() || icons.contains(key) ) {
+            continue;
+        }
+
+        icons.insert( key, BucketIcons() );
+        fileBuckets << newBucket;
+        threadPool.start( new VehicleIconRenderJob(this, svgFilePath, newBucket) );
+    }
+
+    // Remove the oldest buckets
+    while ( fileBuckets.count() > VehicleIconAtlas::MAXIMUM_BUCKETS ) {
+        icons.remove( bucketKey(svgFilePath, fileBuckets.takeFirst()) );
+    }
+}
+
+QSvgRenderer *VehicleIconAtlasPrivate::renderer( const QString &svgFilePath )
+{
+    QSvgRenderer *svgRenderer = renderers.value( svgFilePath );
+    if ( !svgRenderer ) {
+        svgRenderer = new QSvgRenderer( svgFilePath );
+        renderers.insert( svgFilePath, svgRenderer );
+    }
+    return svgRenderer;
+}
+
+VehicleIconAtlas::VehicleIconAtlas() : d_ptr(new VehicleIconAtlasPrivate)
+{
+}
+
+VehicleIconAtlas::~VehicleIconAtlas()
+{
+    delete d_ptr;
+}
+
+VehicleIconAtlas *VehicleIconAtlas::instance()
+{
+    return globalVehicleIconAtlas;
+}
+
+QString VehicleIconAtlas::iconKey( VehicleType vehicle, IconFlags flags )
+{
+    QString vehicleKey;
+    switch ( vehicle ) {
+        case Tram: vehicleKey = "tram"; break;
+        case Bus: vehicleKey = "bus"; break;
+        case TrolleyBus: vehicleKey = "trolleybus"; break;
+        case Subway: vehicleKey = "subway"; break;
+        case Metro: vehicleKey = "metro"; break;
+        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
+        case RegionalTrain: vehicleKey = "regionaltrain"; break;
+        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
+        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
+        case IntercityTrain: vehicleKey = "intercitytrain"; break;
+        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
+        case Feet: vehicleKey = "feet"; break;
+        case Ship: vehicleKey = "ship"; break;
+        case Plane: vehicleKey = "plane"; break;
+        default:
+            return QString();
+    }
+
+    // Use monochrome (mostly white) icons
+    if ( flags.testFlag(MonochromeIcon) ) {
+        vehicleKey.append( "_white" );
+    }
+    if ( flags.testFlag(EmptyIcon) ) {
+        vehicleKey.append( "_empty" );
+    }
+
+    return vehicleKey;
+}
+
+QSize VehicleIconAtlas::bucketSize( const QSize &size )
+{
+    return QSize( qMax(1, (size.width() + SIZE_BUCKET_STEP - 1) / SIZE_BUCKET_STEP),
+                  qMax(1, (size.height() + SIZE_BUCKET_STEP - 1) / SIZE_BUCKET_STEP) )
+            * SIZE_BUCKET_STEP;
+}
+
+QString VehicleIconAtlas::transportLineText( const QString &transportLine )
+{
+    QString text;
+    if ( transportLine.length() > 8 ) {
+        // The transport line string is too long to be drawn inside a vehicle icon
+        const QStringList words = transportLine.split( QRegExp("[ \\-_\\+&/\\\\]"),
+                                                       QString::SkipEmptyParts );
+        if ( words.count() == 1 ) {
+            // No spaces in the transport line string, remove all lower case letters
+            text = words[0];
+            text.remove( QRegExp("[a-z]+") );
+            if ( text.length() > 8 ) {
+                // Still more than eight characters, cut the string
+                text = text.left( 8 );
+            }
+        } else {
+            // Multiple words in the transport line string,
+            // create an abbreviation by only using the first letter of each word
+            foreach ( const QString &word, words ) {
+                text += word[0]; // Empty parts are skipped, therefore word is not empty
+            }
+        }
+    } else {
+        text = transportLine;
+        text.remove( ' ' );
+    }
+    return text;
+}
+
+void VehicleIconAtlas::prerender( const QString &svgFilePath, const QSize &size )
+{
+    Q_D( VehicleIconAtlas );
+    if ( svgFilePath.isEmpty() || size.isEmpty() ) {
+        return;
+    }
+
+    QMutexLocker locker( &d->mutex );
+    d->prerender( svgFilePath, size );
+}
+
+QImage VehicleIconAtlas::icon( const QString &svgFilePath, const QString &elementKey,
+                               const QSize &size )
+{
+    Q_D( VehicleIconAtlas );
+    if ( svgFilePath.isEmpty() || elementKey.isEmpty() || size.isEmpty() ) {
+        return QImage();
+    }
+
+    const QString imageKey = QString("%1|%2x%3|").arg( svgFilePath )
+            .arg( size.width() ).arg( size.height() ) + elementKey;
+    QMutexLocker locker( &d->mutex );
+    const QImage *cachedImage = d->images.object( imageKey );
+    if ( cachedImage ) {
+        return *cachedImage;
+    }
+
+    // Start rendering the bucket in the background, if not already done
+    const QSize bucket = bucketSize( size );
+    const QString key = VehicleIconAtlasPrivate::bucketKey( svgFilePath, bucket );
+    if ( !d->icons.contains(key) ) {
+        d->prerender( svgFilePath, size );
+    }
+
+    QImage bucketIcon = d->icons[ key ].value( elementKey );
+    if ( bucketIcon.isNull() ) {
+        // The bucket is not rendered yet, render only the requested icon directly
+        QSvgRenderer *renderer = d->renderer( svgFilePath );
+        if ( !renderer->isValid() || !renderer->elementExists(elementKey) ) {
+            kDebug() << "SVG element" << elementKey << "not found in" << svgFilePath;
+            return QImage();
+        }
+        bucketIcon = renderElement( renderer, elementKey, bucket );
+        d->icons[ key ].insert( elementKey, bucketIcon );
+        ++d->directlyRenderedIconCount;
+    }
+
+    // Scale the icon of the bucket down to the requested size
+    const QSize imageSize(
+            qMax(1, qRound(qreal(bucketIcon.width()) * size.width() / bucket.width())),
+            qMax(1, qRound(qreal(bucketIcon.height()) * size.height() / bucket.height())) );
+    const QImage image = imageSize == bucketIcon.size() ? bucketIcon
+            : bucketIcon.scaled( imageSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+    d->images.insert( imageKey, new QImage(image) );
+    return image;
+}
+
+QImage VehicleIconAtlas::iconWithTransportLine( const QString &svgFilePath, VehicleType vehicle,
+        IconFlags flags, const QSize &size, const QString &transportLine, const QFont &font,
+        TextStyle textStyle )
+{
+    Q_D( VehicleIconAtlas );
+    const QString text = transportLineText( transportLine );
+    if ( text.isEmpty() ) {
+        return icon( svgFilePath, iconKey(vehicle, flags & ~EmptyIcon), size );
+    }
+
+    const QString elementKey = iconKey( vehicle, flags | EmptyIcon );
+    const QString imageKey = QString("%1|%2x%3|%4|%5|%6|").arg( svgFilePath )
+            .arg( size.width() ).arg( size.height() ).arg( elementKey ).arg( font.family() )
+            .arg( static_cast<int>(textStyle) ) + text;
+    {
+        QMutexLocker locker( &d->mutex );
+        const QImage *cachedImage = d->images.object( imageKey );
+        if ( cachedImage ) {
+            return *cachedImage;
+        }
+    }
+
+    QImage image = icon( svgFilePath, elementKey, size );
+    if ( image.isNull() ) {
+        return image;
+    }
+
+    // Draw the transport line string into the empty icon
+    QFont textFont( font );
+    textFont.setBold( true );
+    if ( text.length() > 2 ) {
+        textFont.setPixelSize( qMax(8, qCeil(1.18 * image.width() / text.length())) );
+    } else {
+        textFont.setPixelSize( qMax(1, qRound(image.width() * 0.5)) );
+    }
+
+    QPainter painter( &image );
+    painter.setRenderHint( QPainter::Antialiasing );
+    painter.setFont( textFont );
+    if ( textStyle == OutlinedText ) {
+        // Draw white text with a dark gray outline
+        const QFontMetrics fm( textFont );
+        QPen textOutlinePen( QColor(0, 0, 0, 100) );
+        textOutlinePen.setWidthF( qMin(qreal(10.0), qreal(textFont.pixelSize() / 5.0)) );
+        textOutlinePen.setCapStyle( Qt::RoundCap );
+        textOutlinePen.setJoinStyle( Qt::RoundJoin );
+        QPainterPath textPath;
+        textPath.addText( (image.width() - fm.width(text)) / 2.0,
+                          image.height() - (image.height() - fm.ascent() + fm.descent()) / 2.0,
+                          textFont, text );
+        painter.setPen( textOutlinePen );
+        painter.drawPath( textPath );
+        painter.fillPath( textPath, Qt::white );
+    } else {
+        painter.setPen( Qt::white );
+        painter.drawText( image.rect(), text, QTextOption(Qt::AlignCenter) );
+    }
+    painter.end();
+
+    QMutexLocker locker( &d->mutex );
+    d->images.insert( imageKey, new QImage(image) );
+    return image;
+}
+
+void VehicleIconAtlas::waitForRendering()
+{
+    Q_D( VehicleIconAtlas );
+    d->threadPool.waitForDone();
+}
+
+void VehicleIconAtlas::clear()
+{
+    Q_D( VehicleIconAtlas );
+    d->threadPool.waitForDone();
+
+    QMutexLocker locker( &d->mutex );
+    d->icons.clear();
+    d->buckets.clear();
+    d->images.clear();
+    qDeleteAll( d->renderers );
+    d->renderers.clear();
+}
+
+int VehicleIconAtlas::prerenderedIconCount() const
+{
+    Q_D( const VehicleIconAtlas );
+    QMutexLocker locker( &d->mutex );
+    return d->prerenderedIconCount;
+}
+
+int VehicleIconAtlas::directlyRenderedIconCount() const
+{
+    Q_D( const VehicleIconAtlas );
+    QMutexLocker locker( &d->mutex );
+    return d->directlyRenderedIconCount;
+}
+
+} // namespace PublicTransport
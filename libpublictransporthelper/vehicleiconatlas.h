@@ -0,0 +1,163 @@
+/*
+ *   Copyright 2013 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains a shared atlas of pre-rendered vehicle type icons.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef VEHICLEICONATLAS_HEADER
+#define VEHICLEICONATLAS_HEADER
+
+// Own includes
+#include "publictransporthelper_export.h"
+#include "enums.h"
+
+// Qt includes
+#include <QImage>
+
+class QFont;
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+class VehicleIconAtlasPrivate;
+
+/**
+ * @brief A process wide atlas of vehicle type icons, rendered from SVG files.
+ *
+ * Icons get rendered for size buckets, ie. requested sizes get rounded up to a multiple of
+ * SIZE_BUCKET_STEP and the icons of a bucket get scaled down to the requested size. All icons
+ * of an SVG file for a bucket (and the neighbouring buckets, for zooming) get rendered at once
+ * in a background thread, when an icon of the bucket gets requested the first time or when
+ * prerender() gets called. Only if an icon is requested before its bucket is rendered, the
+ * single icon gets rendered directly.
+ *
+ * The transport line string can be drawn on top of "empty" icons using
+ * iconWithTransportLine(). Scaled icons and icons with transport line get cached.
+ *
+ * The functions of the atlas are thread safe, but icon() and iconWithTransportLine() should be
+ * called from the GUI thread, because they may render into QImages using the given font.
+ *
+ * @code
+ * VehicleIconAtlas *atlas = VehicleIconAtlas::instance();
+ * QImage icon = atlas->icon( svg->imagePath(), VehicleIconAtlas::iconKey(Tram), QSize(32, 32) );
+ * @endcode
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT VehicleIconAtlas {
+public:
+    /** @brief Flags for the SVG elements to use for vehicle type icons. */
+    enum IconFlag {
+        ColoredIcon      = 0x0, /**< The default colored vehicle icon. */
+        EmptyIcon        = 0x1, /**< Vehicle icon without content like "tram", "bus", etc.
+                * Used to draw the transport line string into the icon. */
+        MonochromeIcon   = 0x2 /**< Use monochrome version of the icon. */
+    };
+    Q_DECLARE_FLAGS( IconFlags, IconFlag )
+
+    /** @brief How to draw transport line strings in iconWithTransportLine(). */
+    enum TextStyle {
+        PlainText, /**< Draw white text. */
+        OutlinedText /**< Draw white text with a dark outline, eg. for monochrome icons. */
+    };
+
+    /** @brief Icon sizes get rounded up to a multiple of this step. */
+    static const int SIZE_BUCKET_STEP;
+
+    /** @brief The maximal number of size buckets to keep, per SVG file. */
+    static const int MAXIMUM_BUCKETS;
+
+    /** @brief The maximal number of cached scaled icons and icons with transport line. */
+    static const int MAXIMUM_CACHED_IMAGES;
+
+    /** @brief Get the global atlas instance, shared by all applets. */
+    static VehicleIconAtlas *instance();
+
+    /** @brief Create a new empty atlas, use instance() to get the shared atlas. */
+    VehicleIconAtlas();
+    ~VehicleIconAtlas();
+
+    /**
+     * @brief Get the SVG element key for @p vehicle with @p flags, eg. "tram_white".
+     *
+     * An empty string gets returned for unknown vehicle types.
+     **/
+    static QString iconKey( VehicleType vehicle, IconFlags flags = ColoredIcon );
+
+    /** @brief Get the size of the bucket to use for icons of @p size. */
+    static QSize bucketSize( const QSize &size );
+
+    /**
+     * @brief Get a shortened version of @p transportLine to draw into vehicle icons.
+     *
+     * Spaces get removed, strings with more than eight characters get abbreviated.
+     **/
+    static QString transportLineText( const QString &transportLine );
+
+    /**
+     * @brief Start rendering all icons of @p svgFilePath for @p size in a background thread.
+     *
+     * Should be called when the icon size changes, eg. when the zoom factor changes, to have
+     * the icons ready when they get painted. Does nothing if the icons are already rendered.
+     **/
+    void prerender( const QString &svgFilePath, const QSize &size );
+
+    /**
+     * @brief Get the icon for the SVG element @p elementKey in @p svgFilePath.
+     *
+     * The SVG element gets scaled like the SVG document would be scaled to @p size, ie. like
+     * Plasma::Svg::paint() after Plasma::Svg::resize(). A null image gets returned if there is
+     * no such element.
+     **/
+    QImage icon( const QString &svgFilePath, const QString &elementKey, const QSize &size );
+
+    /**
+     * @brief Get the empty icon of @p vehicle with the transport line string drawn into it.
+     *
+     * The text gets drawn bold using the family of @p font, its pixel size depends on @p size
+     * and the length of the text, see transportLineText(). If @p transportLine is empty, the
+     * normal icon of @p vehicle gets returned.
+     **/
+    QImage iconWithTransportLine( const QString &svgFilePath, VehicleType vehicle,
+                                  IconFlags flags, const QSize &size,
+                                  const QString &transportLine, const QFont &font,
+                                  TextStyle textStyle = PlainText );
+
+    /** @brief Wait until all background rendering is done. */
+    void waitForRendering();
+
+    /** @brief Remove all rendered icons. */
+    void clear();
+
+    /** @brief The number of icons that were rendered in background threads. */
+    int prerenderedIconCount() const;
+
+    /** @brief The number of icons that needed to be rendered directly. */
+    int directlyRenderedIconCount() const;
+
+private:
+    Q_DISABLE_COPY( VehicleIconAtlas )
+    Q_DECLARE_PRIVATE( VehicleIconAtlas )
+    VehicleIconAtlasPrivate *const d_ptr;
+};
+
+} // namespace PublicTransport
+
+Q_DECLARE_OPERATORS_FOR_FLAGS( PublicTransport::VehicleIconAtlas::IconFlags )
+
+#endif // Multiple inclusion guard